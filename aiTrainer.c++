@@ -12,6 +12,8 @@
 #include <iostream>
 using namespace std;
 #include <fstream>
+#include <vector>
+#include <atomic>
 
 #include <signal.h>
 #include <pthread.h>
@@ -30,6 +32,12 @@ using namespace std;
 #include "joystick.h"
 #include "net_ctrls.hxx"
 #include "neuralNet.h"
+#include "dataSet.h"
+#include "dataRecorder.h"
+#include "brainSweep.h"
+#include "eyeEncoder.h"
+#include "seekerEncoding.h"
+#include "fastMath.h"
 
 #include "gvpApiClient.hpp"
 #include "gvpTimer.hpp"
@@ -49,7 +57,9 @@ enum Mode
   {
     TRAININGMODE,
     RECORDINGMODE,
-    TESTINGMODE
+    TESTINGMODE,
+    IMPORTMODE,
+    SWEEPMODE
   };
 
 
@@ -62,8 +72,12 @@ bool activateNeuralNet = false;
 bool DONE = false;
 
 
-// Position datastruct from fgFdmReceiver
+// Position datastruct from fgFdmReceiver,
+// and how many FDM packets it's been
+// filled from, so a sample's only
+// recorded once
 localDataStruct posData;
+atomic<unsigned long> fdmPackets(0);
 
 
 // Target data, position of target used
@@ -105,6 +119,26 @@ joystickValues jsVals;
 int HIDDENNEURONS  = 12;
 
 
+// Training on a binary data set, passes
+// over the whole set, and samples per
+// shuffled mini batch
+#define TRAININGEPOCHS 5000
+#define BATCHSIZE      32
+
+// Text files to convert, for import mode
+vector<string> importFiles;
+
+// Record mode can also record the same
+// flight with continuous inputs (see
+// utils/seekerEncoding.h), with or
+// without airspeed
+string continuousFileName;
+bool   continuousAirspeed = true;
+
+// Candidates to try, for sweep mode
+sweepSettings sweep;
+
+
 
 // The angular distance in degrees
 // for example, if the trgt is 
@@ -114,13 +148,6 @@ int HIDDENNEURONS  = 12;
 #define SIDEBOUNDRY 8.0
 #define VERTBOUNDRY 8.0
 
-bool onSide   = false;
-bool onLeft   = false;
-bool onRight  = false;
-bool onVert   = false;
-bool onTop    = false;
-bool onBottom = false;
-
 
 
 // All booleans
@@ -153,7 +180,6 @@ struct brainOutputs
 
 
 
-brainInputs  neuralInputData;
 brainOutputs neuralOutputData;
 
 
@@ -239,7 +265,32 @@ void runNeuralNetData()
   unsigned long view     = gvp->getViewEntity();
   unsigned long targetID = 0;
   
-  ofstream trainingDataFile;
+  // Background writer for RECORDINGMODE
+  DataRecorder *recorder = NULL;
+  float         sampleInputs [EYE_INPUTS];
+  float         sampleTargets[STICK_OUTPUTS];
+  struct timespec sampleTime;
+  unsigned long recordedPacket = 0;
+  unsigned long packet;
+
+  // Continuous inputs, if recording them
+  // too, or testing a continuous brain
+  DataRecorder    *continuousRecorder = NULL;
+  SeekerEncoding   testEncoding = EyeEncoding;
+  float            continuousInputs[CONTINUOUS_AIRSPEED_INPUTS];
+  continuousSample sensors;
+  double           distance;
+  double           lastDistance = 0.0;
+  double           lastDistanceTime = 0.0;
+  double           now;
+
+  // Same encoding the TargetSeeker flies with
+  eyeSample     sample;
+  eyeBoundaries boundaries;
+
+  boundaries.side     = SIDEBOUNDRY;
+  boundaries.vertical = VERTBOUNDRY;
+  boundaries.roll     = ROLLCUTOFF;
 
 
   gvpVector<> horizTrgtVector;
@@ -255,6 +306,15 @@ void runNeuralNetData()
     {
       cout<<"Opening brainFile ("<<brainFile<<") for testing..."<<endl;
       testingBrain.ReadData(brainFile);
+
+      testEncoding = encodingForInputs(testingBrain.InputLayer.NumberOfNodes);
+      if (testEncoding == UnknownEncoding)
+	{
+	  cout<<brainFile<<" has "<<testingBrain.InputLayer.NumberOfNodes
+	      <<" inputs, not a TargetSeeker brain"<<endl;
+	  exit(1);
+	}
+      cout<<"Testing with "<<encodingName(testEncoding)<<" inputs"<<endl;
     }
 
 
@@ -263,11 +323,21 @@ void runNeuralNetData()
 
   if (currentMode == RECORDINGMODE)
     {
-      trainingDataFile.open(dataFileName.c_str(), ios::out);
-      if(!trainingDataFile)
+      // Saved as a binary data set, ready
+      // for aiTrainer train
+      recorder = new DataRecorder(dataFileName, EYE_INPUTS, STICK_OUTPUTS,
+				  eyeInputNames, stickOutputNames);
+
+      if (!continuousFileName.empty())
 	{
-	  cout<<"Failed to open "<<dataFileName<<endl;
-	  exit(1);
+	  SeekerEncoding encoding = continuousAirspeed ? 
+	    ContinuousAirspeedEncoding : ContinuousEncoding;
+
+	  continuousRecorder = new DataRecorder(continuousFileName,
+						inputsForEncoding(encoding),
+						STICK_OUTPUTS,
+						encodingInputNames(encoding),
+						stickOutputNames);
 	}
     }
   
@@ -305,13 +375,11 @@ void runNeuralNetData()
 
   while (!DONE)
     {
-      onSide   = false;
-      onLeft   = false;
-      onRight  = false;
-      onVert   = false;
-      onTop    = false;
-      onBottom = false;
-
+      // The loop goes round much faster than
+      // FlightGear sends, only a new packet
+      // is a new sample. Which one, before
+      // posData's looked at.
+      packet = fdmPackets.load(memory_order_acquire);
 
       ownship->setPositionGeo(currentTime(), ellipsoid,
 			      posData.latitude, posData.longitude,
@@ -328,150 +396,58 @@ void runNeuralNetData()
       vertTrgtVector.normalize();
       straightAhead.normalize();
 
-      trgtBearing    = acos(straightAhead.dot(horizTrgtVector));
+      trgtBearing    = fastAcos(straightAhead.dot(horizTrgtVector));
       trgtBearing   *= RAD2DEG;
-      trgtElevation  = acos(straightAhead.dot(vertTrgtVector));
+      trgtElevation  = fastAcos(straightAhead.dot(vertTrgtVector));
       trgtElevation *= RAD2DEG;
 
 
-      if ((fabs(trgtBearing)) >= SIDEBOUNDRY)
-	{
-	  onSide = true;
+      sample.bearing   = trgtBearing;
+      sample.elevation = trgtElevation;
+      sample.relativeX = trgtX;
+      sample.relativeZ = trgtZ;
+      sample.roll      = posData.roll;
 
-	  if (trgtX <= 0.0)
-	    {
-	      onLeft = true;
-	    }
-	  else
-	    {
-	      onRight = true;
-	    }
-	}
-      else
-	{
-	  onSide = false;
-	}
+      // Set "eye" activation levels and roll flags,
+      // in the order of eyeInputNames
+      encodeEyes(sample, boundaries, sampleInputs);
 
-      if ((fabs(trgtElevation)) >= VERTBOUNDRY)
-	{
-	  onVert = true;
+      // Range rate from the change in distance
+      clock_gettime(CLOCK_MONOTONIC, &sampleTime);
+      now      = sampleTime.tv_sec + sampleTime.tv_nsec * 1e-9;
+      distance = sqrt(trgtX * trgtX + trgtY * trgtY + trgtZ * trgtZ);
 
-	  if (trgtZ <= 0.0)
-	    {
-	      onBottom = true;
-	    }
-	  else
-	    {
-	      onTop = true;
-	    }
-	}
-      else
-	{
-	  onVert = false;
-	}
+      sensors.bearing   = trgtBearing;
+      sensors.elevation = trgtElevation;
+      sensors.relativeX = trgtX;
+      sensors.relativeZ = trgtZ;
+      sensors.roll      = posData.roll;
+      sensors.pitch     = posData.pitch;
+      sensors.airspeed  = posData.airspeed;
+      sensors.rangeRate = 0.0;
 
-      // Initialize values...
-      neuralInputData.centerEye     = -1.0;
-      neuralInputData.upperEye      = -1.0;
-      neuralInputData.upperRightEye = -1.0;
-      neuralInputData.rightEye      = -1.0;
-      neuralInputData.lowerRightEye = -1.0;
-      neuralInputData.lowerEye      = -1.0;
-      neuralInputData.lowerLeftEye  = -1.0;
-      neuralInputData.leftEye       = -1.0;
-      neuralInputData.upperLeftEye  = -1.0;
-
-      neuralInputData.rolledRight   = -1.0;
-      neuralInputData.rolledLeft    = -1.0;
-      
-      cout<<endl<<"*************************************************"<<endl;
-      // Set "eye" activation levels
-      if(onLeft && onTop)
+      if ((lastDistanceTime > 0.0) && (now > lastDistanceTime))
 	{
-	  cout<<"*XX"<<endl<<"XXX"<<endl<<"XXX"<<endl<<endl;
-	  neuralInputData.upperLeftEye = 1.0;
+	  sensors.rangeRate = (distance - lastDistance) / (now - lastDistanceTime);
 	}
-      else
-	if(!onSide && onTop)
-	  {
-	    cout<<"X*X"<<endl<<"XXX"<<endl<<"XXX"<<endl<<endl;
-	    neuralInputData.upperEye = 1.0;
-	  }
-	else
-	  if(onRight && onTop)
-	    {
-	      cout<<"XX*"<<endl<<"XXX"<<endl<<"XXX"<<endl<<endl;
-	      neuralInputData.upperRightEye = 1.0;
-	    }
-	  else
-	    if(!onVert && onLeft)
-	      {
-		cout<<"XXX"<<endl<<"*XX"<<endl<<"XXX"<<endl<<endl;
-		neuralInputData.leftEye = 1.0;
-	      }
-	    else
-	      if(!onVert && !onSide)
-		{
-		  cout<<"XXX"<<endl<<"X*X"<<endl<<"XXX"<<endl<<endl;
-		  neuralInputData.centerEye = 1.0;
-		}
-	      else
-		if (!onVert && onRight)
-		  {
-		    cout<<"XXX"<<endl<<"XX*"<<endl<<"XXX"<<endl<<endl;
-		    neuralInputData.rightEye = 1.0;
-		  }
-		else
-		  if (onBottom && onLeft)
-		    {
-		      cout<<"XXX"<<endl<<"XXX"<<endl<<"*XX"<<endl<<endl;
-		      neuralInputData.lowerLeftEye = 1.0;
-		    }
-		  else
-		    if (!onSide && onBottom)
-		      {
-			cout<<"XXX"<<endl<<"XXX"<<endl<<"X*X"<<endl<<endl;
-			neuralInputData.lowerEye = 1.0;
-		      }
-		    else
-		      if (onRight && onBottom)
-			{
-			  cout<<"XXX"<<endl<<"XXX"<<endl<<"XX*"<<endl<<endl;
-			  neuralInputData.lowerRightEye = 1.0;
-			}
-		      else
-			{
-			  cout<<"Error, invalid eye activation!"<<endl;
-			  exit(1);
-			}
-
-
-      if (posData.roll >= ROLLCUTOFF)
-	{
-	  neuralInputData.rolledRight = 1.0;
-	  cout<<"ROLLED RIGHT!!!"<<endl;
-	}
-      else
-	if (posData.roll <= -ROLLCUTOFF)
-	  {
-	    neuralInputData.rolledLeft = 1.0;
-	    cout<<"ROLLED LEFT!!!"<<endl;
-	  }
 
-      cout<<"*************************************************"<<endl<<endl;
+      lastDistance     = distance;
+      lastDistanceTime = now;
+
+      if (currentMode == TESTINGMODE)
+	encodeContinuous(sensors, (testEncoding == ContinuousAirspeedEncoding),
+			 continuousInputs);
+      else
+	encodeContinuous(sensors, continuousAirspeed, continuousInputs);
 
       if (activateNeuralNet)
 	{
 	  // run neural net here....
-	  testingBrain.SetInput(0, neuralInputData.centerEye);
-	  testingBrain.SetInput(1, neuralInputData.upperEye);
-	  testingBrain.SetInput(2, neuralInputData.upperRightEye);
-	  testingBrain.SetInput(3, neuralInputData.rightEye);
-	  testingBrain.SetInput(4, neuralInputData.lowerRightEye);
-	  testingBrain.SetInput(5, neuralInputData.lowerEye);
-	  testingBrain.SetInput(6, neuralInputData.lowerLeftEye);
-	  testingBrain.SetInput(7, neuralInputData.leftEye);
-	  testingBrain.SetInput(8, neuralInputData.upperLeftEye);
+	  for (int i = 0; i < inputsForEncoding(testEncoding); i++)
+	    {
+	      testingBrain.SetInput(i, (testEncoding == EyeEncoding) ?
+				    sampleInputs[i] : continuousInputs[i]);
+	    }
 	  
 	  testingBrain.FeedForward();
 
@@ -521,40 +497,43 @@ void runNeuralNetData()
 	}
 
 
-      // don't record the first cycle to trainingDataFile
+      // don't record the first cycle
       if (!initialized)
 	{
 	  initialized = true;
 	  continue;
 	}
 
-      if (currentMode == RECORDINGMODE)
+      if ((currentMode == RECORDINGMODE) && (packet != recordedPacket))
 	{
-	  cout<<"RECORDING MODE BROKEN!!!!!!!"<<endl;
-	  cout<<"Training files must be hand written!"<<endl;
-
-	  // 	  trainingDataFile<< neuralInputData.centerEye     <<" "
-	  // 			  << neuralInputData.upperEye      <<" "
-	  // 			  << neuralInputData.upperRightEye <<" "
-	  // 			  << neuralInputData.rightEye      <<" "
-	  // 			  << neuralInputData.lowerRightEye <<" "
-	  // 			  << neuralInputData.lowerEye      <<" "
-	  // 			  << neuralInputData.lowerLeftEye  <<" "
-	  // 			  << neuralInputData.leftEye       <<" "
-	  // 			  << neuralInputData.upperLeftEye  <<" "
-	  // 			  << neuralInputData.inverted      <<" "
-	  // 			  << neuralInputData.roll          <<" "
-	  // 			  << neuralOutputData.newElevator  <<" "
-	  // 			  << neuralOutputData.newAileron   <<" "
-	  // 			  << neuralOutputData.newRudder    <<endl;
+	  recordedPacket = packet;
+
+	  // What the human did with the stick
+	  // is what the net should learn to do
+	  stickToTargets(jsVals.elevator, jsVals.aileron, sampleTargets);
+
+	  // Never blocks, the recorder's own
+	  // thread does the file writing
+	  recorder->record(sampleInputs, sampleTargets, now);
+
+	  if (continuousRecorder)
+	    {
+	      continuousRecorder->record(continuousInputs, sampleTargets, now);
+	    }
 	}
       
       nanosleep(&ts, NULL);
     }
 
-if (currentMode == RECORDINGMODE)
+  if (recorder)
+    {
+      // Saves whatever is left
+      delete recorder;
+    }
+
+  if (continuousRecorder)
     {
-      trainingDataFile.close();
+      delete continuousRecorder;
     }
 
   delete entityStore;
@@ -686,6 +665,198 @@ void trainBrain()
 
 
 
+// Train on a binary data set (see utils/dataSet.h
+// and aiTrainer import), passes over shuffled 
+// mini batches until the mean error is low 
+// enough. Much faster than one trainBrain() 
+// run per little text file.
+void trainBrainFromDataSet()
+{
+  bool existingBrain = false;
+  int  count;
+  int  i, j;
+  int  numInputs;
+  long epoch;
+  double error = 1;
+
+  const float *batchInputs [BATCHSIZE];
+  const float *batchTargets[BATCHSIZE];
+
+  NeuralNetwork trainerBrain;
+  DataSet       trainingSet;
+  ifstream      testBrainFile;
+
+  if (!trainingSet.open(dataFileName))
+    {
+      exit(1);
+    }
+
+  // Eye or continuous inputs, the set
+  // decides (see utils/seekerEncoding.h)
+  numInputs = trainingSet.getNumInputs();
+
+  if ((encodingForInputs(numInputs) == UnknownEncoding) ||
+      (trainingSet.getNumOutputs() != OUTPUTNEURONS))
+    {
+      cout<<dataFileName<<" has "<<numInputs<<" inputs and "
+	  <<trainingSet.getNumOutputs()<<" outputs, the brain needs "
+	  <<EYE_INPUTS<<", "<<CONTINUOUS_INPUTS<<" or "
+	  <<CONTINUOUS_AIRSPEED_INPUTS<<" inputs and "
+	  <<OUTPUTNEURONS<<" outputs"<<endl;
+      exit(1);
+    }
+
+  testBrainFile.open(brainFile.c_str(), ios::in);
+  existingBrain = !testBrainFile.fail();
+  testBrainFile.close();
+
+  if (existingBrain)
+    {
+      cout<<"Modifying existing neural net"<<endl;
+      trainerBrain.ReadData(brainFile);
+
+      if (trainerBrain.InputLayer.NumberOfNodes != numInputs)
+	{
+	  cout<<brainFile<<" has "<<trainerBrain.InputLayer.NumberOfNodes
+	      <<" inputs, "<<dataFileName<<" has "<<numInputs<<endl;
+	  exit(1);
+	}
+    }
+  else
+    {
+      cout<<"Starting a new neural net"<<endl;
+      trainerBrain.Initialize(numInputs, 
+			      HIDDENNEURONS, 
+			      OUTPUTNEURONS);
+    }
+  
+  trainerBrain.SetLearningRate(0.2);
+  trainerBrain.SetMomentum(true,0.9);
+
+  cout<<"Training a "<<encodingName(encodingForInputs(numInputs))
+      <<" brain on "<<trainingSet.getNumSamples()
+      <<" samples from "<<dataFileName<<endl;
+
+  for (epoch = 0; (epoch < TRAININGEPOCHS) && (error > 0.05); epoch++)
+    {
+      error = 0;
+      trainingSet.shuffle(epoch + 1);
+
+      while ((count = trainingSet.nextBatch(BATCHSIZE, batchInputs, 
+					    batchTargets)) > 0)
+	{
+	  for (i = 0; i < count; i++)
+	    {
+	      for (j = 0; j < numInputs; j++)
+		{
+		  trainerBrain.SetInput(j, batchInputs[i][j]);
+		}
+
+	      for (j = 0; j < OUTPUTNEURONS; j++)
+		{
+		  trainerBrain.SetDesiredOutput(j, batchTargets[i][j]);
+		}
+
+	      // Learn...
+	      trainerBrain.FeedForward();
+	      error += trainerBrain.CalculateError();
+	      trainerBrain.BackPropagate();
+	    }
+	}
+
+      error /= trainingSet.getNumSamples();
+
+      if ((epoch % 100) == 0)
+	{
+	  cout<<"Epoch "<<epoch<<", mean error "<<error<<endl;
+	}
+    }
+
+  cout<<"Finished after "<<epoch<<" epochs, mean error "<<error<<endl;
+  trainerBrain.DumpData(brainFile);
+}
+
+
+
+
+
+
+// Train a whole set of candidate brains at
+// once (see utils/brainSweep.h), and keep the
+// one that does best on the held out samples
+void sweepBrains()
+{
+  vector<sweepCandidate> candidates;
+  NeuralNetwork          bestBrain;
+  DataSet                trainingSet;
+  string                 leaderboardFile = brainFile + ".leaderboard";
+
+  if (!DataSet::isDataSetFile(dataFileName))
+    {
+      cout<<dataFileName<<" isn't a binary data set, "
+	  <<"make one with aiTrainer import"<<endl;
+      exit(1);
+    }
+
+  if (!trainingSet.open(dataFileName))
+    {
+      exit(1);
+    }
+
+  candidates = makeSweepCandidates(sweep);
+
+  if (!runBrainSweep(trainingSet, candidates, sweep, bestBrain))
+    {
+      exit(1);
+    }
+
+  cout<<endl<<"Best: hidden "<<candidates[0].hiddenNodes
+      <<", rate "<<candidates[0].learningRate
+      <<", momentum "<<candidates[0].momentum
+      <<", held out error "<<candidates[0].holdoutError<<endl;
+
+  bestBrain.DumpData(brainFile);
+  bestBrain.CleanUp();
+
+  if (writeSweepLeaderboard(leaderboardFile, candidates))
+    {
+      cout<<"Leaderboard written to "<<leaderboardFile<<endl;
+    }
+}
+
+
+
+
+// Comma separated lists from the sweep options
+void parseIntList(const char* text, vector<int> &values)
+{
+  values.clear();
+  for (const char *p = text; p; p = strchr(p, ','))
+    {
+      if (*p == ',')
+	p++;
+      values.push_back(atoi(p));
+    }
+}
+
+
+
+void parseDoubleList(const char* text, vector<double> &values)
+{
+  values.clear();
+  for (const char *p = text; p; p = strchr(p, ','))
+    {
+      if (*p == ',')
+	p++;
+      values.push_back(atof(p));
+    }
+}
+
+
+
+
+
+
 // This thread handles receiving 
 // position updates from the
 // flight model in FlightGear
@@ -715,6 +886,14 @@ void *gvpUpdateThread(void*)
 
   js = new Joystick(0);
 
+  // When the human moved the stick, to the
+  // microsecond, to line up with the FDM
+  // samples in the data set
+  if (currentMode == RECORDINGMODE)
+    {
+      js->recordEvents(dataFileName + ".stick");
+    }
+
 
   // This is the viewpoint entity
   unsigned long view = gvp->getViewEntity();
@@ -730,6 +909,7 @@ void *gvpUpdateThread(void*)
       // Get the position from flightgear
       fdmInput.update();
       posData = fdmInput.getPositionGeo();
+      fdmPackets.fetch_add(1, memory_order_release);
       
       if (activateNeuralNet)
 	{
@@ -790,9 +970,17 @@ void printUsageInfo()
   cout<<"For training:  aiTrainer train [Data set filename] [numHiddenNodes]"
       <<"[Neural Net file]"<<endl<<endl;
   cout<<"For recording: aiTrainer record [GVPHOSTNAME] "
-      <<"[Data Set filename to save]"<<endl<<endl;
+      <<"[Binary data set filename to save] "
+      <<"[Continuous input data set to save] [noairspeed]"<<endl<<endl;
   cout<<"For test: aiTrainer test [GVPHOSTNAME] "
       <<"[Neural Net file]"<<endl<<endl;
+  cout<<"For import: aiTrainer import [Binary data set to save] "
+      <<"[Text data set files...]"<<endl<<endl;
+  cout<<"For sweep: aiTrainer sweep [Binary data set] [Best neural net file] "
+      <<"[-hidden 6,8,10] [-rates 0.1,0.2] [-momentum 0,0.9] "
+      <<"[-random N] [-threads N] [-epochs N]"<<endl<<endl;
+  cout<<"The training data set can be a text file, or a binary "
+      <<"set made with import"<<endl<<endl;
 }
 
 
@@ -833,6 +1021,14 @@ int main(int argc, char **argv)
 	currentMode  = RECORDINGMODE;
 	gvpHost      = argv[2];
 	dataFileName = argv[3]; 
+
+	// Optionally the same flight with
+	// continuous inputs, for comparing
+	if (argc > 4)
+	  {
+	    continuousFileName = argv[4];
+	    continuousAirspeed = !((argc > 5) && !strcmp(argv[5], "noairspeed"));
+	  }
       }
     else
       if (!strcmp(argv[1], "test"))
@@ -843,10 +1039,60 @@ int main(int argc, char **argv)
 	  brainFile   = argv[3]; 
 	}
       else
-	{
-	  printUsageInfo();
-	  return 0;
-	}
+	if (!strcmp(argv[1], "import"))
+	  {
+	    cout<<"Starting import"<<endl;
+	    currentMode  = IMPORTMODE;
+	    dataFileName = argv[2];
+
+	    for (int i = 3; i < argc; i++)
+	      {
+		importFiles.push_back(argv[i]);
+	      }
+	  }
+	else
+	  if (!strcmp(argv[1], "sweep") && (argc >= 4))
+	    {
+	      cout<<"Starting hyperparameter sweep"<<endl;
+	      currentMode  = SWEEPMODE;
+	      dataFileName = argv[2];
+	      brainFile    = argv[3];
+
+	      defaultSweepSettings(sweep);
+	      sweep.maxEpochs = TRAININGEPOCHS;
+
+	      for (int i = 4; i < argc; i++)
+		{
+		  if (i + 1 >= argc)
+		    {
+		      printUsageInfo();
+		      return 0;
+		    }
+
+		  if (!strcmp(argv[i], "-hidden"))
+		    parseIntList(argv[++i], sweep.hiddenNodes);
+		  else if (!strcmp(argv[i], "-rates"))
+		    parseDoubleList(argv[++i], sweep.learningRates);
+		  else if (!strcmp(argv[i], "-momentum"))
+		    parseDoubleList(argv[++i], sweep.momentums);
+		  else if (!strcmp(argv[i], "-random"))
+		    sweep.randomCandidates = atoi(argv[++i]);
+		  else if (!strcmp(argv[i], "-threads"))
+		    sweep.threads = atoi(argv[++i]);
+		  else if (!strcmp(argv[i], "-epochs"))
+		    sweep.maxEpochs = atol(argv[++i]);
+		  else
+		    {
+		      printUsageInfo();
+		      return 0;
+		    }
+		}
+	    }
+	  else
+	    {
+	      printUsageInfo();
+	      return 0;
+	    }
   
   
   switch(currentMode)
@@ -854,7 +1100,30 @@ int main(int argc, char **argv)
     case TRAININGMODE:
       // run trainBrain completely through the 
       // training set
-      trainBrain();
+      if (DataSet::isDataSetFile(dataFileName))
+	{
+	  trainBrainFromDataSet();
+	}
+      else
+	{
+	  trainBrain();
+	}
+      break;
+
+    case IMPORTMODE:
+      {
+	long imported = importTextDataSets(importFiles, dataFileName);
+
+	if (imported < 0)
+	  {
+	    exit(1);
+	  }
+	cout<<"Wrote "<<imported<<" samples to "<<dataFileName<<endl;
+      }
+      break;
+
+    case SWEEPMODE:
+      sweepBrains();
       break;
 
     case RECORDINGMODE:
@@ -0,0 +1,288 @@
+// Times utils/airspace.h as the number of
+// aircraft grows, against every aircraft
+// checking every other one. The aircraft
+// are spread at the same density however
+// many there are, the way a bigger swarm
+// covers more ground, so the work each one
+// does should stay about the same.
+//
+// Each tick every aircraft moves, reports,
+// the airspace is rebuilt, and every one
+// asks who's within AIRSPACEBENCHRADIUS and
+// for its AIRSPACEBENCHK nearest. The
+// answers are checked against the brute
+// force ones, exits with 1 if any differ.
+//
+//   airspacebench [-quick]
+
+
+#include <iostream>
+using namespace std;
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#include "airspace.h"
+#include "route.h"
+
+
+
+// Square kilometers of sky each aircraft
+// gets, and how far it looks
+#define AIRSPACEBENCHAREA    25.0
+#define AIRSPACEBENCHRADIUS  10000.0  // meters
+#define AIRSPACEBENCHK       4
+
+// Aircraft timed in total for each size,
+// spread over as many ticks as that takes
+#define AIRSPACEBENCHWORK    200000
+
+#define DEG2RAD 0.017453292519943295
+
+
+
+
+struct benchAircraft
+{
+  double lat, lon, alt;
+  double dLat, dLon;
+};
+
+
+
+static double secondsNow()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+
+static double randomBetween(double low, double high)
+{
+  return low + (high - low) * (rand() / (double)RAND_MAX);
+}
+
+
+
+// A square of sky around Monterey
+static void makeAircraft(vector<benchAircraft> &aircraft, int count)
+{
+  double side     = sqrt(count * AIRSPACEBENCHAREA) * 1000.0;
+  double latSide  = side / 111320.0;
+  double lonSide  = latSide / cos(36.6 * DEG2RAD);
+
+  aircraft.resize(count);
+
+  for (int i = 0; i < count; i++)
+    {
+      aircraft[i].lat  = 36.6 + randomBetween(-latSide, latSide) / 2.0;
+      aircraft[i].lon  = -121.9 + randomBetween(-lonSide, lonSide) / 2.0;
+      aircraft[i].alt  = randomBetween(500.0, 10000.0);
+
+      // About 100 m/s, at 10 ticks a second
+      aircraft[i].dLat = randomBetween(-1.0, 1.0) * 10.0 / 111320.0;
+      aircraft[i].dLon = randomBetween(-1.0, 1.0) * 10.0 / 111320.0;
+    }
+}
+
+
+
+static void moveAircraft(vector<benchAircraft> &aircraft)
+{
+  for (size_t i = 0; i < aircraft.size(); i++)
+    {
+      aircraft[i].lat += aircraft[i].dLat;
+      aircraft[i].lon += aircraft[i].dLon;
+    }
+}
+
+
+
+// The same answers the slow way
+static void bruteForce(const vector<double> &ecef, int self, int k,
+		       vector<airspaceNeighbor> &within,
+		       vector<airspaceNeighbor> &nearest)
+{
+  int count = ecef.size() / 3;
+
+  within.clear();
+  nearest.clear();
+
+  for (int i = 0; i < count; i++)
+    {
+      if (i == self)
+	{
+	  continue;
+	}
+
+      double dx = ecef[3 * i]     - ecef[3 * self];
+      double dy = ecef[3 * i + 1] - ecef[3 * self + 1];
+      double dz = ecef[3 * i + 2] - ecef[3 * self + 2];
+
+      airspaceNeighbor neighbor;
+      neighbor.id       = i;
+      neighbor.distance = sqrt(dx * dx + dy * dy + dz * dz);
+
+      nearest.push_back(neighbor);
+      if (neighbor.distance <= AIRSPACEBENCHRADIUS)
+	{
+	  within.push_back(neighbor);
+	}
+    }
+
+  sort(within.begin(), within.end());
+
+  if ((int)nearest.size() > k)
+    {
+      partial_sort(nearest.begin(), nearest.begin() + k, nearest.end());
+      nearest.resize(k);
+    }
+  else
+    {
+      sort(nearest.begin(), nearest.end());
+    }
+}
+
+
+
+static bool sameIds(const vector<airspaceNeighbor> &a,
+		    const vector<airspaceNeighbor> &b)
+{
+  if (a.size() != b.size())
+    {
+      return false;
+    }
+
+  for (size_t i = 0; i < a.size(); i++)
+    {
+      if (a[i].id != b[i].id)
+	{
+	  return false;
+	}
+    }
+
+  return true;
+}
+
+
+
+
+int main(int argc, char* argv[])
+{
+  static const int sizes[] = { 10, 100, 1000, 10000 };
+
+  vector<benchAircraft>    aircraft;
+  vector<double>           ecef;
+  vector<airspaceNeighbor> within, nearest, bruteWithin, bruteNearest;
+  Airspace                 airspace;
+  long   work = AIRSPACEBENCHWORK;
+  long   mismatches = 0, found;
+  double start, updateTime, queryTime, bruteTime;
+  int    ticks, checked;
+
+  if ((argc > 1) && !strcmp(argv[1], "-quick"))
+    {
+      work /= 10;
+    }
+
+  srand(1);
+
+  cout<<"Per aircraft per tick, "<<AIRSPACEBENCHRADIUS / 1000.0
+      <<" km radius and "<<AIRSPACEBENCHK<<" nearest"<<endl;
+  cout<<setw(9)<<"aircraft"<<setw(13)<<"update us"<<setw(13)<<"query us"
+      <<setw(13)<<"brute us"<<setw(11)<<"in range"<<endl;
+
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+      int count = sizes[s];
+
+      makeAircraft(aircraft, count);
+      airspace.clear();
+      ecef.resize(3 * count);
+
+      ticks      = (work + count - 1) / count;
+      updateTime = 0.0;
+      queryTime  = 0.0;
+      found      = 0;
+
+      for (int tick = 0; tick < ticks; tick++)
+	{
+	  moveAircraft(aircraft);
+
+	  start = secondsNow();
+	  for (int i = 0; i < count; i++)
+	    {
+	      airspace.report(i, aircraft[i].lat, aircraft[i].lon,
+			      aircraft[i].alt, (i % 10) == 0);
+	    }
+	  airspace.update();
+	  updateTime += secondsNow() - start;
+
+	  start = secondsNow();
+	  for (int i = 0; i < count; i++)
+	    {
+	      const airspaceContact *self = airspace.getContact(i);
+
+	      found += airspace.withinRadius(self->ecef, AIRSPACEBENCHRADIUS,
+					     within, i);
+	      airspace.nearest(self->ecef, AIRSPACEBENCHK, nearest, i);
+	    }
+	  queryTime += secondsNow() - start;
+	}
+
+
+      // The last tick again, checked against
+      // brute force, and that timed. It's all
+      // pairs, so only a sample of them at
+      // the larger sizes.
+      for (int i = 0; i < count; i++)
+	{
+	  const airspaceContact *self = airspace.getContact(i);
+	  memcpy(&ecef[3 * i], self->ecef, sizeof(self->ecef));
+	}
+
+      checked = (count < 1000) ? count : 1000;
+
+      start = secondsNow();
+      for (int c = 0; c < checked; c++)
+	{
+	  int i = (int)((long)c * count / checked);
+	  bruteForce(ecef, i, AIRSPACEBENCHK, bruteWithin, bruteNearest);
+	}
+      bruteTime = secondsNow() - start;
+
+      for (int c = 0; c < checked; c++)
+	{
+	  int i = (int)((long)c * count / checked);
+
+	  bruteForce(ecef, i, AIRSPACEBENCHK, bruteWithin, bruteNearest);
+	  airspace.withinRadius(&ecef[3 * i], AIRSPACEBENCHRADIUS, within, i);
+	  airspace.nearest(&ecef[3 * i], AIRSPACEBENCHK, nearest, i);
+
+	  if (!sameIds(within, bruteWithin) || !sameIds(nearest, bruteNearest))
+	    {
+	      mismatches++;
+	    }
+	}
+
+      cout<<setw(9)<<count<<fixed<<setprecision(3)
+	  <<setw(13)<<updateTime * 1e6 / ((double)ticks * count)
+	  <<setw(13)<<queryTime * 1e6 / ((double)ticks * count)
+	  <<setw(13)<<bruteTime * 1e6 / checked
+	  <<setw(11)<<setprecision(1)<<found / ((double)ticks * count)<<endl;
+      cout.unsetf(ios::floatfield);
+    }
+
+  cout<<endl<<mismatches<<" aircraft got different answers "
+      <<"from brute force"<<endl;
+
+  return (mismatches == 0) ? 0 : 1;
+}
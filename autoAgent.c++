@@ -25,7 +25,11 @@ using namespace std;
 #include "ucavStates.h"
 #include "fgFdmReceiver.h"
 #include "fgCtrlsTransmitter.h"
+#include "telemetryBus.h"
+#include "gvpSender.h"
+#include "stateEstimator.h"
 #include "joystick.h"
+#include "realTime.h"
 #include "net_ctrls.hxx"
 #include "gvpApiClient.hpp"
 #include "gvpTimer.hpp"
@@ -65,17 +69,20 @@ bool USEGVP = false;
 
 
 
-// Position datastruct from fgFdmReceiver
-// Allowed to be used by both processes
-// i.e. gvpUpdateThread writes it,
-// main process reads it
-localDataStruct posData;
-float airSpeed  = 0.0;
-
+// Position data from FlightGear goes
+// through a TelemetryBus, written by
+// fdmReceiveThread, each reader has
+// its own TelemetrySubscriber
 
 bool SIMSTARTED = false;
 
 
+// Real time mode for the FDM receive
+// thread and the control loop, off
+// unless there's a -realtime option
+realTimeSettings REALTIME;
+
+
 
 
 
@@ -103,71 +110,20 @@ void signalHandler(int signal)
 
 
 
-// This thread handles receiving 
-// position updates from the
-// flight model in FlightGear
-// and sending them to GVP
-void *gvpUpdateThread(void*)
+// Sleep until a time in seconds
+// on CLOCK_MONOTONIC, straight back
+// if it's already gone by
+void sleepUntil(double time)
 {
-  // Used for briefly suspending the thread
   struct timespec ts;
-  ts.tv_sec  = 0;
-  ts.tv_nsec = 1000;
-
-  // listen for position updates 
-  // from FlightGear on port 5060
-  FgFdmReceiver fdmInput(5060);
-
 
-  // The GVP api client, so I can 
-  // send position updates to the 
-  // GVP viewpoint
-  gvpApiClient gvp(GVPHOST.c_str(), 5050);
+  ts.tv_sec  = (time_t)time;
+  ts.tv_nsec = (long)((time - ts.tv_sec) * 1e9);
 
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
 
 
-  // This is the viewpoint entity
-  unsigned long view = gvp.getViewEntity();
-
-  
-
-
-
-  while(!DONE)
-    {
-      // Get the position from flightgear
-      fdmInput.update();
-
-      if (!SIMSTARTED)
-	{
-	  sayOutloud(false, "simulation has begun");
-	  sleep(1);
-
-	  sayOutloud(false, "starting autonomous agent in 3");
-	  sayOutloud(false, "2");
-	  sayOutloud(false, "1");
-	  sayOutloud(true, "autonomous agent active");
-
-	  SIMSTARTED = true;
-	}
-
-      posData  = fdmInput.getPositionGeo();
-      airSpeed = fdmInput.getAirspeed();
-
-
-      // Put that position into GVP
-      gvp.setPositionGeo(currentTime(), view,
-			 posData.latitude, posData.longitude,
-			 posData.altitude * FEET2MET, posData.heading,
-			 posData.pitch, posData.roll);
-
-      // Suspend execution briefly
-      nanosleep(&ts, NULL);
-    }
-
-
-  cout<<"Exiting gvpUpdateThread"<<endl;
-}
 
 
 
@@ -175,25 +131,37 @@ void *gvpUpdateThread(void*)
 
 // This thread handles receiving 
 // position updates from the
-// flight model in FlightGear
-void *positionUpdateThread(void*)
+// flight model in FlightGear,
+// and is the only thing listening
+// on the port. Every update goes
+// on the telemetry bus for whoever
+// wants it.
+void *fdmReceiveThread(void *bus)
 {
-  // Used for briefly suspending the thread
-  struct timespec ts;
-  ts.tv_sec  = 0;
-  ts.tv_nsec = 1000;
+  TelemetryBus *telemetry = (TelemetryBus*)bus;
+  struct timespec now;
 
   // listen for position updates 
   // from FlightGear on port 5060
   FgFdmReceiver fdmInput(5060);
 
+  if (REALTIME.enabled)
+    {
+      makeThreadRealTime("FDM receive", REALTIME.receiveCpu,
+			 REALTIME.receivePriority);
+    }
 
 
 
   while(!DONE)
     {
-      // Get the position from flightgear
+      // Get the position from flightgear,
+      // waits for the next packet
       fdmInput.update();
+      clock_gettime(CLOCK_MONOTONIC, &now);
+
+      telemetry->publish(now.tv_sec + now.tv_nsec * 1e-9,
+			 fdmInput.getPositionGeo());
 
       if (!SIMSTARTED)
 	{
@@ -207,16 +175,11 @@ void *positionUpdateThread(void*)
 
 	  SIMSTARTED = true;
 	}
-
-      posData  = fdmInput.getPositionGeo();
-      airSpeed = fdmInput.getAirspeed();
-
-      // Suspend execution briefly
-      nanosleep(&ts, NULL);
     }
 
 
-  cout<<"Exiting positionUpdateThread"<<endl;
+  cout<<"Exiting fdmReceiveThread"<<endl;
+  return NULL;
 }
 
 
@@ -224,9 +187,6 @@ void *positionUpdateThread(void*)
 
 
 
-
-
-
 // Main loop sends control to FlightGear to control the
 // flight model, or FDM
 int main(int argc, char **argv)
@@ -240,10 +200,43 @@ int main(int argc, char **argv)
   bool gearRaised          = false;
 
 
+  // What the Ucav's sensors can see. Anything
+  // else flying gets reported into it too,
+  // on our own it's just us. It has to
+  // outlast the Ucav.
+  Airspace airspace;
+
+  // The ground, if AUTOAGENT_TERRAIN names
+  // a directory of DTED tiles. It has to
+  // outlast the Ucav too.
+  char    *terrainTiles = getenv("AUTOAGENT_TERRAIN");
+  Terrain *terrain      = NULL;
+
+  if (terrainTiles)
+    {
+      terrain = new Terrain(terrainTiles);
+      terrain->start();
+    }
+
   Ucav uav(1);
+  uav.setAirspace(&airspace);
+  uav.setTerrain(terrain);
+
 
+  // Command line options, -realtime
+  // ones first, anywhere...
+  int argsLeft = 1;
 
-  // Command line options...
+  for (int i = 1; i < argc; i++)
+    {
+      if (!REALTIME.parseOption(argv[i]))
+	{
+	  argv[argsLeft++] = argv[i];
+	}
+    }
+  argc = argsLeft;
+
+  // ...then the rest by position
   switch(argc)
     {
     case 1:
@@ -270,7 +263,8 @@ int main(int argc, char **argv)
       break;
 
     default:
-      cout<<"Usage: autoAgent [gvphost] [joy]\n"<<endl;
+      cout<<"Usage: autoAgent [-realtime[=settings file]] "
+	  <<"[gvphost] [joy]\n"<<endl;
     }
 
 
@@ -292,28 +286,46 @@ int main(int argc, char **argv)
   
   
 
+  // The FDM data from FlightGear,
+  // and our place in it
+  TelemetryBus        telemetry;
+  TelemetrySubscriber fdm(telemetry);
+  telemetrySample     fdmSample;
+
+  cout<<"FDM telemetry can be read from "<<telemetry.getPath()<<endl;
+
+
+  // Flies on where the aircraft will be
+  // when the controls get there, not where
+  // it was in the last packet. Set
+  // AUTOAGENT_FDM_FILTER=1 to smooth it too.
+  StateEstimator  estimator;
+  localDataStruct fdmState;
+  char           *filter = getenv("AUTOAGENT_FDM_FILTER");
+
+  estimator.setFiltering(filter && !strcmp(filter, "1"));
+
+
   // Thread to pull data from the FDM of
-  // Flightgear, and send it to GVP
-  pthread_t gvpUpdate;
+  // Flightgear
+  pthread_t fdmReceive;
+
 
 
+  // If GVP is being used, this
+  // sends the FDM data on, on
+  // its own thread
+  GvpSender *gvpSender = NULL;
 
-  // If GVP isn't being used,
-  // this thread will be spawned
-  // to grab FDM data we need
-  pthread_t positionUpdate;
 
 
+  pthread_create(&fdmReceive, NULL, fdmReceiveThread, &telemetry);
 
   // Creat the thread that will update GVP
   if (USEGVP)
     {
-      pthread_create(&gvpUpdate, NULL, gvpUpdateThread, NULL);
-    }
-  else
-    {
-      pthread_create(&positionUpdate, NULL, 
-		     positionUpdateThread, NULL);
+      gvpSender = new GvpSender(telemetry, GVPHOST, 5050);
+      gvpSender->start();
     }
 
   // Catch sigint to shutdown cleanly
@@ -340,6 +352,23 @@ int main(int argc, char **argv)
    }
 
 
+  // Last, every other thread's been started
+  // by now and won't take after this one
+  JitterMonitor controlJitter("Control loop");
+  double        wakeUpAt;
+  double        sendStarted;
+
+  if (REALTIME.enabled)
+    {
+      if (REALTIME.lockMemory)
+	{
+	  lockAllMemory();
+	}
+      makeThreadRealTime("Control loop", REALTIME.controlCpu,
+			 REALTIME.controlPriority);
+    }
+
+
 
   while(!DONE)
     {
@@ -372,16 +401,26 @@ int main(int argc, char **argv)
 	    }
 	  
 
+	  // Only ever flies on the newest,
+	  // there's no catching up on old
+	  // positions
+	  if (fdm.latest(fdmSample))
+	    {
+	      estimator.addSample(fdmSample);
+	    }
+
+	  estimator.predict(RateGroup::now(), fdmState);
+
 	  // Run Finite State Machine...
-	  uav.setPositionGeo(posData.latitude, 
-			     posData.longitude,
-			     posData.altitude * FEET2MET,
-			     posData.agl      * FEET2MET,
-			     posData.heading, 
-			     posData.pitch, 
-			     posData.roll);
-
-	  uav.setAirspeed(airSpeed);
+	  uav.setPositionGeo(fdmState.latitude, 
+			     fdmState.longitude,
+			     fdmState.altitude * FEET2MET,
+			     fdmState.agl      * FEET2MET,
+			     fdmState.heading, 
+			     fdmState.pitch, 
+			     fdmState.roll);
+
+	  uav.setAirspeed(fdmState.airspeed);
 	  
 	  if ((!gearRaised) && (!uav.getGearDown()))
 	    {
@@ -390,6 +429,7 @@ int main(int argc, char **argv)
 	      gearRaised = true;
 	    }
 
+	  airspace.update();
 	  uav.update();
 	  
 	  uav.getControlPositions(newElevator, newAileron,
@@ -405,12 +445,34 @@ int main(int argc, char **argv)
 	}
 
       // Send data to FlightGear
+      sendStarted = RateGroup::now();
       ctrlsOutput.sendData();
 
-      // Suspend execution briefly
-      nanosleep(&ts, NULL);
+      if (USEJOYSTICK)
+	{
+	  // Suspend execution briefly
+	  nanosleep(&ts, NULL);
+	}
+      else
+	{
+	  // The last stage of the Ucav's tick
+	  uav.getTickBudget().ran(TransmitStage, sendStarted,
+				  RateGroup::now());
+
+	  // Nothing to do until the Ucav's
+	  // next part is due. Only a sleep
+	  // counts, not running late.
+	  wakeUpAt = uav.getNextUpdateTime();
+
+	  if (wakeUpAt > RateGroup::now())
+	    {
+	      sleepUntil(wakeUpAt);
+	      controlJitter.wokeUp(wakeUpAt, RateGroup::now());
+	    }
+	}
     }
   cout<<"Main loop exited..."<<endl;
+  controlJitter.report();
 
 
   if (USEJOYSTICK)
@@ -420,16 +482,27 @@ int main(int argc, char **argv)
 
 
 
+  pthread_join(fdmReceive, NULL);
+
   if (USEGVP)
     {
-      pthread_join(gvpUpdate, NULL);
+      gvpSender->stop();
+      gvpSender->report();
+      delete gvpSender;
     }
-  else
+
+  if (terrain)
     {
-      pthread_join(positionUpdate, NULL);
+      uav.setTerrain(NULL);
+      cout<<"Terrain: "<<terrain->getLoads()<<" tiles loaded, "
+	  <<terrain->getEvictions()<<" evicted"<<endl;
+      delete terrain;
     }
 
   sayOutloud(true, "autoagent program stopped");
+
+  // Let the speech worker finish up
+  shutdownSpeech();
   cout<<"Done."<<endl;
 
   return 0;
@@ -0,0 +1,815 @@
+// Offline benchmark for the neural net brains.
+// Loads brain files and, without FlightGear or
+// GVP, reports how well they fit the training
+// sets (MSE per output) and how fast they are:
+// load time, single sample and batched inference
+// latency, and training throughput. Results can
+// also be written as JSON, so runs from different
+// builds can be compared.
+//
+//   brainbench [-json results.json] [-iterations N]
+//              brainFile... [-sets dataSet...]
+//
+// Data sets can be binary (.dset) or text, text
+// ones are imported on the fly. Without -sets
+// the brains are scored on the training sets,
+// trainingFiles/* and pureTrainingSet. Brains aren't
+// modified, training throughput is measured on
+// a second copy.
+//
+// Each brain is only scored on sets with its
+// input encoding (eye or continuous, see
+// utils/seekerEncoding.h). With brains of both
+// kinds, the best of each are compared side by
+// side, on fit and on how much their outputs
+// jump from one sample to the next (recorded
+// sets are in time order, so this is how
+// jerky the stick would be).
+
+
+#include <iostream>
+using namespace std;
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <glob.h>
+
+
+#include "neuralNet.h"
+#include "dataSet.h"
+#include "seekerEncoding.h"
+
+
+
+// Samples in one batched inference run,
+// same as the trainer's mini batches
+#define BENCHBATCHSIZE 32
+
+// Default number of timed inferences
+#define BENCHITERATIONS 20000
+
+// Seconds spent measuring training throughput
+#define BENCHTRAINSECONDS 2.0
+
+// Scored against when there's no -sets
+#define BENCHDEFAULTSETS "trainingFiles/*"
+#define BENCHPURESET     "pureTrainingSet"
+
+
+
+
+struct setResult
+{
+  string         name;
+  long           numSamples;
+  vector<double> outputMse;
+  double         meanMse;
+
+  // Mean change of an output between
+  // one sample and the next
+  double         outputStep;
+};
+
+
+struct brainResult
+{
+  string name;
+  string encoding;
+  int    numInputs;
+  int    numHidden;
+  int    numOutputs;
+
+  double loadMs;
+  double singleP50Us;
+  double singleP99Us;
+  double batchP50Us;
+  double batchP99Us;
+  double trainSamplesPerSec;
+
+  vector<setResult> sets;
+};
+
+
+
+struct benchSet
+{
+  string   name;
+  DataSet *data;
+};
+
+
+
+
+static double secondsNow()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+
+// Value at a percentile of already sorted times
+static double percentile(const vector<double>& sorted, double fraction)
+{
+  size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+
+
+static bool fileExists(string filename)
+{
+  ifstream testFile(filename.c_str(), ios::in);
+  return !testFile.fail();
+}
+
+
+
+
+// Text sets imported together into
+// one temporary binary one
+static DataSet *importBenchSet(const vector<string>& textFiles)
+{
+  DataSet *data = new DataSet;
+
+  char tmpName[] = "/tmp/brainbenchXXXXXX";
+  int  tmpFd     = mkstemp(tmpName);
+
+  if (tmpFd < 0)
+    {
+      perror("brainbench: mkstemp");
+      delete data;
+      return NULL;
+    }
+  ::close(tmpFd);
+
+  bool opened = (importTextDataSets(textFiles, tmpName) >= 0) &&
+		data->open(tmpName);
+
+  // The mapping stays good after
+  // the file is gone
+  unlink(tmpName);
+
+  if (!opened)
+    {
+      delete data;
+      return NULL;
+    }
+  return data;
+}
+
+
+
+// Open a data set, importing text
+// sets on the fly
+static DataSet *openBenchSet(string filename)
+{
+  DataSet *data;
+
+  if (!DataSet::isDataSetFile(filename))
+    {
+      return importBenchSet(vector<string>(1, filename));
+    }
+
+  data = new DataSet;
+
+  if (!data->open(filename))
+    {
+      delete data;
+      return NULL;
+    }
+  return data;
+}
+
+
+
+
+static void feedSample(NeuralNetwork &brain, const float* inputs,
+		       int numInputs)
+{
+  for (int i = 0; i < numInputs; i++)
+    {
+      brain.SetInput(i, inputs[i]);
+    }
+  brain.FeedForward();
+}
+
+
+
+
+static setResult measureFit(NeuralNetwork &brain, const benchSet &set,
+			    int numOutputs)
+{
+  setResult      result;
+  vector<double> lastOutputs(numOutputs, 0.0);
+  double         error;
+  long           s;
+  int            i;
+
+  result.name       = set.name;
+  result.numSamples = set.data->getNumSamples();
+  result.outputMse.assign(numOutputs, 0.0);
+  result.meanMse    = 0.0;
+  result.outputStep = 0.0;
+
+  for (s = 0; s < result.numSamples; s++)
+    {
+      feedSample(brain, set.data->getInputs(s), set.data->getNumInputs());
+
+      for (i = 0; i < numOutputs; i++)
+	{
+	  error = brain.GetOutput(i) - set.data->getTargets(s)[i];
+	  result.outputMse[i] += error * error;
+
+	  if (s > 0)
+	    {
+	      result.outputStep += fabs(brain.GetOutput(i) - lastOutputs[i]);
+	    }
+	  lastOutputs[i] = brain.GetOutput(i);
+	}
+    }
+
+  if (result.numSamples > 1)
+    {
+      result.outputStep /= (result.numSamples - 1) * numOutputs;
+    }
+
+  for (i = 0; i < numOutputs; i++)
+    {
+      if (result.numSamples > 0)
+	{
+	  result.outputMse[i] /= result.numSamples;
+	}
+      result.meanMse += result.outputMse[i] / numOutputs;
+    }
+
+  return result;
+}
+
+
+
+
+static brainResult benchBrain(string brainFile, vector<benchSet>& sets,
+			      int iterations)
+{
+  brainResult    result;
+  NeuralNetwork  brain;
+  NeuralNetwork  trainingBrain;
+  vector<const float*> inputs;
+  vector<const float*> targets;
+  vector<double> times;
+  vector<float>  randomInputs;
+  double         start, stop;
+  long           trained;
+  size_t         next;
+  int            i, j, b;
+
+  result.name = brainFile;
+
+
+  // Load
+  start = secondsNow();
+  brain.ReadData(brainFile);
+  stop  = secondsNow();
+
+  result.loadMs     = (stop - start) * 1e3;
+  result.numInputs  = brain.InputLayer.NumberOfNodes;
+  result.numHidden  = brain.HiddenLayer.NumberOfNodes;
+  result.numOutputs = brain.OutputLayer.NumberOfNodes;
+  result.encoding   = encodingName(encodingForInputs(result.numInputs));
+
+
+  // Fit against every set the brain's shape matches
+  for (size_t s = 0; s < sets.size(); s++)
+    {
+      if ((sets[s].data->getNumInputs()  != result.numInputs) ||
+	  (sets[s].data->getNumOutputs() != result.numOutputs))
+	{
+	  cout<<"Skipping "<<sets[s].name<<" for "<<brainFile
+	      <<", it has "<<sets[s].data->getNumInputs()<<" inputs and "
+	      <<sets[s].data->getNumOutputs()<<" outputs"<<endl;
+	  continue;
+	}
+
+      result.sets.push_back(measureFit(brain, sets[s], result.numOutputs));
+
+      for (long n = 0; n < sets[s].data->getNumSamples(); n++)
+	{
+	  inputs.push_back(sets[s].data->getInputs(n));
+	  targets.push_back(sets[s].data->getTargets(n));
+	}
+    }
+
+  // Nothing to time against, use
+  // random -1/1 inputs, like the eyes
+  if (inputs.empty())
+    {
+      srand(1);
+      randomInputs.resize(BENCHBATCHSIZE * result.numInputs);
+
+      for (i = 0; i < (int)randomInputs.size(); i++)
+	{
+	  randomInputs[i] = (rand() & 1) ? 1.0 : -1.0;
+	}
+      for (b = 0; b < BENCHBATCHSIZE; b++)
+	{
+	  inputs.push_back(&randomInputs[b * result.numInputs]);
+	}
+    }
+
+
+  // Single sample latency, inputs in to outputs out
+  times.resize(iterations);
+  next = 0;
+  double sink = 0.0;
+
+  for (i = 0; i < iterations; i++)
+    {
+      const float *sample = inputs[next];
+      next = (next + 1) % inputs.size();
+
+      start = secondsNow();
+      feedSample(brain, sample, result.numInputs);
+      for (j = 0; j < result.numOutputs; j++)
+	{
+	  sink += brain.GetOutput(j);
+	}
+      stop  = secondsNow();
+
+      times[i] = (stop - start) * 1e6;
+    }
+
+  sort(times.begin(), times.end());
+  result.singleP50Us = percentile(times, 0.50);
+  result.singleP99Us = percentile(times, 0.99);
+
+
+  // Batched latency, a whole batch per timing
+  times.resize(iterations / BENCHBATCHSIZE + 1);
+
+  for (i = 0; i < (int)times.size(); i++)
+    {
+      start = secondsNow();
+      for (b = 0; b < BENCHBATCHSIZE; b++)
+	{
+	  feedSample(brain, inputs[next], result.numInputs);
+	  next = (next + 1) % inputs.size();
+
+	  for (j = 0; j < result.numOutputs; j++)
+	    {
+	      sink += brain.GetOutput(j);
+	    }
+	}
+      stop  = secondsNow();
+
+      times[i] = (stop - start) * 1e6;
+    }
+
+  sort(times.begin(), times.end());
+  result.batchP50Us = percentile(times, 0.50);
+  result.batchP99Us = percentile(times, 0.99);
+
+
+  // Training throughput, on a copy so the
+  // brain being measured isn't touched.
+  // Without targets there's nothing to train on.
+  result.trainSamplesPerSec = 0.0;
+
+  if (!targets.empty())
+    {
+      trainingBrain.ReadData(brainFile);
+      trainingBrain.SetLearningRate(0.2);
+      trainingBrain.SetMomentum(true, 0.9);
+
+      trained = 0;
+      next    = 0;
+      start   = secondsNow();
+
+      do
+	{
+	  for (b = 0; b < BENCHBATCHSIZE; b++)
+	    {
+	      for (j = 0; j < result.numOutputs; j++)
+		{
+		  trainingBrain.SetDesiredOutput(j, targets[next][j]);
+		}
+	      feedSample(trainingBrain, inputs[next], result.numInputs);
+	      trainingBrain.BackPropagate();
+
+	      next = (next + 1) % inputs.size();
+	    }
+	  trained += BENCHBATCHSIZE;
+	  stop     = secondsNow();
+	}
+      while (stop - start < BENCHTRAINSECONDS);
+
+      result.trainSamplesPerSec = trained / (stop - start);
+      trainingBrain.CleanUp();
+    }
+
+  brain.CleanUp();
+
+  // Keeps the compiler from dropping
+  // the timed work
+  if (sink == 12345.6789)
+    {
+      cout<<sink<<endl;
+    }
+
+  return result;
+}
+
+
+
+
+static void printResult(const brainResult &result)
+{
+  cout<<endl<<result.name<<" ("<<result.numInputs<<" "<<result.numHidden
+      <<" "<<result.numOutputs<<", "<<result.encoding<<" inputs)"<<endl;
+
+  cout<<fixed<<setprecision(3);
+  cout<<"  load:          "<<result.loadMs<<" ms"<<endl;
+  cout<<"  single:        p50 "<<result.singleP50Us<<" us, p99 "
+      <<result.singleP99Us<<" us"<<endl;
+  cout<<"  batch of "<<BENCHBATCHSIZE<<":   p50 "<<result.batchP50Us
+      <<" us, p99 "<<result.batchP99Us<<" us"<<endl;
+  cout<<setprecision(0);
+  cout<<"  training:      "<<result.trainSamplesPerSec<<" samples/s"<<endl;
+
+  cout<<setprecision(5);
+  for (size_t s = 0; s < result.sets.size(); s++)
+    {
+      const setResult &set = result.sets[s];
+
+      cout<<"  "<<set.name<<" ("<<set.numSamples<<" samples): mse";
+      for (size_t i = 0; i < set.outputMse.size(); i++)
+	{
+	  cout<<" "<<set.outputMse[i];
+	}
+      cout<<", mean "<<set.meanMse<<", output step "<<set.outputStep<<endl;
+    }
+
+  cout.unsetf(ios::floatfield);
+  cout<<setprecision(6);
+}
+
+
+
+
+// The best brain of each encoding, on the
+// mean of its sets' mean MSE
+struct encodingResult
+{
+  string encoding;
+  int    numBrains;
+  string bestBrain;
+  double meanMse;
+  double outputStep;
+  double singleP50Us;
+};
+
+
+
+static vector<encodingResult> compareEncodings(const vector<brainResult>& results)
+{
+  vector<encodingResult> compared;
+  size_t                 r, s, e;
+
+  for (r = 0; r < results.size(); r++)
+    {
+      const brainResult &result = results[r];
+
+      if (result.sets.empty())
+	{
+	  continue;
+	}
+
+      double meanMse    = 0.0;
+      double outputStep = 0.0;
+
+      for (s = 0; s < result.sets.size(); s++)
+	{
+	  meanMse    += result.sets[s].meanMse    / result.sets.size();
+	  outputStep += result.sets[s].outputStep / result.sets.size();
+	}
+
+      for (e = 0; e < compared.size(); e++)
+	{
+	  if (compared[e].encoding == result.encoding)
+	    break;
+	}
+
+      if (e == compared.size())
+	{
+	  encodingResult first;
+	  first.encoding  = result.encoding;
+	  first.numBrains = 0;
+	  first.meanMse   = 1e30;
+	  compared.push_back(first);
+	}
+
+      compared[e].numBrains++;
+
+      if (meanMse < compared[e].meanMse)
+	{
+	  compared[e].bestBrain   = result.name;
+	  compared[e].meanMse     = meanMse;
+	  compared[e].outputStep  = outputStep;
+	  compared[e].singleP50Us = result.singleP50Us;
+	}
+    }
+
+  return compared;
+}
+
+
+
+static void printComparison(const vector<encodingResult>& compared)
+{
+  cout<<endl<<"Encodings:"<<endl;
+
+  cout<<fixed<<setprecision(5);
+  for (size_t e = 0; e < compared.size(); e++)
+    {
+      cout<<"  "<<compared[e].encoding<<": best of "<<compared[e].numBrains
+	  <<" is "<<compared[e].bestBrain<<", mean mse "<<compared[e].meanMse
+	  <<", output step "<<compared[e].outputStep
+	  <<setprecision(3)<<", p50 "<<compared[e].singleP50Us<<" us"
+	  <<setprecision(5)<<endl;
+    }
+
+  cout.unsetf(ios::floatfield);
+  cout<<setprecision(6);
+}
+
+
+
+
+// Names are file paths, quote the
+// couple of characters JSON cares about
+static string jsonString(const string &text)
+{
+  string quoted = "\"";
+
+  for (size_t i = 0; i < text.size(); i++)
+    {
+      if ((text[i] == '"') || (text[i] == '\\'))
+	{
+	  quoted += '\\';
+	}
+      quoted += text[i];
+    }
+
+  return quoted + "\"";
+}
+
+
+
+
+static bool writeJson(string filename, const vector<brainResult>& results,
+		      const vector<encodingResult>& compared, int iterations)
+{
+  ofstream json(filename.c_str(), ios::out);
+
+  if (!json)
+    {
+      cout<<"Failed to open "<<filename<<endl;
+      return false;
+    }
+
+  json<<setprecision(9);
+  json<<"{"<<endl;
+  json<<"  \"iterations\": "<<iterations<<","<<endl;
+  json<<"  \"batchSize\": "<<BENCHBATCHSIZE<<","<<endl;
+  json<<"  \"brains\": ["<<endl;
+
+  for (size_t r = 0; r < results.size(); r++)
+    {
+      const brainResult &result = results[r];
+
+      json<<"    {"<<endl;
+      json<<"      \"brain\": "<<jsonString(result.name)<<","<<endl;
+      json<<"      \"encoding\": "<<jsonString(result.encoding)<<","<<endl;
+      json<<"      \"inputs\": "<<result.numInputs<<","<<endl;
+      json<<"      \"hidden\": "<<result.numHidden<<","<<endl;
+      json<<"      \"outputs\": "<<result.numOutputs<<","<<endl;
+      json<<"      \"loadMs\": "<<result.loadMs<<","<<endl;
+      json<<"      \"singleP50Us\": "<<result.singleP50Us<<","<<endl;
+      json<<"      \"singleP99Us\": "<<result.singleP99Us<<","<<endl;
+      json<<"      \"batchP50Us\": "<<result.batchP50Us<<","<<endl;
+      json<<"      \"batchP99Us\": "<<result.batchP99Us<<","<<endl;
+      json<<"      \"trainSamplesPerSec\": "<<result.trainSamplesPerSec
+	  <<","<<endl;
+      json<<"      \"sets\": [";
+
+      for (size_t s = 0; s < result.sets.size(); s++)
+	{
+	  const setResult &set = result.sets[s];
+
+	  json<<(s ? "," : "")<<endl;
+	  json<<"        {\"set\": "<<jsonString(set.name)
+	      <<", \"samples\": "<<set.numSamples<<", \"mse\": [";
+	  for (size_t i = 0; i < set.outputMse.size(); i++)
+	    {
+	      json<<(i ? ", " : "")<<set.outputMse[i];
+	    }
+	  json<<"], \"meanMse\": "<<set.meanMse
+	      <<", \"outputStep\": "<<set.outputStep<<"}";
+	}
+
+      json<<endl<<"      ]"<<endl;
+      json<<"    }"<<(r + 1 < results.size() ? "," : "")<<endl;
+    }
+
+  json<<"  ],"<<endl;
+  json<<"  \"encodings\": [";
+
+  for (size_t e = 0; e < compared.size(); e++)
+    {
+      json<<(e ? "," : "")<<endl;
+      json<<"    {\"encoding\": "<<jsonString(compared[e].encoding)
+	  <<", \"brains\": "<<compared[e].numBrains
+	  <<", \"bestBrain\": "<<jsonString(compared[e].bestBrain)
+	  <<", \"meanMse\": "<<compared[e].meanMse
+	  <<", \"outputStep\": "<<compared[e].outputStep
+	  <<", \"singleP50Us\": "<<compared[e].singleP50Us<<"}";
+    }
+
+  json<<endl<<"  ]"<<endl;
+  json<<"}"<<endl;
+
+  return !json.fail();
+}
+
+
+
+
+// The training sets aiTrainer is usually run
+// on, whichever of them are there. The split
+// up trainingFiles are a sample or so each,
+// they're scored as one set.
+static void openDefaultSets(vector<benchSet>& sets)
+{
+  vector<string> trainingFiles;
+  glob_t         found;
+  benchSet       set;
+
+  if (glob(BENCHDEFAULTSETS, 0, NULL, &found) == 0)
+    {
+      for (size_t f = 0; f < found.gl_pathc; f++)
+	{
+	  trainingFiles.push_back(found.gl_pathv[f]);
+	}
+    }
+  globfree(&found);
+
+  if (!trainingFiles.empty())
+    {
+      set.name = BENCHDEFAULTSETS;
+      set.data = importBenchSet(trainingFiles);
+
+      if (set.data)
+	sets.push_back(set);
+      else
+	cout<<"Couldn't read "<<BENCHDEFAULTSETS<<", skipping them"<<endl;
+    }
+
+  if (fileExists(BENCHPURESET))
+    {
+      set.name = BENCHPURESET;
+      set.data = openBenchSet(BENCHPURESET);
+
+      if (set.data)
+	sets.push_back(set);
+      else
+	cout<<"Couldn't read "<<BENCHPURESET<<", skipping it"<<endl;
+    }
+
+  if (sets.empty())
+    {
+      cout<<"No training sets in "<<BENCHDEFAULTSETS<<" or "
+	  <<BENCHPURESET<<", only timing the brains"<<endl;
+    }
+}
+
+
+
+
+void printUsage()
+{
+  cout<<"Usage: brainbench [-json results.json] [-iterations N] "
+      <<"brainFile... [-sets dataSet...]"<<endl;
+  cout<<"  Without -sets, scores against "<<BENCHDEFAULTSETS<<" and "
+      <<BENCHPURESET<<endl;
+  cout<<"  e.g. brainbench -json bench.json brains/* targetSeekerNeuralNet "
+      <<"-sets trainingSet.dset"<<endl;
+}
+
+
+
+
+int main(int argc, char* argv[])
+{
+  vector<string>      brainFiles;
+  vector<benchSet>    sets;
+  vector<brainResult> results;
+  vector<encodingResult> compared;
+  string              jsonFile;
+  int                 iterations = BENCHITERATIONS;
+  bool                readingSets = false;
+  int                 i;
+
+  for (i = 1; i < argc; i++)
+    {
+      if (!strcmp(argv[i], "-json") && (i + 1 < argc))
+	{
+	  jsonFile = argv[++i];
+	}
+      else if (!strcmp(argv[i], "-iterations") && (i + 1 < argc))
+	{
+	  iterations = atoi(argv[++i]);
+	}
+      else if (!strcmp(argv[i], "-sets"))
+	{
+	  readingSets = true;
+	}
+      else if (argv[i][0] == '-')
+	{
+	  printUsage();
+	  exit(1);
+	}
+      else if (readingSets)
+	{
+	  benchSet set;
+	  set.name = argv[i];
+	  set.data = openBenchSet(argv[i]);
+
+	  if (!set.data)
+	    {
+	      cout<<"Couldn't read data set "<<argv[i]<<endl;
+	      exit(1);
+	    }
+	  sets.push_back(set);
+	}
+      else
+	{
+	  brainFiles.push_back(argv[i]);
+	}
+    }
+
+  if (brainFiles.empty() || (iterations < 1))
+    {
+      printUsage();
+      exit(1);
+    }
+
+  if (!readingSets)
+    {
+      openDefaultSets(sets);
+    }
+
+  for (size_t b = 0; b < brainFiles.size(); b++)
+    {
+      // ReadData doesn't notice a missing file
+      if (!fileExists(brainFiles[b]))
+	{
+	  cout<<"Couldn't open brain "<<brainFiles[b]<<endl;
+	  exit(1);
+	}
+
+      results.push_back(benchBrain(brainFiles[b], sets, iterations));
+      printResult(results.back());
+    }
+
+  for (size_t s = 0; s < sets.size(); s++)
+    {
+      delete sets[s].data;
+    }
+
+  compared = compareEncodings(results);
+  if (!compared.empty())
+    {
+      printComparison(compared);
+    }
+
+  if (!jsonFile.empty())
+    {
+      if (!writeJson(jsonFile, results, compared, iterations))
+	{
+	  exit(1);
+	}
+      cout<<endl<<"Results written to "<<jsonFile<<endl;
+    }
+
+  return 0;
+}
@@ -0,0 +1,260 @@
+// Compiles an eye brain into the table of
+// every answer it can give (utils/brainTable.h),
+// checks the table gives exactly what the net
+// does, and times the two against each other.
+// The TargetSeeker does the same compile by
+// itself when it loads a brain, this is for
+// looking at the table, or writing it out as
+// a constexpr header.
+//
+//   braincompile [-header table.h] [-name tableName]
+//                [-iterations N] brainFile
+
+
+#include <iostream>
+using namespace std;
+#include <iomanip>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+
+#include "neuralNet.h"
+#include "seekerEncoding.h"
+#include "brainTable.h"
+
+
+
+// Default number of timed inferences
+#define COMPILEITERATIONS 1000000
+
+
+
+
+static double secondsNow()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+
+// Something for each eye cell and roll,
+// spread around the boundaries
+static void makeSamples(eyeSample *samples, int count)
+{
+  srand(1);
+
+  for (int i = 0; i < count; i++)
+    {
+      samples[i].bearing   = (rand() % 600) / 10.0;
+      samples[i].elevation = (rand() % 600) / 10.0;
+      samples[i].relativeX = (rand() % 2001) - 1000.0;
+      samples[i].relativeZ = (rand() % 2001) - 1000.0;
+      samples[i].roll      = (rand() % 200) / 10.0 - 10.0;
+    }
+}
+
+
+
+// Base of the file name, made into
+// something that can name a variable
+static string tableNameFor(string brainFile)
+{
+  string name;
+  size_t slash = brainFile.rfind('/');
+
+  if (slash != string::npos)
+    {
+      brainFile = brainFile.substr(slash + 1);
+    }
+
+  for (size_t i = 0; i < brainFile.size(); i++)
+    {
+      name += isalnum(brainFile[i]) ? brainFile[i] : '_';
+    }
+
+  if (name.empty() || isdigit(name[0]))
+    {
+      name = "brain_" + name;
+    }
+
+  return name + "Table";
+}
+
+
+
+void printUsage()
+{
+  cout<<"Usage: braincompile [-header table.h] [-name tableName] "
+      <<"[-iterations N] brainFile"<<endl;
+  cout<<"  e.g. braincompile -header seekerTable.h targetSeekerNeuralNet"
+      <<endl;
+}
+
+
+
+
+int main(int argc, char* argv[])
+{
+  static const int numSamples = 1024;
+
+  NeuralNetwork  net;
+  SeekerEncoding encoding;
+  brainTable     table;
+  eyeSample      samples[numSamples];
+  eyeBoundaries  boundaries;
+  string         brainFile, headerFile, tableName;
+  int            iterations = COMPILEITERATIONS;
+  long           mismatches = 0;
+  double         start, netUs, tableUs, checksum = 0.0;
+  int            i;
+
+  for (i = 1; i < argc; i++)
+    {
+      if (!strcmp(argv[i], "-header") && (i + 1 < argc))
+	{
+	  headerFile = argv[++i];
+	}
+      else if (!strcmp(argv[i], "-name") && (i + 1 < argc))
+	{
+	  tableName = argv[++i];
+	}
+      else if (!strcmp(argv[i], "-iterations") && (i + 1 < argc))
+	{
+	  iterations = atoi(argv[++i]);
+	}
+      else if ((argv[i][0] == '-') || !brainFile.empty())
+	{
+	  printUsage();
+	  exit(1);
+	}
+      else
+	{
+	  brainFile = argv[i];
+	}
+    }
+
+  if (brainFile.empty() || (iterations < 1))
+    {
+      printUsage();
+      exit(1);
+    }
+
+  if (tableName.empty())
+    {
+      tableName = tableNameFor(brainFile);
+    }
+
+  if (!net.LoadData(brainFile))
+    {
+      exit(1);
+    }
+
+  encoding = encodingForInputs(net.InputLayer.NumberOfNodes);
+
+  if (!compileBrain(net, encoding, table))
+    {
+      cout<<brainFile<<" is a "<<encodingName(encoding)<<" brain with "
+	  <<net.InputLayer.NumberOfNodes<<" inputs and "
+	  <<net.OutputLayer.NumberOfNodes<<" outputs, its inputs "
+	  <<"aren't a fixed set, it can't be compiled"<<endl;
+      net.CleanUp();
+      exit(1);
+    }
+
+  cout<<brainFile<<": "<<net.HiddenLayer.NumberOfNodes
+      <<" hidden nodes, compiled to "<<EYE_STATES<<" entries"<<endl<<endl;
+
+  cout<<" cell roll ";
+  for (i = 0; i < STICK_OUTPUTS; i++)
+    {
+      cout<<setw(12)<<stickOutputNames[i];
+    }
+  cout<<endl;
+
+  for (int state = 0; state < EYE_STATES; state++)
+    {
+      cout<<setw(5)<<state / EYE_ROLL_STATES
+	  <<setw(5)<<state % EYE_ROLL_STATES;
+
+      for (i = 0; i < STICK_OUTPUTS; i++)
+	{
+	  cout<<setw(12)<<setprecision(5)<<table.outputs[state][i];
+	}
+      cout<<endl;
+    }
+  cout<<endl;
+
+
+  // The table has to be the net, for
+  // whatever the eyes could see
+  boundaries.side     = 10.0;
+  boundaries.vertical = 10.0;
+  boundaries.roll     = 5.0;
+
+  makeSamples(samples, numSamples);
+
+  for (i = 0; i < numSamples; i++)
+    {
+      const double *outputs = table.outputs[eyeState(samples[i], boundaries)];
+
+      encodeEyes(samples[i], boundaries, net.InputLayer.NeuronValues);
+      net.FeedForward();
+
+      for (int j = 0; j < STICK_OUTPUTS; j++)
+	{
+	  if (outputs[j] != net.GetOutput(j))
+	    {
+	      mismatches++;
+	    }
+	}
+    }
+
+  cout<<"Checked against the net on "<<numSamples<<" samples, "
+      <<mismatches<<" outputs different"<<endl;
+
+
+  // The same work the TargetSeeker does
+  // each time, both ways
+  start = secondsNow();
+  for (i = 0; i < iterations; i++)
+    {
+      encodeEyes(samples[i % numSamples], boundaries,
+		 net.InputLayer.NeuronValues);
+      net.FeedForward();
+      checksum += net.GetOutput(i % STICK_OUTPUTS);
+    }
+  netUs = (secondsNow() - start) * 1e6 / iterations;
+
+  start = secondsNow();
+  for (i = 0; i < iterations; i++)
+    {
+      checksum += table.outputs[eyeState(samples[i % numSamples],
+					 boundaries)][i % STICK_OUTPUTS];
+    }
+  tableUs = (secondsNow() - start) * 1e6 / iterations;
+
+  cout<<"Net:   "<<setprecision(4)<<netUs * 1000.0<<" ns per inference"<<endl;
+  cout<<"Table: "<<setprecision(4)<<tableUs * 1000.0<<" ns per inference, "
+      <<setprecision(3)<<netUs / tableUs<<"x faster"
+      <<" (checksum "<<checksum<<")"<<endl;
+
+  net.CleanUp();
+
+  if (!headerFile.empty())
+    {
+      if (!writeBrainTableHeader(table, tableName, brainFile, headerFile))
+	{
+	  exit(1);
+	}
+      cout<<"Wrote "<<tableName<<" to "<<headerFile<<endl;
+    }
+
+  return (mismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,540 @@
+// The Pilot's flight controllers,
+// see flightController.h
+
+#include <iostream>
+using namespace std;
+#include <math.h>
+#include <string.h>
+
+
+#include "flightController.h"
+#include "pilot.h"
+#include "speech.h"
+
+
+
+// Attitude hold defaults. Pitch and roll
+// have the proportional gains the old fixed
+// attitude hold had (full elevator at 5
+// degrees off, full aileron at 15), with a
+// little integral for trim and a little
+// derivative for damping.
+static const pidGains defaultGains[AttitudeHoldController::NumberOfLoops] =
+  {
+    //  kp          ki     kd     integral  output
+    {  0.2,         0.05,  0.02,   0.3,      1.0  },  // pitch -> elevator
+    {  0.066666667, 0.01,  0.01,   0.2,      1.0  },  // roll -> aileron
+    {  1.0,         0.0,   0.0,    0.0,     25.0  },  // heading -> roll
+    {  0.05,        0.002, 0.0,    3.0,     10.0  }   // altitude -> pitch
+  };
+
+// Roll error beyond which pitch is left alone
+// until the wings are closer to level, so the
+// heading doesn't get too out of whack
+#define WINGS_FIRST_ROLL_ERROR 15.0
+
+
+
+
+// -180..180, the short way round
+static double headingError(double wanted, double heading)
+{
+  double error = fmod(wanted - heading, 360.0);
+
+  if (error > 180.0)
+    {
+      error -= 360.0;
+    }
+  else if (error < -180.0)
+    {
+      error += 360.0;
+    }
+
+  return error;
+}
+
+
+
+static inline double clampTo(double value, double limit)
+{
+  if (value > limit)
+    {
+      return limit;
+    }
+  if (value < -limit)
+    {
+      return -limit;
+    }
+
+  return value;
+}
+
+
+
+
+/*********************************************************
+
+PidLoop
+
+*********************************************************/
+
+
+PidLoop::PidLoop()
+{
+  gains.kp            = 0.0;
+  gains.ki            = 0.0;
+  gains.kd            = 0.0;
+  gains.integralLimit = 0.0;
+  gains.outputLimit   = 1.0;
+
+  reset();
+}
+
+
+
+void PidLoop::setGains(const pidGains &newGains)
+{
+  gains = newGains;
+  reset();
+}
+
+
+
+void PidLoop::reset()
+{
+  integral      = 0.0;
+  lastError     = 0.0;
+  haveLastError = false;
+}
+
+
+
+double PidLoop::update(double error, double dt)
+{
+  double proportional, derivative, newIntegral, output;
+
+  proportional = gains.kp * error;
+
+  // Nothing to take a slope from yet
+  derivative = (haveLastError && (dt > 0.0)) ?
+    gains.kd * (error - lastError) / dt : 0.0;
+
+  newIntegral = clampTo(integral + gains.ki * error * dt,
+			gains.integralLimit);
+
+  output = proportional + newIntegral + derivative;
+
+  // Anti-windup, only let the integral grow
+  // if that doesn't push the output further
+  // past its limit
+  if (!(((output >  gains.outputLimit) && (error > 0.0)) ||
+	((output < -gains.outputLimit) && (error < 0.0))))
+    {
+      integral = newIntegral;
+    }
+
+  lastError     = error;
+  haveLastError = true;
+
+  return clampTo(proportional + integral + derivative, gains.outputLimit);
+}
+
+
+
+
+/*********************************************************
+
+FlightController
+
+*********************************************************/
+
+
+FlightController::FlightController(FlyingMode controllerMode)
+{
+  mode    = controllerMode;
+  period  = 0.0;
+  lastRun = 0.0;
+  haveRun = false;
+}
+
+
+
+FlightController::~FlightController()
+{
+}
+
+
+
+void FlightController::setRate(double hertz)
+{
+  period = (hertz > 0.0) ? 1.0 / hertz : 0.0;
+}
+
+
+double FlightController::getRate() const
+{
+  return (period > 0.0) ? 1.0 / period : 0.0;
+}
+
+
+
+void FlightController::reset()
+{
+  haveRun = false;
+  resetState();
+}
+
+
+
+FlyingMode FlightController::run(double time, const posStruct &position,
+				 desiredState &goal, controlsStruct &controls)
+{
+  double dt = haveRun ? time - lastRun : 0.0;
+
+  if (haveRun && (dt < period))
+    {
+      return mode;
+    }
+
+  lastRun = time;
+  haveRun = true;
+
+  return step(dt, position, goal, controls);
+}
+
+
+
+
+/*********************************************************
+
+TakeOffController
+
+*********************************************************/
+
+
+TakeOffController::TakeOffController():FlightController(TakeOffMode)
+{
+  rotateSpeed = 175.0;  // knots
+  climbPitch  =  30.0;
+  climbRoll   =   0.0;
+
+  resetState();
+}
+
+
+
+void TakeOffController::setRotateSpeed(double knots)
+{
+  rotateSpeed = knots;
+}
+
+
+void TakeOffController::setClimbAttitude(double pitch, double roll)
+{
+  climbPitch = pitch;
+  climbRoll  = roll;
+}
+
+
+
+void TakeOffController::resetState()
+{
+  runwayHeading     = 0.0;
+  haveRunwayHeading = false;
+}
+
+
+
+FlyingMode TakeOffController::step(double, const posStruct &position,
+				   desiredState &goal,
+				   controlsStruct &controls)
+{
+  double offRunway;
+
+  // This should be a valid initial heading down the runway
+  // Need the heading down the runway so we don't go
+  // off the side of the runway
+  if ((!haveRunwayHeading) && (position.heading != 0.0) &&
+      (position.airSpeed != 0.0))
+    {
+      haveRunwayHeading = true;
+      runwayHeading     = position.heading;
+    }
+
+  // Steer rudder left and right to
+  // keep us straight
+  offRunway = headingError(runwayHeading, position.heading);
+
+  if (offRunway > 0.0)
+    {
+      controls.rudder = 0.05;
+    }
+  else if (offRunway < 0.0)
+    {
+      controls.rudder = -0.05;
+    }
+  else
+    {
+      controls.rudder = 0.0;
+    }
+
+  // Peg the throttles for takeoff!
+  controls.throttle = 1.0;
+
+  // Time to lift off, set an attitude to hold, and let the
+  // attitude hold handle it...
+  if (position.airSpeed >= rotateSpeed)
+    {
+      goal.holdHeading = runwayHeading;
+      goal.holdPitch   = climbPitch;
+      goal.holdRoll    = climbRoll;
+
+      sayOutloud(true, "liftoff, aircraft is airborne");
+      return AttitudeHoldMode;
+    }
+
+  return mode;
+}
+
+
+
+
+/*********************************************************
+
+AttitudeHoldController
+
+*********************************************************/
+
+
+AttitudeHoldController::AttitudeHoldController():
+  FlightController(AttitudeHoldMode)
+{
+  for (int i = 0; i < NumberOfLoops; i++)
+    {
+      loops[i].setGains(defaultGains[i]);
+    }
+
+  headingHold  = false;
+  altitudeHold = false;
+}
+
+
+
+void AttitudeHoldController::setGains(holdLoop loop, const pidGains &gains)
+{
+  loops[loop].setGains(gains);
+}
+
+
+void AttitudeHoldController::enableHeadingHold(bool on)
+{
+  headingHold = on;
+  loops[HeadingLoop].reset();
+}
+
+
+void AttitudeHoldController::enableAltitudeHold(bool on)
+{
+  altitudeHold = on;
+  loops[AltitudeLoop].reset();
+}
+
+
+
+void AttitudeHoldController::resetState()
+{
+  for (int i = 0; i < NumberOfLoops; i++)
+    {
+      loops[i].reset();
+    }
+}
+
+
+
+FlyingMode AttitudeHoldController::step(double dt, const posStruct &position,
+					desiredState &goal,
+					controlsStruct &controls)
+{
+  double wantedPitch = goal.holdPitch;
+  double wantedRoll  = goal.holdRoll;
+  double rollError;
+
+  // The outer loops just move
+  // the attitude to hold
+  if (altitudeHold)
+    {
+      wantedPitch = loops[AltitudeLoop].update(goal.holdAltitude -
+					       position.alt, dt);
+    }
+
+  if (headingHold)
+    {
+      wantedRoll = loops[HeadingLoop].update(headingError(goal.holdHeading,
+							  position.heading),
+					     dt);
+    }
+
+  // Right wing down is positive roll,
+  // positive aileron rolls right
+  rollError         = wantedRoll - position.roll;
+  controls.aileron  = loops[RollLoop].update(rollError, dt);
+
+  // Level the wings first if they're way off,
+  // and don't let the pitch integral wind up
+  // while it's being ignored
+  if (fabs(rollError) > WINGS_FIRST_ROLL_ERROR)
+    {
+      controls.elevator = 0.0;
+      loops[PitchLoop].reset();
+    }
+  else
+    {
+      // Positive elevator pushes the nose down
+      controls.elevator = -loops[PitchLoop].update(wantedPitch -
+						   position.pitch, dt);
+    }
+
+  controls.rudder   = 0.0;
+  controls.throttle = 1.0;
+
+  return mode;
+}
+
+
+
+
+/*********************************************************
+
+SeekerController
+
+*********************************************************/
+
+
+SeekerController::SeekerController():FlightController(TargetSeekMode)
+{
+  seeker = NULL;
+  resetState();
+}
+
+
+
+void SeekerController::setTargetSeeker(TargetSeeker *newSeeker)
+{
+  seeker = newSeeker;
+}
+
+
+
+void SeekerController::think(const posStruct &position)
+{
+  seeker->setAircraftPosition(position.lat, position.lon, position.alt,
+			      position.heading, position.pitch,
+			      position.roll);
+  seeker->calculateNewTargetBearingElevationDist();
+  seeker->getAircraftControls(command[0], command[1], command[2]);
+
+  haveCommand = true;
+}
+
+
+
+void SeekerController::getSmoothing(seekerSmoothing &saved) const
+{
+  memcpy(saved.command,   command,   sizeof(command));
+  memcpy(saved.elevators, elevators, sizeof(elevators));
+  memcpy(saved.ailerons,  ailerons,  sizeof(ailerons));
+  memcpy(saved.rudders,   rudders,   sizeof(rudders));
+
+  saved.haveCommand   = haveCommand;
+  saved.head          = head;
+  saved.smootherEmpty = smootherEmpty;
+}
+
+
+
+void SeekerController::setSmoothing(const seekerSmoothing &saved)
+{
+  memcpy(command,   saved.command,   sizeof(command));
+  memcpy(elevators, saved.elevators, sizeof(elevators));
+  memcpy(ailerons,  saved.ailerons,  sizeof(ailerons));
+  memcpy(rudders,   saved.rudders,   sizeof(rudders));
+
+  haveCommand   = saved.haveCommand;
+  head          = saved.head % SEEKER_SMOOTHING;
+  smootherEmpty = saved.smootherEmpty;
+}
+
+
+
+void SeekerController::resetState()
+{
+  head          = 0;
+  smootherEmpty = true;
+  haveCommand   = false;
+}
+
+
+
+FlyingMode SeekerController::step(double, const posStruct &position,
+				  desiredState &,
+				  controlsStruct &controls)
+{
+  double elevator, aileron, rudder;
+
+  // Don't fly the first steps after a switch
+  // on whatever the net said last time
+  if (!haveCommand)
+    {
+      think(position);
+    }
+
+  elevator = command[0];
+  aileron  = command[1];
+  rudder   = command[2];
+
+  // The continuous brains are smooth already
+  if (seeker->getEncoding() != EyeEncoding)
+    {
+      controls.elevator = elevator;
+      controls.aileron  = aileron;
+      controls.rudder   = rudder;
+      controls.throttle = 1.0;
+      return mode;
+    }
+
+  // Start the average off at the first
+  // command, not at zero
+  if (smootherEmpty)
+    {
+      for (int i = 0; i < SEEKER_SMOOTHING; i++)
+	{
+	  elevators[i] = elevator;
+	  ailerons [i] = aileron;
+	  rudders  [i] = rudder;
+	}
+      smootherEmpty = false;
+    }
+
+  elevators[head] = elevator;
+  ailerons [head] = aileron;
+  rudders  [head] = rudder;
+  head = (head + 1) % SEEKER_SMOOTHING;
+
+  controls.elevator = 0.0;
+  controls.aileron  = 0.0;
+  controls.rudder   = 0.0;
+
+  for (int i = 0; i < SEEKER_SMOOTHING; i++)
+    {
+      controls.elevator += elevators[i];
+      controls.aileron  += ailerons [i];
+      controls.rudder   += rudders  [i];
+    }
+
+  controls.elevator /= SEEKER_SMOOTHING;
+  controls.aileron  /= SEEKER_SMOOTHING;
+  controls.rudder   /= SEEKER_SMOOTHING;
+  controls.throttle  = 1.0;
+
+  return mode;
+}
@@ -0,0 +1,294 @@
+#ifndef FLIGHTCONTROLLER_H
+#define FLIGHTCONTROLLER_H
+
+// The ways the Pilot can fly the aircraft.
+// Each FlyingMode has a FlightController,
+// the Pilot runs whichever one its mode
+// says. A controller keeps all of its own
+// state (nothing static, nothing allocated
+// once it's built) and can be set to run
+// less often than every update, the controls
+// just stay where it left them in between.
+//
+//   TakeOffController       full throttle down
+//                           the runway, rotate
+//                           at a set airspeed
+//   AttitudeHoldController  PID loops on pitch
+//                           and roll, with
+//                           optional heading and
+//                           altitude hold on top
+//   SeekerController        the TargetSeeker's
+//                           neural net
+
+
+
+
+enum FlyingMode
+  {
+    TargetSeekMode = 1,
+    AttitudeHoldMode,
+    TakeOffMode,
+    SitStillMode,
+    endList
+  };
+
+
+
+
+// basic position information,
+// attitude, and speed information
+struct posStruct
+{
+  double lat;
+  double lon;
+  double alt;
+  double radAlt;
+  double heading;
+  double pitch;
+  double roll;
+  double airSpeed;
+};
+
+
+struct desiredState
+{
+  // For target seeking mode
+  double targetLat;
+  double targetLon;
+  double targetAlt;
+
+  // For attitude hold mode
+  double holdHeading;
+  double holdPitch;
+  double holdRoll;
+  double holdAirSpeed;
+  double holdAltitude;
+};
+
+
+
+
+// basic flight control info
+struct controlsStruct
+{
+  double elevator;
+  double aileron;
+  double rudder;
+  double throttle;
+};
+
+
+
+
+
+// Gains and limits for one PID loop. The
+// integral is held to integralLimit, the
+// output to outputLimit.
+struct pidGains
+{
+  double kp;
+  double ki;
+  double kd;
+  double integralLimit;
+  double outputLimit;
+};
+
+
+
+// One PID loop. While the output is pinned
+// at its limit the integral stops growing in
+// that direction (anti-windup), so it doesn't
+// overshoot unwinding it afterwards.
+class PidLoop
+{
+ public:
+  PidLoop();
+
+  void   setGains(const pidGains &newGains);
+  void   reset();
+
+  // error is setpoint - measurement, dt the
+  // seconds since the last update
+  double update(double error, double dt);
+
+ private:
+  pidGains gains;
+  double   integral;
+  double   lastError;
+  bool     haveLastError;
+};
+
+
+
+
+
+// Base of all the controllers. The Pilot
+// calls run() every update, step() only
+// happens once the controller's period is up.
+class FlightController
+{
+ public:
+  FlightController(FlyingMode controllerMode);
+  virtual ~FlightController();
+
+  // Updates a second, 0 (the default)
+  // runs it on every update
+  void   setRate(double hertz);
+  double getRate() const;
+
+  // Forget everything, the Pilot calls
+  // this when it switches to the controller
+  void reset();
+
+  // Time in seconds. Returns the mode
+  // to fly from now on, normally this
+  // controller's own.
+  FlyingMode run(double time, const posStruct &position,
+		 desiredState &goal, controlsStruct &controls);
+
+ protected:
+  virtual void       resetState() = 0;
+  virtual FlyingMode step(double dt, const posStruct &position,
+			  desiredState &goal, controlsStruct &controls) = 0;
+
+  FlyingMode mode;
+
+ private:
+  double period;
+  double lastRun;
+  bool   haveRun;
+};
+
+
+
+
+
+// Holds the runway heading with the rudder
+// at full throttle, and rotates into
+// AttitudeHoldMode at the climb attitude
+// once fast enough
+class TakeOffController : public FlightController
+{
+ public:
+  TakeOffController();
+
+  void setRotateSpeed(double knots);
+  void setClimbAttitude(double pitch, double roll);
+
+ protected:
+  void       resetState();
+  FlyingMode step(double dt, const posStruct &position,
+		  desiredState &goal, controlsStruct &controls);
+
+ private:
+  double rotateSpeed;
+  double climbPitch;
+  double climbRoll;
+  double runwayHeading;
+  bool   haveRunwayHeading;
+};
+
+
+
+
+
+// Pitch and roll held with PID loops.
+// Heading hold banks towards holdHeading,
+// altitude hold pitches towards holdAltitude,
+// instead of using holdRoll and holdPitch.
+class AttitudeHoldController : public FlightController
+{
+ public:
+  AttitudeHoldController();
+
+  enum holdLoop
+    {
+      PitchLoop,
+      RollLoop,
+      HeadingLoop,
+      AltitudeLoop,
+      NumberOfLoops
+    };
+
+  void setGains(holdLoop loop, const pidGains &gains);
+  void enableHeadingHold(bool on);
+  void enableAltitudeHold(bool on);
+
+ protected:
+  void       resetState();
+  FlyingMode step(double dt, const posStruct &position,
+		  desiredState &goal, controlsStruct &controls);
+
+ private:
+  PidLoop loops[NumberOfLoops];
+  bool    headingHold;
+  bool    altitudeHold;
+};
+
+
+
+
+
+// Defined in pilot.h
+class TargetSeeker;
+
+
+// Flies to the target with the TargetSeeker's
+// neural net. The net is the slow part, it
+// only picks a new command when think() is
+// called, step() keeps flying the latest
+// one. The eye brains only know 9 boxes,
+// their jumps from box to box are averaged
+// out over the last few steps.
+#define SEEKER_SMOOTHING 15
+
+// The smoothing as it stands, to carry
+// on with after a restart
+struct seekerSmoothing
+{
+  double command[3];
+  bool   haveCommand;
+
+  double elevators[SEEKER_SMOOTHING];
+  double ailerons [SEEKER_SMOOTHING];
+  double rudders  [SEEKER_SMOOTHING];
+  int    head;
+  bool   smootherEmpty;
+};
+
+class SeekerController : public FlightController
+{
+ public:
+  SeekerController();
+
+  void setTargetSeeker(TargetSeeker *newSeeker);
+
+  // Run the net on the position
+  void think(const posStruct &position);
+
+  void getSmoothing(seekerSmoothing &saved) const;
+  void setSmoothing(const seekerSmoothing &saved);
+
+ protected:
+  void       resetState();
+  FlyingMode step(double dt, const posStruct &position,
+		  desiredState &goal, controlsStruct &controls);
+
+ private:
+  TargetSeeker *seeker;
+
+  // The net's latest command
+  double command[3];
+  bool   haveCommand;
+
+  double elevators[SEEKER_SMOOTHING];
+  double ailerons [SEEKER_SMOOTHING];
+  double rudders  [SEEKER_SMOOTHING];
+  int    head;
+  bool   smootherEmpty;
+};
+
+
+
+
+#endif // FLIGHTCONTROLLER_H
@@ -27,3 +27,40 @@ void BaseEntity::setId(int newId)
   nextValidId = id + 1;
   cout<<"Instatiated a base entity with id "<<id<<endl;
 }
+
+
+
+// Entities that don't take messages
+// just drop them
+bool BaseEntity::handleMessage(const message &)
+{
+  return false;
+}
+
+
+
+int BaseEntity::deliverMessages(double now)
+{
+  return inbox.deliver(now, this);
+}
+
+
+
+MessageInbox& BaseEntity::getInbox()
+{
+  return inbox;
+}
+
+
+
+void BaseEntity::joinGroup(int group)
+{
+  MessageDispatcher::Instance()->joinGroup(id, group);
+}
+
+
+
+void BaseEntity::leaveGroup(int group)
+{
+  MessageDispatcher::Instance()->leaveGroup(id, group);
+}
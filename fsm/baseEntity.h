@@ -2,6 +2,9 @@
 #define BASEENTITY_H
 
 
+#include "messaging.h"
+
+
 // Base class for an entity
 // Needs to be inherited
 // by a more specific entity
@@ -12,6 +15,12 @@ class BaseEntity
   BaseEntity(int id)
     {
       setId(id);
+      MessageDispatcher::Instance()->registerEntity(this);
+    }
+
+  virtual ~BaseEntity()
+    {
+      MessageDispatcher::Instance()->removeEntity(this);
     }
   
   // Entities must have an update
@@ -22,6 +31,21 @@ class BaseEntity
   virtual void update() = 0;
 
   int getId() const;
+
+
+  // Messages from the MessageDispatcher,
+  // see messaging.h. handleMessage() gets
+  // each one that's due when the entity
+  // calls deliverMessages(), from its own
+  // update, and returns TRUE if it was
+  // used.
+  virtual bool handleMessage(const message &msg);
+  int          deliverMessages(double now);
+
+  MessageInbox& getInbox();
+
+  void joinGroup(int group);
+  void leaveGroup(int group);
   
  private:
   // Static so that you can 
@@ -34,6 +58,8 @@ class BaseEntity
   // Identifying number
   int id;
   void setId(int id);
+
+  MessageInbox inbox;
 };
 
 
@@ -9,6 +9,9 @@
 #endif
 
 
+#include "messaging.h"
+
+
 // A template class for states
 // to be used in conjunction with the
 // state machine in stateMachine.h
@@ -28,6 +31,15 @@ class BaseState
 
   // State exit function, run once, upon exit of the state
   virtual void exit(entityType*) = 0;
+
+  // A message for the entity, passed on
+  // by the stateMachine's handleMessage
+  // function. Return TRUE if it was used,
+  // the default ignores everything.
+  virtual bool onMessage(entityType*, const message&)
+    {
+      return FALSE;
+    }
 };
 
 
@@ -0,0 +1,382 @@
+#ifndef BEHAVIOR_H
+#define BEHAVIOR_H
+
+
+// Multi-tick behaviors for the states in
+// stateMachine.h, written as one C++20
+// coroutine instead of a counter kept
+// between calls to execute():
+//
+//   static Behavior attackScript(Ucav *ucav)
+//   {
+//     co_await ticks(5);
+//     ucav->threatKilled();
+//   }
+//
+// The state's enter() starts the script,
+// execute() calls tick() once per update,
+// and exit() stops it. A script waits with
+// co_await ticks(n), n more ticks go by
+// first, or co_await until(test), where test
+// is anything callable returning bool and is
+// checked once a tick. tick() returns true
+// once the script has finished, the state
+// does its switching then, never from inside
+// the script, as changing state stops it.
+//
+// The first argument of a script has to be
+// the entity it runs for, which needs a
+// getBehaviorPool(). The frame comes out of
+// that entity's pool, so a suspended
+// behavior costs a pool block and nothing
+// off the heap.
+
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+
+
+
+// Bytes in each frame, and frames in each
+// entity's pool. A state's script is done
+// with before the next state's starts, so
+// one at a time is the usual.
+#ifndef BEHAVIOR_FRAME_SIZE
+#define BEHAVIOR_FRAME_SIZE  256
+#endif
+
+#ifndef BEHAVIOR_POOL_FRAMES
+#define BEHAVIOR_POOL_FRAMES 2
+#endif
+
+
+
+
+// Fixed size blocks on a free list. Frames
+// too big for a block, or wanted while
+// they're all in use, come off the heap
+// instead and are counted, see
+// getOverflows().
+class BehaviorPool
+{
+ public:
+  BehaviorPool()
+    {
+      freeBlocks = NULL;
+      inUse      = 0;
+      overflows  = 0;
+      largest    = 0;
+
+      for (int i = BEHAVIOR_POOL_FRAMES - 1; i >= 0; i--)
+	{
+	  freeBlock *block = (freeBlock*)blocks[i];
+	  block->next = freeBlocks;
+	  freeBlocks  = block;
+	}
+    }
+
+
+  void *allocate(size_t size)
+    {
+      blockHeader *header;
+
+      if (size > largest)
+	{
+	  largest = size;
+	}
+
+      if (freeBlocks && (size + sizeof(blockHeader) <= BEHAVIOR_FRAME_SIZE))
+	{
+	  header     = (blockHeader*)freeBlocks;
+	  freeBlocks = freeBlocks->next;
+	  header->pool = this;
+	  inUse++;
+	}
+      else
+	{
+	  header = (blockHeader*)::operator new(size + sizeof(blockHeader));
+	  header->pool = NULL;
+	  overflows++;
+	}
+
+      return header + 1;
+    }
+
+
+  // Back to whichever pool it came
+  // from, or the heap
+  static void release(void *frame)
+    {
+      blockHeader  *header = (blockHeader*)frame - 1;
+      BehaviorPool *pool   = header->pool;
+
+      if (pool)
+	{
+	  freeBlock *block = (freeBlock*)header;
+	  block->next      = pool->freeBlocks;
+	  pool->freeBlocks = block;
+	  pool->inUse--;
+	}
+      else
+	{
+	  ::operator delete(header);
+	}
+    }
+
+
+  int    getFramesInUse()   const { return inUse; }
+  long   getOverflows()     const { return overflows; }
+  size_t getLargestFrame()  const { return largest; }
+
+
+
+ private:
+  // Ahead of each frame, padded so
+  // the frame stays aligned
+  struct alignas(alignof(std::max_align_t)) blockHeader
+  {
+    BehaviorPool *pool;
+  };
+
+  struct freeBlock
+  {
+    freeBlock *next;
+  };
+
+  alignas(alignof(std::max_align_t))
+    unsigned char blocks[BEHAVIOR_POOL_FRAMES][BEHAVIOR_FRAME_SIZE];
+
+  freeBlock *freeBlocks;
+  int        inUse;
+  long       overflows;
+  size_t     largest;
+
+  // Blocks point back at it
+  BehaviorPool(const BehaviorPool&);
+  BehaviorPool& operator=(const BehaviorPool&);
+};
+
+
+
+
+// The handle to a running script, owned
+// by the entity it runs for
+class Behavior
+{
+ public:
+  struct promise_type
+  {
+    // What the script is waiting for,
+    // see ticks and until below
+    int          waitTicks;
+    bool       (*waitTest)(void *awaiter);
+    void        *waitAwaiter;
+
+    promise_type()
+      {
+	waitTicks   = 0;
+	waitTest    = NULL;
+	waitAwaiter = NULL;
+      }
+
+    Behavior get_return_object()
+      {
+	return Behavior(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+
+    // Nothing runs until the first tick, and
+    // the frame stays around until the
+    // Behavior lets it go
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend()   noexcept { return {}; }
+
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+
+    // The pool of whatever entity the
+    // script's first argument points to
+    struct entityPool
+    {
+      template <class entityType>
+      entityPool(entityType *entity):
+	pool(entity->getBehaviorPool())
+	{}
+
+      BehaviorPool &pool;
+    };
+
+    // Not templates, so g++ can see the
+    // frame is freed by the delete that
+    // goes with the new it came from
+    static void *operator new(size_t size, entityPool owner, ...)
+      {
+	return owner.pool.allocate(size);
+      }
+
+    static void operator delete(void *frame, size_t)
+      {
+	BehaviorPool::release(frame);
+      }
+  };
+
+
+  Behavior():
+    handle(NULL)
+    {}
+
+  Behavior(Behavior &&other):
+    handle(other.handle)
+    {
+      other.handle = NULL;
+    }
+
+  Behavior& operator=(Behavior &&other)
+    {
+      if (this != &other)
+	{
+	  stop();
+	  handle       = other.handle;
+	  other.handle = NULL;
+	}
+      return *this;
+    }
+
+  ~Behavior()
+    {
+      stop();
+    }
+
+
+  // Run the script up to its next wait, if
+  // what it's waiting for has come about.
+  // Returns true once it has finished, or
+  // if there isn't one.
+  bool tick()
+    {
+      if (!handle || handle.done())
+	{
+	  return true;
+	}
+
+      promise_type &promise = handle.promise();
+
+      if (promise.waitTicks > 0)
+	{
+	  if (--promise.waitTicks > 0)
+	    {
+	      return false;
+	    }
+	}
+      else if (promise.waitTest)
+	{
+	  if (!promise.waitTest(promise.waitAwaiter))
+	    {
+	      return false;
+	    }
+	  promise.waitTest = NULL;
+	}
+
+      handle.resume();
+      return handle.done();
+    }
+
+
+  bool isRunning() const
+    {
+      return handle && !handle.done();
+    }
+
+
+  // Throw the script away, wherever
+  // it's got to
+  void stop()
+    {
+      if (handle)
+	{
+	  handle.destroy();
+	  handle = NULL;
+	}
+    }
+
+
+ private:
+  explicit Behavior(std::coroutine_handle<promise_type> newHandle):
+    handle(newHandle)
+    {}
+
+  std::coroutine_handle<promise_type> handle;
+
+  Behavior(const Behavior&);
+  Behavior& operator=(const Behavior&);
+};
+
+
+
+
+// co_await ticks(n), carry on n ticks
+// after this one
+struct ticks
+{
+  int count;
+
+  ticks(int newCount):
+    count(newCount)
+    {}
+
+  bool await_ready() const
+    {
+      return count <= 0;
+    }
+
+  void await_suspend(std::coroutine_handle<Behavior::promise_type> script)
+    {
+      script.promise().waitTicks = count;
+    }
+
+  void await_resume() {}
+};
+
+
+
+
+// co_await until(test), carry on the first
+// tick test() is true, this one included.
+// The test lives in the awaiter, in the
+// script's frame, so it's never copied off
+// anywhere.
+template <class testType>
+struct untilAwaiter
+{
+  testType test;
+
+  bool await_ready()
+    {
+      return test();
+    }
+
+  void await_suspend(std::coroutine_handle<Behavior::promise_type> script)
+    {
+      script.promise().waitTest    = &check;
+      script.promise().waitAwaiter = this;
+    }
+
+  void await_resume() {}
+
+  static bool check(void *awaiter)
+    {
+      return ((untilAwaiter*)awaiter)->test();
+    }
+};
+
+
+template <class testType>
+untilAwaiter<testType> until(testType test)
+{
+  return untilAwaiter<testType>{test};
+}
+
+
+
+#endif
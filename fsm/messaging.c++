@@ -0,0 +1,425 @@
+// Entity inboxes and the dispatcher,
+// see messaging.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <math.h>
+
+
+#include "messaging.h"
+#include "baseEntity.h"
+#include "rateGroup.h"
+
+
+
+
+MessageInbox::MessageInbox()
+{
+  stub.next.store(NULL, memory_order_relaxed);
+  stub.later = NULL;
+
+  head.store(&stub, memory_order_relaxed);
+  tail = &stub;
+
+  for (int i = 0; i < MESSAGE_WHEEL_SLOTS; i++)
+    {
+      wheel[i] = NULL;
+    }
+
+  wheelTick    = 0;
+  wheelStarted = false;
+  waiting      = 0;
+}
+
+
+
+// Whatever never got delivered
+MessageInbox::~MessageInbox()
+{
+  messageNode *node;
+
+  while ((node = pop()) != NULL)
+    {
+      delete node;
+    }
+
+  for (int i = 0; i < MESSAGE_WHEEL_SLOTS; i++)
+    {
+      while (wheel[i])
+	{
+	  node     = wheel[i];
+	  wheel[i] = node->later;
+	  delete node;
+	}
+    }
+}
+
+
+
+void MessageInbox::post(messageNode *node)
+{
+  messageNode *previous;
+
+  node->next.store(NULL, memory_order_relaxed);
+
+  // Between these two the list is broken at
+  // previous, pop() waits for it to join up
+  previous = head.exchange(node, memory_order_acq_rel);
+  previous->next.store(node, memory_order_release);
+}
+
+
+
+int MessageInbox::deliver(double now, BaseEntity *entity)
+{
+  messageNode *node;
+  messageNode *last = head.load(memory_order_acquire);
+  long long    tick;
+  long long    first;
+  int          delivered = 0;
+  bool         end       = false;
+
+  // Up to what was there when we started,
+  // anything the handlers post waits. If
+  // that ended with the stub, it's when
+  // the tail gets back round to it.
+  while (!end && !((last == &stub) && (tail == &stub)) &&
+	 ((node = pop()) != NULL))
+    {
+      end = (node == last);
+
+      if (node->msg.dispatchTime <= now)
+	{
+	  entity->handleMessage(node->msg);
+	  delete node;
+	  delivered++;
+	}
+      else
+	{
+	  schedule(node);
+	}
+    }
+
+  if (waiting == 0)
+    {
+      return delivered;
+    }
+
+  // Every slot gone by since last time,
+  // and this one again, it may have
+  // something due later in it
+  tick = (long long)floor(now / MESSAGE_WHEEL_RESOLUTION);
+
+  if (!wheelStarted)
+    {
+      wheelTick    = tick;
+      wheelStarted = true;
+    }
+
+  first = wheelTick;
+  if (tick - first >= MESSAGE_WHEEL_SLOTS)
+    {
+      first = tick - MESSAGE_WHEEL_SLOTS + 1;
+    }
+
+  for (long long t = first; t <= tick; t++)
+    {
+      delivered += deliverSlot((int)(t % MESSAGE_WHEEL_SLOTS), now, entity);
+    }
+
+  wheelTick = tick;
+
+  return delivered;
+}
+
+
+
+int MessageInbox::getWaiting() const
+{
+  return waiting;
+}
+
+
+
+
+/******************************************
+ Private Functions
+*******************************************/
+
+
+
+// NULL if it's empty, or a poster is
+// half way through adding the next one
+messageNode *MessageInbox::pop()
+{
+  messageNode *node = tail;
+  messageNode *next = node->next.load(memory_order_acquire);
+
+  if (node == &stub)
+    {
+      if (next == NULL)
+	{
+	  return NULL;
+	}
+
+      tail = next;
+      node = next;
+      next = next->next.load(memory_order_acquire);
+    }
+
+  if (next)
+    {
+      tail = next;
+      return node;
+    }
+
+  if (node != head.load(memory_order_acquire))
+    {
+      return NULL;
+    }
+
+  // node is the last one, put the stub
+  // behind it so it can be taken
+  post(&stub);
+
+  next = node->next.load(memory_order_acquire);
+  if (next)
+    {
+      tail = next;
+      return node;
+    }
+
+  return NULL;
+}
+
+
+
+void MessageInbox::schedule(messageNode *node)
+{
+  long long tick = (long long)floor(node->msg.dispatchTime /
+				    MESSAGE_WHEEL_RESOLUTION);
+  int       slot = (int)(tick % MESSAGE_WHEEL_SLOTS);
+
+  node->later = wheel[slot];
+  wheel[slot] = node;
+  waiting++;
+}
+
+
+
+// The ones in the slot due by now, the rest
+// are a turn or more of the wheel away
+int MessageInbox::deliverSlot(int slot, double now, BaseEntity *entity)
+{
+  messageNode **link = &wheel[slot];
+  messageNode  *node;
+  int           delivered = 0;
+
+  while ((node = *link) != NULL)
+    {
+      if (node->msg.dispatchTime <= now)
+	{
+	  *link = node->later;
+	  waiting--;
+
+	  entity->handleMessage(node->msg);
+	  delete node;
+	  delivered++;
+	}
+      else
+	{
+	  link = &node->later;
+	}
+    }
+
+  return delivered;
+}
+
+
+
+
+/**************************************************************/
+
+
+
+
+MessageDispatcher* MessageDispatcher::Instance()
+{
+  static MessageDispatcher instance;
+  return &instance;
+}
+
+
+
+MessageDispatcher::MessageDispatcher()
+{
+  for (int i = 0; i < MESSAGE_MAX_ENTITIES; i++)
+    {
+      entities[i].store(NULL, memory_order_relaxed);
+      groups[i].store(0, memory_order_relaxed);
+    }
+
+  highestId.store(-1, memory_order_relaxed);
+}
+
+
+
+void MessageDispatcher::registerEntity(BaseEntity *entity)
+{
+  int id = entity->getId();
+  int highest;
+
+  if ((id < 0) || (id >= MESSAGE_MAX_ENTITIES))
+    {
+      cout<<"MessageDispatcher: entity "<<id<<" is past "
+	  <<"MESSAGE_MAX_ENTITIES, it won't get any messages"<<endl;
+      return;
+    }
+
+  entities[id].store(entity, memory_order_release);
+
+  highest = highestId.load(memory_order_relaxed);
+  while ((id > highest) &&
+	 !highestId.compare_exchange_weak(highest, id, memory_order_release))
+    {
+    }
+}
+
+
+
+void MessageDispatcher::removeEntity(BaseEntity *entity)
+{
+  int         id       = entity->getId();
+  BaseEntity *expected = entity;
+
+  if ((id >= 0) && (id < MESSAGE_MAX_ENTITIES))
+    {
+      entities[id].compare_exchange_strong(expected, NULL);
+      groups[id].store(0, memory_order_relaxed);
+    }
+}
+
+
+
+void MessageDispatcher::joinGroup(int id, int group)
+{
+  if ((id >= 0) && (id < MESSAGE_MAX_ENTITIES) &&
+      (group >= 0) && (group < MESSAGE_GROUPS))
+    {
+      groups[id].fetch_or(1u << group, memory_order_relaxed);
+    }
+}
+
+
+
+void MessageDispatcher::leaveGroup(int id, int group)
+{
+  if ((id >= 0) && (id < MESSAGE_MAX_ENTITIES) &&
+      (group >= 0) && (group < MESSAGE_GROUPS))
+    {
+      groups[id].fetch_and(~(1u << group), memory_order_relaxed);
+    }
+}
+
+
+
+bool MessageDispatcher::inGroup(int id, int group) const
+{
+  if ((id < 0) || (id >= MESSAGE_MAX_ENTITIES) ||
+      (group < 0) || (group >= MESSAGE_GROUPS))
+    {
+      return false;
+    }
+
+  return (groups[id].load(memory_order_relaxed) >> group) & 1u;
+}
+
+
+
+bool MessageDispatcher::dispatchMessage(int receiver, message msg,
+					double delay)
+{
+  return post(receiver, msg, (delay > 0.0) ? RateGroup::now() + delay : 0.0);
+}
+
+
+
+bool MessageDispatcher::dispatchMessage(int receiver, int sender,
+					int messageID, double delay)
+{
+  return dispatchMessage(receiver, message(messageID, sender), delay);
+}
+
+
+
+bool MessageDispatcher::dispatchMessageAt(int receiver, message msg,
+					  double time)
+{
+  return post(receiver, msg, time);
+}
+
+
+
+int MessageDispatcher::broadcastMessage(int group, message msg, double delay)
+{
+  double       time    = (delay > 0.0) ? RateGroup::now() + delay : 0.0;
+  int          highest = highestId.load(memory_order_acquire);
+  unsigned int bit;
+  int          sent    = 0;
+
+  if ((group < 0) || (group >= MESSAGE_GROUPS))
+    {
+      return 0;
+    }
+
+  bit = 1u << group;
+
+  for (int id = 0; id <= highest; id++)
+    {
+      if ((groups[id].load(memory_order_relaxed) & bit) &&
+	  post(id, msg, time))
+	{
+	  sent++;
+	}
+    }
+
+  return sent;
+}
+
+
+
+
+/******************************************
+ Private Functions
+*******************************************/
+
+
+
+bool MessageDispatcher::post(int receiver, const message &msg, double time)
+{
+  BaseEntity  *entity;
+  messageNode *node;
+
+  if ((receiver < 0) || (receiver >= MESSAGE_MAX_ENTITIES))
+    {
+      return false;
+    }
+
+  entity = entities[receiver].load(memory_order_acquire);
+  if (entity == NULL)
+    {
+      return false;
+    }
+
+  node = new messageNode;
+  node->later            = NULL;
+  node->msg              = msg;
+  node->msg.receiver     = receiver;
+  node->msg.dispatchTime = time;
+
+  entity->getInbox().post(node);
+
+  return true;
+}
@@ -1,14 +1,248 @@
 #ifndef MESSAGING_H
 #define MESSAGING_H
 
+// Messages among the entities, so they hear
+// about things when they happen instead of
+// polling for them every tick.
+//
+// Each entity (baseEntity.h) has an inbox any
+// thread can post to without taking a lock,
+// and only the entity itself takes messages
+// out of, when it calls deliverMessages()
+// from its update. The MessageDispatcher
+// finds the inbox for an entity id, or for
+// every entity in a group.
+//
+// A message can wait before it's delivered,
+// for a delay or until a time (seconds, on
+// the CLOCK_MONOTONIC clock of
+// RateGroup::now()). Those sit in the inbox's
+// timer wheel once the entity has seen them,
+// one slot per MESSAGE_WHEEL_RESOLUTION
+// seconds, so checking for the ones that are
+// due costs the slots gone by, not the
+// number waiting.
+
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+
+
+// Room for a payload, whatever fits
+// and can be copied with memcpy
+#define MESSAGE_PAYLOAD_SIZE 48
+
+// Ids are handed out in order from 0
+// (baseEntity.c++), up to this many
+#ifndef MESSAGE_MAX_ENTITIES
+#define MESSAGE_MAX_ENTITIES 4096
+#endif
+
+// Groups are bits, 0..31
+#define MESSAGE_GROUPS 32
+
+// For messages that don't come from
+// an entity (sensor threads, timers)
+#define MESSAGE_NO_SENDER -1
+
+// Timer wheel, 10 ms slots, about five
+// seconds around. Longer delays go round
+// more than once.
+#define MESSAGE_WHEEL_SLOTS      512
+#define MESSAGE_WHEEL_RESOLUTION 0.01
+
+
+
+class BaseEntity;
+
+
+
+
+// Something unique for each type of
+// payload, to check it comes out as
+// the type it went in as
+template <class payloadType>
+inline const void *payloadTag()
+{
+  static const char tag = 0;
+  return &tag;
+}
+
+
+
+
 // A simple message structure
 // to aid in communications among
 // various entities.
 struct message
 {
-  int messageID;
+  int    messageID;
+  int    sender;
+  int    receiver;
+
+  // When it's to be delivered,
+  // 0 for straight away
+  double dispatchTime;
+
+  message()
+    {
+      messageID    = 0;
+      sender       = MESSAGE_NO_SENDER;
+      receiver     = MESSAGE_NO_SENDER;
+      dispatchTime = 0.0;
+      payloadType  = NULL;
+    }
+
+  message(int newMessageID, int newSender)
+    {
+      messageID    = newMessageID;
+      sender       = newSender;
+      receiver     = MESSAGE_NO_SENDER;
+      dispatchTime = 0.0;
+      payloadType  = NULL;
+    }
+
+
+  template <class dataType>
+  void setPayload(const dataType &data)
+    {
+      static_assert(std::is_trivially_copyable<dataType>::value,
+		    "message payloads are copied with memcpy");
+      static_assert(sizeof(dataType) <= MESSAGE_PAYLOAD_SIZE,
+		    "message payload bigger than MESSAGE_PAYLOAD_SIZE");
+
+      memcpy(payload, &data, sizeof(dataType));
+      payloadType = payloadTag<dataType>();
+    }
+
+  // False if there's no payload, or
+  // it isn't a dataType
+  template <class dataType>
+  bool getPayload(dataType &data) const
+    {
+      if (payloadType != payloadTag<dataType>())
+	{
+	  return false;
+	}
+
+      memcpy(&data, payload, sizeof(dataType));
+      return true;
+    }
+
+  bool hasPayload() const
+    {
+      return payloadType != NULL;
+    }
+
+
+ private:
+  const void *payloadType;
+  alignas(8) unsigned char payload[MESSAGE_PAYLOAD_SIZE];
+};
+
+
+
+
+// How a message travels, in the inbox's
+// queue and then maybe its timer wheel
+struct messageNode
+{
+  std::atomic<messageNode*> next;
+  messageNode              *later;
+  message                   msg;
+};
+
+
+
+
+// Many posting, one delivering. The queue
+// is an intrusive linked list the posters
+// swap themselves onto the head of, the
+// owner takes from the tail.
+class MessageInbox
+{
+ public:
+  MessageInbox();
+  ~MessageInbox();
+
+  // Any thread, takes the node over
+  void post(messageNode *node);
+
+  // The owner only. Hands everything due by
+  // now to entity->handleMessage(), and
+  // returns how many. Messages posted while
+  // it's at it wait for the next call.
+  int  deliver(double now, BaseEntity *entity);
+
+  // Messages in the timer wheel
+  int  getWaiting() const;
+
+
+ private:
+  alignas(64) std::atomic<messageNode*> head;
+  alignas(64) messageNode *tail;
+  messageNode              stub;
+
+  messageNode *wheel[MESSAGE_WHEEL_SLOTS];
+  long long    wheelTick;
+  bool         wheelStarted;
+  int          waiting;
+
+  messageNode *pop();
+  void         schedule(messageNode *node);
+  int          deliverSlot(int slot, double now, BaseEntity *entity);
+
+  MessageInbox(const MessageInbox&);
+  MessageInbox& operator=(const MessageInbox&);
+};
+
+
+
+
+// Finds the entities by id. Entities add
+// and remove themselves, see baseEntity.c++.
+// Sending is safe from any thread; removing
+// an entity while messages are still being
+// sent to it isn't.
+class MessageDispatcher
+{
+ public:
+  static MessageDispatcher* Instance();
+
+  void registerEntity(BaseEntity *entity);
+  void removeEntity(BaseEntity *entity);
 
+  // Group membership, by entity id
+  void joinGroup(int id, int group);
+  void leaveGroup(int id, int group);
+  bool inGroup(int id, int group) const;
+
+  // To msg.receiver, after delay seconds.
+  // False if there's no such entity.
+  bool dispatchMessage(int receiver, message msg, double delay = 0.0);
+  bool dispatchMessage(int receiver, int sender, int messageID,
+		       double delay = 0.0);
+
+  // To msg.receiver, at time
+  bool dispatchMessageAt(int receiver, message msg, double time);
+
+  // To everyone in the group, after delay
+  // seconds. Returns how many got it.
+  int  broadcastMessage(int group, message msg, double delay = 0.0);
+
+
+ private:
+  MessageDispatcher();
+
+  std::atomic<BaseEntity*>  entities[MESSAGE_MAX_ENTITIES];
+  std::atomic<unsigned int> groups[MESSAGE_MAX_ENTITIES];
+  std::atomic<int>          highestId;
+
+  bool post(int receiver, const message &msg, double time);
 };
 
 
+
 #endif
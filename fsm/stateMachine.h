@@ -140,6 +140,26 @@ class StateMachine
     }
 
 
+
+
+  // Offer a message to the current state,
+  // and if it doesn't use it, the global
+  // state. Returns TRUE if one of them did.
+  bool handleMessage(const message &msg) const
+    {
+      if (currentState && currentState->onMessage(agent, msg))
+	{
+	  return TRUE;
+	}
+
+      if (globalState && globalState->onMessage(agent, msg))
+	{
+	  return TRUE;
+	}
+
+      return FALSE;
+    }
+
   
  private:
   // This is the "owner" of the statemachine
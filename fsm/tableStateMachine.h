@@ -0,0 +1,454 @@
+#ifndef TABLESTATEMACHINE_H
+#define TABLESTATEMACHINE_H
+
+// Table driven, event driven alternative to
+// the StateMachine in stateMachine.h. Instead
+// of burying the switching logic in the states
+// themselves, every transition is a row in a
+// constexpr table:
+//
+//   { fromState, event, toState, guard }
+//
+// States may have a parent state, so a row on
+// a parent applies to all of its children
+// unless a child has its own row for the same
+// event. The table is checked and flattened into
+// a [state][event] index at compile time, so
+// dispatching an event is one array load plus
+// the guards on that (state, event) pair.
+//
+// Nothing switches state unless an event is
+// raised. raiseEvent() only queues the event,
+// the queue is drained (run to completion) at
+// the end of update(), or by processEvents().
+//
+// The machine definition is a struct that looks
+// like this:
+//
+//   struct myDef
+//   {
+//     typedef MyEntity entityType;
+//     enum { numStates = ..., numEvents = ... };
+//     static constexpr int  parent[numStates]     = {...};
+//     static constexpr bool remembered[numStates] = {...};
+//     static constexpr int  historyDefault        = ...;
+//     static constexpr transitionRow<MyEntity> rows[] = {...};
+//   };
+//
+// and the machine itself is inherited by a class
+// (CRTP) that supplies the state actions:
+//
+//   void enterState(int state);
+//   void executeState(int state);
+//   void exitState(int state);
+//
+// which are normally just a switch on the state.
+//
+// remembered says whether leaving a state makes
+// it the HISTORY_STATE target (startup states
+// shouldn't be), and historyDefault is where a
+// HISTORY_STATE transition goes when there's
+// nothing to go back to.
+
+
+#include <array>
+#include <cstddef>
+#include <iostream>
+
+
+
+// Special values for a row's toState
+#define HISTORY_STATE      -1  // go back to the previous leaf state
+#define INTERNAL_TRANSITION -2  // consume the event, no state change
+
+// Parent of a top level state
+#define NO_PARENT_STATE    -1
+
+// Index value for "no row for this state/event"
+#define NO_TRANSITION      -1
+
+// Most events that can be waiting to be processed
+#define MAX_QUEUED_EVENTS  16
+
+
+
+// A single transition. The guard is optional,
+// NULL means always take it. Rows for the same
+// (from, event) pair must be adjacent, and are
+// tried in order, first passing guard wins.
+template <class entityType>
+struct transitionRow
+{
+  int  from;
+  int  event;
+  int  to;
+  bool (*guard)(const entityType*);
+};
+
+
+
+
+
+// Compile time helpers, used by the
+// static_asserts in TableStateMachine
+namespace tableFsm
+{
+  template <class def>
+  constexpr std::size_t numRows()
+  {
+    return sizeof(def::rows) / sizeof(def::rows[0]);
+  }
+
+
+  // True if some other state names this
+  // state as its parent
+  template <class def>
+  constexpr bool isComposite(int state)
+  {
+    for (int i = 0; i < def::numStates; i++)
+      {
+	if (def::parent[i] == state)
+	  {
+	    return true;
+	  }
+      }
+    return false;
+  }
+
+
+  // Parent chains must end at NO_PARENT_STATE
+  // within numStates hops, or there's a cycle
+  template <class def>
+  constexpr bool parentsValid()
+  {
+    for (int i = 0; i < def::numStates; i++)
+      {
+	int hops  = 0;
+	int state = def::parent[i];
+
+	while (state != NO_PARENT_STATE)
+	  {
+	    if ((state < 0) || (state >= def::numStates) ||
+		(++hops > def::numStates))
+	      {
+		return false;
+	      }
+	    state = def::parent[state];
+	  }
+      }
+
+    return ((def::historyDefault >= 0) &&
+	    (def::historyDefault < def::numStates) &&
+	    !isComposite<def>(def::historyDefault));
+  }
+
+
+  // Every row must use valid ids, and only
+  // leaf states (or the pseudo states) can
+  // be transitioned to
+  template <class def>
+  constexpr bool rowsValid()
+  {
+    for (std::size_t r = 0; r < numRows<def>(); r++)
+      {
+	const int from  = def::rows[r].from;
+	const int event = def::rows[r].event;
+	const int to    = def::rows[r].to;
+
+	if ((from  < 0) || (from  >= def::numStates) ||
+	    (event < 0) || (event >= def::numEvents))
+	  {
+	    return false;
+	  }
+
+	if ((to != HISTORY_STATE) && (to != INTERNAL_TRANSITION))
+	  {
+	    if ((to < 0) || (to >= def::numStates) ||
+		isComposite<def>(to))
+	      {
+		return false;
+	      }
+	  }
+      }
+    return true;
+  }
+
+
+  // Rows sharing a (from, event) pair have to be
+  // adjacent, and only the last one may be
+  // unguarded, otherwise the rows after it
+  // can never be taken
+  template <class def>
+  constexpr bool rowsReachable()
+  {
+    for (std::size_t r = 0; r < numRows<def>(); r++)
+      {
+	for (std::size_t s = r + 1; s < numRows<def>(); s++)
+	  {
+	    if ((def::rows[s].from  == def::rows[r].from) &&
+		(def::rows[s].event == def::rows[r].event))
+	      {
+		if ((def::rows[r].guard == nullptr) ||
+		    (def::rows[s - 1].from  != def::rows[r].from) ||
+		    (def::rows[s - 1].event != def::rows[r].event))
+		  {
+		    return false;
+		  }
+	      }
+	  }
+      }
+    return true;
+  }
+
+
+  // Flatten the table and the state hierarchy
+  // into [state][event] -> first row index
+  template <class def>
+  constexpr std::array<std::array<short, def::numEvents>, def::numStates>
+  buildIndex()
+  {
+    std::array<std::array<short, def::numEvents>, def::numStates> index{};
+
+    for (int state = 0; state < def::numStates; state++)
+      {
+	for (int event = 0; event < def::numEvents; event++)
+	  {
+	    short found = NO_TRANSITION;
+	    int   level = state;
+
+	    // Walk up the hierarchy until someone
+	    // handles this event
+	    while ((found == NO_TRANSITION) && (level != NO_PARENT_STATE))
+	      {
+		for (std::size_t r = 0; r < numRows<def>(); r++)
+		  {
+		    if ((def::rows[r].from == level) &&
+			(def::rows[r].event == event))
+		      {
+			found = (short)r;
+			break;
+		      }
+		  }
+		level = def::parent[level];
+	      }
+	    index[state][event] = found;
+	  }
+      }
+    return index;
+  }
+}
+
+
+
+
+
+
+template <class derivedType, class def>
+class TableStateMachine
+{
+ public:
+  typedef typename def::entityType entityType;
+
+  static_assert(tableFsm::parentsValid<def>(),
+		"TableStateMachine: state hierarchy has a cycle, "
+		"a bad parent id, or a bad historyDefault");
+  static_assert(tableFsm::rowsValid<def>(),
+		"TableStateMachine: transition row with a bad id, "
+		"or a transition into a composite state");
+  static_assert(tableFsm::rowsReachable<def>(),
+		"TableStateMachine: unreachable transition row, rows "
+		"for one state/event must be adjacent with only the "
+		"last one unguarded");
+
+
+  TableStateMachine(entityType* newAgent):
+    agent(newAgent),
+    currentState(NO_PARENT_STATE),
+    previousState(NO_PARENT_STATE),
+    queueHead(0),
+    queueCount(0),
+    droppedEvents(0)
+    {}
+
+
+  // Set the initial state, and run its
+  // entry action. Call once at startup.
+  // Resuming after a restart can say what
+  // the state before it was too.
+  void start(int initialState, int previous = NO_PARENT_STATE)
+    {
+      currentState  = initialState;
+      previousState = previous;
+      derived()->enterState(currentState);
+    }
+
+
+  int getCurrentState()  const { return currentState;  }
+  int getPreviousState() const { return previousState; }
+
+
+  // Is the machine in this state, or in
+  // a child of it if it's a composite state
+  bool isInState(int state) const
+    {
+      int level = currentState;
+
+      while (level != NO_PARENT_STATE)
+	{
+	  if (level == state)
+	    {
+	      return true;
+	    }
+	  level = def::parent[level];
+	}
+      return false;
+    }
+
+
+  // Queue an event. Safe to call from inside
+  // state actions, it will be handled once the
+  // current action returns. If the queue is
+  // full the event is dropped and counted.
+  void raiseEvent(int event)
+    {
+      if (queueCount == MAX_QUEUED_EVENTS)
+	{
+	  droppedEvents++;
+	  return;
+	}
+
+      eventQueue[(queueHead + queueCount) % MAX_QUEUED_EVENTS] = event;
+      queueCount++;
+    }
+
+
+  unsigned long getDroppedEvents() const
+    {
+      return droppedEvents;
+    }
+
+
+  // Run the current state's action, then
+  // handle whatever events got raised
+  void update()
+    {
+      if (currentState != NO_PARENT_STATE)
+	{
+	  derived()->executeState(currentState);
+	}
+      processEvents();
+    }
+
+
+  // Drain the event queue, taking at most
+  // one transition per event
+  void processEvents()
+    {
+      while (queueCount > 0)
+	{
+	  int event = eventQueue[queueHead];
+	  queueHead = (queueHead + 1) % MAX_QUEUED_EVENTS;
+	  queueCount--;
+
+	  dispatch(event);
+	}
+    }
+
+
+
+ private:
+  static constexpr std::array<std::array<short, def::numEvents>,
+			      def::numStates> index =
+    tableFsm::buildIndex<def>();
+
+
+  // This is the "owner" of the statemachine,
+  // handed to the guards
+  entityType* agent;
+
+  int currentState;
+  int previousState;
+
+  int           eventQueue[MAX_QUEUED_EVENTS];
+  int           queueHead;
+  int           queueCount;
+  unsigned long droppedEvents;
+
+
+  derivedType* derived()
+    {
+      return static_cast<derivedType*>(this);
+    }
+
+
+  void dispatch(int event)
+    {
+      if ((currentState == NO_PARENT_STATE) ||
+	  (event < 0) || (event >= def::numEvents))
+	{
+	  return;
+	}
+
+      int row = index[currentState][event];
+
+      if (row == NO_TRANSITION)
+	{
+	  // Nobody cares about this event here
+	  return;
+	}
+
+      const int from = def::rows[row].from;
+
+      for (; ((std::size_t)row < tableFsm::numRows<def>()) &&
+	     (def::rows[row].from  == from) &&
+	     (def::rows[row].event == event); row++)
+	{
+	  if ((def::rows[row].guard == nullptr) ||
+	      def::rows[row].guard(agent))
+	    {
+	      changeState(def::rows[row].to);
+	      return;
+	    }
+	}
+    }
+
+
+  // Exit the old state, enter the new one
+  void changeState(int newState)
+    {
+      if (newState == INTERNAL_TRANSITION)
+	{
+	  return;
+	}
+
+      if (newState == HISTORY_STATE)
+	{
+	  newState = previousState;
+
+	  if (newState == NO_PARENT_STATE)
+	    {
+	      // Nothing to go back to
+	      newState = def::historyDefault;
+	    }
+	}
+
+      derived()->exitState(currentState);
+
+      if (def::remembered[currentState])
+	{
+	  previousState = currentState;
+	}
+
+      currentState  = newState;
+      derived()->enterState(currentState);
+    }
+};
+
+
+
+template <class derivedType, class def>
+constexpr std::array<std::array<short, def::numEvents>, def::numStates>
+TableStateMachine<derivedType, def>::index;
+
+
+#endif
@@ -1,6 +1,9 @@
 #include <iostream>
 using namespace std;
-#include <fstream>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <unistd.h>
 
 
 
@@ -15,16 +18,127 @@ using namespace std;
 
 
 
+
+// The HotReloader calls these on its own
+// thread, the loading and checking happens
+// there, not in the control loop
+static void reloadBrain(const string &path, void *ucav)
+{
+  seekerBrain *newBrain = TargetSeeker::loadBrain(path);
+
+  if (newBrain == NULL)
+    {
+      cout<<"Keeping the brain we're flying with"<<endl;
+      return;
+    }
+
+  ((Ucav*)ucav)->offerTargetSeekerBrain(newBrain);
+}
+
+
+
+static void reloadRoute(const string &path, void *ucav)
+{
+  Route *newRoute = new Route;
+
+  if (!newRoute->load(path))
+    {
+      cout<<"Keeping the course we're flying"<<endl;
+      delete newRoute;
+      return;
+    }
+
+  ((Ucav*)ucav)->offerRoute(newRoute);
+}
+
+
+
+// The legacy states by the table state
+// machine's numbers, which checkpoints
+// save them as
+static int fsmStateOf(BaseState<Ucav>* state)
+{
+  if (state == NULL)
+    return FsmStartup;
+  if (state == TakeOffState::Instance())
+    return FsmTakeOff;
+  if (state == CruiseRouteState::Instance())
+    return FsmCruiseRoute;
+  if (state == LandState::Instance())
+    return FsmLand;
+  if (state == EvadeState::Instance())
+    return FsmEvade;
+  if (state == AttackState::Instance())
+    return FsmAttack;
+  if (state == RecoveryState::Instance())
+    return FsmRecovery;
+
+  return NO_PARENT_STATE;
+}
+
+
+
+static BaseState<Ucav>* legacyStateFor(int state)
+{
+  switch (state)
+    {
+    case FsmTakeOff:     return TakeOffState::Instance();
+    case FsmCruiseRoute: return CruiseRouteState::Instance();
+    case FsmLand:        return LandState::Instance();
+    case FsmEvade:       return EvadeState::Instance();
+    case FsmAttack:      return AttackState::Instance();
+    case FsmRecovery:    return RecoveryState::Instance();
+    default:             return NULL;
+    }
+}
+
+
+
 // Ucav constructor, initializes 
 // variables, and also checks to 
 // see if it's supposed to do 
 // an emergency start. 
-Ucav::Ucav(int newId):BaseEntity(newId)
+Ucav::Ucav(int newId):BaseEntity(newId),
+		      navigationRate("Navigation", UCAV_NAVIGATION_RATE),
+		      guidanceRate("Guidance", UCAV_GUIDANCE_RATE),
+		      controlRate("Control", UCAV_CONTROL_RATE),
+		      tickBudget("Tick", UCAV_TICK_DEADLINE)
 {
   stateMachine = new StateMachine<Ucav>(this);
   stateMachine->setGlobalState(GlobalState::Instance());
   pilot = new Pilot;
 
+  // In ucavTickStage order
+  tickBudget.addStage("Fsm",      UCAV_FSM_BUDGET);
+  tickBudget.addStage("Guidance", UCAV_GUIDANCE_BUDGET);
+  tickBudget.addStage("Control",  UCAV_CONTROL_BUDGET);
+  tickBudget.addStage("Transmit", UCAV_TRANSMIT_BUDGET);
+
+  wantedPilotMode = SitStillMode;
+  holdingForTime  = FALSE;
+
+  joinGroup(UCAV_MESSAGE_GROUP);
+
+  airspace = NULL;
+
+  terrain          = NULL;
+  terrainFloor     = 0.0;
+  haveTerrainFloor = FALSE;
+
+  tableFsm            = NULL;
+  shadowMismatchTicks = 0;
+  shadowMismatches    = 0;
+
+#if defined(UCAV_TABLE_FSM) || defined(UCAV_FSM_SHADOW)
+  tableFsm = new UcavTableFsm(this);
+#endif
+
+#ifdef UCAV_FSM_SHADOW
+  // The original StateMachine flies,
+  // this one just follows along
+  tableFsm->setDrivesUcav(false);
+#endif
+
   position.lat            = 0.0;       
   position.lon            = 0.0;       
   position.alt            = 0.0;
@@ -48,9 +162,26 @@ Ucav::Ucav(int newId):BaseEntity(newId)
   flightControls.rudder   = 0.0;
   flightControls.throttle = 0.0;
 
+  routeVersion = 0;
   readInWaypoints();
+  updatePositionEcef();
+  rejoinRoute = FALSE;
+
+  char checkpointFile[64];
+  snprintf(checkpointFile, sizeof(checkpointFile), "%s%d",
+	   UCAV_CHECKPOINT_FILE, getId());
+
+  checkpointTicks = 0;
+  if (!checkpoint.open(checkpointFile, UCAV_CHECKPOINT_VERSION,
+		       sizeof(ucavCheckpoint)))
+    {
+      cout<<"Flying without checkpoints, a crash will "
+	  <<"start over"<<endl;
+    }
+
+  ucavCheckpoint saved;
 
-  if(!emergencyStart())
+  if(!emergencyStart(saved))
     {
       stateMachine->setCurrentState(TakeOffState::Instance());
 
@@ -58,6 +189,16 @@ Ucav::Ucav(int newId):BaseEntity(newId)
       stateMachine->changeState(TakeOffState::Instance());
 
       data.recoveryBoot = FALSE;
+
+      if (tableFsm)
+	{
+	  tableFsm->start(FsmTakeOff);
+	}
+    }
+  else if (resumeFlight(saved))
+    {
+      // Carrying on as if nothing happened
+      data.recoveryBoot = FALSE;
     }
   else
     {
@@ -65,6 +206,25 @@ Ucav::Ucav(int newId):BaseEntity(newId)
       // global state will handle
       // it from here...
       data.recoveryBoot = TRUE;
+      rejoinRoute       = data.haveNavCourse;
+
+      tellStateMachine(RecoveryBootMsg);
+
+      if (tableFsm)
+	{
+	  tableFsm->start(FsmStartup);
+	  raiseFsmEvent(RecoveryBootEvent);
+	}
+    }
+
+  // New brains and courses can be dropped
+  // in while flying
+  reloader.watch(pilot->getTargetSeekerBrainFile(), reloadBrain, this);
+  reloader.watch("./waypointsFile", reloadRoute, this);
+
+  if (!reloader.start())
+    {
+      cout<<"Brains and courses won't be reloaded while flying"<<endl;
     }
 }
 
@@ -84,29 +244,68 @@ Ucav::~Ucav()
 {
   cout<<"In Ucav destructor..."<<endl;
 
+  // Nothing new can turn up
+  // while we take things apart
+  reloader.stop();
+
+  if (airspace)
+    {
+      airspace->remove(getId());
+    }
+
+  reportUpdateRates();
+
+#ifdef UCAV_TABLE_FSM
+  if (data.errorState || 
+      tableFsm->isInState(FsmRecovery))
+#else
   if (data.errorState || 
       stateMachine->isInState(RecoveryState::Instance()))
+#endif
     {
       cout<<"Ucav software exiting in an bad state, "
 	  <<"save information to memory for use "
 	  <<"in next boot"<<endl;
       emergencyDataDump();
     }
+  else
+    {
+      // A normal shutdown, start
+      // afresh next time
+      checkpoint.markClosed();
+    }
 
   if (stateMachine)
     {
       delete stateMachine;
     }
 
-  if ((data.haveNavCourse) && (waypoints != NULL))
+  // The frame lives in behaviorPool,
+  // let it go while that's still here
+  behavior.stop();
+
+  if (behaviorPool.getOverflows() > 0)
     {
-      delete waypoints;
+      cout<<behaviorPool.getOverflows()<<" behavior frames didn't fit in "
+	  <<"the pool, the largest was "<<behaviorPool.getLargestFrame()
+	  <<" bytes"<<endl;
     }
-  
+
   if (pilot)
     {
       delete pilot;
     }
+
+  delete route;
+
+  if (tableFsm)
+    {
+#ifdef UCAV_FSM_SHADOW
+      cout<<"Shadow state machine disagreed on "
+	  <<shadowMismatches<<" ticks"<<endl;
+#endif
+      delete tableFsm;
+    }
 }
 
 
@@ -116,42 +315,173 @@ Ucav::~Ucav()
 // This is the primary execution function, 
 // must be called repeatedly for the 
 // entity and Finite State Machine to
-// function. 
+// function. Call it as often as you like,
+// each part only runs when it's due.
+//
+// Each call is a tick with a deadline to
+// have the controls out by. The net's left
+// out when it won't fit in what's left,
+// the controls never are.
 void Ucav::update()
 {
-  // To make it easier to track each tick:
-  cout<<endl<<"*************************************************"
-      <<endl<<endl;
- 
-  pollSensors();
+  double now = RateGroup::now();
+  double started;
+
+  tickBudget.startTick(now);
+  checkTickBudget();
+
+  // The decisions, which state we're in
+  // and where we're going, change slowly
+  if (navigationRate.due(now))
+    {
+      started = now;
+
+      swapInNewRoute();
+      updateTerrainFloor();
+
+      // Threats are only decided on here,
+      // so they're only looked for here
+      pollSensors();
+
+      if(data.autoMode)
+	{
+	  // What's happened since the last
+	  // tick, before deciding anything
+	  deliverMessages(now);
+
+#ifdef UCAV_TABLE_FSM
+	  tableFsm->update();
+#else
+	  stateMachine->update();
+#ifdef UCAV_FSM_SHADOW
+	  tableFsm->update();
+	  checkShadowFsm();
+#endif
+#endif
+	}
+
+      // For now, systemTime is just
+      // number of "ticks" of the state
+      // machine. Handy for demonstrating
+      // state switching by using systemTime
+      // to drive the pollSensors() function
+      data.systemTime++;
+
+      if (++checkpointTicks >= UCAV_CHECKPOINT_TICKS)
+	{
+	  checkpointTicks = 0;
+	  saveCheckpoint();
+	}
+
+      now = RateGroup::now();
+      navigationRate.finished(now);
+      tickBudget.ran(FsmStage, started, now);
+    }
 
-  if(data.autoMode)
+  if (!data.autoMode)
     {
-      stateMachine->update();
-      pilot->setPositionGeo(position.lat, position.lon,
-			    position.alt, position.radAlt, 
-			    position.heading, position.pitch, 
-			    position.roll);
+      return;
+    }
+
+  pilot->setPositionGeo(position.lat, position.lon,
+			position.alt, position.radAlt, 
+			position.heading, position.pitch, 
+			position.roll);
 
-      pilot->update();
+  // The net picks where to steer, unless
+  // there's no time for it. Then the last
+  // command it picked is steered to again,
+  // and it waits for its next period.
+  if (guidanceRate.due(now))
+    {
+      if (holdingForTime || !tickBudget.fits(GuidanceStage, now))
+	{
+	  tickBudget.leftOut(GuidanceStage);
+	}
+      else
+	{
+	  started = now;
+	  pilot->updateGuidance();
+
+	  now = RateGroup::now();
+	  guidanceRate.finished(now);
+	  tickBudget.ran(GuidanceStage, started, now);
+	}
+    }
+
+  // and the inner loops steer there,
+  // as often as FlightGear can use it
+  if (controlRate.due(now))
+    {
+      started = now;
+      pilot->update(now);
 
       pilot->getControlPositions(flightControls.elevator, 
 				 flightControls.aileron,
 				 flightControls.rudder,
 				 flightControls.throttle);
+
+      now = RateGroup::now();
+      controlRate.finished(now);
+      tickBudget.ran(ControlStage, started, now);
     }
-  else
+}
+
+
+
+void Ucav::setUpdateRates(double navigation, double guidance, 
+			  double control)
+{
+  navigationRate.setRate(navigation);
+  guidanceRate.setRate(guidance);
+  controlRate.setRate(control);
+}
+
+
+
+double Ucav::getNextUpdateTime() const
+{
+  double next = navigationRate.nextRelease();
+
+  if (data.autoMode)
     {
-      cout<<"Manual mode, need a human pilot!"<<endl;
+      if (guidanceRate.nextRelease() < next)
+	{
+	  next = guidanceRate.nextRelease();
+	}
+      if (controlRate.nextRelease() < next)
+	{
+	  next = controlRate.nextRelease();
+	}
     }
 
+  return next;
+}
+
+
+
+void Ucav::reportUpdateRates() const
+{
+  navigationRate.report();
+  guidanceRate.report();
+  controlRate.report();
+  tickBudget.report();
+}
+
+
+
+TickBudget& Ucav::getTickBudget()
+{
+  return tickBudget;
+}
+
+
 
-  // For now, systemTime is just
-  // number of "ticks". Handy for
-  // demonstrating state switching
-  // by using systemTime to drive the
-  // pollSensors() function
-  data.systemTime++;
+
+
+BehaviorPool& Ucav::getBehaviorPool()
+{
+  return behaviorPool;
 }
 
 
@@ -159,8 +489,15 @@ void Ucav::update()
 
 
 
+// Says so once, on the way into manual,
+// not on every tick it stays there
 void Ucav::setAutoMode(bool newMode)
 {
+  if (data.autoMode && !newMode)
+    {
+      cout<<"Manual mode, need a human pilot!"<<endl;
+    }
+
   data.autoMode = newMode;
 }
 
@@ -184,6 +521,7 @@ double Ucav::getBaroAltitude() const
 void Ucav::setBaroAltitude(double newAltitude)
 {
   position.alt = newAltitude;
+  updatePositionEcef();
 }
 
 
@@ -215,6 +553,7 @@ void Ucav::setPositionGeo(double lat, double lon,
   position.pitch   = pitch;
   position.roll    = roll;
   position.heading = heading;
+  updatePositionEcef();
 }
 
 
@@ -254,6 +593,7 @@ void Ucav::setLatLon(double newLat, double newLon)
 {
   position.lat = newLat;
   position.lon = newLon;
+  updatePositionEcef();
 }
 
 
@@ -305,10 +645,26 @@ void Ucav::getPositionOfNextWaypoint(double &lat, double &lon,
 {
   if (data.haveNavCourse)
     {
-      waypointData wyptData = waypoints->at(data.currentWaypoint-1); 
-      lat = wyptData.lat;
-      lon = wyptData.lon;
-      alt = wyptData.alt;
+      if (rejoinRoute)
+	{
+	  // Only asked for once we're flying
+	  // the course again, so the position
+	  // is a real one by now
+	  int leg = getNearestRouteLeg();
+
+	  if (leg >= 0)
+	    {
+	      cout<<"Rejoining the course on leg "<<leg + 1
+		  <<", next waypoint is "<<leg + 2<<endl;
+	      data.currentWaypoint = leg + 2;
+	    }
+	  rejoinRoute = FALSE;
+	}
+
+      const routeWaypoint &wypt = route->getWaypoint(data.currentWaypoint-1);
+      lat = wypt.lat;
+      lon = wypt.lon;
+      alt = wypt.alt;
     }
   else
     {
@@ -324,11 +680,75 @@ void Ucav::getPositionOfNextWaypoint(double &lat, double &lon,
 
 
 
+float Ucav::getDistanceToNextWaypoint() const
+{
+  if (!data.haveNavCourse)
+    {
+      return 0.0;
+    }
+
+  return route->distanceToWaypoint(positionEcef, data.currentWaypoint-1);
+}
+
+
+
+bool Ucav::getRouteTrackError(double &crossTrack, double &alongTrack) const
+{
+  // Leg n ends at waypoint n+1, counting
+  // waypoints from 1 like the rest of Ucav
+  int leg = data.currentWaypoint - 2;
+
+  if (!data.haveNavCourse || (leg < 0))
+    {
+      crossTrack = 0.0;
+      alongTrack = 0.0;
+      return false;
+    }
+
+  route->trackError(positionEcef, leg, crossTrack, alongTrack);
+  return true;
+}
+
+
+
+int Ucav::getNearestRouteLeg() const
+{
+  return route->nearestLeg(positionEcef);
+}
+
+
+
+int Ucav::getRouteVersion() const
+{
+  return routeVersion;
+}
+
+
+
+void Ucav::offerTargetSeekerBrain(seekerBrain *newBrain)
+{
+  pilot->offerTargetSeekerBrain(newBrain);
+}
+
+
+void Ucav::offerRoute(Route *newRoute)
+{
+  routeUpdates.publish(newRoute);
+}
+
+
+
+
 void Ucav::setNextWaypoint(int newNextWypt)
 {
   if (newNextWypt <= data.numberOfWaypoints)
     {
-      data.currentWaypoint = newNextWypt;
+      if (newNextWypt != data.currentWaypoint)
+	{
+	  data.currentWaypoint = newNextWypt;
+	  raiseFsmEvent(WaypointReachedEvent);
+	  tellWaypointChanged();
+	}
     }
   else
     {
@@ -368,7 +788,7 @@ float Ucav::getTargetSeekerVertBoundary() const
 void Ucav::setTargetSeekerTargetPos(double lat, double lon, double alt)
 {
   pilot->setTargetSeekerTargetPos(lat, lon, alt);
-  pilot->setPilotMode(TargetSeekMode);
+  setPilotMode(TargetSeekMode);
 }
 
 
@@ -387,9 +807,29 @@ bool Ucav::getStallState() const
 }
 
 
+// Sensors (or whoever) report a stall. The 
+// table driven machine only hears about the
+// change, not the level.
+void Ucav::setStallState(bool newStalled)
+{
+  if (newStalled && !data.stalled)
+    {
+      data.stalled = TRUE;
+      raiseFsmEvent(StallEvent);
+      tellStateMachine(StalledMsg);
+    }
+  else if (!newStalled)
+    {
+      notStalledAnymore();
+    }
+}
+
+
 void Ucav::notStalledAnymore()
 {
   data.stalled = FALSE;
+  raiseFsmEvent(RecoveredEvent);
+  tellStateMachine(RecoveredMsg);
 }
 
 
@@ -404,9 +844,26 @@ bool Ucav::getThreatDetection() const
 }
 
 
+void Ucav::setThreatDetection(bool newThreat)
+{
+  if (newThreat && !data.detectThreat)
+    {
+      data.detectThreat = TRUE;
+      raiseFsmEvent(ThreatDetectedEvent);
+      tellStateMachine(ThreatDetectedMsg);
+    }
+  else if (!newThreat)
+    {
+      threatKilled();
+    }
+}
+
+
 void Ucav::threatKilled()
 {
   data.detectThreat = FALSE;
+  raiseFsmEvent(ThreatKilledEvent);
+  tellStateMachine(ThreatKilledMsg);
 }
 
 
@@ -422,161 +879,502 @@ void Ucav::recoveryBootFinished()
 }
 
 
+// While the attitude's held for want of
+// time, the net only takes over again once
+// the ticks are back on time. Anything
+// else ends the hold now.
 void Ucav::setPilotMode(FlyingMode newMode)
 {
+  wantedPilotMode = newMode;
+
+  if (holdingForTime)
+    {
+      if (newMode == TargetSeekMode)
+	{
+	  return;
+	}
+
+      stopHoldingForTime();
+    }
+
   pilot->setPilotMode(newMode);
 }
 
 
 
+void Ucav::setAirspace(Airspace *newAirspace)
+{
+  if (airspace)
+    {
+      airspace->remove(getId());
+    }
+
+  airspace = newAirspace;
+  threatsInRange.clear();
+}
+
+
+
+int Ucav::getAircraftWithin(double radius,
+			    vector<airspaceNeighbor> &found) const
+{
+  if (!airspace)
+    {
+      found.clear();
+      return 0;
+    }
+
+  return airspace->withinRadius(positionEcef, radius, found, getId());
+}
+
+
+
+int Ucav::getNearestAircraft(int k, vector<airspaceNeighbor> &found) const
+{
+  if (!airspace)
+    {
+      found.clear();
+      return 0;
+    }
+
+  return airspace->nearest(positionEcef, k, found, getId());
+}
+
+
+
+void Ucav::setTerrain(Terrain *newTerrain)
+{
+  terrain          = newTerrain;
+  haveTerrainFloor = FALSE;
+}
+
+
+
+bool Ucav::getTerrainFloor(double &floor) const
+{
+  if (haveTerrainFloor)
+    {
+      floor = terrainFloor;
+    }
+
+  return haveTerrainFloor;
+}
+
+
+
+bool Ucav::handleMessage(const message &msg)
+{
+  // A stall or threat reported from outside
+  // changes the flags like anything else,
+  // and the setter tells the state machine
+  if (msg.sender != getId())
+    {
+      switch (msg.messageID)
+	{
+	case StalledMsg:
+	  setStallState(TRUE);
+	  return TRUE;
+
+	case RecoveredMsg:
+	  setStallState(FALSE);
+	  return TRUE;
+
+	case ThreatDetectedMsg:
+	  setThreatDetection(TRUE);
+	  return TRUE;
+
+	case ThreatKilledMsg:
+	  setThreatDetection(FALSE);
+	  return TRUE;
+
+	default:
+	  break;
+	}
+    }
+
+#ifdef UCAV_TABLE_FSM
+  // The table driven machine gets
+  // events from the setters instead
+  return FALSE;
+#else
+  return stateMachine->handleMessage(msg);
+#endif
+}
+
+
+
 /**********************************************/
 // Private member functions
 
 
-// This function is simulating some
-// simple sensors, all triggered 
-// by number of cycles
+
+void Ucav::raiseFsmEvent(int event)
+{
+  if (tableFsm)
+    {
+      tableFsm->raiseEvent(event);
+    }
+}
+
+
+
+void Ucav::tellStateMachine(int messageID)
+{
+  MessageDispatcher::Instance()->dispatchMessage(getId(), getId(), messageID);
+}
+
+
+
+void Ucav::tellWaypointChanged()
+{
+  message msg(WaypointChangedMsg, getId());
+
+  msg.setPayload(data.currentWaypoint);
+  MessageDispatcher::Instance()->dispatchMessage(getId(), msg);
+}
+
+
+
+// Which of the table driven machine's
+// states the original StateMachine is in
+int Ucav::legacyFsmState() const
+{
+  return fsmStateOf(stateMachine->getCurrentState());
+}
+
+
+
+// Run after both machines have ticked. The
+// original GlobalState notices some level 
+// changes a tick later than the table gets
+// the event, so only complain if the two 
+// still disagree on the next tick.
+void Ucav::checkShadowFsm()
+{
+  int legacy = legacyFsmState();
+  int table  = tableFsm->getCurrentState();
+
+  if (legacy == table)
+    {
+      shadowMismatchTicks = 0;
+      return;
+    }
+
+  shadowMismatchTicks++;
+
+  if (shadowMismatchTicks >= 2)
+    {
+      shadowMismatches++;
+      cout<<"Shadow FSM mismatch at tick "<<data.systemTime
+	  <<": StateMachine is in "<<UcavTableFsm::stateName(legacy)
+	  <<", table FSM is in "<<UcavTableFsm::stateName(table)<<endl;
+    }
+}
+
+
+
+// Report where we are, and look for hostile
+// aircraft within UCAV_THREAT_RADIUS. One
+// that wasn't in range last time is a new
+// threat. One that stays in range after
+// it's been dealt with isn't raised again
+// until it's left and come back.
 void Ucav::pollSensors()
 {
-  //  cout<<"Updating the sensor data for the Ucav..."<<endl<<endl;
+  const airspaceContact *contact;
+  bool                   newThreat = FALSE;
+
+  if (!airspace)
+    {
+      return;
+    }
+
+  airspace->report(getId(), position.lat, position.lon, position.alt, FALSE);
+  airspace->withinRadius(positionEcef, UCAV_THREAT_RADIUS, inRange, getId());
 
-  // No sensors now... 
+  sensedThreats.clear();
+  for (size_t i = 0; i < inRange.size(); i++)
+    {
+      contact = airspace->getContact(inRange[i].id);
+
+      if (contact && contact->hostile)
+	{
+	  sensedThreats.push_back(contact->id);
+	}
+    }
 
-  //
-  // This would be an excellent place to have an 
-  // entity store sync'ed with the global
-  // GVP entity manager for networked sims...
+  sort(sensedThreats.begin(), sensedThreats.end());
 
+  for (size_t i = 0; i < sensedThreats.size(); i++)
+    {
+      if (!binary_search(threatsInRange.begin(), threatsInRange.end(),
+			 sensedThreats[i]))
+	{
+	  cout<<"Sensors picked up a threat, aircraft "
+	      <<sensedThreats[i]<<endl;
+	  newThreat = TRUE;
+	}
+    }
+
+  threatsInRange.swap(sensedThreats);
+
+  if (newThreat)
+    {
+      setThreatDetection(TRUE);
+    }
 }
 
 
 
-// This function simply stores
-// whether or not the Ucav was in 
-// a stalled state on exit, and if
-// there was a threat when it last
-// exited. This only happens if
-// the Ucav had an error state on
-// exit. 
-void Ucav::emergencyDataDump()
+// Ground we haven't got the tile for yet
+// is asked for here, and is known a
+// tick or two later
+void Ucav::updateTerrainFloor()
 {
-  cout<<"In emergencyDataDump()"<<endl;
-  ofstream emergencyFile("./emergencyFile", ios::out);
-  
-  if (!emergencyFile)
+  double highest;
+
+  if (!terrain)
     {
-      cout<<"Failed to open emergencyFile"<<endl;
+      return;
     }
-  else
+
+  haveTerrainFloor = terrain->highestAhead(position.lat, position.lon,
+					   position.heading,
+					   UCAV_TERRAIN_LOOKAHEAD, highest);
+  if (haveTerrainFloor)
     {
-      // Simply store wether we were 
-      // stalled when we died, or
-      // if there was a threat when 
-      // we died...
+      terrainFloor = highest + UCAV_TERRAIN_CLEARANCE;
+    }
+}
 
-      if (data.stalled)
-	emergencyFile<<"1 ";
-      else
-	emergencyFile<<"0 ";
 
-      if (data.detectThreat)
-	emergencyFile<<"1 ";
-      else
-	emergencyFile<<"0 ";
 
-      emergencyFile<<endl;
-	
-      emergencyFile.close();
+// Too many deadlines missed in a row and
+// the net's given up for holding the
+// attitude, which costs next to nothing.
+// Enough made in a row and it's back.
+void Ucav::checkTickBudget()
+{
+  if (!holdingForTime)
+    {
+      if ((tickBudget.getMissStreak() >= UCAV_DEGRADE_AFTER) &&
+	  (wantedPilotMode == TargetSeekMode))
+	{
+	  cout<<"Missed "<<tickBudget.getMissStreak()
+	      <<" deadlines in a row, holding the attitude"<<endl;
+
+	  pilot->holdAttitude();
+	  holdingForTime = TRUE;
+	}
+    }
+  else if (tickBudget.getMadeStreak() >= UCAV_RECOVER_AFTER)
+    {
+      cout<<"Back on time, flying to the target again"<<endl;
+
+      stopHoldingForTime();
+      pilot->setPilotMode(wantedPilotMode);
     }
 }
 
 
 
-// This file will read in an 
-// emergencyFile to see if the 
-// Ucav was stalled, and if there
-// was a threat last time it exited. 
-bool  Ucav::emergencyStart()
+void Ucav::stopHoldingForTime()
 {
-  int readInteger = 0;
+  pilot->enableHeadingHold(false);
+  pilot->enableAltitudeHold(false);
+
+  holdingForTime = FALSE;
+}
+
+
+
+// A copy of everything, every few
+// navigation ticks. Only a copy into
+// the mapped file, the kernel writes
+// it out.
+void Ucav::saveCheckpoint()
+{
+  ucavCheckpoint saved;
+
+  memset(&saved, 0, sizeof(saved));
+
+  saved.data     = data;
+  saved.position = position;
+  saved.controls = flightControls;
+
+#ifdef UCAV_TABLE_FSM
+  saved.state         = tableFsm->getCurrentState();
+  saved.previousState = tableFsm->getPreviousState();
+#else
+  saved.state         = legacyFsmState();
+  saved.previousState = fsmStateOf(stateMachine->getPreviousState());
+#endif
+
+  pilot->saveState(saved.pilot);
+
+  // A hold for want of time isn't
+  // anywhere to resume to
+  if (holdingForTime)
+    {
+      saved.pilot.mode = wantedPilotMode;
+    }
+
+  checkpoint.save(&saved);
+}
+
+
+
+// On the way out in a bad state, the
+// last checkpoint is left for the next
+// boot, and made sure of
+void Ucav::emergencyDataDump()
+{
+  cout<<"In emergencyDataDump()"<<endl;
+
+  saveCheckpoint();
+
+  if (!checkpoint.sync())
+    {
+      cout<<"Failed to write the checkpoint out"<<endl;
+    }
+}
+
 
-  cout<<"In emergencyStart()"<<endl;
 
-  ifstream emergencyFile("./emergencyFile", ios::in);
+// Looks for a checkpoint left by a crash,
+// or a bad exit, and takes back what the
+// Ucav knew then. The course is whatever
+// the waypointsFile has now, the place
+// along it from the checkpoint.
+bool Ucav::emergencyStart(ucavCheckpoint &saved)
+{
+  cout<<"In emergencyStart()"<<endl;
 
-  if (!emergencyFile)
+  if (!checkpoint.restore(&saved))
     {
-      cout<<"There isn't an emergency file, "
+      cout<<"There isn't a checkpoint, "
 	  <<"assume it's a normal startup..."<<endl;
       return FALSE;
     }
-  else
+
+  cout<<"There is a checkpoint, "
+      <<"jump start the initialization!"<<endl;
+
+  data.systemTime   = saved.data.systemTime;
+  data.stalled      = saved.data.stalled;
+  data.detectThreat = saved.data.detectThreat;
+  data.gearDown     = saved.data.gearDown;
+  data.airSpeed     = saved.data.airSpeed;
+
+  // Waypoints count from 1
+  if (data.haveNavCourse && (saved.data.currentWaypoint >= 1) &&
+      (saved.data.currentWaypoint <= data.numberOfWaypoints))
     {
-      cout<<"There is an emergency file, "
-	  <<"jump start the initialization!"<<endl;
+      data.currentWaypoint = saved.data.currentWaypoint;
+    }
 
-      emergencyFile>>readInteger;
+  position       = saved.position;
+  flightControls = saved.controls;
+  updatePositionEcef();
 
-      if (readInteger == 1)
-	data.stalled = TRUE;
-      else
-	data.stalled = FALSE;
+  return TRUE;
+}
 
-      emergencyFile>>readInteger;
 
-       if (readInteger == 1)
-	data.detectThreat = TRUE;
-      else
-	data.detectThreat = FALSE;
-       
-     return TRUE;
+
+bool Ucav::resumeFlight(const ucavCheckpoint &saved)
+{
+  BaseState<Ucav> *state = legacyStateFor(saved.state);
+
+  if (state == NULL)
+    {
+      return FALSE;
     }
-}
 
+  cout<<"Resuming in "<<UcavTableFsm::stateName(saved.state)
+      <<", at waypoint "<<data.currentWaypoint<<endl;
+
+  stateMachine->changeState(state);
+  stateMachine->setPreviousState(legacyStateFor(saved.previousState));
+
+  if (tableFsm)
+    {
+      tableFsm->start(saved.state, saved.previousState);
+    }
+
+  // After the state's enter(), so the
+  // smoothing it reset is put back
+  pilot->restoreState(saved.pilot);
+  wantedPilotMode = saved.pilot.mode;
+
+  return TRUE;
+}
 
 
 // This function checks for a waypoint
-// file, and if it exists reads it in
-// to a vector, and sets the waypoints
-// vector pointer for the Ucav class. 
+// file, and if it exists loads it in
+// to the Ucav's route.
 void Ucav::readInWaypoints()
 {
-  int waypointCounter = 0;
-  waypointData waypointStruct;
-
   cout<<"In readInWaypoints()"<<endl;
-  
-  ifstream waypointFile("./waypointsFile", ios::in);
 
-  if (!waypointFile)
+  route = new Route;
+
+  if (access("./waypointsFile", F_OK) == -1)
     {
       cout<<"There isn't a waypointsFile, not "
 	  <<"loading a course."<<endl;
       data.haveNavCourse = FALSE;
     }
+  else if (!route->load("./waypointsFile"))
+    {
+      cout<<"Couldn't use the waypointsFile, not "
+	  <<"loading a course."<<endl;
+      data.haveNavCourse = FALSE;
+    }
   else
     {
-      waypoints = new vector<waypointData>;
-      data.haveNavCourse = TRUE;
-
-      cout<<"Loading a navigation course from waypointsFile"<<endl;
+      cout<<"Loaded a navigation course of "<<route->getNumberOfWaypoints()
+	  <<" waypoints, "<<route->getLength() / 1000.0<<" km"<<endl;
+      data.haveNavCourse     = TRUE;
+      data.numberOfWaypoints = route->getNumberOfWaypoints();
+      data.currentWaypoint   = 1;
+    }
+}
 
-      while(!waypointFile.fail())
-      {
-	waypointFile>>waypointStruct.lat;
-	waypointFile>>waypointStruct.lon;
-	waypointFile>>waypointStruct.alt;
 
-	waypoints->push_back(waypointStruct);
-	waypointCounter++;
-      }
 
-      // Since eof is always behind by one
-      waypointCounter--;
-      waypoints->pop_back();
-      cout<<"Done reading in waypoints..."<<endl;
-      data.numberOfWaypoints = waypointCounter;
-      data.currentWaypoint   = 1;
-      waypointFile.close();
+// A course reloaded while flying. Where we
+// were on the old one means nothing on the
+// new one, so pick it up at the nearest leg
+// the next time the waypoint is asked for,
+// and tell the state machines it changed.
+void Ucav::swapInNewRoute()
+{
+  if (!routeUpdates.swapIn(route))
+    {
+      return;
     }
+
+  cout<<"Flying a new course of "<<route->getNumberOfWaypoints()
+      <<" waypoints, "<<route->getLength() / 1000.0<<" km"<<endl;
+
+  data.haveNavCourse     = TRUE;
+  data.numberOfWaypoints = route->getNumberOfWaypoints();
+  data.currentWaypoint   = 1;
+  rejoinRoute            = TRUE;
+  routeVersion++;
+
+  raiseFsmEvent(WaypointReachedEvent);
+  tellWaypointChanged();
+}
+
+
+
+// One geodetic conversion a tick, for
+// the Ucav. The waypoints were done
+// when the course was loaded.
+void Ucav::updatePositionEcef()
+{
+  Route::geoToEcef(position.lat, position.lon, position.alt, positionEcef);
 }
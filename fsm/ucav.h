@@ -8,7 +8,127 @@
 #include "baseState.h"
 #include "baseEntity.h"
 #include "stateMachine.h"
+#include "behavior.h"
+#include "ucavTableFsm.h"
 #include "pilot.h"
+#include "route.h"
+#include "hotReload.h"
+#include "rateGroup.h"
+#include "airspace.h"
+#include "terrain.h"
+#include "checkpoint.h"
+#include "tickBudget.h"
+
+
+
+// How often the parts of update() run, in
+// hertz. The control loop runs at the rate
+// FlightGear sends the FDM at (see startFG).
+#ifndef UCAV_NAVIGATION_RATE
+#define UCAV_NAVIGATION_RATE  5.0
+#endif
+
+#ifndef UCAV_GUIDANCE_RATE
+#define UCAV_GUIDANCE_RATE   15.0
+#endif
+
+#ifndef UCAV_CONTROL_RATE
+#define UCAV_CONTROL_RATE    30.0
+#endif
+
+// How long after an update() starts the
+// controls have to be out, and the share
+// each stage of it expects to take. The
+// net's left out, and the last command
+// flown again, when it won't fit.
+#ifndef UCAV_TICK_DEADLINE
+#define UCAV_TICK_DEADLINE    0.005   // seconds
+#endif
+
+#ifndef UCAV_FSM_BUDGET
+#define UCAV_FSM_BUDGET       0.002
+#endif
+
+#ifndef UCAV_GUIDANCE_BUDGET
+#define UCAV_GUIDANCE_BUDGET  0.0015
+#endif
+
+#ifndef UCAV_CONTROL_BUDGET
+#define UCAV_CONTROL_BUDGET   0.0005
+#endif
+
+#ifndef UCAV_TRANSMIT_BUDGET
+#define UCAV_TRANSMIT_BUDGET  0.0005
+#endif
+
+// Deadlines missed in a row before the net
+// is given up for attitude hold, and made
+// in a row before it's flown again
+#ifndef UCAV_DEGRADE_AFTER
+#define UCAV_DEGRADE_AFTER    3
+#endif
+
+#ifndef UCAV_RECOVER_AFTER
+#define UCAV_RECOVER_AFTER    50
+#endif
+
+// Hostile aircraft closer than this
+// are a threat
+#ifndef UCAV_THREAT_RADIUS
+#define UCAV_THREAT_RADIUS   10000.0  // meters
+#endif
+
+// How high to stay over the highest
+// ground this far along the heading
+#ifndef UCAV_TERRAIN_CLEARANCE
+#define UCAV_TERRAIN_CLEARANCE  300.0  // meters
+#endif
+
+#ifndef UCAV_TERRAIN_LOOKAHEAD
+#define UCAV_TERRAIN_LOOKAHEAD 5000.0  // meters
+#endif
+
+
+
+
+// What the Ucav tells its state machine
+// about, see messaging.h. Other threads and
+// entities can report a stall or a threat
+// the same way, with sender set to their
+// id or MESSAGE_NO_SENDER.
+enum ucavMessage
+  {
+    StalledMsg,
+    RecoveredMsg,
+    ThreatDetectedMsg,
+    ThreatKilledMsg,
+    WaypointChangedMsg,    // payload int, the next waypoint
+    RecoveryBootMsg
+  };
+
+// The stages of a tick, see
+// Ucav::getTickBudget()
+enum ucavTickStage
+  {
+    FsmStage,
+    GuidanceStage,
+    ControlStage,
+    TransmitStage
+  };
+
+// Every Ucav is in this group
+#define UCAV_MESSAGE_GROUP 0
+
+
+// Navigation ticks between checkpoints,
+// and where they go (the Ucav's id is
+// added on the end)
+#ifndef UCAV_CHECKPOINT_TICKS
+#define UCAV_CHECKPOINT_TICKS 1
+#endif
+
+#define UCAV_CHECKPOINT_FILE    "./ucavCheckpoint"
+#define UCAV_CHECKPOINT_VERSION 1
 
 
 
@@ -32,12 +152,19 @@ struct ucavData
 };
 
 
-// waypoint information
-struct waypointData
+
+// Everything needed to carry on flying
+// after a crash, see utils/checkpoint.h.
+// States are ucavFsmStates, whichever
+// state machine is flying.
+struct ucavCheckpoint
 {
-  double lat;
-  double lon;
-  double alt;
+  ucavData        data;
+  posStruct       position;
+  controlsStruct  controls;
+  int             state;
+  int             previousState;
+  pilotCheckpoint pilot;
 };
 
 
@@ -51,9 +178,35 @@ class Ucav : public BaseEntity
 
   // This is the update function, needs 
   // to be called repeatedly for the
-  // entity to function
+  // entity to function. Each part of it
+  // only runs when its rate says so:
+  //   navigation  the state machine, and
+  //               switching waypoints
+  //   guidance    the TargetSeeker's net
+  //   control     the Pilot's inner loops
+  //               and smoothing
   void update();
 
+  // In hertz, 0 runs that part on every
+  // update()
+  void   setUpdateRates(double navigation, double guidance, 
+			double control);
+
+  // When update() next has something to do,
+  // seconds on CLOCK_MONOTONIC, so the caller
+  // can sleep until then
+  double getNextUpdateTime() const;
+
+  // Runs, skipped periods and overruns
+  // of each part so far, and deadline
+  // misses of each stage
+  void   reportUpdateRates() const;
+
+  // Each update() starts a tick. Whoever
+  // sends the controls on accounts for
+  // it as the TransmitStage.
+  TickBudget& getTickBudget();
+
 
   // Whether or not to allow
   // the Statemachine to operate
@@ -100,6 +253,26 @@ class Ucav : public BaseEntity
   void getPositionOfNextWaypoint(double &lat, double &lon, double &alt);
   void setNextWaypoint(int newNextWypt);
 
+  // Straight from the precomputed route, no
+  // GVP calls. Distance is to the next
+  // waypoint, the track errors are against
+  // the leg ending at it (false if it's the
+  // first waypoint, there's no leg to it).
+  float getDistanceToNextWaypoint() const;
+  bool  getRouteTrackError(double &crossTrack, double &alongTrack) const;
+  int   getNearestRouteLeg() const;
+
+  // Goes up by one every time a new course
+  // is swapped in while flying, so the state
+  // machine knows to fetch the waypoint again
+  int   getRouteVersion() const;
+
+  // Called on the reload thread with a newly
+  // loaded brain or course, they're swapped
+  // in at the start of the next update()
+  void  offerTargetSeekerBrain(seekerBrain *newBrain);
+  void  offerRoute(Route *newRoute);
+
 
   // Interface functions for 
   // accessing the Ucav's TargetSeeker NN flier
@@ -117,11 +290,13 @@ class Ucav : public BaseEntity
   // Simply check the boolean state
   // of these Ucav variables
   bool   getStallState()      const;
+  void   setStallState(bool newStalled);
   void   notStalledAnymore();
 
   bool   getErrorState()      const;
 
   bool   getThreatDetection() const;
+  void   setThreatDetection(bool newThreat);
   void   threatKilled();
 
   bool   getRecoveryBoot()    const;
@@ -130,12 +305,59 @@ class Ucav : public BaseEntity
   // Change the ucav autonomous pilot's mode
   void   setPilotMode(FlyingMode newMode);
 
+  // The airspace the sensors look at, NULL
+  // (the default) for no sensors. The Ucav
+  // reports itself into it, whoever owns it
+  // calls its update() once a tick.
+  void   setAirspace(Airspace *newAirspace);
+
+  // Other aircraft as of the airspace's
+  // last update, nearest first
+  int    getAircraftWithin(double radius,
+			   vector<airspaceNeighbor> &found) const;
+  int    getNearestAircraft(int k, vector<airspaceNeighbor> &found) const;
+
+  // The ground to stay clear of, NULL (the
+  // default) for none. Whoever owns it starts
+  // its loader.
+  void   setTerrain(Terrain *newTerrain);
+
+  // The lowest safe altitude ahead, as of the
+  // last navigation tick: the highest ground
+  // within UCAV_TERRAIN_LOOKAHEAD along the
+  // heading, plus UCAV_TERRAIN_CLEARANCE.
+  // False if that ground isn't known (yet).
+  bool   getTerrainFloor(double &floor) const;
+
+  // Passes messages on to the state machine,
+  // reports from anyone else go through the
+  // setters above first
+  virtual bool handleMessage(const message &msg);
+
 
   // pointer to the statemachine for
   // this entity. It's new'd in the 
   // constructor.
   StateMachine<Ucav>* stateMachine;
 
+  // The current state's script, if it's one
+  // that takes more than a tick, see
+  // behavior.h. Its frame comes out of
+  // getBehaviorPool().
+  Behavior      behavior;
+  BehaviorPool& getBehaviorPool();
+
+  // The table driven version of the same
+  // behavior. Only new'd when built with
+  // UCAV_TABLE_FSM or UCAV_FSM_SHADOW,
+  // NULL otherwise.
+  UcavTableFsm* tableFsm;
+
+  // Which of the table driven machine's
+  // ucavFsmStates the original
+  // StateMachine is in
+  int legacyFsmState() const;
+
 
 
  private:
@@ -147,29 +369,98 @@ class Ucav : public BaseEntity
   controlsStruct flightControls;
 
 
-  // Pointer to a vector 
-  // of waypoint information records
-  vector<waypointData>* waypoints;
-  
+  // The navigation course, and the
+  // Ucav's position in the same earth
+  // centered coordinates as it
+  Route  *route;
+  double  positionEcef[3];
+  int     routeVersion;
+
+  // Watches the brain and waypointsFile,
+  // and hands new ones over through these
+  HotReloader       reloader;
+  ReloadSlot<Route> routeUpdates;
+  void              swapInNewRoute();
+
+  // After a recovery boot we don't know
+  // how far along the course we got, pick
+  // it up again at the nearest leg
+  bool   rejoinRoute;
+  void   updatePositionEcef();
+
+  // Frames for behavior
+  BehaviorPool behaviorPool;
+
+  // The parts of update()
+  RateGroup navigationRate;
+  RateGroup guidanceRate;
+  RateGroup controlRate;
+
+  // Deadline of each update(), and
+  // attitude hold in place of the net
+  // while they're being missed
+  TickBudget tickBudget;
+  FlyingMode wantedPilotMode;
+  bool       holdingForTime;
+  void       checkTickBudget();
+  void       stopHoldingForTime();
 
   // Check sensors, and 
   // update data structure
   void pollSensors();
 
+  Airspace                *airspace;
+  vector<airspaceNeighbor> inRange;
+  vector<int>              threatsInRange;
+  vector<int>              sensedThreats;
+
+  Terrain *terrain;
+  double   terrainFloor;
+  bool     haveTerrainFloor;
+  void     updateTerrainFloor();
+
+  // The last few ticks, kept in a mapped
+  // file so a crash can't lose them
+  Checkpoint checkpoint;
+  int        checkpointTicks;
+  void       saveCheckpoint();
+
   // Dump data to aid a reboot
   // in attempt to resolve system
   // error
   void emergencyDataDump();
 
   // Checks to see if it's reboot
-  // and try to quickly recover
-  bool emergencyStart();
+  // and try to quickly recover,
+  // saved is the checkpoint found
+  bool emergencyStart(ucavCheckpoint &saved);
+
+  // Straight back into the state the
+  // checkpoint was in, false if it
+  // wasn't in one we can resume
+  bool resumeFlight(const ucavCheckpoint &saved);
 
   // Checks for a waypoint file, 
   // and reads in the data if it
   // exists.
   void readInWaypoints();
 
+  // Hand an event to the table 
+  // driven state machine, if
+  // there is one
+  void raiseFsmEvent(int event);
+
+  // Tell our own state machine, it
+  // hears on the next tick
+  void tellStateMachine(int messageID);
+  void tellWaypointChanged();
+
+  // Shadow mode, compare the two
+  // state machines after a tick
+  void checkShadowFsm();
+  int  shadowMismatchTicks;
+  long shadowMismatches;
+
 
   // Name of the textfile that 
   // has the neural network 
@@ -9,6 +9,77 @@ using namespace std;
 
 
 
+// Radar altitude in meters, for
+// the takeoff script
+static double radarAltitude(Ucav* ucav)
+{
+  double lat, lon, alt, radAlt, heading, pitch, roll;
+
+  ucav->getPositionGeo(lat, lon, alt, radAlt, heading, pitch, roll);
+  return radAlt;
+}
+
+
+
+// Above the terrain floor ahead, or
+// there's no terrain to know it from
+static bool clearOfTerrain(Ucav* ucav)
+{
+  double lat, lon, alt, radAlt, heading, pitch, roll;
+  double floor;
+
+  if (!ucav->getTerrainFloor(floor))
+    {
+      return true;
+    }
+
+  ucav->getPositionGeo(lat, lon, alt, radAlt, heading, pitch, roll);
+  return alt >= floor;
+}
+
+
+
+// Attacks and recoveries interrupt what we
+// were doing, and revert to it once they're
+// done. Going from one of them straight to
+// the other mustn't lose what that was.
+// There's no current state on a recovery
+// boot, isInState can't be asked then.
+static void interruptWith(Ucav* ucav, BaseState<Ucav>* newState)
+{
+  StateMachine<Ucav>* machine     = ucav->stateMachine;
+  BaseState<Ucav>*    interrupted = machine->getCurrentState();
+
+  if (interrupted &&
+      (machine->isInState(AttackState::Instance()) ||
+       machine->isInState(RecoveryState::Instance())))
+    {
+      interrupted = machine->getPreviousState();
+    }
+
+  machine->changeState(newState);
+  machine->setPreviousState(interrupted);
+}
+
+
+
+// Head for the next waypoint, no lower
+// than the terrain floor ahead
+static void targetNextWaypoint(Ucav* ucav)
+{
+  double wyptLat, wyptLon, wyptAlt;
+  double floor;
+
+  ucav->getPositionOfNextWaypoint(wyptLat, wyptLon, wyptAlt);
+
+  if (ucav->getTerrainFloor(floor) && (wyptAlt < floor))
+    {
+      wyptAlt = floor;
+    }
+
+  ucav->setTargetSeekerTargetPos(wyptLat, wyptLon, wyptAlt);
+}
+
 
 /**************************************************************/
 
@@ -31,14 +102,24 @@ void GlobalState::enter(Ucav* ucav)
 
 
 
+// Nothing to poll for, the switching
+// happens as the messages come in
+void GlobalState::execute(Ucav*)
+{
+}
+
+
+
+
 // This function primarily handles state
 // switching for the state machine
-void GlobalState::execute(Ucav* ucav)
+bool GlobalState::onMessage(Ucav* ucav, const message& msg)
 {
-  // We just rebooted the ucav after an error, see
-  // what was going on when the software crashed
-  if (ucav->getRecoveryBoot())
+  switch (msg.messageID)
     {
+    case RecoveryBootMsg:
+      // We just rebooted the ucav after an error, see
+      // what was going on when the software crashed
       cout<<"Global state sees that we're starting "
 	  <<"up in recovery mode"<<endl;
 
@@ -47,61 +128,70 @@ void GlobalState::execute(Ucav* ucav)
       // attempting an attitude recovery
       if(ucav->getStallState())
 	{
-	  ucav->stateMachine->changeState(RecoveryState::Instance());
+	  interruptWith(ucav, RecoveryState::Instance());
 	}
       else if (ucav->getThreatDetection())
 	{
 	  // If we're not busy trying to recover
 	  // from a stall, and there's a threat 
 	  // out there, go back to Attack mode
-	  ucav->stateMachine->changeState(AttackState::Instance());
+	  interruptWith(ucav, AttackState::Instance());
 	}
       else
 	{
 	  // Not sure what was going on when the software crashed
 	  // go to recovery mode just to be safe.
-	  ucav->stateMachine->changeState(RecoveryState::Instance());
+	  interruptWith(ucav, RecoveryState::Instance());
 	}
       cout<<"About to call recoveryBootFinished..."<<endl;
 
       // reset the boolean...
       ucav->recoveryBootFinished();
-    }
-
-
-
-
-  // If I'm stalled, and not already trying to recover...
-  if (ucav->getStallState() &&
-      !ucav->stateMachine->isInState(RecoveryState::Instance()))
-    {
-      cout<<"Global state detects that we're stalled, "
-	  <<"flipping to recovery state."<<endl;
-      ucav->stateMachine->changeState(RecoveryState::Instance());
-    }
+      return TRUE;
 
 
+    case StalledMsg:
+      // If I'm stalled, and not already trying to recover...
+      if (ucav->getStallState() &&
+	  !ucav->stateMachine->isInState(RecoveryState::Instance()))
+	{
+	  cout<<"Global state detects that we're stalled, "
+	      <<"flipping to recovery state."<<endl;
+	  interruptWith(ucav, RecoveryState::Instance());
+	}
+      return TRUE;
+
+
+    case ThreatDetectedMsg:
+    case RecoveredMsg:
+      // If there's a threat, and I'm not already in attack, and
+      // I'm not in an emergency recovery state, then switch to 
+      // attack. One that turned up while we were recovering
+      // is still there once we've recovered.
+      if ((ucav->getThreatDetection()) && 
+	  !ucav->stateMachine->isInState(RecoveryState::Instance()) &&
+	  !ucav->stateMachine->isInState(AttackState::Instance()))
+	{
+	  cout<<"Global state sees a threat, and we're not in "
+	      <<"recovery state, moving to attack..."<<endl;
+	  interruptWith(ucav, AttackState::Instance());
+	}
+      return TRUE;
 
-  // If there's a threat, and I'm not already in attack, and
-  // I'm not in an emergency recovery state, then switch to 
-  // attack
-  if ((ucav->getThreatDetection()) && 
-      !ucav->stateMachine->isInState(RecoveryState::Instance()) &&
-      !ucav->stateMachine->isInState(AttackState::Instance()))
-    {
-      cout<<"Global state sees a threat, and we're not in "
-	  <<"recovery state, moving to attack..."<<endl;
-      ucav->stateMachine->changeState(AttackState::Instance());
-    }
 
+    case ThreatKilledMsg:
+      if (ucav->stateMachine->isInState(AttackState::Instance()) &&
+	  !ucav->getThreatDetection())
+	{
+	  cout<<"Global state sees that the threat's gone, going to "
+	      <<"cruise mode"<<endl;
+	  ucav->stateMachine->changeState(CruiseRouteState::Instance());
+	}
+      return TRUE;
 
 
-  if (ucav->stateMachine->isInState(AttackState::Instance()) &&
-      !ucav->getThreatDetection())
-    {
-      cout<<"Global state sees that the threat's gone, going to "
-	  <<"cruise mode"<<endl;
-      ucav->stateMachine->changeState(CruiseRouteState::Instance());
+    default:
+      return FALSE;
     }
 }
 
@@ -137,10 +227,7 @@ CruiseRouteState* CruiseRouteState::Instance()
 void CruiseRouteState::enter(Ucav* ucav)
 {
   // Set the first target and switch pilot mode...
-  double wyptLat, wyptLon, wyptAlt;
-
-  ucav->getPositionOfNextWaypoint(wyptLat, wyptLon, wyptAlt);
-  ucav->setTargetSeekerTargetPos(wyptLat, wyptLon, wyptAlt);
+  targetNextWaypoint(ucav);
   ucav->setPilotMode(TargetSeekMode);
 }
 
@@ -150,31 +237,50 @@ void CruiseRouteState::enter(Ucav* ucav)
 
 void CruiseRouteState::execute(Ucav* ucav)
 {
-  cout<<"cruiseRouteState::execute..."<<endl;
+  int nextWypt = ucav->getNextWaypoint();
+
+  if ((ucav->getDistanceToNextWaypoint() <= 926) &&
+      (nextWypt < ucav->getNumberOfWaypoints()))
+    {
+      ucav->setNextWaypoint(nextWypt + 1);
+    }
+  else
+    {
+      // The ground ahead changes
+      // as we turn and fly on
+      targetNextWaypoint(ucav);
+    }
+}
 
-  static double wyptLat = 0.0, wyptLon = 0.0, wyptAlt = 0.0;
 
-  static int  lastNextWypt = 0;
-  static int  nextWypt     = 0;
-  static char speakWaypoint[100];
 
-  nextWypt = ucav->getNextWaypoint();
+// A new next waypoint, or a new course,
+// which can come in with the same next
+// waypoint number
+bool CruiseRouteState::onMessage(Ucav* ucav, const message& msg)
+{
+  char   speakWaypoint[100];
+  int    nextWypt;
 
-  if (nextWypt != lastNextWypt)
+  if (msg.messageID != WaypointChangedMsg)
     {
-      sprintf(speakWaypoint, "next waypoint is now %d", nextWypt);
-      sayOutloud(true, speakWaypoint);
-      
-      ucav->getPositionOfNextWaypoint(wyptLat, wyptLon, wyptAlt);
-      ucav->setTargetSeekerTargetPos(wyptLat, wyptLon, wyptAlt);
+      return FALSE;
     }
-  else if ((ucav->getTargetDistance() <= 926) &&
-	   (nextWypt < ucav->getNumberOfWaypoints()))
+
+  // Moved on again since, there's
+  // another one of these behind it
+  if (msg.getPayload(nextWypt) && (nextWypt != ucav->getNextWaypoint()))
     {
-      ucav->setNextWaypoint(nextWypt + 1);
+      return TRUE;
     }
-  
-  lastNextWypt = nextWypt;
+
+  targetNextWaypoint(ucav);
+
+  snprintf(speakWaypoint, sizeof(speakWaypoint),
+	   "next waypoint is now %d", ucav->getNextWaypoint());
+  sayOutloud(true, speakWaypoint);
+
+  return TRUE;
 }
 
 
@@ -202,10 +308,32 @@ TakeOffState* TakeOffState::Instance()
 
 
 
+// Climb out, raising the landing gear
+// on the way
+static Behavior takeOffScript(Ucav* ucav)
+{
+  // Climb to this altitude, then switch to cruise state
+  static const double climbTo  = 800; // meters
+
+  // Raise the landing gear at this altitude..
+  static const double gearUpAt = 100; // meters
+
+  co_await until([ucav] { return radarAltitude(ucav) > gearUpAt; });
+  ucav->setGearDown(false);
+
+  // and over whatever's ahead
+  co_await until([ucav] { return (radarAltitude(ucav) > climbTo) &&
+			    clearOfTerrain(ucav); });
+}
+
+
+
+
 void TakeOffState::enter(Ucav* ucav)
 {
   cout<<"TakeOffState::enter..."<<endl;
   ucav->setPilotMode(TakeOffMode);
+  ucav->behavior = takeOffScript(ucav);
 }
 
 
@@ -214,33 +342,11 @@ void TakeOffState::enter(Ucav* ucav)
 
 
 // Increase our altitude until we're
-// at 25 units of height, then switch
+// at 800 meters, then switch
 // state to cruiseRoute...
 void TakeOffState::execute(Ucav* ucav)
 {
-  cout<<"TakeOffState::execute..."<<endl;
-
-  // Climb to this altitude, then switch to cruise state
-  static double climbTo  = 800; // meters
-
-  // Raise the landing gear at this altitude..
-  static double gearUpAt = 100; // meters
-
-
-  static bool   gearUp   = false;
-
-  static double lat, lon, alt, radAlt, heading, pitch, roll;
-
-
-  ucav->getPositionGeo(lat, lon, alt, radAlt, heading, pitch, roll);
- 
-  if ((!gearUp) && (radAlt > gearUpAt))
-    {
-      ucav->setGearDown(false);
-      gearUp = true;
-    }
-
-  if (radAlt > climbTo)
+  if (ucav->behavior.tick())
     {
       ucav->stateMachine->changeState(CruiseRouteState::Instance());
     }
@@ -254,6 +360,7 @@ void TakeOffState::execute(Ucav* ucav)
 void TakeOffState::exit(Ucav* ucav)
 {
   cout<<"TakeOffState::exit..."<<endl;
+  ucav->behavior.stop();
 }
 
 
@@ -279,9 +386,9 @@ void LandState::enter(Ucav* ucav)
 }
 
 
-void LandState::execute(Ucav* ucav)
+// Nothing to do here yet
+void LandState::execute(Ucav*)
 {
-  cout<<"LandState::execute..."<<endl;
 }
 
 
@@ -314,9 +421,9 @@ void EvadeState::enter(Ucav* ucav)
 }
 
 
-void EvadeState::execute(Ucav* ucav)
+// Nothing to do here yet
+void EvadeState::execute(Ucav*)
 {
-  cout<<"EvadeState::execute..."<<endl;
 }
 
 
@@ -343,35 +450,36 @@ AttackState* AttackState::Instance()
 }
 
 
+// take 5 ticks to kill a threat..
+static Behavior attackScript(Ucav* ucav)
+{
+  co_await ticks(5);
+
+  cout<<"Succesfully killed the threat!"<<endl;
+
+  // reset the boolean, since 
+  // I don't have real sensors to 
+  // detect that the threat is really
+  // gone...
+  ucav->threatKilled();
+}
+
+
 void AttackState::enter(Ucav* ucav)
 {
   cout<<"AttackState::enter..."<<endl;
+  ucav->behavior = attackScript(ucav);
 }
 
 
-// Simply count the number of updates
-// in this state, and then mark the 
-// threat as killed. Then revert
-// to the previous state, and if there
-// isn't a previous state, switch
-// to cruiseRoute state
+// Run the attack, and once the threat
+// is killed revert to the previous
+// state, and if there isn't a previous
+// state, switch to cruiseRoute state
 void AttackState::execute(Ucav* ucav)
 {
-  static int counter = 0;
-  cout<<"AttackState::execute..."<<endl;
-
-  // take 5 ticks to killa threat..
-  if (counter == 5)
+  if (ucav->behavior.tick())
     {
-      counter = 0;
-      cout<<"Succesfully killed the threat!"<<endl;
-      
-      // reset the boolean, since 
-      // I don't have real sensors to 
-      // detect that the threat is really
-      // gone...
-      ucav->threatKilled();
-
       // Go back to what I was doing before
       // I had to attack a threat
       if (!ucav->stateMachine->revertState())
@@ -382,10 +490,6 @@ void AttackState::execute(Ucav* ucav)
 	  ucav->stateMachine->changeState(CruiseRouteState::Instance());
 	}
     }
-  else
-    {
-      counter++;
-    }
 }
 
 
@@ -393,6 +497,7 @@ void AttackState::execute(Ucav* ucav)
 void AttackState::exit(Ucav* ucav)
 {
   cout<<"AttackState::exit..."<<endl;
+  ucav->behavior.stop();
 }
 
 
@@ -413,38 +518,45 @@ RecoveryState* RecoveryState::Instance()
 }
 
 
+// Assume that 5 ticks are enough
+// to fully recover from a stall
+static Behavior recoveryScript(Ucav* ucav)
+{
+  co_await ticks(5);
+
+  cout<<"Successfully recovered!"<<endl;
+
+  // reset the stalled boolean, since
+  // I don't really have any sensors
+  // to detect air flow over the wings. 
+  ucav->notStalledAnymore();
+}
+
+
 void RecoveryState::enter(Ucav* ucav)
 {
   cout<<"RecoveryState::enter..."<<endl;
+  ucav->behavior = recoveryScript(ucav);
 }
 
 
-// Simply count the number of time
-// this is updated. Assume that 5 
-// executions of this function is 
-// enough to fully recover from a 
-// stall. Then, revert to previous
-// state, and if there isn't a 
+// Run the recovery, then attack a threat
+// that turned up meanwhile, or revert to
+// previous state, and if there isn't a 
 // previous state, switch to 
 // cruiseRoute state.
 void RecoveryState::execute(Ucav* ucav)
 {
-  static int counter = 0;
-  cout<<"RecoveryState::execute..."<<endl;
-
-  // take 5 ticks to recovery from
-  // unusual attitude...
-  if (counter == 5)
+  if (ucav->behavior.tick())
     {
-      counter = 0;
-      cout<<"Successfully recovered!"<<endl;
-
-      // reset the stalled boolean, since
-      // I don't really have any sensors
-      // to detect air flow over the wings. 
-      ucav->notStalledAnymore();
-
-      if (!ucav->stateMachine->revertState())
+      // Straight there, not by way of the
+      // previous state until the
+      // RecoveredMsg turns up next tick
+      if (ucav->getThreatDetection())
+	{
+	  interruptWith(ucav, AttackState::Instance());
+	}
+      else if (!ucav->stateMachine->revertState())
 	{
 	  // revert failed, must not be a 
 	  // previous state to revert to. 
@@ -452,16 +564,13 @@ void RecoveryState::execute(Ucav* ucav)
 	  ucav->stateMachine->changeState(CruiseRouteState::Instance());
 	}
     }
-  else
-    {
-      counter++;
-    }
 }
 
 
 void RecoveryState::exit(Ucav* ucav)
 {
   cout<<"RecoveryState::exit..."<<endl;
+  ucav->behavior.stop();
 }
 
 
@@ -41,6 +41,8 @@ class GlobalState : public BaseState<Ucav>
   virtual void execute(Ucav* ucav);
   virtual void exit(Ucav* ucav);
 
+  virtual bool onMessage(Ucav* ucav, const message& msg);
+
 
  private:
   void globalAI();
@@ -61,6 +63,8 @@ class CruiseRouteState : public BaseState<Ucav>
   virtual void execute(Ucav* ucav);
   virtual void exit(Ucav* ucav);
 
+  virtual bool onMessage(Ucav* ucav, const message& msg);
+
  private:
   void cruiseRouteAI();
 };
@@ -0,0 +1,242 @@
+#include <iostream>
+using namespace std;
+#include <stdio.h>
+
+
+
+#include "ucavTableFsm.h"
+#include "ucav.h"
+#include "speech.h"
+
+
+
+// Out of class definitions for the
+// constexpr tables, still needed for
+// anything that takes their address
+constexpr int                 ucavFsmDef::parent[];
+constexpr bool                ucavFsmDef::remembered[];
+constexpr transitionRow<Ucav> ucavFsmDef::rows[];
+
+
+
+
+
+/**************************************************************/
+// Guards
+
+
+bool ucavFsmDef::isStalled(const Ucav* ucav)
+{
+  return ucav->getStallState();
+}
+
+
+bool ucavFsmDef::threatPresent(const Ucav* ucav)
+{
+  return ucav->getThreatDetection();
+}
+
+
+
+
+
+/**************************************************************/
+
+
+UcavTableFsm::UcavTableFsm(Ucav* newUcav):
+  TableStateMachine<UcavTableFsm, ucavFsmDef>(newUcav)
+{
+  ucav          = newUcav;
+  drivesUcav    = true;
+  attackTicks   = 0;
+  recoveryTicks = 0;
+  gearUp        = false;
+}
+
+
+
+void UcavTableFsm::setDrivesUcav(bool newDrives)
+{
+  drivesUcav = newDrives;
+}
+
+
+
+const char* UcavTableFsm::stateName(int state)
+{
+  switch(state)
+    {
+    case FsmRoot:        return "Root";
+    case FsmStartup:     return "Startup";
+    case FsmTakeOff:     return "TakeOff";
+    case FsmAirborne:    return "Airborne";
+    case FsmCruiseRoute: return "CruiseRoute";
+    case FsmLand:        return "Land";
+    case FsmEvade:       return "Evade";
+    case FsmAttack:      return "Attack";
+    case FsmRecovery:    return "Recovery";
+    default:             return "Unknown";
+    }
+}
+
+
+
+
+
+// State entry functions, run once, upon
+// entry of the state. Same work as the
+// enter() functions in ucavStates.c++
+void UcavTableFsm::enterState(int state)
+{
+  double wyptLat, wyptLon, wyptAlt;
+  char   speakWaypoint[100];
+
+  switch(state)
+    {
+    case FsmTakeOff:
+      if (drivesUcav)
+	{
+	  ucav->setPilotMode(TakeOffMode);
+	}
+      break;
+
+    case FsmCruiseRoute:
+      // Set the target and switch pilot mode,
+      // re-entered every time the waypoint changes
+      if (drivesUcav)
+	{
+	  snprintf(speakWaypoint, sizeof(speakWaypoint),
+		   "next waypoint is now %d", ucav->getNextWaypoint());
+	  sayOutloud(true, speakWaypoint);
+
+	  ucav->getPositionOfNextWaypoint(wyptLat, wyptLon, wyptAlt);
+	  ucav->setTargetSeekerTargetPos(wyptLat, wyptLon, wyptAlt);
+	  ucav->setPilotMode(TargetSeekMode);
+	}
+      break;
+
+    case FsmAttack:
+      attackTicks = 0;
+      break;
+
+    case FsmRecovery:
+      recoveryTicks = 0;
+      break;
+
+    default:
+      break;
+    }
+}
+
+
+
+
+
+// Run the current state, the per tick
+// part of the execute() functions in
+// ucavStates.c++. The switching logic
+// lives in the table now, these only
+// raise events.
+void UcavTableFsm::executeState(int state)
+{
+  // Climb to this altitude, then switch to cruise state
+  static const double climbTo  = 800; // meters
+
+  // Raise the landing gear at this altitude..
+  static const double gearUpAt = 100; // meters
+
+  double lat, lon, alt, radAlt, heading, pitch, roll;
+  int    nextWypt;
+
+
+  switch(state)
+    {
+    case FsmTakeOff:
+      ucav->getPositionGeo(lat, lon, alt, radAlt, heading, pitch, roll);
+
+      if ((!gearUp) && (radAlt > gearUpAt))
+	{
+	  if (drivesUcav)
+	    {
+	      ucav->setGearDown(false);
+	    }
+	  gearUp = true;
+	}
+
+      if (radAlt > climbTo)
+	{
+	  raiseEvent(ClimbCompleteEvent);
+	}
+      break;
+
+    case FsmCruiseRoute:
+      // Ucav::setNextWaypoint raises the
+      // WaypointReachedEvent for us
+      nextWypt = ucav->getNextWaypoint();
+
+      if (drivesUcav &&
+	  (ucav->getDistanceToNextWaypoint() <= 926) &&
+	  (nextWypt < ucav->getNumberOfWaypoints()))
+	{
+	  ucav->setNextWaypoint(nextWypt + 1);
+	}
+      break;
+
+    case FsmAttack:
+      // take 5 ticks to kill a threat,
+      // Ucav::threatKilled raises the event
+      if (attackTicks == 5)
+	{
+	  attackTicks = 0;
+	  cout<<"Succesfully killed the threat!"<<endl;
+
+	  if (drivesUcav)
+	    {
+	      ucav->threatKilled();
+	    }
+	}
+      else
+	{
+	  attackTicks++;
+	}
+      break;
+
+    case FsmRecovery:
+      // take 5 ticks to recover from an unusual
+      // attitude, Ucav::notStalledAnymore raises
+      // the event
+      if (recoveryTicks == 5)
+	{
+	  recoveryTicks = 0;
+	  cout<<"Successfully recovered!"<<endl;
+
+	  if (drivesUcav)
+	    {
+	      ucav->notStalledAnymore();
+	    }
+	}
+      else
+	{
+	  recoveryTicks++;
+	}
+      break;
+
+    default:
+      break;
+    }
+}
+
+
+
+
+
+// State exit functions, run once,
+// upon exit of the state
+void UcavTableFsm::exitState(int state)
+{
+  if ((state == FsmStartup) && drivesUcav)
+    {
+      // Recovery boot has been dealt with
+      ucav->recoveryBootFinished();
+    }
+}
@@ -0,0 +1,166 @@
+#ifndef UCAVTABLEFSM_H
+#define UCAVTABLEFSM_H
+
+// The Ucav behavior from ucavStates.h/c++ ported
+// onto the table driven TableStateMachine. The
+// switching logic that GlobalState::execute polls
+// for every tick is the transition table below,
+// and the Ucav raises events when its flags
+// change instead.
+//
+// Build with -DUCAV_TABLE_FSM to have the Ucav
+// fly with this machine, or -DUCAV_FSM_SHADOW to
+// keep flying with the original StateMachine and
+// run this one alongside it, complaining whenever
+// the two disagree about the current state.
+
+
+#include "tableStateMachine.h"
+
+
+class Ucav;
+
+
+
+enum ucavFsmState
+  {
+    FsmRoot,          // composite, everything
+    FsmStartup,       // nothing decided yet (recovery boot)
+    FsmTakeOff,
+    FsmAirborne,      // composite, normal flight
+    FsmCruiseRoute,
+    FsmLand,
+    FsmEvade,
+    FsmAttack,
+    FsmRecovery,
+    numUcavFsmStates
+  };
+
+
+
+enum ucavFsmEvent
+  {
+    StallEvent,
+    ThreatDetectedEvent,
+    ThreatKilledEvent,
+    WaypointReachedEvent,
+    RecoveryBootEvent,
+    ClimbCompleteEvent,
+    RecoveredEvent,
+    numUcavFsmEvents
+  };
+
+
+
+
+// The machine definition, see tableStateMachine.h
+struct ucavFsmDef
+{
+  typedef Ucav entityType;
+
+  enum
+    {
+      numStates = numUcavFsmStates,
+      numEvents = numUcavFsmEvents
+    };
+
+  // Guards
+  static bool isStalled(const Ucav* ucav);
+  static bool threatPresent(const Ucav* ucav);
+
+  static constexpr int parent[numStates] =
+    {
+      NO_PARENT_STATE, // FsmRoot
+      FsmRoot,         // FsmStartup
+      FsmRoot,         // FsmTakeOff
+      FsmRoot,         // FsmAirborne
+      FsmAirborne,     // FsmCruiseRoute
+      FsmAirborne,     // FsmLand
+      FsmAirborne,     // FsmEvade
+      FsmAirborne,     // FsmAttack
+      FsmRoot          // FsmRecovery
+    };
+
+  // Don't revert back into startup, nor into
+  // an attack or recovery, they only interrupt
+  static constexpr bool remembered[numStates] =
+    {
+      false, false, true, false, true, true, true, false, false
+    };
+
+  // Same fallback as the original states use
+  // when StateMachine::revertState() fails
+  static constexpr int historyDefault = FsmCruiseRoute;
+
+  static constexpr transitionRow<Ucav> rows[] =
+    {
+      // We rebooted after an error, go back to whatever
+      // we were doing. Not sure? Recover to be safe.
+      { FsmStartup,     RecoveryBootEvent,    FsmRecovery,         isStalled     },
+      { FsmStartup,     RecoveryBootEvent,    FsmAttack,           threatPresent },
+      { FsmStartup,     RecoveryBootEvent,    FsmRecovery,         nullptr       },
+
+      // Stalls always win
+      { FsmRoot,        StallEvent,           FsmRecovery,         nullptr       },
+      { FsmRecovery,    StallEvent,           INTERNAL_TRANSITION, nullptr       },
+
+      // Threats are attacked, unless we're busy recovering
+      { FsmRoot,        ThreatDetectedEvent,  FsmAttack,           nullptr       },
+      { FsmRecovery,    ThreatDetectedEvent,  INTERNAL_TRANSITION, nullptr       },
+      { FsmAttack,      ThreatDetectedEvent,  INTERNAL_TRANSITION, nullptr       },
+
+      // Done with a threat or stall, back to what we were doing,
+      // unless a threat showed up while we were recovering
+      { FsmAttack,      ThreatKilledEvent,    HISTORY_STATE,       nullptr       },
+      { FsmRecovery,    RecoveredEvent,       FsmAttack,           threatPresent },
+      { FsmRecovery,    RecoveredEvent,       HISTORY_STATE,       nullptr       },
+
+      { FsmTakeOff,     ClimbCompleteEvent,   FsmCruiseRoute,      nullptr       },
+
+      // Re-enter cruise to pick up the new waypoint
+      { FsmCruiseRoute, WaypointReachedEvent, FsmCruiseRoute,      nullptr       }
+    };
+};
+
+
+
+
+
+class UcavTableFsm : public TableStateMachine<UcavTableFsm, ucavFsmDef>
+{
+ public:
+  UcavTableFsm(Ucav* newUcav);
+
+
+  // When false, the state actions keep their
+  // own bookkeeping but don't touch the Ucav.
+  // Used for running in the shadow of the
+  // original StateMachine.
+  void setDrivesUcav(bool newDrives);
+
+
+  // Actions, called by TableStateMachine
+  void enterState(int state);
+  void executeState(int state);
+  void exitState(int state);
+
+
+  // For printing
+  static const char* stateName(int state);
+
+
+ private:
+  Ucav* ucav;
+  bool  drivesUcav;
+
+  // Per entity versions of the
+  // function statics in ucavStates.c++
+  int  attackTicks;
+  int  recoveryTicks;
+  bool gearUp;
+};
+
+
+
+
+#endif
@@ -0,0 +1,298 @@
+// Checks the table driven state machine
+// (fsm/ucavTableFsm.h) against the original
+// one (fsm/ucavStates.h), offline. Built with
+// UCAV_FSM_SHADOW the Ucav flies with the
+// original and runs the table one alongside.
+// This feeds it a fixed script of events, no
+// FlightGear or GVP server needed, and after
+// every tick checks the two are in the same
+// state. Each step of the script also has to
+// end up in the state it names.
+//
+// Exits with 1 on the first tick the machines
+// disagree, or the first step that doesn't get
+// where it should.
+//
+//   fsmcheck
+
+
+#include <iostream>
+using namespace std;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#include "ucav.h"
+#include "ucavTableFsm.h"
+#include "checkpoint.h"
+#include "speech.h"
+
+
+
+#ifndef UCAV_FSM_SHADOW
+#error "fsmcheck needs both state machines, build it with -DUCAV_FSM_SHADOW"
+#endif
+
+
+// Most ticks a step waits for its state
+#define FSMCHECKTICKS 20
+
+// Over the helipad at North Island
+#define FSMCHECKLAT   32.709672
+#define FSMCHECKLON  -117.213235
+
+
+
+
+enum scriptAction
+  {
+    NoAction,
+    Climb,           // past the takeoff altitude
+    ReachWaypoint,   // fly onto the next waypoint
+    Threat,
+    Stall
+  };
+
+
+struct scriptStep
+{
+  const char   *what;
+  scriptAction  action;
+  ucavFsmState  expect;
+};
+
+
+
+// Where the aircraft is, the script
+// moves it and every tick reports it
+struct scriptAircraft
+{
+  double lat, lon, alt, radAlt;
+};
+
+
+
+
+// Off the runway and back, with stalls and
+// threats on the way, and on top of each other
+static const scriptStep flightScript[] =
+  {
+    { "on the runway",                 NoAction,      FsmTakeOff     },
+    { "stall on the climb",            Stall,         FsmRecovery    },
+    { "recovered, back to the climb",  NoAction,      FsmTakeOff     },
+    { "climb out",                     Climb,         FsmCruiseRoute },
+    { "reach the next waypoint",       ReachWaypoint, FsmCruiseRoute },
+    { "threat",                        Threat,        FsmAttack      },
+    { "threat killed",                 NoAction,      FsmCruiseRoute },
+    { "stall",                         Stall,         FsmRecovery    },
+    { "recovered",                     NoAction,      FsmCruiseRoute },
+    { "stall",                         Stall,         FsmRecovery    },
+    { "threat while recovering",       Threat,        FsmRecovery    },
+    { "recovered, into the attack",    NoAction,      FsmAttack      },
+    { "threat killed",                 NoAction,      FsmCruiseRoute },
+    { "threat",                        Threat,        FsmAttack      },
+    { "stall while attacking",         Stall,         FsmRecovery    },
+    { "recovered, back to the attack", NoAction,      FsmAttack      },
+    { "threat killed",                 NoAction,      FsmCruiseRoute },
+    { "reach the next waypoint",       ReachWaypoint, FsmCruiseRoute }
+  };
+
+
+// After a crash in a state that can't be
+// resumed, from the checkpoint's flags
+static const scriptStep stalledBootScript[] =
+  {
+    { "recovery boot, stalled",        NoAction,      FsmRecovery    },
+    { "recovered",                     NoAction,      FsmCruiseRoute }
+  };
+
+static const scriptStep threatBootScript[] =
+  {
+    { "recovery boot, threat",         NoAction,      FsmAttack      },
+    { "threat killed",                 NoAction,      FsmCruiseRoute }
+  };
+
+static const scriptStep unsureBootScript[] =
+  {
+    { "recovery boot, not sure why",   NoAction,      FsmRecovery    },
+    { "recovered",                     NoAction,      FsmCruiseRoute }
+  };
+
+
+
+
+static string checkpointFileFor(int id)
+{
+  char checkpointFile[64];
+
+  snprintf(checkpointFile, sizeof(checkpointFile), "%s%d",
+	   UCAV_CHECKPOINT_FILE, id);
+
+  return checkpointFile;
+}
+
+
+
+// A checkpoint the Ucav can't resume from,
+// so it boots into recovery the way the
+// state machines decide
+static bool leaveCrashCheckpoint(int id, bool stalled, bool threat)
+{
+  Checkpoint     checkpoint;
+  ucavCheckpoint saved;
+
+  memset(&saved, 0, sizeof(saved));
+
+  saved.state             = FsmStartup;
+  saved.previousState     = FsmStartup;
+  saved.data.stalled      = stalled;
+  saved.data.detectThreat = threat;
+
+  return checkpoint.open(checkpointFileFor(id), UCAV_CHECKPOINT_VERSION,
+			 sizeof(saved)) &&
+    checkpoint.save(&saved);
+}
+
+
+
+static void startScriptAction(Ucav *ucav, scriptAction action,
+			      scriptAircraft &aircraft)
+{
+  switch (action)
+    {
+    case Climb:
+      aircraft.alt    = 900.0;
+      aircraft.radAlt = 900.0;
+      break;
+
+    case ReachWaypoint:
+      ucav->getPositionOfNextWaypoint(aircraft.lat, aircraft.lon,
+				      aircraft.alt);
+      aircraft.radAlt = aircraft.alt;
+      break;
+
+    case Threat:
+      ucav->setThreatDetection(true);
+      break;
+
+    case Stall:
+      ucav->setStallState(true);
+      break;
+
+    default:
+      break;
+    }
+}
+
+
+
+// Runs one script on a new Ucav, false
+// at the first thing that's wrong
+static bool runScript(const char *name, int id,
+		      const scriptStep *script, int numberOfSteps)
+{
+  scriptAircraft aircraft;
+  Ucav          *ucav;
+  bool           ok = true;
+  int            legacy, table;
+  int            tick = 0;
+
+  cout<<"Script "<<name<<endl;
+
+  aircraft.lat    = FSMCHECKLAT;
+  aircraft.lon    = FSMCHECKLON;
+  aircraft.alt    = 0.0;
+  aircraft.radAlt = 0.0;
+
+  ucav = new Ucav(id);
+  ucav->setUpdateRates(0.0, 0.0, 0.0);
+  ucav->setAirspeed(150.0);
+
+  for (int step = 0; ok && (step < numberOfSteps); step++)
+    {
+      startScriptAction(ucav, script[step].action, aircraft);
+
+      for (int wait = 0; wait < FSMCHECKTICKS; wait++)
+	{
+	  ucav->setPositionGeo(aircraft.lat, aircraft.lon, aircraft.alt,
+			       aircraft.radAlt, 0.0, 0.0, 0.0);
+	  ucav->update();
+	  tick++;
+
+	  legacy = ucav->legacyFsmState();
+	  table  = ucav->tableFsm->getCurrentState();
+
+	  if (legacy != table)
+	    {
+	      cout<<"  tick "<<tick<<", "<<script[step].what
+		  <<": StateMachine is in "<<UcavTableFsm::stateName(legacy)
+		  <<", table FSM is in "<<UcavTableFsm::stateName(table)<<endl;
+	      ok = false;
+	      break;
+	    }
+
+	  if (table == script[step].expect)
+	    {
+	      break;
+	    }
+	}
+
+      if (ok && (table != script[step].expect))
+	{
+	  cout<<"  "<<script[step].what<<": both in "
+	      <<UcavTableFsm::stateName(table)<<" after "<<FSMCHECKTICKS
+	      <<" ticks, should be in "
+	      <<UcavTableFsm::stateName(script[step].expect)<<endl;
+	  ok = false;
+	}
+
+      if (ok)
+	{
+	  cout<<"  tick "<<tick<<", "<<script[step].what<<": both in "
+	      <<UcavTableFsm::stateName(table)<<endl;
+	}
+    }
+
+  delete ucav;
+
+  unlink(checkpointFileFor(id).c_str());
+
+  return ok;
+}
+
+
+
+
+int main()
+{
+  bool ok = true;
+
+  initSpeech(NoSpeech);
+
+  // Ids only go up, each script
+  // gets a Ucav of its own
+  unlink(checkpointFileFor(1).c_str());
+  ok = ok && runScript("flight", 1, flightScript,
+		       sizeof(flightScript) / sizeof(flightScript[0]));
+
+  ok = ok && leaveCrashCheckpoint(2, true, false) &&
+    runScript("stalled boot", 2, stalledBootScript,
+	      sizeof(stalledBootScript) / sizeof(stalledBootScript[0]));
+
+  ok = ok && leaveCrashCheckpoint(3, false, true) &&
+    runScript("threat boot", 3, threatBootScript,
+	      sizeof(threatBootScript) / sizeof(threatBootScript[0]));
+
+  ok = ok && leaveCrashCheckpoint(4, false, false) &&
+    runScript("unsure boot", 4, unsureBootScript,
+	      sizeof(unsureBootScript) / sizeof(unsureBootScript[0]));
+
+  shutdownSpeech();
+
+  cout<<(ok ? "The state machines agree" : "The state machines DISAGREE")
+      <<endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,392 @@
+// Checks and times utils/fastMath.h against
+// libm. The accuracy part walks every input
+// range the project uses with a fine step
+// (every float between 0.5 and 1 for acos)
+// and exits with 1 if any function is worse
+// than the error fastMath.h promises. The
+// speed part times libm, the fast scalar
+// calls and the fast array calls.
+//
+//   mathbench [-quick]
+//
+// -quick uses 1/16 of the points.
+
+
+#include <iostream>
+using namespace std;
+#include <iomanip>
+#include <vector>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#include "fastMath.h"
+
+
+
+// Inputs per timed run
+#define MATHBENCHCOUNT 1000000
+
+// Timed runs, the best one is reported
+#define MATHBENCHRUNS 5
+
+
+
+
+static double secondsNow()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+
+
+// Largest error seen for one function
+// over one range, and where
+struct accuracyResult
+{
+  const char *name;
+  const char *range;
+  double      maxError;
+  double      worstInput;
+  double      allowed;
+  long        points;
+};
+
+
+
+static void printAccuracy(const accuracyResult &result)
+{
+  cout<<"  "<<setw(12)<<left<<result.name<<right
+      <<setw(26)<<result.range
+      <<setw(12)<<result.points
+      <<"  max error "<<scientific<<setprecision(2)<<result.maxError
+      <<" (allowed "<<result.allowed<<") at "
+      <<setprecision(9)<<result.worstInput
+      <<(result.maxError <= result.allowed ? "" : "  FAILED")<<endl;
+  cout.unsetf(ios::floatfield);
+  cout<<setprecision(6);
+}
+
+
+
+
+static accuracyResult checkExp(double low, double high, double step,
+			       const char *range)
+{
+  accuracyResult result = { "fastExp", range, 0.0, 0.0,
+			    FASTMATH_EXP_MAX_REL_ERROR, 0 };
+
+  for (double x = low; x <= high; x += step, result.points++)
+    {
+      double exact = exp(x);
+      double error = fabs(fastExp(x) - exact) / exact;
+
+      if (error > result.maxError)
+	{
+	  result.maxError   = error;
+	  result.worstInput = x;
+	}
+    }
+
+  return result;
+}
+
+
+
+static accuracyResult checkSigmoid(double low, double high, double step,
+				   const char *range)
+{
+  accuracyResult result = { "fastSigmoid", range, 0.0, 0.0,
+			    FASTMATH_SIGMOID_MAX_ERROR, 0 };
+
+  for (double x = low; x <= high; x += step, result.points++)
+    {
+      // The same expression neuralNet.cpp used
+      double exact = 1.0f / (1 + exp(-x));
+      double error = fabs(fastSigmoid(x) - exact);
+
+      if (error > result.maxError)
+	{
+	  result.maxError   = error;
+	  result.worstInput = x;
+	}
+    }
+
+  return result;
+}
+
+
+
+static accuracyResult checkAcos(double step, const char *range)
+{
+  accuracyResult result = { "fastAcos", range, 0.0, 0.0,
+			    FASTMATH_ACOS_MAX_ERROR, 0 };
+
+  for (double x = -1.0; x <= 1.0; x += step, result.points++)
+    {
+      double error = fabs(fastAcos(x) - acos(x));
+
+      if (error > result.maxError)
+	{
+	  result.maxError   = error;
+	  result.worstInput = x;
+	}
+    }
+
+  return result;
+}
+
+
+
+// The dot products in the TargetSeeker are
+// floats, walk every one of them near 1,
+// where acos is steepest
+static accuracyResult checkAcosFloats(int stride, const char *range)
+{
+  accuracyResult result = { "fastAcos", range, 0.0, 0.0,
+			    FASTMATH_ACOS_MAX_ERROR, 0 };
+
+  for (float x = 0.5f; x <= 1.0f; result.points++)
+    {
+      double error = fabs(fastAcos(x) - acos((double)x));
+
+      if (error > result.maxError)
+	{
+	  result.maxError   = error;
+	  result.worstInput = x;
+	}
+
+      for (int i = 0; i < stride; i++)
+	{
+	  x = nextafterf(x, 2.0f);
+	}
+    }
+
+  return result;
+}
+
+
+
+// Points on circles from a meter to a
+// hundred kilometers, all the way round
+static accuracyResult checkAtan2(double step, const char *range)
+{
+  accuracyResult result = { "fastAtan2", range, 0.0, 0.0,
+			    FASTMATH_ATAN2_MAX_ERROR, 0 };
+
+  for (double radius = 1.0; radius <= 1e5; radius *= 10.0)
+    {
+      for (double angle = -FASTMATH_PI; angle <= FASTMATH_PI;
+	   angle += step, result.points++)
+	{
+	  double y     = radius * sin(angle);
+	  double x     = radius * cos(angle);
+	  double error = fabs(fastAtan2(y, x) - atan2(y, x));
+
+	  // -pi and pi are the same way
+	  if (error > FASTMATH_PI)
+	    {
+	      error = fabs(error - 2 * FASTMATH_PI);
+	    }
+
+	  if (error > result.maxError)
+	    {
+	      result.maxError   = error;
+	      result.worstInput = angle;
+	    }
+	}
+    }
+
+  return result;
+}
+
+
+
+static accuracyResult checkSinCos(double low, double high, double step,
+				  const char *range)
+{
+  accuracyResult result = { "fastSinCos", range, 0.0, 0.0,
+			    FASTMATH_SINCOS_MAX_ERROR, 0 };
+  double sine, cosine, error;
+
+  for (double x = low; x <= high; x += step, result.points++)
+    {
+      fastSinCos(x, sine, cosine);
+      error = fmax(fabs(sine - sin(x)), fabs(cosine - cos(x)));
+
+      if (error > result.maxError)
+	{
+	  result.maxError   = error;
+	  result.worstInput = x;
+	}
+    }
+
+  return result;
+}
+
+
+
+
+// Time one loop over the inputs, best of
+// a few runs, in nanoseconds per call
+#define TIMELOOP(nanoseconds, body)				\
+  {								\
+    double best = 1e30;						\
+    for (int run = 0; run < MATHBENCHRUNS; run++)		\
+      {								\
+	double start = secondsNow();				\
+	body;							\
+	double took = secondsNow() - start;			\
+	best = (took < best) ? took : best;			\
+      }								\
+    nanoseconds = best * 1e9 / MATHBENCHCOUNT;			\
+  }
+
+
+
+static void printSpeed(const char *name, double libm, double fast,
+		       double array)
+{
+  cout<<"  "<<setw(12)<<left<<name<<right<<fixed<<setprecision(2)
+      <<"  libm "<<setw(7)<<libm<<" ns"
+      <<"  fast "<<setw(7)<<fast<<" ns"
+      <<"  array "<<setw(7)<<array<<" ns"
+      <<"  ("<<setprecision(1)<<libm / array<<"x)"<<endl;
+  cout.unsetf(ios::floatfield);
+  cout<<setprecision(6);
+}
+
+
+
+
+int main(int argc, char* argv[])
+{
+  vector<accuracyResult> results;
+  bool   quick = (argc > 1) && !strcmp(argv[1], "-quick");
+  double scale = quick ? 16.0 : 1.0;
+  bool   passed = true;
+
+  cout<<"Accuracy"<<endl;
+
+  // Neuron sums stay well inside +-60,
+  // the wider ranges are for completeness
+  results.push_back(checkExp(-60.0, 60.0, 1e-5 * scale, "-60..60"));
+  results.push_back(checkExp(-700.0, 700.0, 1e-3 * scale, "-700..700"));
+  results.push_back(checkSigmoid(-60.0, 60.0, 1e-5 * scale, "-60..60"));
+  results.push_back(checkSigmoid(-1000.0, 1000.0, 1e-2 * scale,
+				 "-1000..1000"));
+
+  results.push_back(checkAcos(1e-7 * scale, "-1..1"));
+  results.push_back(checkAcosFloats((int)scale, "every float 0.5..1"));
+
+  results.push_back(checkAtan2(1e-6 * scale, "radius 1..1e5"));
+
+  // Radians from a single turn out to
+  // degree sized values passed as radians
+  results.push_back(checkSinCos(-2 * FASTMATH_PI, 2 * FASTMATH_PI,
+				1e-6 * scale, "-2pi..2pi"));
+  results.push_back(checkSinCos(-1000.0, 1000.0, 1e-4 * scale,
+				"-1000..1000"));
+
+  for (size_t i = 0; i < results.size(); i++)
+    {
+      printAccuracy(results[i]);
+      passed = passed && (results[i].maxError <= results[i].allowed);
+    }
+
+
+  // Inputs like the real ones
+  vector<double> in(MATHBENCHCOUNT);
+  vector<double> in2(MATHBENCHCOUNT);
+  vector<double> out(MATHBENCHCOUNT);
+  vector<double> out2(MATHBENCHCOUNT);
+  double libm, fast, array;
+  double sink = 0.0;
+  int    i;
+
+  srand(1);
+
+  cout<<endl<<"Speed, per call"<<endl;
+
+  for (i = 0; i < MATHBENCHCOUNT; i++)
+    {
+      in[i] = (rand() / (double)RAND_MAX) * 20.0 - 10.0;
+    }
+
+  TIMELOOP(libm, for (i = 0; i < MATHBENCHCOUNT; i++)
+	   out[i] = exp(in[i]));
+  TIMELOOP(fast, for (i = 0; i < MATHBENCHCOUNT; i++)
+	   out[i] = fastExp(in[i]));
+  TIMELOOP(array, fastExpArray(&in[0], &out[0], MATHBENCHCOUNT));
+  sink += out[MATHBENCHCOUNT / 2];
+  printSpeed("exp", libm, fast, array);
+
+  TIMELOOP(libm, for (i = 0; i < MATHBENCHCOUNT; i++)
+	   out[i] = 1.0 / (1.0 + exp(-in[i])));
+  TIMELOOP(fast, for (i = 0; i < MATHBENCHCOUNT; i++)
+	   out[i] = fastSigmoid(in[i]));
+  TIMELOOP(array, fastSigmoidArray(&in[0], &out[0], MATHBENCHCOUNT));
+  sink += out[MATHBENCHCOUNT / 2];
+  printSpeed("sigmoid", libm, fast, array);
+
+  for (i = 0; i < MATHBENCHCOUNT; i++)
+    {
+      in[i] = (rand() / (double)RAND_MAX) * 2.0 - 1.0;
+    }
+
+  TIMELOOP(libm, for (i = 0; i < MATHBENCHCOUNT; i++)
+	   out[i] = acos(in[i]));
+  TIMELOOP(fast, for (i = 0; i < MATHBENCHCOUNT; i++)
+	   out[i] = fastAcos(in[i]));
+  TIMELOOP(array, fastAcosArray(&in[0], &out[0], MATHBENCHCOUNT));
+  sink += out[MATHBENCHCOUNT / 2];
+  printSpeed("acos", libm, fast, array);
+
+  for (i = 0; i < MATHBENCHCOUNT; i++)
+    {
+      in2[i] = (rand() / (double)RAND_MAX) * 2.0 - 1.0;
+    }
+
+  TIMELOOP(libm, for (i = 0; i < MATHBENCHCOUNT; i++)
+	   out[i] = atan2(in[i], in2[i]));
+  TIMELOOP(fast, for (i = 0; i < MATHBENCHCOUNT; i++)
+	   out[i] = fastAtan2(in[i], in2[i]));
+  TIMELOOP(array, fastAtan2Array(&in[0], &in2[0], &out[0], MATHBENCHCOUNT));
+  sink += out[MATHBENCHCOUNT / 2];
+  printSpeed("atan2", libm, fast, array);
+
+  for (i = 0; i < MATHBENCHCOUNT; i++)
+    {
+      in[i] = (rand() / (double)RAND_MAX) * 4 * FASTMATH_PI - 2 * FASTMATH_PI;
+    }
+
+  TIMELOOP(libm, for (i = 0; i < MATHBENCHCOUNT; i++)
+	   { out[i] = sin(in[i]); out2[i] = cos(in[i]); });
+  TIMELOOP(fast, for (i = 0; i < MATHBENCHCOUNT; i++)
+	   fastSinCos(in[i], out[i], out2[i]));
+  TIMELOOP(array, fastSinCosArray(&in[0], &out[0], &out2[0], MATHBENCHCOUNT));
+  sink += out[MATHBENCHCOUNT / 2] + out2[MATHBENCHCOUNT / 2];
+  printSpeed("sincos", libm, fast, array);
+
+  // Keeps the compiler from dropping
+  // the timed work
+  if (sink == 12345.6789)
+    {
+      cout<<sink<<endl;
+    }
+
+  if (!passed)
+    {
+      cout<<endl<<"Accuracy check FAILED"<<endl;
+      return 1;
+    }
+
+  cout<<endl<<"Accuracy check passed"<<endl;
+  return 0;
+}
@@ -421,12 +421,33 @@ void NeuralNetwork::DumpData(string filename)
 // Call this with the name of a saved Neural
 // net instead of calling initialize
 void NeuralNetwork::ReadData(string filename)
+{
+  if (!LoadData(filename))
+    {
+      exit(1);
+    }
+}
+
+
+
+// ReadData without the exit, for loading a
+// brain while another one is flying. Says
+// what's wrong and returns false if the file
+// isn't a whole brain, leaving the net empty
+// (nothing to CleanUp).
+bool NeuralNetwork::LoadData(string filename)
 {
   int i, j;
   int readI, readJ;
 
   ifstream brainFile(filename.c_str(), ios::in);
 
+  if (!brainFile)
+    {
+      cout<<"Error, can't open brainfile "<<filename<<endl;
+      return false;
+    }
+
   brainFile>>InputLayer.NumberOfNodes;
   brainFile>>HiddenLayer.NumberOfNodes;
   brainFile>>OutputLayer.NumberOfNodes;
@@ -434,6 +455,16 @@ void NeuralNetwork::ReadData(string filename)
 //   cout<<"Read in nodes: ("<<InputLayer.NumberOfNodes<<", "
 //       <<HiddenLayer.NumberOfNodes<<", "
 //       <<OutputLayer.NumberOfNodes<<")"<<endl;
+
+  // Before allocating anything off them
+  if (brainFile.fail() ||
+      (InputLayer.NumberOfNodes  < 1) || (InputLayer.NumberOfNodes  > 10000) ||
+      (HiddenLayer.NumberOfNodes < 1) || (HiddenLayer.NumberOfNodes > 10000) ||
+      (OutputLayer.NumberOfNodes < 1) || (OutputLayer.NumberOfNodes > 10000))
+    {
+      cout<<"Error, bad brainfile in readData 0!"<<endl;
+      return false;
+    }
   
   InputLayer.NumberOfChildNodes  = HiddenLayer.NumberOfNodes;
   InputLayer.NumberOfParentNodes = 0;
@@ -464,8 +495,8 @@ void NeuralNetwork::ReadData(string filename)
 	  if ((readI != i) || (readJ != j))
 	    {
 	      cout<<"Error, bad brainfile in readData 1!"<<endl;
-	      brainFile.close();
-	      exit(1);
+	      CleanUp();
+	      return false;
 	    }
 	  brainFile>>InputLayer.Weights[i][j];
 	}
@@ -477,8 +508,8 @@ void NeuralNetwork::ReadData(string filename)
       if (readI != i)
 	{
 	  cout<<"Error, bad brainfile in readData 2!"<<endl;
-	  brainFile.close();
-	  exit(1);
+	  CleanUp();
+	  return false;
 	}
       brainFile>>InputLayer.BiasWeights[i];
     }
@@ -492,8 +523,8 @@ void NeuralNetwork::ReadData(string filename)
 	  if ((readI != i) || (readJ != j))
 	    {
 	      cout<<"Error, bad brainfile in readData 3!"<<endl;
-	      brainFile.close();
-	      exit(1);
+	      CleanUp();
+	      return false;
 	    }
 	  brainFile>>HiddenLayer.Weights[i][j];
 	}
@@ -506,8 +537,8 @@ void NeuralNetwork::ReadData(string filename)
 	{
 	  cout<<"Error, bad brainfile in readData 4!"<<endl;
 	  cout<<"ReadI is: "<<readI<<" and i is: "<<i<<endl;
-	  brainFile.close();
-	  exit(1);
+	  CleanUp();
+	  return false;
 	}
       brainFile>>HiddenLayer.BiasWeights[i];
     }
@@ -518,11 +549,20 @@ void NeuralNetwork::ReadData(string filename)
       if (readI != i)
 	{
 	  cout<<"Error, bad brainfile in readData 5!"<<endl;
-	  brainFile.close();
-	  exit(1);
+	  CleanUp();
+	  return false;
 	}
       brainFile>>OutputLayer.NeuronValues[i];
     }
 
+  // Cut off part way through a number
+  if (brainFile.fail())
+    {
+      cout<<"Error, brainfile "<<filename<<" is truncated!"<<endl;
+      CleanUp();
+      return false;
+    }
+
   brainFile.close();
+  return true;
 }
@@ -69,6 +69,7 @@ public:
 	void	SetMomentum(bool useMomentum, double factor);
 	void	DumpData(string filename);
 	void    ReadData(string filename);
+	bool    LoadData(string filename);
 };
 
 #endif   // NEURALNET_H
@@ -18,6 +18,9 @@ using namespace std;
 #include "neuralNet.h"
 #include "pilot.h"
 #include "speech.h"
+#include "eyeEncoder.h"
+#include "seekerEncoding.h"
+#include "fastMath.h"
 
 
 #define ROLLCUTOFF 5.0
@@ -52,6 +55,7 @@ Pilot::Pilot()
   goalData.holdPitch 	  = 0;
   goalData.holdRoll 	  = 0;
   goalData.holdAirSpeed   = 0;
+  goalData.holdAltitude   = 0;
 
   flightControls.elevator = 0;
   flightControls.aileron  = 0;
@@ -60,6 +64,17 @@ Pilot::Pilot()
 
   targetSeekerBrain = "./targetSeekerNeuralNet";
   trgtSeekNet = new TargetSeeker(5.0, 5.0, targetSeekerBrain);
+
+  seekerController.setTargetSeeker(trgtSeekNet);
+
+  for (int i = 0; i < endList; i++)
+    {
+      controllers[i] = NULL;
+    }
+
+  controllers[TargetSeekMode]   = &seekerController;
+  controllers[AttitudeHoldMode] = &attitudeController;
+  controllers[TakeOffMode]      = &takeOffController;
 }
 
 
@@ -91,6 +106,7 @@ void Pilot::setPositionGeo(double lat, double lon, double alt,
 void Pilot::setAirspeed(double newAirspeed)
 {
   positionData.airSpeed = newAirspeed;
+  trgtSeekNet->setAirspeed(newAirspeed);
 }
 
 
@@ -127,110 +143,61 @@ void Pilot::setHoldAirspeed(double airspeed)
 
 
 
-void Pilot::getControlPositions(double &elevator, double &aileron, 
-				double &rudder, double &throttle)
+void Pilot::setHoldAltitude(double altitude)
 {
-  elevator = flightControls.elevator;
-  aileron  = flightControls.aileron;
-  rudder   = flightControls.rudder;
-  throttle = flightControls.throttle;
+  goalData.holdAltitude = altitude;
 }
 
 
 
-void Pilot::setControlPositions(double elevator, double aileron, 
-			 double rudder, double throttle)
+void Pilot::enableHeadingHold(bool on)
 {
-  flightControls.elevator = elevator;
-  flightControls.aileron  = aileron;
-  flightControls.rudder   = rudder;
-  flightControls.throttle = throttle;
+  attitudeController.enableHeadingHold(on);
 }
 
 
-
-
-void Pilot::setSmoothedControlPositions(double elevator, double aileron, 
-					double rudder, double throttle)
+void Pilot::enableAltitudeHold(bool on)
 {
-  static const int meanPositions = 15;
-  static bool      initialized   = false;
-  static int       headIndex = 0;
+  attitudeController.enableAltitudeHold(on);
+}
 
-  static double elevators[meanPositions];
-  static double ailerons [meanPositions];
-  static double rudders  [meanPositions];
-  static double throttles[meanPositions];
-  
-  static double smoothedElevator = 0.0;
-  static double smoothedAileron  = 0.0;
-  static double smoothedRudder   = 0.0;
-  static double smoothedThrottle = 0.0;
 
-  static double summedElevator;
-  static double summedAileron;
-  static double summedRudder;
-  static double summedThrottle;
 
-  int counter = 0;
+void Pilot::setRotateSpeed(double knots)
+{
+  takeOffController.setRotateSpeed(knots);
+}
 
 
-  summedElevator = 0.0;
-  summedAileron  = 0.0;
-  summedRudder   = 0.0;
-  summedThrottle = 0.0;
 
-  if (!initialized)
+void Pilot::setControllerRate(FlyingMode mode, double hertz)
+{
+  if ((mode >= 1) && (mode < endList) && controllers[mode])
     {
-      for (int i = 0; i < meanPositions; i++)
-	{
-	  elevators[i] = 0.0;
-	  ailerons [i] = 0.0;
-	  rudders  [i] = 0.0;
-	  throttles[i] = 0.0;
-	}
-
-      initialized = true;
+      controllers[mode]->setRate(hertz);
     }
+}
 
-  elevators[headIndex] = elevator;
-  ailerons [headIndex] = aileron; 
-  rudders  [headIndex] = rudder;
-  throttles[headIndex] = throttle;
-  
-  counter = headIndex;
 
-  for (int i = 0; i < meanPositions; i++)
-    {
-      summedElevator += elevators[counter];
-      summedAileron  += ailerons [counter];
-      summedRudder   += rudders  [counter];
-      summedThrottle += throttles[counter];
-
-      counter--;
-      
-      if (counter < 0)
-	{
-	  counter = meanPositions;
-	}
-    }
 
-  smoothedElevator = summedElevator/(double)meanPositions;
-  smoothedAileron  = summedAileron /(double)meanPositions;
-  smoothedRudder   = summedRudder  /(double)meanPositions;
-  smoothedThrottle = summedThrottle/(double)meanPositions;
+void Pilot::getControlPositions(double &elevator, double &aileron, 
+				double &rudder, double &throttle)
+{
+  elevator = flightControls.elevator;
+  aileron  = flightControls.aileron;
+  rudder   = flightControls.rudder;
+  throttle = flightControls.throttle;
+}
 
-  flightControls.elevator = smoothedElevator;
-  flightControls.aileron  = smoothedAileron;
-  flightControls.rudder   = smoothedRudder;
-  flightControls.throttle = smoothedThrottle;
-  
-  headIndex++;
 
-  if (headIndex > meanPositions)
-    {
-      headIndex = 0;
-    }
+
+void Pilot::setControlPositions(double elevator, double aileron, 
+			 double rudder, double throttle)
+{
+  flightControls.elevator = elevator;
+  flightControls.aileron  = aileron;
+  flightControls.rudder   = rudder;
+  flightControls.throttle = throttle;
 }
 
 
@@ -262,6 +229,19 @@ float Pilot::getTargetSeekerVertBoundary() const
 
 
 
+string Pilot::getTargetSeekerBrainFile() const
+{
+  return targetSeekerBrain;
+}
+
+
+void Pilot::offerTargetSeekerBrain(seekerBrain *newBrain)
+{
+  trgtSeekNet->offerBrain(newBrain);
+}
+
+
+
 void Pilot::setPilotMode(FlyingMode newMode)
 {
   if ((newMode < 1 ) || (newMode >= endList))
@@ -272,6 +252,13 @@ void Pilot::setPilotMode(FlyingMode newMode)
     }
   else
     {
+      // A controller starts afresh every
+      // time it's switched to
+      if ((newMode != currentMode) && controllers[newMode])
+	{
+	  controllers[newMode]->reset();
+	}
+
       currentMode = newMode;
     }
 }
@@ -280,178 +267,87 @@ void Pilot::setPilotMode(FlyingMode newMode)
 
 
 
-void Pilot::update()
+void Pilot::holdAttitude()
 {
-  static float  targetBearing      = 0.0;
-  static float  targetElevation    = 0.0;
-  static float  sideAngleBoundary  = 0.0;
-  static float  vertAngleBoundary  = 0.0;
+  setHoldAttitude(positionData.heading, 0.0, 0.0);
+  setHoldAltitude(positionData.alt);
 
-  static double tempElevator       = 0.0;
-  static double tempAileron        = 0.0;
-  static double tempRudder         = 0.0;
+  enableHeadingHold(true);
+  enableAltitudeHold(true);
 
-  switch(currentMode)
-    {
-    case TargetSeekMode:
-      trgtSeekNet->setAircraftPosition(positionData.lat, positionData.lon,
-				       positionData.alt, positionData.heading,
-				       positionData.pitch, positionData.roll);
-      trgtSeekNet->calculateNewTargetBearingElevationDist();
-      trgtSeekNet->getAircraftControls(tempElevator, 
-				       tempAileron,
-				       tempRudder);
-      setSmoothedControlPositions(tempElevator, tempAileron,
-				  tempRudder, 1.0);
-      break;
-
-    case AttitudeHoldMode:
-      cout<<"In Pilot::update, in AttitudeHoldMode"<<endl;
-      holdAttitude();
-      
-      break;
-
-    case TakeOffMode:
-      cout<<"In Pilot::update, in TakeOffMode"<<endl;
-      takeoffAircraft();
-      break;
-
-    case SitStillMode:
-      
-      break;
-      
-    default:
-      cout<<"Pilot::update(), invalid currentMode: "<<currentMode<<endl;
-    }
+  setPilotMode(AttitudeHoldMode);
 }
 
 
 
+void Pilot::saveState(pilotCheckpoint &saved) const
+{
+  saved.mode     = currentMode;
+  saved.goal     = goalData;
+  saved.controls = flightControls;
 
-/*********************************************************
-
-Private functions
+  trgtSeekNet->getTargetPosition(saved.seekerTarget[0],
+				 saved.seekerTarget[1],
+				 saved.seekerTarget[2]);
+  seekerController.getSmoothing(saved.smoothing);
+}
 
-*********************************************************/
 
 
-void Pilot::takeoffAircraft()
+// The controller's switched to first, that
+// resets it, then its smoothing put back
+void Pilot::restoreState(const pilotCheckpoint &saved)
 {
-  // Constants to strive for...
-  static const float takeOffSpeed =  175.0;
-  static const float wowCutoff    =    3.0;
-  static const float targetPitch  =   30.0;
-  static const float targetRoll   =    0.0;
+  setPilotMode(saved.mode);
 
+  goalData       = saved.goal;
+  flightControls = saved.controls;
+
+  trgtSeekNet->setTargetPosition(saved.seekerTarget[0],
+				 saved.seekerTarget[1],
+				 saved.seekerTarget[2]);
+  seekerController.setSmoothing(saved.smoothing);
+}
 
-  static double targetHeading  = 0.0;
-  static bool   initialized    = false;
 
-  // This should be a valid initial heading down the runway
-  // Need the heading down the runway so we don't go 
-  // off the side of the runway
-  if ((!initialized) && (positionData.heading != 0.0) && 
-      (positionData.airSpeed != 0.0))
-    {
-      initialized   = true;
-      targetHeading = positionData.heading;
-    }
 
-  // Steer rudder left and right to 
-  // keep us straight
-  if ((targetHeading - positionData.heading) > 0.0)
-    {
-      flightControls.rudder = 0.05;
-    }
-  else if ((targetHeading - positionData.heading) < 0.0)
-    {
-      flightControls.rudder = -0.05;
-    }
-  else
-    {
-      flightControls.rudder = 0.0;
-    }
 
 
-  // Time to lift off, set an attitude to hold, and let the 
-  // attitudeHoldMode handle it...
-  if (positionData.airSpeed >= takeOffSpeed)
+void Pilot::updateGuidance()
+{
+  if (currentMode == TargetSeekMode)
     {
-      // Time to liftoff...
-      setHoldAttitude(targetHeading, targetPitch, targetRoll);
-      setPilotMode(AttitudeHoldMode);
-      sayOutloud(true, "liftoff, aircraft is airborne");
+      seekerController.think(positionData);
     }
-
-  // Peg the throttles for takeoff!
-  flightControls.throttle = 1.0;
 }
 
 
 
 
 
-
-
-void Pilot::holdAttitude()
+void Pilot::update(double time)
 {
-//   static const double pitchDiffScaling = 0.1;         // 10 degrees..
-//   static const double rollDiffScaling  = 0.066666667; // 15 degrees...  
-
-  static const double pitchDiffScaling = 0.2;         // 5 degrees..
-  static const double rollDiffScaling  = 0.066666667; // 15 degrees...  
+  FlightController *controller = controllers[currentMode];
+  FlyingMode        nextMode;
 
-  static double pitchDiff = 0.0;
-  static double rollDiff  = 0.0;
-  
-  pitchDiff = (positionData.pitch - goalData.holdPitch) 
-    * pitchDiffScaling;
-
-  rollDiff  = (positionData.roll - goalData.holdRoll) 
-    * rollDiffScaling;
-
-
-  if (pitchDiff > 1.0)
-    {
-      pitchDiff = 1.0;
-    }
-  else if (pitchDiff < -1.0)
+  // Sitting still
+  if (controller == NULL)
     {
-      pitchDiff = -1.0;
+      return;
     }
 
+  nextMode = controller->run(time, positionData, goalData, flightControls);
 
-  // If the roll is this extreme,
-  // ignore pitch for the moment,
-  // level the wings first. This 
-  // way the heading doesn't
-  // get too out of whack
-  if (rollDiff > 1.0)
+  // Takeoff hands over to attitude hold
+  if (nextMode != currentMode)
     {
-      pitchDiff = 0.0;
-      rollDiff = 1.0;
+      setPilotMode(nextMode);
     }
-  else if (rollDiff < -1.0)
-    {
-      pitchDiff = 0.0;
-      rollDiff = -1.0;
-    }
-  setControlPositions(pitchDiff, -rollDiff, 0.0, 1.0);
 }
 
 
 
 
-
-
-
-
-
-
-
-
-
-
 /******************************************************/
 // Target seeker class, for utilizing
 // a neural network
@@ -484,8 +380,19 @@ TargetSeeker::TargetSeeker(float sideAngleBoundary,
   ellipsoid = new gvpEllipsoid;
   ellipsoid->set(ellipsoid->WGS84);
   
-  targetNet = new NeuralNetwork;
-  targetNet->ReadData(netFileName);
+  airspeed         = 0.0;
+  rangeRate        = 0.0;
+  lastDistance     = 0.0;
+  lastDistanceTime = 0.0;
+  haveLastDistance = false;
+
+  if ((brain = loadBrain(netFileName)) == NULL)
+    {
+      exit(1);
+    }
+
+  cout<<"TargetSeeker using "<<encodingName(brain->encoding)
+      <<" inputs from "<<netFileName<<endl;
 }
 
 
@@ -494,7 +401,7 @@ TargetSeeker::~TargetSeeker()
 {
   delete ellipsoid;
   delete entityStore;
-  delete targetNet;
+  delete brain;
 }
 
 
@@ -530,6 +437,67 @@ void TargetSeeker::setAircraftPosition(double newLat, double newLon,
 
 
 
+void TargetSeeker::setAirspeed(double newAirspeed)
+{
+  airspeed = newAirspeed;
+}
+
+
+
+SeekerEncoding TargetSeeker::getEncoding() const
+{
+  return brain->encoding;
+}
+
+
+
+seekerBrain* TargetSeeker::loadBrain(string netFileName)
+{
+  seekerBrain *newBrain = new seekerBrain;
+
+  if (!(newBrain->loaded = newBrain->net.LoadData(netFileName)))
+    {
+      delete newBrain;
+      return NULL;
+    }
+
+  // The number of inputs says how the
+  // brain wants to see the target
+  newBrain->encoding =
+    encodingForInputs(newBrain->net.InputLayer.NumberOfNodes);
+
+  if ((newBrain->encoding == UnknownEncoding) ||
+      (newBrain->net.OutputLayer.NumberOfNodes != STICK_OUTPUTS))
+    {
+      cout<<"Error, "<<netFileName<<" has "
+	  <<newBrain->net.InputLayer.NumberOfNodes<<" inputs and "
+	  <<newBrain->net.OutputLayer.NumberOfNodes
+	  <<" outputs, not a TargetSeeker brain!"<<endl;
+      delete newBrain;
+      return NULL;
+    }
+
+  // Done here, on whichever thread is
+  // loading it, not while flying
+  if ((newBrain->compiled = compileBrain(newBrain->net, newBrain->encoding,
+					 newBrain->table)))
+    {
+      cout<<netFileName<<" compiled to a "<<EYE_STATES
+	  <<" entry table"<<endl;
+    }
+
+  return newBrain;
+}
+
+
+
+void TargetSeeker::offerBrain(seekerBrain *newBrain)
+{
+  brainUpdates.publish(newBrain);
+}
+
+
+
 void TargetSeeker::setSideAngleBoundary(float newSideAngleBoundary)
 {
   sideBoundary = newSideAngleBoundary;
@@ -572,6 +540,12 @@ float TargetSeeker::getTargetDistance() const
 }
 
 
+float TargetSeeker::getTargetRangeRate() const
+{
+  return rangeRate;
+}
+
+
 void TargetSeeker::calculateNewTargetBearingElevationDist()
 {
   static double qx = 0.0, qy = 0.0,qz = 0.0, qw = 0.0;;
@@ -614,14 +588,24 @@ void TargetSeeker::calculateNewTargetBearingElevationDist()
 
   toTarget = targetPosition - shipPosition;
   targetDistance = toTarget.magnitude();
+
+  // Closing (negative) or opening speed, from
+  // the change since the last calculation
+  if (haveLastDistance && (time > lastDistanceTime))
+    {
+      rangeRate = (targetDistance - lastDistance) / (time - lastDistanceTime);
+    }
+  lastDistance     = targetDistance;
+  lastDistanceTime = time;
+  haveLastDistance = true;
  
   horizTrgtVector.normalize();
   vertTrgtVector.normalize();
   straightAhead.normalize();
   
-  trgtBearing    = acos(straightAhead.dot(horizTrgtVector));
+  trgtBearing    = fastAcos(straightAhead.dot(horizTrgtVector));
   trgtBearing   *= RAD2DEG;
-  trgtElevation  = acos(straightAhead.dot(vertTrgtVector));
+  trgtElevation  = fastAcos(straightAhead.dot(vertTrgtVector));
   trgtElevation *= RAD2DEG;
 }
 
@@ -636,168 +620,89 @@ void TargetSeeker::getAircraftControls(double &elevator, double &aileron,
   static double elevatorMultiplier = 0.0;
   static double aileronMultiplier  = 0.0;
 
-  onSide   = false;
-  onLeft   = false;
-  onRight  = false;
-  onVert   = false;
-  onTop    = false;
-  onBottom = false;
- 
-  
+  eyeSample        sample;
+  eyeBoundaries    boundaries;
+  continuousSample sensors;
+
   // Must call this explicitely prior to 
   // calling getAircraftcontrols...
   // calculateNewTargetBearingElevationDist();
 
-
-  if ((fabs(trgtBearing)) >= sideBoundary)
+  // Pick up a reloaded brain, if there is one
+  if (brainUpdates.swapIn(brain))
     {
-      onSide = true;
-
-      if (relativeTrgtX <= 0.0)
-	{
-	  onLeft = true;
-	}
-      else
-	{
-	  onRight = true;
-	}
+      cout<<"TargetSeeker now flying a new "<<encodingName(brain->encoding)
+	  <<" brain"<<endl;
     }
-  else
+
+  if (brain->encoding == EyeEncoding)
     {
-      onSide = false;
+      sample.bearing    = trgtBearing;
+      sample.elevation  = trgtElevation;
+      sample.relativeX  = relativeTrgtX;
+      sample.relativeZ  = relativeTrgtZ;
+      sample.roll       = roll;
+
+      boundaries.side     = sideBoundary;
+      boundaries.vertical = vertBoundary;
+      boundaries.roll     = ROLLCUTOFF;
     }
 
-  if ((fabs(trgtElevation)) >= vertBoundary)
+  // A compiled brain already knows
+  // its answer for what it sees
+  if (brain->compiled)
     {
-      onVert = true;
+      const double *outputs = brain->table.outputs[eyeState(sample, 
+							     boundaries)];
 
-      if (relativeTrgtZ <= 0.0)
-	{
-	  onBottom = true;
-	}
-      else
-	{
-	  onTop = true;
-	}
+      pullBack    = outputs[0];
+      pushForward = outputs[1];
+      rollRight   = outputs[2];
+      rollLeft    = outputs[3];
     }
   else
     {
-      onVert = false;
-    }
-  
-  // Initialize values...
-  centerEye     = -1.0;
-  upperEye      = -1.0;
-  upperRightEye = -1.0;
-  rightEye      = -1.0;
-  lowerRightEye = -1.0;
-  lowerEye      = -1.0;
-  lowerLeftEye  = -1.0;
-  leftEye       = -1.0;
-  upperLeftEye  = -1.0;
-
-  rolledRight   = -1.0;
-  rolledLeft    = -1.0;
-
-
-  cout<<endl<<"*************************************************"<<endl;
-  // Set "eye" activation levels
-  if(onLeft && onTop)
-    {
-      cout<<"*XX"<<endl<<"XXX"<<endl<<"XXX"<<endl<<endl;
-      upperLeftEye = 1.0;
-    }
-  else
-    if(!onSide && onTop)
-      {
-	cout<<"X*X"<<endl<<"XXX"<<endl<<"XXX"<<endl<<endl;
-	upperEye = 1.0;
-      }
-    else
-      if(onRight && onTop)
+      // The inputs go straight into the net's
+      // input layer (the same as SetInput() 
+      // on each of them)
+      if (brain->encoding == EyeEncoding)
 	{
-	  cout<<"XX*"<<endl<<"XXX"<<endl<<"XXX"<<endl<<endl;
-	  upperRightEye = 1.0;
+	  // Set "eye" activation levels and the roll flags
+	  encodeEyes(sample, boundaries, brain->net.InputLayer.NeuronValues);
 	}
       else
-	if(!onVert && onLeft)
-	  {
-	    cout<<"XXX"<<endl<<"*XX"<<endl<<"XXX"<<endl<<endl;
-	    leftEye = 1.0;
-	  }
-	else
-	  if(!onVert && !onSide)
-	    {
-	      cout<<"XXX"<<endl<<"X*X"<<endl<<"XXX"<<endl<<endl;
-	      centerEye = 1.0;
-	    }
-	  else
-	    if (!onVert && onRight)
-	      {
-		cout<<"XXX"<<endl<<"XX*"<<endl<<"XXX"<<endl<<endl;
-		rightEye = 1.0;
-	      }
-	    else
-	      if (onBottom && onLeft)
-		{
-		  cout<<"XXX"<<endl<<"XXX"<<endl<<"*XX"<<endl<<endl;
-		  lowerLeftEye = 1.0;
-		}
-	      else
-		if (!onSide && onBottom)
-		  {
-		    cout<<"XXX"<<endl<<"XXX"<<endl<<"X*X"<<endl<<endl;
-		    lowerEye = 1.0;
-		  }
-		else
-		  if (onRight && onBottom)
-		    {
-		      cout<<"XXX"<<endl<<"XXX"<<endl<<"XX*"<<endl;
-		      lowerRightEye = 1.0;
-		    }
-		  else
-		    {
-		      cout<<"Error, invalid eye activation!"<<endl;
-		      exit(1);
-		    }
-
-  if (roll >= ROLLCUTOFF)
-    {
-      rolledRight = 1.0;
-    }
-  else if (roll <= -ROLLCUTOFF)
-    {
-      rolledLeft = 1.0;
-    }
-  
-  cout<<"*************************************************"<<endl<<endl;
-
-
-  // Data is ready for input
-  // run neural net here....
-  targetNet->SetInput(0,  centerEye);
-  targetNet->SetInput(1,  upperEye);
-  targetNet->SetInput(2,  upperRightEye);
-  targetNet->SetInput(3,  rightEye);
-  targetNet->SetInput(4,  lowerRightEye);
-  targetNet->SetInput(5,  lowerEye);
-  targetNet->SetInput(6,  lowerLeftEye);
-  targetNet->SetInput(7,  leftEye);
-  targetNet->SetInput(8,  upperLeftEye);
-
-  targetNet->SetInput(9,  rolledRight);
-  targetNet->SetInput(10, rolledLeft);
+	{
+	  sensors.bearing   = trgtBearing;
+	  sensors.elevation = trgtElevation;
+	  sensors.relativeX = relativeTrgtX;
+	  sensors.relativeZ = relativeTrgtZ;
+	  sensors.roll      = roll;
+	  sensors.pitch     = pitch;
+	  sensors.rangeRate = rangeRate;
+	  sensors.airspeed  = airspeed;
+
+	  encodeContinuous(sensors, 
+			   (brain->encoding == ContinuousAirspeedEncoding),
+			   brain->net.InputLayer.NeuronValues);
+	}
   
-  targetNet->FeedForward();
+      brain->net.FeedForward();
   
-  pullBack    = targetNet->GetOutput(0);
-  pushForward = targetNet->GetOutput(1);
-  rollRight   = targetNet->GetOutput(2);
-  rollLeft    = targetNet->GetOutput(3);
+      pullBack    = brain->net.GetOutput(0);
+      pushForward = brain->net.GetOutput(1);
+      rollRight   = brain->net.GetOutput(2);
+      rollLeft    = brain->net.GetOutput(3);
+    }
  
 
   // Set the multipliers for smoother flight...
-  if (fabs(trgtElevation) >= 30.0)
+  // A continuous brain already knows how far
+  // off the target is, and answers in proportion
+  if (brain->encoding != EyeEncoding)
+    {
+      elevatorMultiplier = 1.0;
+    }
+  else if (fabs(trgtElevation) >= 30.0)
     {
       elevatorMultiplier = 1.0;
     }
@@ -810,7 +715,11 @@ void TargetSeeker::getAircraftControls(double &elevator, double &aileron,
       elevatorMultiplier = 0.3;
     }
 
-  if (fabs(trgtBearing) >= 30.0)
+  if (brain->encoding != EyeEncoding)
+    {
+      aileronMultiplier = 1.0;
+    }
+  else if (fabs(trgtBearing) >= 30.0)
     {
       aileronMultiplier = 1.0;
     }
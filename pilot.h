@@ -25,6 +25,10 @@
 
 
 #include "neuralNet.h"
+#include "seekerEncoding.h"
+#include "brainTable.h"
+#include "hotReload.h"
+#include "flightController.h"
 
 #include "gvpApiClient.hpp"
 #include "gvpTimer.hpp"
@@ -37,57 +41,39 @@
 
 
 
-enum FlyingMode
-  {
-    TargetSeekMode = 1,
-    AttitudeHoldMode,
-    TakeOffMode,
-    SitStillMode,
-    endList
-  };
-
-
-
+// Defined further down
+class TargetSeeker;
 
-// basic position information,
-// attitude, and speed information
-struct posStruct
-{
-  double lat;
-  double lon;
-  double alt;
-  double radAlt;
-  double heading;
-  double pitch;
-  double roll;  
-  double airSpeed;
-};
 
 
-struct desiredState
+// A TargetSeeker brain, and how it wants to
+// see the target. Swapped in as one when a
+// new brain is loaded while flying.
+struct seekerBrain
 {
-  // For target seeking mode
-  double targetLat;
-  double targetLon;
-  double targetAlt;
-  
-  // For attitude hold mode
-  double holdHeading;
-  double holdPitch;
-  double holdRoll;
-  double holdAirSpeed;
-};
-
+  NeuralNetwork  net;
+  SeekerEncoding encoding;
+  bool           loaded;
 
+  // Every answer an eye brain can give,
+  // flown instead of the net if compiled
+  brainTable     table;
+  bool           compiled;
 
+  seekerBrain()
+  {
+    encoding = UnknownEncoding;
+    loaded   = false;
+    compiled = false;
+  }
 
-// basic flight control info
-struct controlsStruct
-{
-  double elevator;
-  double aileron;
-  double rudder;
-  double throttle;
+  ~seekerBrain()
+  {
+    if (loaded)
+      {
+	net.CleanUp();
+      }
+  }
 };
 
 
@@ -95,10 +81,16 @@ struct controlsStruct
 
 
 
-// Defined further down
-class TargetSeeker;
-
-
+// What the Pilot was doing, for
+// picking up after a restart
+struct pilotCheckpoint
+{
+  FlyingMode      mode;
+  desiredState    goal;
+  controlsStruct  controls;
+  double          seekerTarget[3];  // lat, lon, alt
+  seekerSmoothing smoothing;
+};
 
 
 
@@ -130,15 +122,29 @@ class Pilot
   // The desired airspeed
   void setHoldAirspeed(double airspeed);
 
+  // And altitude, in meters, only
+  // held with altitude hold on
+  void setHoldAltitude(double altitude);
+
+  // Have the attitude hold steer to the hold
+  // heading / climb or descend to the hold
+  // altitude rather than hold roll / pitch
+  void enableHeadingHold(bool on);
+  void enableAltitudeHold(bool on);
+
+  // Speed the takeoff rotates at, in knots
+  void setRotateSpeed(double knots);
+
+  // How many times a second a mode's controller
+  // runs, 0 is every update. The controls stay
+  // put in between.
+  void setControllerRate(FlyingMode mode, double hertz);
+
   // Needed for Ucav to control the flightmodel
   void getControlPositions(double &elevator, double &aileron, 
 			   double &rudder, double &throttle);
   void setControlPositions(double elevator, double aileron, 
 			   double rudder, double throttle);
-  // Averages the positions over time to "smooth" the
-  // control of the aircraft
-  void setSmoothedControlPositions(double elevator, double aileron, 
-				   double rudder, double throttle);
 
   // Interface functions for accessing the 
   // Pilot's targetSeeker neural net system
@@ -147,14 +153,36 @@ class Pilot
   void  setTargetSeekerVertBoundary(float newVertAngleBoundary);
   float getTargetSeekerVertBoundary() const;
 
+  // The TargetSeeker's brain file, and a new
+  // brain loaded from it (see hotReload.h)
+  string getTargetSeekerBrainFile() const;
+  void   offerTargetSeekerBrain(seekerBrain *newBrain);
+
   
   // Set the mode of the pilot object
   void setPilotMode(FlyingMode newMode);
 
+  // Fly straight and level on the heading
+  // and at the altitude it's at now, in
+  // AttitudeHoldMode. Cheap, for when
+  // there's no time for the net.
+  void holdAttitude();
+
+
+  // The TargetSeeker's net picks a new command,
+  // only does anything in TargetSeekMode. Can
+  // be run less often than update().
+  void updateGuidance();
 
   // Update the pilot, execute the current mode
-  // and calculate new control positions
-  void update();
+  // and calculate new control positions. Time
+  // is seconds on CLOCK_MONOTONIC.
+  void update(double time);
+
+  // The mode, goals, controls and smoothing,
+  // see utils/checkpoint.h
+  void saveState(pilotCheckpoint &saved) const;
+  void restoreState(const pilotCheckpoint &saved);
 
 
   
@@ -168,8 +196,12 @@ class Pilot
   controlsStruct flightControls;
   string         targetSeekerBrain;
 
-  void takeoffAircraft();
-  void holdAttitude();
+  // One controller for each FlyingMode,
+  // NULL for SitStillMode
+  TakeOffController      takeOffController;
+  AttitudeHoldController attitudeController;
+  SeekerController       seekerController;
+  FlightController      *controllers[endList];
 };
 
 
@@ -213,6 +245,24 @@ class TargetSeeker
   void setAircraftPosition(double newLat, double newLon, 
 			   double newAlt, double newHeading, 
 			   double newPitch, double newRoll);
+
+  // Only used by brains with the
+  // airspeed input, in knots
+  void setAirspeed(double newAirspeed);
+
+  // How the brain sees the target, worked
+  // out from its number of inputs
+  SeekerEncoding getEncoding() const;
+
+  // Read and check a brain file without
+  // touching the one flying. NULL (after
+  // saying why) if it's no good.
+  static seekerBrain* loadBrain(string netFileName);
+
+  // Hand over a brain from loadBrain(), from
+  // any thread. It takes over on the next
+  // call to getAircraftControls().
+  void offerBrain(seekerBrain *newBrain);
   
   
   // Call this after setting the ownship position, and target position
@@ -233,6 +283,9 @@ class TargetSeeker
   float getTargetElevation() const;
   float getTargetDistance()  const;
 
+  // Meters/second, negative while closing
+  float getTargetRangeRate() const;
+
   // ...and this version forces a new
   // bearing, elevation, and distance calculation,
   // and retrieves both...
@@ -275,30 +328,13 @@ class TargetSeeker
   double pitch;
   double roll;
 
-  bool onSide;
-  bool onLeft;
-  bool onRight;
-  bool onVert;
-  bool onTop;
-  bool onBottom;
-  
-  // Neural Net inputs,
-  // a 9 sensor "eye"
-  float centerEye;
-  float upperEye;
-  float upperRightEye;
-  float rightEye;
-  float lowerRightEye;
-  float lowerEye;
-  float lowerLeftEye;
-  float leftEye;
-  float upperLeftEye;
-
-  // And additional inputs
-  // to the input layer
-  // of the neural net
-  float rolledRight;
-  float rolledLeft;
+  double airspeed;
+
+  // For the range rate
+  double rangeRate;
+  double lastDistance;
+  double lastDistanceTime;
+  bool   haveLastDistance;
 
   // Outputs from the neural net
   float pullBack;
@@ -314,7 +350,8 @@ class TargetSeeker
 
   // And of course, the
   // neural network
-  NeuralNetwork  *targetNet;
+  seekerBrain              *brain;
+  ReloadSlot<seekerBrain>   brainUpdates;
 };
 
 
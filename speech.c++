@@ -1,49 +1,379 @@
 // Simple file for saying things. Didn't have much luck
 // linking against the development libraries,
-// so a simple system call to the festival 
-// program itself will do.
+// so the festival program itself is run, once,
+// in --pipe mode and fed SayText commands.
 // Drew Kirkpatrick, drew.kirkpatrick@gmail.com
 
 
 
 #include <iostream>
 using namespace std;
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <atomic>
 
 
 #include "speech.h"
 
 
 
-// the speakScript simply throws the command
-// to the background. Easier than coming up
-// with an extra thread just for running
-// speech commands
-void sayOutloud(bool background, char* toSay)
+// One queued phrase. sequence is the usual
+// bounded MPMC ring bookkeeping, it says
+// whether the slot is free for a producer
+// or full and waiting for the worker.
+struct speechSlot
 {
-  char command[100];
+  atomic<unsigned long> sequence;
+  unsigned long         hash;
+  char                  text[SPEECH_MAX_LENGTH];
+};
 
-  if (background)
+
+
+static speechSlot            slots[SPEECH_QUEUE_SIZE];
+static atomic<unsigned long> enqueuePos(0);
+static atomic<unsigned long> dequeuePos(0);
+
+// Hash of the most recently queued phrase,
+// for coalescing repeats
+static atomic<unsigned long> lastQueuedHash(0);
+
+static atomic<unsigned long> droppedPhrases(0);
+static atomic<unsigned long> coalescedPhrases(0);
+
+static atomic<bool> speechRunning(false);
+static atomic<bool> speechStopping(false);
+
+static SpeechBackend   speechBackend = FestivalSpeech;
+static FILE           *festival      = NULL;
+static sem_t           phrasesWaiting;
+static pthread_t       speechWorker;
+static pthread_mutex_t speechInitLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+
+// djb2, good enough to spot a repeated phrase
+static unsigned long hashPhrase(const char* text)
+{
+  unsigned long hash = 5381;
+
+  while (*text)
+    {
+      hash = ((hash << 5) + hash) + (unsigned char)(*text++);
+    }
+
+  // 0 is reserved for "nothing queued"
+  return hash ? hash : 1;
+}
+
+
+
+
+// Try to add a phrase to the queue. Returns
+// the queue position it went into, or 0 if
+// it was coalesced or dropped.
+static unsigned long queuePhrase(const char* toSay)
+{
+  unsigned long hash = hashPhrase(toSay);
+  unsigned long pos;
+  speechSlot   *slot;
+
+  // Same thing as the last phrase, and that
+  // one hasn't been spoken yet, don't bother
+  if ((hash == lastQueuedHash.load(memory_order_relaxed)) &&
+      (dequeuePos.load(memory_order_acquire) !=
+       enqueuePos.load(memory_order_acquire)))
     {
-      // Return immediate from call, speak in the background
-      sprintf(command, "echo \"%s\" | festival --tts &", toSay);
+      coalescedPhrases++;
+      return 0;
     }
-  else
+
+  pos = enqueuePos.load(memory_order_relaxed);
+
+  for (;;)
     {
-      // Wait until the speech is finished before returning
-      sprintf(command, "echo \"%s\" | festival --tts", toSay);
+      slot = &slots[pos & (SPEECH_QUEUE_SIZE - 1)];
+
+      long diff = (long)slot->sequence.load(memory_order_acquire) - (long)pos;
+
+      if (diff == 0)
+	{
+	  if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+					       memory_order_relaxed))
+	    {
+	      break;
+	    }
+	}
+      else if (diff < 0)
+	{
+	  // Full, drop it rather than wait
+	  droppedPhrases++;
+	  return 0;
+	}
+      else
+	{
+	  pos = enqueuePos.load(memory_order_relaxed);
+	}
     }
-  
-  system(command);
+
+  strncpy(slot->text, toSay, SPEECH_MAX_LENGTH - 1);
+  slot->text[SPEECH_MAX_LENGTH - 1] = '\0';
+  slot->hash = hash;
+  slot->sequence.store(pos + 1, memory_order_release);
+
+  lastQueuedHash.store(hash, memory_order_relaxed);
+  sem_post(&phrasesWaiting);
+
+  return pos + 1;
 }
 
 
 
 
-void sayOutloud(bool background, string toSay)
+
+// Hand one phrase to the backend
+static void speakPhrase(const char* text)
 {
-  sayOutloud(background, toSay.c_str());
+  char cleaned[SPEECH_MAX_LENGTH];
+  int  i;
+
+  switch(speechBackend)
+    {
+    case FestivalSpeech:
+      // Quotes and backslashes would end
+      // the scheme string early
+      for (i = 0; text[i] && (i < SPEECH_MAX_LENGTH - 1); i++)
+	{
+	  cleaned[i] = ((text[i] == '"') || (text[i] == '\\')) ? ' ' : text[i];
+	}
+      cleaned[i] = '\0';
+
+      if ((fprintf(festival, "(SayText \"%s\")\n", cleaned) < 0) ||
+	  (fflush(festival) != 0))
+	{
+	  cout<<"Lost the festival process, speech "
+	      <<"goes to the console from now on"<<endl;
+	  speechBackend = LogSpeech;
+	  cout<<"Speech: "<<text<<endl;
+	}
+      break;
+
+    case LogSpeech:
+      cout<<"Speech: "<<text<<endl;
+      break;
+
+    case NoSpeech:
+      break;
+    }
+}
+
+
+
+
+// Worker thread, owns the festival process
+// and empties the queue
+static void *speechThread(void*)
+{
+  // Repeats closer together than this are skipped
+  static const double repeatWindow = 5.0; // seconds
+
+  unsigned long   pos;
+  unsigned long   lastHash = 0;
+  double          lastSpoken = 0.0;
+  double          now;
+  struct timespec ts;
+  speechSlot     *slot;
+
+  for (;;)
+    {
+      sem_wait(&phrasesWaiting);
+
+      // Say everything that's ready. A wakeup can
+      // belong to a phrase further along the ring
+      // than one that's still being copied in, so
+      // don't count on one phrase per wakeup.
+      for (;;)
+	{
+	  pos  = dequeuePos.load(memory_order_relaxed);
+	  slot = &slots[pos & (SPEECH_QUEUE_SIZE - 1)];
+
+	  if (slot->sequence.load(memory_order_acquire) != pos + 1)
+	    {
+	      break;
+	    }
+
+	  clock_gettime(CLOCK_MONOTONIC, &ts);
+	  now = ts.tv_sec + ts.tv_nsec * 1e-9;
+
+	  // Don't say the same thing twice in a row
+	  if ((slot->hash != lastHash) || (now - lastSpoken > repeatWindow))
+	    {
+	      speakPhrase(slot->text);
+	      lastHash   = slot->hash;
+	      lastSpoken = now;
+	    }
+	  else
+	    {
+	      coalescedPhrases++;
+	    }
+
+	  slot->sequence.store(pos + SPEECH_QUEUE_SIZE, memory_order_release);
+	  dequeuePos.store(pos + 1, memory_order_release);
+	}
+
+      if (speechStopping &&
+	  (dequeuePos.load(memory_order_acquire) ==
+	   enqueuePos.load(memory_order_acquire)))
+	{
+	  break;
+	}
+    }
+
+  return NULL;
+}
+
+
+
+
+
+void initSpeech(SpeechBackend backend)
+{
+  pthread_mutex_lock(&speechInitLock);
+
+  if (speechRunning)
+    {
+      pthread_mutex_unlock(&speechInitLock);
+      return;
+    }
+
+  // Starting over after a shutdownSpeech(),
+  // the positions go back to 0 with the slots
+  enqueuePos.store(0, memory_order_relaxed);
+  dequeuePos.store(0, memory_order_relaxed);
+  for (int i = 0; i < SPEECH_QUEUE_SIZE; i++)
+    {
+      slots[i].sequence.store(i, memory_order_relaxed);
+    }
+  sem_init(&phrasesWaiting, 0, 0);
+
+  speechBackend = backend;
+
+  if (speechBackend == FestivalSpeech)
+    {
+      // If festival goes away, find out from
+      // fprintf, not from a SIGPIPE
+      signal(SIGPIPE, SIG_IGN);
+
+      festival = popen("festival --pipe", "w");
+
+      if (!festival)
+	{
+	  cout<<"Couldn't start festival, speech "
+	      <<"goes to the console"<<endl;
+	  speechBackend = LogSpeech;
+	}
+    }
+
+  speechStopping = false;
+  pthread_create(&speechWorker, NULL, speechThread, NULL);
+  speechRunning = true;
+
+  pthread_mutex_unlock(&speechInitLock);
+}
+
+
+
+
+
+void shutdownSpeech()
+{
+  pthread_mutex_lock(&speechInitLock);
+
+  if (!speechRunning)
+    {
+      pthread_mutex_unlock(&speechInitLock);
+      return;
+    }
+
+  // The worker says everything already
+  // queued before it stops
+  speechStopping = true;
+  sem_post(&phrasesWaiting);
+  pthread_join(speechWorker, NULL);
+
+  if (festival)
+    {
+      // Closing stdin makes festival finish
+      // up and exit
+      pclose(festival);
+      festival = NULL;
+    }
+
+  sem_destroy(&phrasesWaiting);
+  speechRunning = false;
+
+  if (droppedPhrases || coalescedPhrases)
+    {
+      cout<<"Speech: dropped "<<droppedPhrases<<" phrases, coalesced "
+	  <<coalescedPhrases<<endl;
+    }
+
+  pthread_mutex_unlock(&speechInitLock);
+}
+
+
+
+
+
+void sayOutloud(bool background, const char* toSay)
+{
+  // Keep waiting callers from hanging
+  // forever on a stuck synthesizer
+  static const int maxWaits = 2000; // * 1ms
+
+  struct timespec ts;
+  ts.tv_sec  = 0;
+  ts.tv_nsec = 1000000;
+
+  unsigned long queuedAt;
+  const char   *env;
+
+  if (!speechRunning)
+    {
+      env = getenv("AUTOAGENT_SPEECH");
+
+      if (env && !strcmp(env, "log"))
+	initSpeech(LogSpeech);
+      else if (env && !strcmp(env, "none"))
+	initSpeech(NoSpeech);
+      else
+	initSpeech(FestivalSpeech);
+    }
+
+  queuedAt = queuePhrase(toSay);
+
+  if (background || (queuedAt == 0))
+    {
+      return;
+    }
+
+  for (int i = 0; (i < maxWaits) &&
+	 (dequeuePos.load(memory_order_acquire) < queuedAt); i++)
+    {
+      nanosleep(&ts, NULL);
+    }
 }
 
 
 
+
+void sayOutloud(bool background, string toSay)
+{
+  sayOutloud(background, toSay.c_str());
+}
@@ -1,11 +1,56 @@
 #ifndef SPEECH_H
 #define SPEECH_H
 
+// Spoken announcements. sayOutloud() only
+// copies the phrase into a bounded lock free
+// queue, a worker thread feeds it to a single
+// long running festival process. Duplicate
+// phrases still waiting in the queue are
+// coalesced, and if the queue is full the
+// phrase is dropped rather than making the
+// caller wait.
 
 
-extern void sayOutloud(bool background, char* toSay);
+#include <string>
 
-extern void sayOutloud(bool background, string toSay);
+
+
+// Longest phrase, anything longer is truncated
+#define SPEECH_MAX_LENGTH 256
+
+// Phrases that can be waiting, power of 2
+#define SPEECH_QUEUE_SIZE 32
+
+
+
+enum SpeechBackend
+  {
+    FestivalSpeech,  // speak through festival
+    LogSpeech,       // print to the console, for headless runs
+    NoSpeech         // throw everything away
+  };
+
+
+
+
+// Start the worker with a given backend. Optional,
+// the first sayOutloud() starts it, using the
+// AUTOAGENT_SPEECH environment variable
+// (festival, log or none, festival by default).
+extern void initSpeech(SpeechBackend backend);
+
+// Say everything still queued, stop
+// festival and the worker thread
+extern void shutdownSpeech();
+
+
+// If background is false, wait (briefly) until
+// the phrase has been handed to the synthesizer,
+// so phrases said in a row keep their pacing.
+// Never use false from the control loop.
+extern void sayOutloud(bool background, const char* toSay);
+
+extern void sayOutloud(bool background, std::string toSay);
 
 
 
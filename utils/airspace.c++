@@ -0,0 +1,454 @@
+// Who's flying nearby,
+// see airspace.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <algorithm>
+#include <math.h>
+
+
+#include "airspace.h"
+#include "route.h"
+
+
+
+
+Airspace::Airspace()
+{
+  cellMask = 0;
+}
+
+
+
+void Airspace::report(int id, double lat, double lon, double alt,
+		      bool hostile)
+{
+  airspaceContact *contact;
+
+  if (id < 0)
+    {
+      return;
+    }
+
+  if (id >= (int)reportOf.size())
+    {
+      reportOf.resize(id + 1, -1);
+    }
+
+  if (reportOf[id] < 0)
+    {
+      reportOf[id] = reports.size();
+      reports.push_back(airspaceContact());
+    }
+
+  contact = &reports[reportOf[id]];
+
+  contact->id      = id;
+  contact->hostile = hostile;
+  contact->lat     = lat;
+  contact->lon     = lon;
+  contact->alt     = alt;
+  Route::geoToEcef(lat, lon, alt, contact->ecef);
+}
+
+
+
+void Airspace::remove(int id)
+{
+  int index;
+
+  if ((id < 0) || (id >= (int)reportOf.size()) || (reportOf[id] < 0))
+    {
+      return;
+    }
+
+  // The last one takes its place
+  index               = reportOf[id];
+  reports[index]      = reports.back();
+  reportOf[reports[index].id] = index;
+  reports.pop_back();
+  reportOf[id]        = -1;
+}
+
+
+
+void Airspace::clear()
+{
+  reports.clear();
+  reportOf.clear();
+}
+
+
+
+void Airspace::update()
+{
+  int64_t  cell[3];
+  size_t   size = 16;
+  size_t   slot;
+  int      first;
+
+  contacts  = reports;
+  contactOf = reportOf;
+
+  grid.resize(contacts.size());
+
+  for (size_t i = 0; i < contacts.size(); i++)
+    {
+      cellOf(contacts[i].ecef, cell);
+      grid[i].cell    = cellKey(cell[0], cell[1], cell[2]);
+      grid[i].contact = i;
+      grid[i].ecef[0] = contacts[i].ecef[0];
+      grid[i].ecef[1] = contacts[i].ecef[1];
+      grid[i].ecef[2] = contacts[i].ecef[2];
+    }
+
+  // They've barely moved since the last
+  // time, so this is nearly in order
+  // already
+  sort(grid.begin(), grid.end());
+
+
+  // At most half full
+  while (size < 2 * grid.size())
+    {
+      size *= 2;
+    }
+
+  cellMask = size - 1;
+  cells.assign(size, cellRun());
+
+  for (first = 0; first < (int)grid.size(); )
+    {
+      cellRun run;
+
+      run.cell  = grid[first].cell;
+      run.first = first;
+      run.count = 0;
+
+      while ((first < (int)grid.size()) && (grid[first].cell == run.cell))
+	{
+	  run.count++;
+	  first++;
+	}
+
+      slot = (run.cell * 0x9E3779B97F4A7C15ULL >> 32) & cellMask;
+      while (cells[slot].count)
+	{
+	  slot = (slot + 1) & cellMask;
+	}
+      cells[slot] = run;
+    }
+}
+
+
+
+int Airspace::getNumberOfContacts() const
+{
+  return contacts.size();
+}
+
+
+
+const airspaceContact* Airspace::getContact(int id) const
+{
+  if ((id < 0) || (id >= (int)contactOf.size()) || (contactOf[id] < 0))
+    {
+      return NULL;
+    }
+
+  return &contacts[contactOf[id]];
+}
+
+
+
+
+int Airspace::withinRadius(const double position[3], double radius,
+			   vector<airspaceNeighbor> &found,
+			   int ignoreId) const
+{
+  int64_t low[3], high[3], cell[3];
+  double  squaredRadius = radius * radius;
+  double  cellsToSearch = 1.0;
+  double  squared;
+
+  found.clear();
+
+  if (grid.empty() || (radius < 0.0))
+    {
+      return 0;
+    }
+
+  for (int j = 0; j < 3; j++)
+    {
+      low[j]  = (int64_t)floor((position[j] - radius) / AIRSPACE_CELL);
+      high[j] = (int64_t)floor((position[j] + radius) / AIRSPACE_CELL);
+      cellsToSearch *= high[j] - low[j] + 1;
+    }
+
+  // A radius that takes in more cells than
+  // there are aircraft is quicker done by
+  // checking every one of them
+  if (cellsToSearch > grid.size())
+    {
+      for (size_t i = 0; i < grid.size(); i++)
+	{
+	  squared = squaredDistance(position, grid[i].ecef);
+
+	  if ((squared <= squaredRadius) &&
+	      (contacts[grid[i].contact].id != ignoreId))
+	    {
+	      airspaceNeighbor neighbor;
+	      neighbor.id       = contacts[grid[i].contact].id;
+	      neighbor.distance = sqrt(squared);
+	      found.push_back(neighbor);
+	    }
+	}
+    }
+  else
+    {
+      for (cell[0] = low[0]; cell[0] <= high[0]; cell[0]++)
+	{
+	  for (cell[1] = low[1]; cell[1] <= high[1]; cell[1]++)
+	    {
+	      for (cell[2] = low[2]; cell[2] <= high[2]; cell[2]++)
+		{
+		  // The corners of the box
+		  // can be out of reach
+		  if (distanceToCell(position, cell) > radius)
+		    {
+		      continue;
+		    }
+
+		  const cellRun *run = findCell(cellKey(cell[0], cell[1],
+							cell[2]));
+		  if (run == NULL)
+		    {
+		      continue;
+		    }
+
+		  for (int i = run->first; i < run->first + run->count; i++)
+		    {
+		      squared = squaredDistance(position, grid[i].ecef);
+
+		      if ((squared <= squaredRadius) &&
+			  (contacts[grid[i].contact].id != ignoreId))
+			{
+			  airspaceNeighbor neighbor;
+			  neighbor.id       = contacts[grid[i].contact].id;
+			  neighbor.distance = sqrt(squared);
+			  found.push_back(neighbor);
+			}
+		    }
+		}
+	    }
+	}
+    }
+
+  sort(found.begin(), found.end());
+
+  return found.size();
+}
+
+
+
+
+// Search rings of cells outwards, like
+// Route::nearestLeg. Once the kth best is
+// closer than anything outside the rings
+// searched so far can be, they're the
+// nearest. The best so far are a heap,
+// worst on top, by squared distance.
+int Airspace::nearest(const double position[3], int k,
+		      vector<airspaceNeighbor> &found, int ignoreId) const
+{
+  int64_t center[3], cell[3];
+  double  gap, boxCells;
+  bool    done = false;
+
+  found.clear();
+
+  if ((k <= 0) || grid.empty())
+    {
+      return 0;
+    }
+
+  auto consider = [&](int i)
+    {
+      if (contacts[grid[i].contact].id == ignoreId)
+	{
+	  return;
+	}
+
+      airspaceNeighbor neighbor;
+      neighbor.id       = contacts[grid[i].contact].id;
+      neighbor.distance = squaredDistance(position, grid[i].ecef);
+
+      if ((int)found.size() < k)
+	{
+	  found.push_back(neighbor);
+	  push_heap(found.begin(), found.end());
+	}
+      else if (neighbor < found.front())
+	{
+	  pop_heap(found.begin(), found.end());
+	  found.back() = neighbor;
+	  push_heap(found.begin(), found.end());
+	}
+    };
+
+  cellOf(position, center);
+
+  for (int ring = 0; !done; ring++)
+    {
+      boxCells = (2.0 * ring + 1) * (2.0 * ring + 1) * (2.0 * ring + 1);
+
+      // Spread out too thin for the rings to
+      // be worth it, check every one instead
+      if (boxCells > grid.size())
+	{
+	  found.clear();
+	  for (int i = 0; i < (int)grid.size(); i++)
+	    {
+	      consider(i);
+	    }
+	  break;
+	}
+
+      for (int x = -ring; x <= ring; x++)
+	{
+	  for (int y = -ring; y <= ring; y++)
+	    {
+	      for (int z = -ring; z <= ring; z++)
+		{
+		  // Only the shell, the inside
+		  // was done on earlier rings
+		  if ((abs(x) != ring) && (abs(y) != ring) && (abs(z) != ring))
+		    {
+		      continue;
+		    }
+
+		  cell[0] = center[0] + x;
+		  cell[1] = center[1] + y;
+		  cell[2] = center[2] + z;
+
+		  if ((int)found.size() == k)
+		    {
+		      gap = distanceToCell(position, cell);
+		      if (gap * gap >= found.front().distance)
+			{
+			  continue;
+			}
+		    }
+
+		  const cellRun *run = findCell(cellKey(cell[0], cell[1],
+							cell[2]));
+		  if (run == NULL)
+		    {
+		      continue;
+		    }
+
+		  for (int i = run->first; i < run->first + run->count; i++)
+		    {
+		      consider(i);
+		    }
+		}
+	    }
+	}
+
+      done = ((int)found.size() == k) &&
+	(found.front().distance <= (ring * AIRSPACE_CELL) *
+	 (ring * AIRSPACE_CELL));
+    }
+
+  sort_heap(found.begin(), found.end());
+
+  for (size_t i = 0; i < found.size(); i++)
+    {
+      found[i].distance = sqrt(found[i].distance);
+    }
+
+  return found.size();
+}
+
+
+
+
+/******************************************
+ Private Functions
+*******************************************/
+
+
+
+const Airspace::cellRun* Airspace::findCell(uint64_t cell) const
+{
+  size_t slot = (cell * 0x9E3779B97F4A7C15ULL >> 32) & cellMask;
+
+  while (cells[slot].count)
+    {
+      if (cells[slot].cell == cell)
+	{
+	  return &cells[slot];
+	}
+      slot = (slot + 1) & cellMask;
+    }
+
+  return NULL;
+}
+
+
+
+// How close position is to any
+// point in the cell
+double Airspace::distanceToCell(const double position[3],
+				const int64_t cell[3])
+{
+  double low, gap, squared = 0.0;
+
+  for (int j = 0; j < 3; j++)
+    {
+      low = cell[j] * AIRSPACE_CELL;
+      gap = (position[j] < low) ? low - position[j] :
+	position[j] - (low + AIRSPACE_CELL);
+      gap = (gap > 0.0) ? gap : 0.0;
+      squared += gap * gap;
+    }
+
+  return sqrt(squared);
+}
+
+
+
+void Airspace::cellOf(const double position[3], int64_t cell[3])
+{
+  for (int j = 0; j < 3; j++)
+    {
+      cell[j] = (int64_t)floor(position[j] / AIRSPACE_CELL);
+    }
+}
+
+
+
+// 21 bits a side, plenty for cells
+// of a few hundred meters and up
+uint64_t Airspace::cellKey(int64_t x, int64_t y, int64_t z)
+{
+  const int64_t offset = 1 << 20;
+  const int64_t mask   = (1 << 21) - 1;
+
+  return ((uint64_t)((x + offset) & mask) << 42) |
+    ((uint64_t)((y + offset) & mask) << 21) |
+    (uint64_t)((z + offset) & mask);
+}
+
+
+
+double Airspace::squaredDistance(const double a[3], const double b[3])
+{
+  double dx = a[0] - b[0];
+  double dy = a[1] - b[1];
+  double dz = a[2] - b[2];
+
+  return dx * dx + dy * dy + dz * dz;
+}
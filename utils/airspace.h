@@ -0,0 +1,150 @@
+// Everything flying nearby, for the Ucav's
+// sensors. Aircraft (the Ucav itself, other
+// agents, whatever else is out there) report
+// where they are, the airspace is rebuilt
+// once a tick, and then anyone can ask who's
+// within a radius of them, or for their k
+// nearest.
+//
+// The rebuild sorts the aircraft into a grid
+// of AIRSPACE_CELL sized cells over earth
+// centered (ECEF) coordinates, the same way
+// Route's nearest leg grid works, plus a hash
+// from each cell to its run of the sorted
+// aircraft. A query only looks at the cells
+// it could find something in, so a swarm
+// costs about the same per aircraft as a
+// pair, instead of every aircraft checking
+// every other one.
+
+
+#ifndef AIRSPACE_H
+#define AIRSPACE_H
+
+
+#include <stdint.h>
+#include <vector>
+
+
+
+// Size of the grid cells, about the
+// distances asked about most
+#ifndef AIRSPACE_CELL
+#define AIRSPACE_CELL 10000.0  // meters
+#endif
+
+
+
+struct airspaceContact
+{
+  int    id;
+  bool   hostile;
+  double lat;
+  double lon;
+  double alt;
+  double ecef[3];
+};
+
+
+
+// An answer to a query, nearest first
+struct airspaceNeighbor
+{
+  int    id;
+  double distance;  // meters
+
+  bool operator<(const airspaceNeighbor &other) const
+  {
+    return (distance < other.distance) ||
+      ((distance == other.distance) && (id < other.id));
+  }
+};
+
+
+
+
+class Airspace
+{
+ public:
+  Airspace();
+
+  // Where an aircraft is now, lat and lon in
+  // degrees, alt in meters. Ids are any
+  // number from 0, entity ids say.
+  void report(int id, double lat, double lon, double alt, bool hostile);
+  void remove(int id);
+  void clear();
+
+  // Rebuild the grid from the reports so
+  // far. Queries see the airspace as of
+  // the last update().
+  void update();
+
+  int  getNumberOfContacts() const;
+
+  // As of the last update(), NULL if
+  // it wasn't there
+  const airspaceContact* getContact(int id) const;
+
+
+  // Everything within radius meters of
+  // position (ECEF), other than ignoreId.
+  // Returns how many.
+  int  withinRadius(const double position[3], double radius,
+		    std::vector<airspaceNeighbor> &found,
+		    int ignoreId = -1) const;
+
+  // The k closest to position, fewer if
+  // there aren't that many
+  int  nearest(const double position[3], int k,
+	       std::vector<airspaceNeighbor> &found,
+	       int ignoreId = -1) const;
+
+
+ private:
+  // As reported, and where each id is in it
+  std::vector<airspaceContact> reports;
+  std::vector<int>             reportOf;
+
+  // The last update(), sorted by cell, with
+  // each cell's run of them found through
+  // an open addressed hash
+  std::vector<airspaceContact> contacts;
+  std::vector<int>             contactOf;
+
+  struct gridEntry
+  {
+    uint64_t cell;
+    int      contact;
+    double   ecef[3];
+
+    bool operator<(const gridEntry &other) const
+    {
+      return (cell < other.cell) ||
+	((cell == other.cell) && (contact < other.contact));
+    }
+  };
+
+  struct cellRun
+  {
+    uint64_t cell;
+    int      first;
+    int      count;   // 0 for an empty slot
+  };
+
+  std::vector<gridEntry> grid;
+  std::vector<cellRun>   cells;
+  uint64_t               cellMask;
+
+  const cellRun* findCell(uint64_t cell) const;
+
+  static void     cellOf(const double position[3], int64_t cell[3]);
+  static uint64_t cellKey(int64_t x, int64_t y, int64_t z);
+  static double   distanceToCell(const double position[3],
+				 const int64_t cell[3]);
+  static double   squaredDistance(const double a[3], const double b[3]);
+};
+
+
+
+#endif // AIRSPACE_H
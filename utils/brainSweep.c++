@@ -0,0 +1,531 @@
+// Hyperparameter sweep for the neural nets,
+// see brainSweep.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+
+#include "brainSweep.h"
+
+
+
+
+// Everything the worker threads share
+struct sweepJob
+{
+  const DataSet               *trainingSet;
+  vector<sweepCandidate>      *candidates;
+  vector<NeuralNetwork*>       brains;
+  const sweepSettings         *settings;
+
+  vector<long>                 trainSamples;
+  vector<long>                 holdoutSamples;
+
+  atomic<size_t>               nextCandidate;
+  atomic<size_t>               finished;
+  pthread_mutex_t              printLock;
+};
+
+
+
+
+// Small xorshift, rand() is shared
+// between the threads
+static uint32_t nextRandom(uint32_t &state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+
+
+static void shuffleSamples(vector<long> &samples, uint32_t seed)
+{
+  uint32_t state = seed ? seed : 0x9e3779b9;
+
+  for (long i = (long)samples.size() - 1; i > 0; i--)
+    {
+      long j = nextRandom(state) % (i + 1);
+      swap(samples[i], samples[j]);
+    }
+}
+
+
+
+// The book's RandomizeWeights() seeds from
+// time(), so brains made in the same second
+// all start out the same. Same -1..1 range
+// in steps of 0.01, but from our own seed.
+static void randomizeLayer(NeuralNetworkLayer &layer, uint32_t &state)
+{
+  int i, j;
+
+  for (i = 0; i < layer.NumberOfNodes; i++)
+    {
+      for (j = 0; j < layer.NumberOfChildNodes; j++)
+	{
+	  layer.Weights[i][j] = (nextRandom(state) % 201) / 100.0 - 1;
+	}
+    }
+
+  for (j = 0; j < layer.NumberOfChildNodes; j++)
+    {
+      layer.BiasWeights[j] = (nextRandom(state) % 201) / 100.0 - 1;
+    }
+}
+
+
+
+static void copyLayerWeights(const NeuralNetworkLayer &from,
+			     NeuralNetworkLayer &to)
+{
+  int i, j;
+
+  for (i = 0; i < from.NumberOfNodes; i++)
+    {
+      for (j = 0; j < from.NumberOfChildNodes; j++)
+	{
+	  to.Weights[i][j] = from.Weights[i][j];
+	}
+    }
+
+  for (j = 0; j < from.NumberOfChildNodes; j++)
+    {
+      to.BiasWeights[j] = from.BiasWeights[j];
+    }
+}
+
+
+
+static void copyBrainWeights(const NeuralNetwork &from, NeuralNetwork &to)
+{
+  copyLayerWeights(from.InputLayer,  to.InputLayer);
+  copyLayerWeights(from.HiddenLayer, to.HiddenLayer);
+}
+
+
+
+
+// Mean squared error per output over some
+// samples, optionally learning from them
+static double runSamples(NeuralNetwork &brain, const DataSet &data,
+			 const vector<long> &samples, bool learn)
+{
+  int    numInputs  = data.getNumInputs();
+  int    numOutputs = data.getNumOutputs();
+  double error      = 0.0;
+  double difference;
+  int    i;
+
+  if (samples.empty())
+    {
+      return 0.0;
+    }
+
+  for (size_t s = 0; s < samples.size(); s++)
+    {
+      const float *inputs  = data.getInputs (samples[s]);
+      const float *targets = data.getTargets(samples[s]);
+
+      for (i = 0; i < numInputs; i++)
+	{
+	  brain.SetInput(i, inputs[i]);
+	}
+
+      brain.FeedForward();
+
+      for (i = 0; i < numOutputs; i++)
+	{
+	  difference = brain.GetOutput(i) - targets[i];
+	  error     += difference * difference;
+
+	  brain.SetDesiredOutput(i, targets[i]);
+	}
+
+      if (learn)
+	{
+	  brain.BackPropagate();
+	}
+    }
+
+  return error / (samples.size() * numOutputs);
+}
+
+
+
+
+// Train one candidate until it stops getting
+// better on the held out samples, and leave
+// its best weights in best
+static void trainCandidate(sweepJob &job, size_t index)
+{
+  sweepCandidate &candidate = (*job.candidates)[index];
+  NeuralNetwork  &best      = *job.brains[index];
+  const DataSet  &data      = *job.trainingSet;
+
+  NeuralNetwork  brain;
+  vector<long>   order(job.trainSamples);
+  uint32_t       state = job.settings->seed * 7919 + index + 1;
+  double         bestError = 1e30;
+  double         holdoutError;
+  double         trainError;
+  long           sinceBest = 0;
+  long           epoch;
+  struct timespec start, stop;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // Same shape as best, which was made
+  // (and randomized) before the threads
+  // started, Initialize() isn't thread safe
+  brain.InputLayer.NumberOfNodes       = best.InputLayer.NumberOfNodes;
+  brain.InputLayer.NumberOfChildNodes  = best.InputLayer.NumberOfChildNodes;
+  brain.InputLayer.NumberOfParentNodes = 0;
+  brain.InputLayer.Initialize(best.InputLayer.NumberOfNodes,
+			      NULL, &brain.HiddenLayer);
+
+  brain.HiddenLayer.NumberOfNodes       = best.HiddenLayer.NumberOfNodes;
+  brain.HiddenLayer.NumberOfChildNodes  = best.HiddenLayer.NumberOfChildNodes;
+  brain.HiddenLayer.NumberOfParentNodes = best.InputLayer.NumberOfNodes;
+  brain.HiddenLayer.Initialize(best.HiddenLayer.NumberOfNodes,
+			       &brain.InputLayer, &brain.OutputLayer);
+
+  brain.OutputLayer.NumberOfNodes       = best.OutputLayer.NumberOfNodes;
+  brain.OutputLayer.NumberOfChildNodes  = 0;
+  brain.OutputLayer.NumberOfParentNodes = best.HiddenLayer.NumberOfNodes;
+  brain.OutputLayer.Initialize(best.OutputLayer.NumberOfNodes,
+			       &brain.HiddenLayer, NULL);
+
+  copyBrainWeights(best, brain);
+
+  brain.SetLearningRate(candidate.learningRate);
+  brain.SetMomentum(candidate.momentum > 0.0, candidate.momentum);
+
+  trainError   = 0.0;
+  holdoutError = 0.0;
+
+  for (epoch = 0; epoch < job.settings->maxEpochs; epoch++)
+    {
+      shuffleSamples(order, nextRandom(state));
+      trainError = runSamples(brain, data, order, true);
+
+      // Nothing held out (a tiny set), then
+      // the training error has to do
+      if (job.holdoutSamples.empty())
+	holdoutError = trainError;
+      else
+	holdoutError = runSamples(brain, data, job.holdoutSamples, false);
+
+      if (holdoutError < bestError - SWEEP_MIN_IMPROVEMENT)
+	{
+	  bestError = holdoutError;
+	  sinceBest = 0;
+
+	  candidate.trainError   = trainError;
+	  candidate.holdoutError = holdoutError;
+	  copyBrainWeights(brain, best);
+	}
+      else if (++sinceBest >= SWEEP_PATIENCE)
+	{
+	  epoch++;
+	  break;
+	}
+    }
+
+  brain.CleanUp();
+
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  candidate.epochs  = epoch;
+  candidate.seconds = (stop.tv_sec - start.tv_sec) +
+		      (stop.tv_nsec - start.tv_nsec) * 1e-9;
+
+  pthread_mutex_lock(&job.printLock);
+  job.finished++;
+  cout<<"["<<job.finished<<"/"<<job.candidates->size()<<"] hidden "
+      <<candidate.hiddenNodes<<", rate "<<candidate.learningRate
+      <<", momentum "<<candidate.momentum<<": held out error "
+      <<candidate.holdoutError<<" after "<<candidate.epochs<<" epochs"<<endl;
+  pthread_mutex_unlock(&job.printLock);
+}
+
+
+
+
+static void *sweepThread(void* jobPtr)
+{
+  sweepJob &job = *(sweepJob*)jobPtr;
+  size_t    index;
+
+  while ((index = job.nextCandidate++) < job.candidates->size())
+    {
+      trainCandidate(job, index);
+    }
+
+  return NULL;
+}
+
+
+
+
+static bool betterCandidate(const pair<double, size_t> &a,
+			    const pair<double, size_t> &b)
+{
+  return a.first < b.first;
+}
+
+
+
+
+
+
+
+void defaultSweepSettings(sweepSettings &settings)
+{
+  static const int    hidden[]   = { 6, 8, 10, 12, 14 };
+  static const double rates[]    = { 0.05, 0.1, 0.2, 0.4 };
+  static const double momentum[] = { 0.0, 0.5, 0.9 };
+
+  settings.hiddenNodes.assign  (hidden,   hidden   + 5);
+  settings.learningRates.assign(rates,    rates    + 4);
+  settings.momentums.assign    (momentum, momentum + 3);
+
+  settings.randomCandidates = 0;
+  settings.threads          = 0;
+  settings.maxEpochs        = 5000;
+  settings.seed             = 1;
+}
+
+
+
+
+vector<sweepCandidate> makeSweepCandidates(const sweepSettings &settings)
+{
+  vector<sweepCandidate> candidates;
+  sweepCandidate         candidate;
+  size_t h, r, m;
+
+  candidate.epochs       = 0;
+  candidate.trainError   = 0.0;
+  candidate.holdoutError = 0.0;
+  candidate.seconds      = 0.0;
+
+  if (settings.hiddenNodes.empty() || settings.learningRates.empty() ||
+      settings.momentums.empty())
+    {
+      return candidates;
+    }
+
+  if (settings.randomCandidates == 0)
+    {
+      for (h = 0; h < settings.hiddenNodes.size(); h++)
+	for (r = 0; r < settings.learningRates.size(); r++)
+	  for (m = 0; m < settings.momentums.size(); m++)
+	    {
+	      candidate.hiddenNodes  = settings.hiddenNodes[h];
+	      candidate.learningRate = settings.learningRates[r];
+	      candidate.momentum     = settings.momentums[m];
+	      candidates.push_back(candidate);
+	    }
+
+      return candidates;
+    }
+
+  // Random search over the ranges the lists
+  // cover, learning rate evenly in log space
+  int    minHidden = *min_element(settings.hiddenNodes.begin(),
+				  settings.hiddenNodes.end());
+  int    maxHidden = *max_element(settings.hiddenNodes.begin(),
+				  settings.hiddenNodes.end());
+  double minRate   = log(*min_element(settings.learningRates.begin(),
+				      settings.learningRates.end()));
+  double maxRate   = log(*max_element(settings.learningRates.begin(),
+				      settings.learningRates.end()));
+  double minMoment = *min_element(settings.momentums.begin(),
+				  settings.momentums.end());
+  double maxMoment = *max_element(settings.momentums.begin(),
+				  settings.momentums.end());
+  uint32_t state   = settings.seed ? settings.seed : 0x9e3779b9;
+
+  for (int i = 0; i < settings.randomCandidates; i++)
+    {
+      candidate.hiddenNodes  = minHidden +
+			       nextRandom(state) % (maxHidden - minHidden + 1);
+      candidate.learningRate = exp(minRate + (maxRate - minRate) *
+				   (nextRandom(state) / 4294967296.0));
+      candidate.momentum     = minMoment + (maxMoment - minMoment) *
+			       (nextRandom(state) / 4294967296.0);
+      candidates.push_back(candidate);
+    }
+
+  return candidates;
+}
+
+
+
+
+bool runBrainSweep(const DataSet &trainingSet,
+		   vector<sweepCandidate> &candidates,
+		   const sweepSettings &settings,
+		   NeuralNetwork &bestBrain)
+{
+  sweepJob          job;
+  vector<pthread_t> threads;
+  long              numSamples = trainingSet.getNumSamples();
+  long              holdout;
+  int               numThreads;
+  size_t            i;
+
+  if (candidates.empty() || (numSamples == 0))
+    {
+      cout<<"Nothing to sweep"<<endl;
+      return false;
+    }
+
+
+  // One fixed split for every candidate,
+  // so their held out errors compare
+  for (long s = 0; s < numSamples; s++)
+    {
+      job.trainSamples.push_back(s);
+    }
+  shuffleSamples(job.trainSamples, settings.seed);
+
+  holdout = (long)(numSamples * SWEEP_HOLDOUT);
+  job.holdoutSamples.assign(job.trainSamples.begin(),
+			    job.trainSamples.begin() + holdout);
+  job.trainSamples.erase(job.trainSamples.begin(),
+			 job.trainSamples.begin() + holdout);
+
+
+  // Brains are made here, one thread, and
+  // hold each candidate's best weights
+  for (i = 0; i < candidates.size(); i++)
+    {
+      uint32_t state = settings.seed * 104729 + i + 1;
+
+      job.brains.push_back(new NeuralNetwork);
+      job.brains[i]->Initialize(trainingSet.getNumInputs(),
+				candidates[i].hiddenNodes,
+				trainingSet.getNumOutputs());
+      randomizeLayer(job.brains[i]->InputLayer,  state);
+      randomizeLayer(job.brains[i]->HiddenLayer, state);
+    }
+
+  job.trainingSet   = &trainingSet;
+  job.candidates    = &candidates;
+  job.settings      = &settings;
+  job.nextCandidate = 0;
+  job.finished      = 0;
+  pthread_mutex_init(&job.printLock, NULL);
+
+  numThreads = settings.threads;
+  if (numThreads <= 0)
+    {
+      numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+  numThreads = max(1, min(numThreads, (int)candidates.size()));
+
+  cout<<"Sweeping "<<candidates.size()<<" candidates on "<<numThreads
+      <<" threads, "<<job.trainSamples.size()<<" training and "
+      <<job.holdoutSamples.size()<<" held out samples"<<endl;
+
+  threads.resize(numThreads);
+  for (int t = 0; t < numThreads; t++)
+    {
+      if (pthread_create(&threads[t], NULL, sweepThread, &job) != 0)
+	{
+	  perror("runBrainSweep: pthread_create");
+	  exit(1);
+	}
+    }
+
+  for (int t = 0; t < numThreads; t++)
+    {
+      pthread_join(threads[t], NULL);
+    }
+
+  pthread_mutex_destroy(&job.printLock);
+
+
+  // Best first
+  vector< pair<double, size_t> > ranking;
+  vector<sweepCandidate>         sorted;
+
+  for (i = 0; i < candidates.size(); i++)
+    {
+      ranking.push_back(make_pair(candidates[i].holdoutError, i));
+    }
+  stable_sort(ranking.begin(), ranking.end(), betterCandidate);
+
+  for (i = 0; i < ranking.size(); i++)
+    {
+      sorted.push_back(candidates[ranking[i].second]);
+    }
+
+
+  // Hand back a copy of the winner
+  NeuralNetwork &winner = *job.brains[ranking[0].second];
+
+  bestBrain.Initialize(winner.InputLayer.NumberOfNodes,
+		       winner.HiddenLayer.NumberOfNodes,
+		       winner.OutputLayer.NumberOfNodes);
+  copyBrainWeights(winner, bestBrain);
+
+  for (i = 0; i < job.brains.size(); i++)
+    {
+      job.brains[i]->CleanUp();
+      delete job.brains[i];
+    }
+
+  candidates = sorted;
+  return true;
+}
+
+
+
+
+bool writeSweepLeaderboard(string filename,
+			   const vector<sweepCandidate> &candidates)
+{
+  ofstream board(filename.c_str(), ios::out);
+
+  if (!board)
+    {
+      cout<<"Failed to open "<<filename<<endl;
+      return false;
+    }
+
+  board<<"# rank hiddenNodes learningRate momentum epochs "
+       <<"trainError holdoutError seconds"<<endl;
+
+  for (size_t i = 0; i < candidates.size(); i++)
+    {
+      board<<i + 1<<" "
+	   <<candidates[i].hiddenNodes<<" "
+	   <<candidates[i].learningRate<<" "
+	   <<candidates[i].momentum<<" "
+	   <<candidates[i].epochs<<" "
+	   <<setprecision(9)
+	   <<candidates[i].trainError<<" "
+	   <<candidates[i].holdoutError<<" "
+	   <<setprecision(4)
+	   <<candidates[i].seconds<<endl
+	   <<setprecision(6);
+    }
+
+  return !board.fail();
+}
@@ -0,0 +1,96 @@
+// Hyperparameter sweep for the neural nets.
+// Trains a set of candidate brains (hidden
+// nodes, learning rate, momentum) at the same
+// time, one thread per core, each in its own
+// NeuralNetwork. Part of the data set is held
+// out, every candidate stops once it quits
+// improving on it, and keeps the weights from
+// its best epoch.
+
+
+#ifndef BRAINSWEEP_H
+#define BRAINSWEEP_H
+
+
+#include <string>
+#include <vector>
+
+#include "neuralNet.h"
+#include "dataSet.h"
+
+
+
+// Fraction of the samples held out
+// for early stopping
+#define SWEEP_HOLDOUT 0.2
+
+// Epochs without a better held out error
+// before a candidate is stopped
+#define SWEEP_PATIENCE 50
+
+// Smallest drop in held out error
+// that counts as better
+#define SWEEP_MIN_IMPROVEMENT 1e-5
+
+
+
+struct sweepCandidate
+{
+  int    hiddenNodes;
+  double learningRate;
+  double momentum;      // 0 is no momentum
+
+  // Filled in by the sweep
+  long   epochs;
+  double trainError;    // mean squared error per output
+  double holdoutError;
+  double seconds;
+};
+
+
+
+struct sweepSettings
+{
+  std::vector<int>    hiddenNodes;
+  std::vector<double> learningRates;
+  std::vector<double> momentums;
+
+  // 0 trains the whole grid, otherwise this
+  // many random picks from the ranges the
+  // lists above cover
+  int  randomCandidates;
+
+  int  threads;         // 0 is one per core
+  long maxEpochs;
+  unsigned int seed;
+};
+
+
+
+// Sensible defaults, the grid covers what
+// was tried by hand with trainScript
+extern void defaultSweepSettings(sweepSettings &settings);
+
+
+// Build the candidate list for some settings
+extern std::vector<sweepCandidate> makeSweepCandidates(const sweepSettings &settings);
+
+
+// Train every candidate on the data set. The
+// candidates come back sorted best first, and
+// bestBrain holds the weights of the winner
+// (the caller CleanUp()s it). Returns false if
+// there's nothing to train.
+extern bool runBrainSweep(const DataSet &trainingSet,
+			  std::vector<sweepCandidate> &candidates,
+			  const sweepSettings &settings,
+			  NeuralNetwork &bestBrain);
+
+
+// One line per candidate, best first
+extern bool writeSweepLeaderboard(std::string filename,
+				  const std::vector<sweepCandidate> &candidates);
+
+
+
+#endif // BRAINSWEEP_H
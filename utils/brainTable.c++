@@ -0,0 +1,105 @@
+// Brains turned into tables,
+// see brainTable.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <stdio.h>
+#include <ctype.h>
+
+
+#include "brainTable.h"
+
+
+
+
+bool compileBrain(NeuralNetwork &net, SeekerEncoding encoding,
+		  brainTable &table)
+{
+  if ((encoding != EyeEncoding) ||
+      (net.InputLayer.NumberOfNodes  != EYE_INPUTS) ||
+      (net.OutputLayer.NumberOfNodes != STICK_OUTPUTS))
+    {
+      return false;
+    }
+
+  for (int state = 0; state < EYE_STATES; state++)
+    {
+      eyeStateInputs(state, net.InputLayer.NeuronValues);
+      net.FeedForward();
+
+      for (int i = 0; i < STICK_OUTPUTS; i++)
+	{
+	  table.outputs[state][i] = net.GetOutput(i);
+	}
+    }
+
+  return true;
+}
+
+
+
+bool writeBrainTableHeader(const brainTable &table, const string &tableName,
+			   const string &brainFile, const string &headerFile)
+{
+  static const char *rollNames[EYE_ROLL_STATES] =
+    {
+      "level", "rolled right", "rolled left"
+    };
+
+  string guard;
+  FILE  *header;
+
+  if ((header = fopen(headerFile.c_str(), "w")) == NULL)
+    {
+      perror(("writeBrainTableHeader: " + headerFile).c_str());
+      return false;
+    }
+
+  for (size_t i = 0; i < tableName.size(); i++)
+    {
+      guard += isalnum(tableName[i]) ? toupper(tableName[i]) : '_';
+    }
+  guard += "_H";
+
+  fprintf(header,
+	  "// Generated by braincompile from %s,\n"
+	  "// the brain's outputs for each eyeState()\n\n"
+	  "#ifndef %s\n"
+	  "#define %s\n\n"
+	  "#include \"brainTable.h\"\n\n\n"
+	  "static constexpr brainTable %s =\n"
+	  "  {\n"
+	  "    {\n",
+	  brainFile.c_str(), guard.c_str(), guard.c_str(), tableName.c_str());
+
+  // %.17g reads back as exactly the same double
+  for (int state = 0; state < EYE_STATES; state++)
+    {
+      fprintf(header, "      { ");
+
+      for (int i = 0; i < STICK_OUTPUTS; i++)
+	{
+	  fprintf(header, "%.17g%s", table.outputs[state][i],
+		  (i < STICK_OUTPUTS - 1) ? ", " : " }");
+	}
+
+      fprintf(header, "%s  // cell %d, %s\n",
+	      (state < EYE_STATES - 1) ? "," : " ",
+	      state / EYE_ROLL_STATES, rollNames[state % EYE_ROLL_STATES]);
+    }
+
+  fprintf(header,
+	  "    }\n"
+	  "  };\n\n"
+	  "#endif // %s\n", guard.c_str());
+
+  if (fclose(header) != 0)
+    {
+      perror(("writeBrainTableHeader: " + headerFile).c_str());
+      return false;
+    }
+
+  return true;
+}
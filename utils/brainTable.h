@@ -0,0 +1,50 @@
+// A brain that sees the target with the eyes
+// (eyeEncoder.h) only ever gets one of
+// EYE_STATES different inputs, so there are
+// only that many answers it can give. They're
+// all worked out when the brain is loaded,
+// and flying it is just looking one up, no
+// matter how many hidden nodes it has.
+//
+// braincompile can also write the table out
+// as a constexpr header, for building a brain
+// into a program.
+
+
+#ifndef BRAINTABLE_H
+#define BRAINTABLE_H
+
+
+#include <string>
+
+#include "neuralNet.h"
+#include "seekerEncoding.h"
+
+
+
+// The net's outputs, in GetOutput() order,
+// for each eyeState()
+struct brainTable
+{
+  double outputs[EYE_STATES][STICK_OUTPUTS];
+};
+
+
+
+// Runs the net on every input it can get.
+// False if its inputs aren't a handful of
+// fixed patterns (the continuous encodings),
+// it has to be run every time.
+extern bool compileBrain(NeuralNetwork &net, SeekerEncoding encoding,
+			 brainTable &table);
+
+// The table as a C++ header defining a
+// constexpr brainTable called tableName
+extern bool writeBrainTableHeader(const brainTable &table,
+				  const std::string &tableName,
+				  const std::string &brainFile,
+				  const std::string &headerFile);
+
+
+
+#endif // BRAINTABLE_H
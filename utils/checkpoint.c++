@@ -0,0 +1,275 @@
+// The last good copy of some state,
+// see checkpoint.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "checkpoint.h"
+
+
+
+// The header and each slot start
+// on a cache line of their own
+#define CHECKPOINT_ALIGN 64
+
+
+
+
+Checkpoint::Checkpoint()
+{
+  map       = NULL;
+  mapSize   = 0;
+  header    = NULL;
+  stateSize = 0;
+  sequence  = 0;
+}
+
+
+
+Checkpoint::~Checkpoint()
+{
+  close();
+}
+
+
+
+bool Checkpoint::open(const string &filename, unsigned int version,
+		      size_t newStateSize)
+{
+  struct stat status;
+  size_t      slotSize;
+  int         fd;
+
+  close();
+
+  path      = filename;
+  stateSize = newStateSize;
+  slotSize  = (sizeof(checkpointSlot) + stateSize + CHECKPOINT_ALIGN - 1) /
+    CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+  mapSize   = CHECKPOINT_ALIGN + 2 * slotSize;
+
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd == -1)
+    {
+      perror(("Checkpoint: opening " + path).c_str());
+      return false;
+    }
+
+  // The wrong size can't be ours,
+  // start it again as zeroes
+  if ((fstat(fd, &status) == -1) || ((size_t)status.st_size != mapSize))
+    {
+      if ((ftruncate(fd, 0) == -1) || (ftruncate(fd, mapSize) == -1))
+	{
+	  perror(("Checkpoint: sizing " + path).c_str());
+	  ::close(fd);
+	  return false;
+	}
+    }
+
+  map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (map == MAP_FAILED)
+    {
+      perror(("Checkpoint: mapping " + path).c_str());
+      map = NULL;
+      return false;
+    }
+
+  header = (checkpointHeader*)map;
+
+  if ((header->magic != CHECKPOINT_MAGIC) || (header->version != version) ||
+      (header->stateSize != stateSize) || (header->slotSize != slotSize))
+    {
+      memset(map, 0, mapSize);
+
+      header->version   = version;
+      header->stateSize = stateSize;
+      header->slotSize  = slotSize;
+      header->current.store(0);
+      header->closed.store(1);
+      header->magic     = CHECKPOINT_MAGIC;
+    }
+
+  // Carry on counting from the
+  // newest copy there is
+  sequence = 0;
+  for (int i = 0; i < 2; i++)
+    {
+      if (slotIsGood(i) && (slot(i)->sequence > sequence))
+	{
+	  sequence = slot(i)->sequence;
+	}
+    }
+
+  return true;
+}
+
+
+
+void Checkpoint::close()
+{
+  if (map)
+    {
+      munmap(map, mapSize);
+      map    = NULL;
+      header = NULL;
+    }
+}
+
+
+
+bool Checkpoint::isOpen() const
+{
+  return map != NULL;
+}
+
+
+
+// The current slot is always whole, the
+// other one's only tried in case the disk
+// lost the last flip (a power failure
+// without a sync())
+bool Checkpoint::restore(void *state) const
+{
+  int current;
+
+  if (!map || header->closed.load(memory_order_acquire))
+    {
+      return false;
+    }
+
+  current = header->current.load(memory_order_acquire) & 1;
+
+  for (int i = 0; i < 2; i++)
+    {
+      int which = current ^ i;
+
+      if (slotIsGood(which))
+	{
+	  memcpy(state, slot(which) + 1, stateSize);
+	  return true;
+	}
+    }
+
+  return false;
+}
+
+
+
+bool Checkpoint::save(const void *state)
+{
+  checkpointSlot *spare;
+  int             which;
+
+  if (!map)
+    {
+      return false;
+    }
+
+  which = (header->current.load(memory_order_relaxed) & 1) ^ 1;
+  spare = slot(which);
+
+  spare->sequence = ++sequence;
+  memcpy(spare + 1, state, stateSize);
+  spare->checksum = checksum(sequence, state, stateSize);
+
+  // The copy's all there before
+  // anyone's pointed at it
+  header->closed.store(0, memory_order_relaxed);
+  header->current.store(which, memory_order_release);
+
+  return true;
+}
+
+
+
+void Checkpoint::markClosed()
+{
+  if (map)
+    {
+      header->closed.store(1, memory_order_release);
+    }
+}
+
+
+
+bool Checkpoint::sync()
+{
+  if (!map)
+    {
+      return false;
+    }
+
+  if (msync(map, mapSize, MS_SYNC) == -1)
+    {
+      perror(("Checkpoint: syncing " + path).c_str());
+      return false;
+    }
+
+  return true;
+}
+
+
+
+unsigned long long Checkpoint::getSaves() const
+{
+  return sequence;
+}
+
+
+
+
+/******************************************
+ Private Functions
+*******************************************/
+
+
+
+checkpointSlot* Checkpoint::slot(int which) const
+{
+  return (checkpointSlot*)((char*)map + CHECKPOINT_ALIGN +
+			   which * header->slotSize);
+}
+
+
+
+bool Checkpoint::slotIsGood(int which) const
+{
+  checkpointSlot *copy = slot(which);
+
+  return (copy->sequence != 0) &&
+    (copy->checksum == checksum(copy->sequence, copy + 1, stateSize));
+}
+
+
+
+// FNV-1a, the state's a few hundred bytes
+unsigned int Checkpoint::checksum(unsigned long long sequence,
+				  const void *state, size_t length)
+{
+  const unsigned char *bytes = (const unsigned char*)state;
+  unsigned int         hash  = 2166136261U;
+
+  for (int i = 0; i < 8; i++)
+    {
+      hash = (hash ^ ((sequence >> (8 * i)) & 0xff)) * 16777619U;
+    }
+
+  for (size_t i = 0; i < length; i++)
+    {
+      hash = (hash ^ bytes[i]) * 16777619U;
+    }
+
+  return hash;
+}
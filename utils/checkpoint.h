@@ -0,0 +1,105 @@
+// Keeps the last good copy of some state in
+// a memory mapped file, so it's still there
+// after a crash, kill -9 and all.
+//
+// The file has a header and two slots. save()
+// writes the slot that isn't current, then
+// flips the header over to it with a single
+// atomic store, so whenever the process dies
+// one slot holds a whole, checksummed copy.
+// The writes land in the page cache as
+// they're made, the kernel gets them to disk
+// in its own time. Surviving the machine
+// losing power too takes a sync().
+//
+// A clean shutdown calls markClosed(), and
+// restore() finds nothing the next time.
+
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+
+#include <atomic>
+#include <string>
+
+
+
+#define CHECKPOINT_MAGIC 0x54504b43  // "CKPT"
+
+
+
+// At the start of the file
+struct checkpointHeader
+{
+  unsigned int magic;
+  unsigned int version;     // of the caller's state layout
+  unsigned int stateSize;
+  unsigned int slotSize;
+
+  std::atomic<unsigned int> current;  // the slot to read, 0 or 1
+  std::atomic<unsigned int> closed;   // shut down cleanly
+};
+
+// Ahead of each copy of the state
+struct checkpointSlot
+{
+  unsigned long long sequence;  // 1, 2, 3... as saved
+  unsigned int       checksum;  // of sequence and the state
+  unsigned int       pad;
+};
+
+
+
+
+class Checkpoint
+{
+ public:
+  Checkpoint();
+  ~Checkpoint();
+
+  // Map filename, made afresh if it's not
+  // there, or holds some other version
+  // or size of state
+  bool open(const std::string &filename, unsigned int version,
+	    size_t stateSize);
+  void close();
+  bool isOpen() const;
+
+  // The newest whole copy, false if there
+  // isn't one or it was closed cleanly
+  bool restore(void *state) const;
+
+  // Into the spare slot, then flipped to
+  bool save(const void *state);
+
+  // Nothing to recover next time
+  void markClosed();
+
+  // Waits for the disk
+  bool sync();
+
+  unsigned long long getSaves() const;
+
+
+ private:
+  std::string        path;
+  void              *map;
+  size_t             mapSize;
+  checkpointHeader  *header;
+  size_t             stateSize;
+  unsigned long long sequence;
+
+  checkpointSlot* slot(int which) const;
+  bool            slotIsGood(int which) const;
+
+  static unsigned int checksum(unsigned long long sequence,
+			       const void *state, size_t length);
+
+  Checkpoint(const Checkpoint&);
+  Checkpoint& operator=(const Checkpoint&);
+};
+
+
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,157 @@
+// Records training samples while flying,
+// see dataRecorder.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <string.h>
+#include <time.h>
+
+
+#include "dataRecorder.h"
+
+
+
+
+DataRecorder::DataRecorder(string filename, int newNumInputs,
+			   int newNumOutputs, const char** inputNames,
+			   const char** outputNames):
+  writer(newNumInputs, newNumOutputs, inputNames, outputNames)
+{
+  dataFileName = filename;
+  numInputs    = newNumInputs;
+  numOutputs   = newNumOutputs;
+
+  head     = 0;
+  tail     = 0;
+  dropped  = 0;
+  stopping = false;
+
+  if (!writer.open(dataFileName))
+    {
+      cout<<"DataRecorder: can't record to "<<dataFileName<<endl;
+      exit(1);
+    }
+
+  if (pthread_create(&writerThread, NULL, writerThreadFunc, this) != 0)
+    {
+      perror("DataRecorder: pthread_create");
+      exit(1);
+    }
+  running = true;
+}
+
+
+
+DataRecorder::~DataRecorder()
+{
+  stop();
+}
+
+
+
+// Single producer, the control thread. Only
+// touches the ring and two atomics.
+bool DataRecorder::record(const float* inputs, const float* targets,
+			  double timestamp)
+{
+  unsigned long position = head.load(memory_order_relaxed);
+
+  if (position - tail.load(memory_order_acquire) >= RECORDER_RING_SIZE)
+    {
+      dropped++;
+      return false;
+    }
+
+  recordedSample &sample = ring[position & (RECORDER_RING_SIZE - 1)];
+
+  sample.timestamp = timestamp;
+  memcpy(sample.inputs,  inputs,  numInputs  * sizeof(float));
+  memcpy(sample.targets, targets, numOutputs * sizeof(float));
+
+  head.store(position + 1, memory_order_release);
+  return true;
+}
+
+
+
+void DataRecorder::stop()
+{
+  if (!running)
+    {
+      return;
+    }
+
+  stopping = true;
+  pthread_join(writerThread, NULL);
+  running = false;
+
+  cout<<"DataRecorder: saved "<<writer.getNumSamples()<<" samples to "
+      <<dataFileName<<", dropped "<<dropped<<endl;
+}
+
+
+
+long DataRecorder::getRecorded() const
+{
+  return head.load(memory_order_relaxed) - dropped.load(memory_order_relaxed);
+}
+
+
+
+long DataRecorder::getDropped() const
+{
+  return dropped.load(memory_order_relaxed);
+}
+
+
+
+
+/******************************************
+ Private Functions
+*******************************************/
+
+
+
+// Move everything in the ring onto
+// the end of the file
+void DataRecorder::drainRing()
+{
+  unsigned long position = tail.load(memory_order_relaxed);
+  unsigned long end      = head.load(memory_order_acquire);
+
+  for (; position != end; position++)
+    {
+      recordedSample &sample = ring[position & (RECORDER_RING_SIZE - 1)];
+      writer.addSample(sample.inputs, sample.targets, sample.timestamp);
+    }
+
+  tail.store(position, memory_order_release);
+
+  writer.flush();
+}
+
+
+
+void *DataRecorder::writerThreadFunc(void* recorderPtr)
+{
+  DataRecorder *recorder = (DataRecorder*)recorderPtr;
+
+  // Used for briefly suspending the thread
+  struct timespec ts;
+  ts.tv_sec  = 0;
+  ts.tv_nsec = 5000000;
+
+  while (!recorder->stopping)
+    {
+      recorder->drainRing();
+      nanosleep(&ts, NULL);
+    }
+
+  // Whatever came in after the last pass
+  recorder->drainRing();
+  recorder->writer.close();
+
+  return NULL;
+}
@@ -0,0 +1,80 @@
+// Records training samples while flying without
+// slowing the control loop down. record() copies
+// the sample into a lock free ring and returns,
+// a writer thread empties the ring onto the end
+// of a binary data set (see dataSet.h) every few
+// milliseconds, so a crash doesn't lose the
+// flight and memory doesn't grow with it.
+
+
+#ifndef DATARECORDER_H
+#define DATARECORDER_H
+
+
+#include <pthread.h>
+#include <atomic>
+#include <string>
+
+#include "dataSet.h"
+
+
+
+// Samples the ring can hold, power of 2.
+// At a few thousand samples a second that's
+// a couple of seconds of slack for the writer.
+#define RECORDER_RING_SIZE 8192
+
+
+
+struct recordedSample
+{
+  double timestamp;
+  float  inputs [DATASET_MAX_INPUTS];
+  float  targets[DATASET_MAX_OUTPUTS];
+};
+
+
+
+
+class DataRecorder
+{
+ public:
+  DataRecorder(std::string filename, int numInputs, int numOutputs,
+	       const char** inputNames, const char** outputNames);
+  ~DataRecorder();
+
+  // Called by the control thread, never blocks.
+  // Returns false if the ring was full and the
+  // sample had to be dropped.
+  bool record(const float* inputs, const float* targets,
+	      double timestamp);
+
+  // Stop the writer, and save everything recorded
+  void stop();
+
+  long getRecorded() const;
+  long getDropped()  const;
+
+
+ private:
+  std::string     dataFileName;
+  int             numInputs;
+  int             numOutputs;
+  DataSetAppender writer;
+
+  recordedSample        ring[RECORDER_RING_SIZE];
+  std::atomic<unsigned long> head;   // written by record()
+  std::atomic<unsigned long> tail;   // written by the writer thread
+  std::atomic<long>          dropped;
+  std::atomic<bool>          stopping;
+
+  pthread_t writerThread;
+  bool      running;
+
+  static void *writerThreadFunc(void* recorder);
+  void  drainRing();
+};
+
+
+
+#endif // DATARECORDER_H
@@ -0,0 +1,765 @@
+// Binary training data sets for the neural nets.
+// See dataSet.h for the layout.
+
+
+
+#include <iostream>
+using namespace std;
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "dataSet.h"
+
+
+
+// Same cutoff used to set the rolled
+// inputs everywhere else
+#ifndef ROLLCUTOFF
+#define ROLLCUTOFF 5.0
+#endif
+
+
+
+const char* eyeInputNames[EYE_INPUTS] =
+  {
+    "centerEye",
+    "upperEye",
+    "upperRightEye",
+    "rightEye",
+    "lowerRightEye",
+    "lowerEye",
+    "lowerLeftEye",
+    "leftEye",
+    "upperLeftEye",
+    "rolledRight",
+    "rolledLeft"
+  };
+
+
+const char* stickOutputNames[STICK_OUTPUTS] =
+  {
+    "pullBack",
+    "pushForward",
+    "rollRight",
+    "rollLeft"
+  };
+
+
+
+
+// Sections start on 64 byte boundaries
+static uint64_t alignSection(uint64_t offset)
+{
+  return (offset + 63) & ~((uint64_t)63);
+}
+
+
+
+// A DATASET_ROWS sample, timestamp first
+// so every row's is 8 byte aligned
+static size_t rowBytes(int numInputs, int numOutputs)
+{
+  size_t bytes = sizeof(double) + (numInputs + numOutputs) * sizeof(float);
+
+  return (bytes + 7) & ~((size_t)7);
+}
+
+
+
+// Whether count items of length bytes, stride
+// bytes apart from offset, are all in the file
+static bool sectionFits(uint64_t offset, uint64_t stride, uint64_t length,
+			uint64_t count, size_t fileSize)
+{
+  return (count == 0) || (offset + (count - 1) * stride + length <= fileSize);
+}
+
+
+
+// The magic number, layout and names, the same
+// for both kinds of writer. Exits on a layout
+// the header can't hold.
+static void startHeader(dataSetHeader &header, int numInputs, int numOutputs,
+			const char** inputNames, const char** outputNames)
+{
+  int i;
+
+  if ((numInputs  <= 0) || (numInputs  > DATASET_MAX_INPUTS) ||
+      (numOutputs <= 0) || (numOutputs > DATASET_MAX_OUTPUTS))
+    {
+      cout<<"Data set: bad layout, "<<numInputs<<" inputs, "
+	  <<numOutputs<<" outputs"<<endl;
+      exit(1);
+    }
+
+  memset(&header, 0, sizeof(header));
+  strncpy(header.magic, DATASET_MAGIC, sizeof(header.magic));
+  header.version    = DATASET_VERSION;
+  header.numInputs  = numInputs;
+  header.numOutputs = numOutputs;
+
+  for (i = 0; i < numInputs; i++)
+    {
+      strncpy(header.inputNames[i], inputNames[i], DATASET_NAME_LENGTH - 1);
+    }
+
+  for (i = 0; i < numOutputs; i++)
+    {
+      strncpy(header.outputNames[i], outputNames[i], DATASET_NAME_LENGTH - 1);
+    }
+}
+
+
+
+
+/******************************************
+ DataSetWriter
+*******************************************/
+
+
+DataSetWriter::DataSetWriter(int numInputs, int numOutputs,
+			     const char** inputNames,
+			     const char** outputNames)
+{
+  startHeader(header, numInputs, numOutputs, inputNames, outputNames);
+
+  haveTimestamps = false;
+}
+
+
+
+DataSetWriter::~DataSetWriter()
+{
+}
+
+
+
+void DataSetWriter::addSample(const float* newInputs,
+			      const float* newTargets)
+{
+  inputs.insert(inputs.end(), newInputs, newInputs + header.numInputs);
+  targets.insert(targets.end(), newTargets, newTargets + header.numOutputs);
+
+  // Keep the timestamp column lined up if
+  // some samples do have times
+  timestamps.push_back(0.0);
+}
+
+
+
+void DataSetWriter::addSample(const float* newInputs,
+			      const float* newTargets,
+			      double timestamp)
+{
+  addSample(newInputs, newTargets);
+  timestamps.back() = timestamp;
+  haveTimestamps    = true;
+}
+
+
+
+long DataSetWriter::getNumSamples() const
+{
+  return timestamps.size();
+}
+
+
+
+bool DataSetWriter::write(string filename)
+{
+  uint64_t numSamples = timestamps.size();
+
+  header.numSamples    = numSamples;
+  header.flags         = haveTimestamps ? DATASET_HAS_TIMESTAMPS : 0;
+  header.inputsOffset  = alignSection(sizeof(header));
+  header.targetsOffset = alignSection(header.inputsOffset +
+				      numSamples * header.numInputs * sizeof(float));
+
+  if (haveTimestamps)
+    {
+      header.timestampsOffset =
+	alignSection(header.targetsOffset +
+		     numSamples * header.numOutputs * sizeof(float));
+    }
+  else
+    {
+      header.timestampsOffset = 0;
+    }
+
+  // Write to a temporary name and rename, so
+  // a reader never maps a half written set
+  string tempName = filename + ".tmp";
+  FILE  *dataFile = fopen(tempName.c_str(), "wb");
+
+  if (!dataFile)
+    {
+      perror("DataSetWriter::write: fopen");
+      return false;
+    }
+
+  bool ok = (fwrite(&header, sizeof(header), 1, dataFile) == 1);
+
+  ok = ok && (fseek(dataFile, header.inputsOffset, SEEK_SET) == 0);
+  ok = ok && (fwrite(inputs.data(), sizeof(float), inputs.size(),
+		     dataFile) == inputs.size());
+
+  ok = ok && (fseek(dataFile, header.targetsOffset, SEEK_SET) == 0);
+  ok = ok && (fwrite(targets.data(), sizeof(float), targets.size(),
+		     dataFile) == targets.size());
+
+  if (haveTimestamps)
+    {
+      ok = ok && (fseek(dataFile, header.timestampsOffset, SEEK_SET) == 0);
+      ok = ok && (fwrite(timestamps.data(), sizeof(double),
+			 timestamps.size(), dataFile) == timestamps.size());
+    }
+
+  ok = (fclose(dataFile) == 0) && ok;
+
+  if (!ok || (rename(tempName.c_str(), filename.c_str()) != 0))
+    {
+      perror("DataSetWriter::write");
+      unlink(tempName.c_str());
+      return false;
+    }
+
+  return true;
+}
+
+
+
+
+
+/******************************************
+ DataSetAppender
+*******************************************/
+
+
+DataSetAppender::DataSetAppender(int numInputs, int numOutputs,
+				 const char** inputNames,
+				 const char** outputNames)
+{
+  startHeader(header, numInputs, numOutputs, inputNames, outputNames);
+
+  rowSize = rowBytes(numInputs, numOutputs);
+
+  header.flags            = DATASET_HAS_TIMESTAMPS | DATASET_ROWS;
+  header.timestampsOffset = alignSection(sizeof(header));
+  header.inputsOffset     = header.timestampsOffset + sizeof(double);
+  header.targetsOffset    = header.inputsOffset + numInputs * sizeof(float);
+
+  dataFile = NULL;
+  added    = 0;
+}
+
+
+
+DataSetAppender::~DataSetAppender()
+{
+  close();
+}
+
+
+
+bool DataSetAppender::open(string filename)
+{
+  close();
+
+  dataFile = fopen(filename.c_str(), "wb");
+  if (!dataFile)
+    {
+      perror(("DataSetAppender::open: " + filename).c_str());
+      return false;
+    }
+
+  header.numSamples = 0;
+  added             = 0;
+
+  // The header, padded out to the first row
+  if ((fwrite(&header, sizeof(header), 1, dataFile) != 1) ||
+      (fseek(dataFile, header.timestampsOffset, SEEK_SET) != 0) ||
+      (fflush(dataFile) != 0))
+    {
+      perror(("DataSetAppender::open: " + filename).c_str());
+      close();
+      return false;
+    }
+
+  return true;
+}
+
+
+
+void DataSetAppender::close()
+{
+  if (dataFile)
+    {
+      flush();
+      fclose(dataFile);
+      dataFile = NULL;
+    }
+}
+
+
+
+bool DataSetAppender::addSample(const float* inputs, const float* targets,
+				double timestamp)
+{
+  char row[sizeof(double) +
+	   (DATASET_MAX_INPUTS + DATASET_MAX_OUTPUTS) * sizeof(float)];
+  char *next = row;
+
+  if (!dataFile)
+    {
+      return false;
+    }
+
+  memset(row, 0, rowSize);
+
+  memcpy(next, &timestamp, sizeof(double));
+  next += sizeof(double);
+  memcpy(next, inputs, header.numInputs * sizeof(float));
+  next += header.numInputs * sizeof(float);
+  memcpy(next, targets, header.numOutputs * sizeof(float));
+
+  // Only into stdio's buffer, flush()
+  // does the writing
+  if (fwrite(row, rowSize, 1, dataFile) != 1)
+    {
+      perror("DataSetAppender::addSample");
+      return false;
+    }
+
+  added++;
+  return true;
+}
+
+
+
+// The rows go out before the count that
+// takes them in, so a reader never counts
+// a row that isn't there
+bool DataSetAppender::flush()
+{
+  uint64_t numSamples = added;
+
+  if (!dataFile)
+    {
+      return false;
+    }
+
+  if (numSamples == header.numSamples)
+    {
+      return true;
+    }
+
+  if ((fflush(dataFile) != 0) ||
+      (pwrite(fileno(dataFile), &numSamples, sizeof(numSamples),
+	      offsetof(dataSetHeader, numSamples)) != sizeof(numSamples)))
+    {
+      perror("DataSetAppender::flush");
+      return false;
+    }
+
+  header.numSamples = numSamples;
+  return true;
+}
+
+
+
+long DataSetAppender::getNumSamples() const
+{
+  return added;
+}
+
+
+
+
+
+/******************************************
+ DataSet
+*******************************************/
+
+
+DataSet::DataSet()
+{
+  fd          = -1;
+  mapping     = NULL;
+  mappingSize = 0;
+  header      = NULL;
+  inputs      = NULL;
+  targets     = NULL;
+  timestamps  = NULL;
+  nextInOrder = 0;
+
+  inputStride     = 0;
+  targetStride    = 0;
+  timestampStride = 0;
+}
+
+
+
+DataSet::~DataSet()
+{
+  close();
+}
+
+
+
+bool DataSet::isDataSetFile(string filename)
+{
+  char magic[8];
+  bool isSet = false;
+
+  FILE *dataFile = fopen(filename.c_str(), "rb");
+
+  if (dataFile)
+    {
+      isSet = ((fread(magic, sizeof(magic), 1, dataFile) == 1) &&
+	       !strncmp(magic, DATASET_MAGIC, sizeof(magic)));
+      fclose(dataFile);
+    }
+
+  return isSet;
+}
+
+
+
+bool DataSet::open(string filename)
+{
+  struct stat fileInfo;
+
+  close();
+
+  if ((fd = ::open(filename.c_str(), O_RDONLY)) == -1)
+    {
+      perror("DataSet::open");
+      return false;
+    }
+
+  if ((fstat(fd, &fileInfo) == -1) ||
+      ((size_t)fileInfo.st_size < sizeof(dataSetHeader)))
+    {
+      cout<<"DataSet::open: "<<filename<<" is too small"<<endl;
+      close();
+      return false;
+    }
+
+  mappingSize = fileInfo.st_size;
+  mapping     = mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+
+  if (mapping == MAP_FAILED)
+    {
+      perror("DataSet::open: mmap");
+      mapping = NULL;
+      close();
+      return false;
+    }
+
+  header = (const dataSetHeader*)mapping;
+
+  if (strncmp(header->magic, DATASET_MAGIC, sizeof(header->magic)) ||
+      (header->version != DATASET_VERSION))
+    {
+      cout<<"DataSet::open: "<<filename<<" isn't a data set"<<endl;
+      close();
+      return false;
+    }
+
+  if ((header->numInputs  == 0) || (header->numInputs  > DATASET_MAX_INPUTS)  ||
+      (header->numOutputs == 0) || (header->numOutputs > DATASET_MAX_OUTPUTS))
+    {
+      cout<<"DataSet::open: "<<filename<<" is truncated or corrupt"<<endl;
+      close();
+      return false;
+    }
+
+  if (header->flags & DATASET_ROWS)
+    {
+      inputStride     = rowBytes(header->numInputs, header->numOutputs);
+      targetStride    = inputStride;
+      timestampStride = inputStride;
+    }
+  else
+    {
+      inputStride     = header->numInputs  * sizeof(float);
+      targetStride    = header->numOutputs * sizeof(float);
+      timestampStride = sizeof(double);
+    }
+
+  if (!sectionFits(header->inputsOffset, inputStride,
+		   header->numInputs * sizeof(float),
+		   header->numSamples, mappingSize) ||
+      !sectionFits(header->targetsOffset, targetStride,
+		   header->numOutputs * sizeof(float),
+		   header->numSamples, mappingSize) ||
+      ((header->flags & DATASET_HAS_TIMESTAMPS) &&
+       !sectionFits(header->timestampsOffset, timestampStride,
+		    sizeof(double), header->numSamples, mappingSize)))
+    {
+      cout<<"DataSet::open: "<<filename<<" is truncated or corrupt"<<endl;
+      close();
+      return false;
+    }
+
+  inputs  = (const float*)((const char*)mapping + header->inputsOffset);
+  targets = (const float*)((const char*)mapping + header->targetsOffset);
+
+  if (header->flags & DATASET_HAS_TIMESTAMPS)
+    {
+      timestamps = (const double*)((const char*)mapping +
+				   header->timestampsOffset);
+    }
+
+  // Mini batches jump all over the file
+  madvise(mapping, mappingSize, MADV_RANDOM);
+
+  order.resize(header->numSamples);
+  for (long i = 0; i < (long)header->numSamples; i++)
+    {
+      order[i] = i;
+    }
+  nextInOrder = 0;
+
+  return true;
+}
+
+
+
+void DataSet::close()
+{
+  if (mapping)
+    {
+      munmap(mapping, mappingSize);
+    }
+
+  if (fd != -1)
+    {
+      ::close(fd);
+    }
+
+  fd          = -1;
+  mapping     = NULL;
+  mappingSize = 0;
+  header      = NULL;
+  inputs      = NULL;
+  targets     = NULL;
+  timestamps  = NULL;
+  order.clear();
+  nextInOrder = 0;
+}
+
+
+
+long DataSet::getNumSamples() const
+{
+  return header ? header->numSamples : 0;
+}
+
+
+int DataSet::getNumInputs() const
+{
+  return header ? header->numInputs : 0;
+}
+
+
+int DataSet::getNumOutputs() const
+{
+  return header ? header->numOutputs : 0;
+}
+
+
+bool DataSet::hasTimestamps() const
+{
+  return (timestamps != NULL);
+}
+
+
+const char* DataSet::getInputName(int i) const
+{
+  return header->inputNames[i];
+}
+
+
+const char* DataSet::getOutputName(int i) const
+{
+  return header->outputNames[i];
+}
+
+
+const float* DataSet::getInputs(long sample) const
+{
+  return (const float*)((const char*)inputs + sample * inputStride);
+}
+
+
+const float* DataSet::getTargets(long sample) const
+{
+  return (const float*)((const char*)targets + sample * targetStride);
+}
+
+
+double DataSet::getTimestamp(long sample) const
+{
+  return timestamps ?
+    *(const double*)((const char*)timestamps + sample * timestampStride) : 0.0;
+}
+
+
+
+// Fisher-Yates with a small xorshift, so a
+// seed always gives the same order
+void DataSet::shuffle(unsigned int seed)
+{
+  uint32_t state = seed ? seed : 0x9e3779b9;
+  long     n     = order.size();
+
+  for (long i = n - 1; i > 0; i--)
+    {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+
+      long j   = state % (i + 1);
+      long tmp = order[i];
+      order[i] = order[j];
+      order[j] = tmp;
+    }
+
+  nextInOrder = 0;
+}
+
+
+
+int DataSet::nextBatch(int batchSize, const float** batchInputs,
+		       const float** batchTargets)
+{
+  int count = 0;
+
+  while ((count < batchSize) && (nextInOrder < (long)order.size()))
+    {
+      batchInputs [count] = getInputs (order[nextInOrder]);
+      batchTargets[count] = getTargets(order[nextInOrder]);
+      count++;
+      nextInOrder++;
+    }
+
+  return count;
+}
+
+
+
+
+
+/******************************************
+ Text importer
+*******************************************/
+
+
+// Maps a -1..1 stick deflection onto two
+// "direction" targets
+static void splitDeflection(float deflection, float &negative,
+			    float &positive)
+{
+  negative = (deflection < 0.0) ? (2.0 * -deflection - 1.0) : -1.0;
+  positive = (deflection > 0.0) ? (2.0 *  deflection - 1.0) : -1.0;
+}
+
+
+
+void stickToTargets(float elevator, float aileron,
+		    float targets[STICK_OUTPUTS])
+{
+  // pullBack, pushForward
+  splitDeflection(elevator, targets[0], targets[1]);
+
+  // rollLeft, rollRight
+  splitDeflection(aileron,  targets[3], targets[2]);
+}
+
+
+
+long importTextDataSets(const vector<string>& textFiles, string outputFile)
+{
+  DataSetWriter writer(EYE_INPUTS, STICK_OUTPUTS,
+		       eyeInputNames, stickOutputNames);
+
+  float  sampleInputs [EYE_INPUTS];
+  float  sampleTargets[STICK_OUTPUTS];
+  float  columns[16];
+  int    numColumns;
+  string line;
+
+
+  for (size_t f = 0; f < textFiles.size(); f++)
+    {
+      ifstream textFile(textFiles[f].c_str(), ios::in);
+      int      lineNumber = 0;
+
+      if (!textFile)
+	{
+	  cout<<"Failed to open "<<textFiles[f]<<endl;
+	  return -1;
+	}
+
+      while (getline(textFile, line))
+	{
+	  istringstream fields(line);
+	  lineNumber++;
+
+	  for (numColumns = 0; (numColumns < 16) &&
+		 (fields>>columns[numColumns]); numColumns++)
+	    ;
+
+	  if (numColumns == 0)
+	    {
+	      // Blank line
+	      continue;
+	    }
+
+	  if (numColumns == EYE_INPUTS + STICK_OUTPUTS)
+	    {
+	      // Current format, already what the net wants
+	      memcpy(sampleInputs,  columns, sizeof(sampleInputs));
+	      memcpy(sampleTargets, columns + EYE_INPUTS, sizeof(sampleTargets));
+	    }
+	  else if (numColumns == 14)
+	    {
+	      // old/autoAgent recordings: 9 eyes, inverted,
+	      // roll (-1..1 of 180 degrees), elevator,
+	      // aileron, rudder. There's no inverted input
+	      // anymore, and the roll becomes the flags.
+	      memcpy(sampleInputs, columns, 9 * sizeof(float));
+
+	      sampleInputs[9]  = (columns[10] * 180.0 >=  ROLLCUTOFF) ? 1.0 : -1.0;
+	      sampleInputs[10] = (columns[10] * 180.0 <= -ROLLCUTOFF) ? 1.0 : -1.0;
+
+	      stickToTargets(columns[11], columns[12], sampleTargets);
+	    }
+	  else
+	    {
+	      cout<<textFiles[f]<<":"<<lineNumber<<": expected 14 or 15 "
+		  <<"columns, found "<<numColumns<<endl;
+	      return -1;
+	    }
+
+	  writer.addSample(sampleInputs, sampleTargets);
+	}
+    }
+
+  if (!writer.write(outputFile))
+    {
+      return -1;
+    }
+
+  return writer.getNumSamples();
+}
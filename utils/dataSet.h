@@ -0,0 +1,229 @@
+// Binary training data sets for the neural nets.
+// One file holds any number of samples, laid out
+// as a header naming every input and output,
+// then all the inputs as one contiguous float
+// array, then all the targets, then (optionally)
+// a timestamp per sample. Sets recorded while
+// flying are laid out a row per sample instead
+// (DATASET_ROWS), so each batch can be added to
+// the end of the file as it comes. Reading
+// either is an mmap, not thousands of
+// operator>> calls.
+
+
+#ifndef DATASET_H
+#define DATASET_H
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+
+
+#define DATASET_MAGIC    "AADSET1"
+#define DATASET_VERSION  1
+
+#define DATASET_MAX_INPUTS   32
+#define DATASET_MAX_OUTPUTS  8
+#define DATASET_NAME_LENGTH  32
+
+// Header flags
+#define DATASET_HAS_TIMESTAMPS 0x1
+
+// Each sample is a row of its timestamp (if it
+// has one), inputs and targets, padded out to
+// 8 bytes. The offsets are of the first row's
+// inputs, targets and timestamp.
+#define DATASET_ROWS           0x2
+
+
+
+// The layout of the data sets the TargetSeeker
+// is trained on, see aiTrainer.c++
+#define EYE_INPUTS    11
+#define STICK_OUTPUTS 4
+
+extern const char* eyeInputNames[EYE_INPUTS];
+extern const char* stickOutputNames[STICK_OUTPUTS];
+
+// Turn -1..1 elevator and aileron deflections
+// (negative elevator is pulling back) into the
+// four stick targets. -1 means not at all, 1
+// means full deflection that way.
+extern void stickToTargets(float elevator, float aileron,
+			   float targets[STICK_OUTPUTS]);
+
+
+
+
+// On disk header, all offsets are
+// from the start of the file. Written
+// in host byte order.
+struct dataSetHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t numInputs;
+  uint32_t numOutputs;
+  uint64_t numSamples;
+
+  uint64_t inputsOffset;      // float[numSamples][numInputs]
+  uint64_t targetsOffset;     // float[numSamples][numOutputs]
+  uint64_t timestampsOffset;  // double[numSamples], or 0
+
+  char inputNames [DATASET_MAX_INPUTS] [DATASET_NAME_LENGTH];
+  char outputNames[DATASET_MAX_OUTPUTS][DATASET_NAME_LENGTH];
+};
+
+
+
+
+
+// Collects samples and writes them out as a
+// data set file when closed
+class DataSetWriter
+{
+ public:
+  DataSetWriter(int numInputs, int numOutputs,
+		const char** inputNames, const char** outputNames);
+  ~DataSetWriter();
+
+  void addSample(const float* inputs, const float* targets);
+  void addSample(const float* inputs, const float* targets,
+		 double timestamp);
+
+  long getNumSamples() const;
+
+  // Returns false if the file couldn't be written
+  bool write(std::string filename);
+
+
+ private:
+  dataSetHeader  header;
+  bool           haveTimestamps;
+
+  std::vector<float>  inputs;
+  std::vector<float>  targets;
+  std::vector<double> timestamps;
+};
+
+
+
+
+
+// Writes a data set as it's recorded, a row
+// per sample (see DATASET_ROWS). The file is
+// always a whole data set, of the samples
+// counted in its header by the last flush().
+class DataSetAppender
+{
+ public:
+  DataSetAppender(int numInputs, int numOutputs,
+		  const char** inputNames, const char** outputNames);
+  ~DataSetAppender();
+
+  // Starts the file again, empty. Returns
+  // false (and says why) if it can't.
+  bool open(std::string filename);
+  void close();
+
+  bool addSample(const float* inputs, const float* targets,
+		 double timestamp);
+
+  // Out to the file everything added since
+  // the last flush, then counted in the header
+  bool flush();
+
+  long getNumSamples() const;
+
+
+ private:
+  dataSetHeader  header;
+  FILE          *dataFile;
+  size_t         rowSize;
+  long           added;
+};
+
+
+
+
+
+// A data set file mapped into memory. The
+// get functions return pointers straight into
+// the mapping, nothing is copied.
+class DataSet
+{
+ public:
+  DataSet();
+  ~DataSet();
+
+  // Map a data set file. Returns false (and
+  // says why) if it isn't a valid data set
+  bool open(std::string filename);
+  void close();
+
+  // Quick check for the magic number,
+  // for telling binary sets from text ones
+  static bool isDataSetFile(std::string filename);
+
+  long getNumSamples() const;
+  int  getNumInputs()  const;
+  int  getNumOutputs() const;
+  bool hasTimestamps() const;
+
+  const char* getInputName(int i)  const;
+  const char* getOutputName(int i) const;
+
+  const float* getInputs(long sample)    const;
+  const float* getTargets(long sample)   const;
+  double       getTimestamp(long sample) const;
+
+
+  // Shuffled mini batches. shuffle() starts a
+  // new pass over the data in a new random
+  // order, nextBatch() hands out up to batchSize
+  // samples of it and returns how many it gave,
+  // 0 once the pass is done.
+  void shuffle(unsigned int seed);
+  int  nextBatch(int batchSize, const float** batchInputs,
+		 const float** batchTargets);
+
+
+ private:
+  int                  fd;
+  void                *mapping;
+  size_t               mappingSize;
+  const dataSetHeader *header;
+  const float         *inputs;
+  const float         *targets;
+  const double        *timestamps;
+
+  // Bytes from one sample's to the next
+  size_t               inputStride;
+  size_t               targetStride;
+  size_t               timestampStride;
+
+  std::vector<long>    order;
+  long                 nextInOrder;
+};
+
+
+
+
+
+// Convert the hand written / recorded text
+// sets into a single binary set. Understands
+// the current 15 column format (pureTrainingSet,
+// trainingFiles/dataSet_N) and the 14 column one
+// recorded by old/autoAgent (old/dataSet_N).
+// Returns the number of samples written, or
+// -1 on failure.
+extern long importTextDataSets(const std::vector<std::string>& textFiles,
+			       std::string outputFile);
+
+
+
+#endif // DATASET_H
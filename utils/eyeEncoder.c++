@@ -0,0 +1,154 @@
+// The TargetSeeker's eye encoding,
+// see eyeEncoder.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <math.h>
+#include <string.h>
+
+
+#include "eyeEncoder.h"
+
+
+
+
+// The 9 eye inputs for each cell, indexed
+// by vertical * 3 + side (top row first, left
+// column first). Input order is eyeInputNames:
+// center, upper, upperRight, right, lowerRight,
+// lower, lowerLeft, left, upperLeft
+static const float eyePatterns[EYE_CELLS][EYE_CELLS] =
+  {
+    // upper left
+    { -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0,  1.0 },
+    // upper
+    { -1.0,  1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0 },
+    // upper right
+    { -1.0, -1.0,  1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0 },
+
+    // left
+    { -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0,  1.0, -1.0 },
+    // center
+    {  1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0 },
+    // right
+    { -1.0, -1.0, -1.0,  1.0, -1.0, -1.0, -1.0, -1.0, -1.0 },
+
+    // lower left
+    { -1.0, -1.0, -1.0, -1.0, -1.0, -1.0,  1.0, -1.0, -1.0 },
+    // lower
+    { -1.0, -1.0, -1.0, -1.0, -1.0,  1.0, -1.0, -1.0, -1.0 },
+    // lower right
+    { -1.0, -1.0, -1.0, -1.0,  1.0, -1.0, -1.0, -1.0, -1.0 }
+  };
+
+
+
+
+// The comparisons are the same ones the old
+// if/else ladder made (a target dead on the
+// boundary is to the side, one at exactly 0
+// is to the left / below), just turned into
+// arithmetic on their 0/1 results.
+int eyeCell(const eyeSample &sample, const eyeBoundaries &boundaries)
+{
+  int onSide = (fabs(sample.bearing)   >= boundaries.side);
+  int onVert = (fabs(sample.elevation) >= boundaries.vertical);
+  int left   = (sample.relativeX <= 0.0);
+  int below  = (sample.relativeZ <= 0.0);
+
+  // 0 left, 1 ahead, 2 right
+  int side     = 1 + onSide * (1 - 2 * left);
+
+  // 0 above, 1 level, 2 below
+  int vertical = 1 + onVert * (2 * below - 1);
+
+  return vertical * 3 + side;
+}
+
+
+
+
+// 0 level, 1 rolled right, 2 rolled left.
+// Right wins if somebody sets a negative
+// cutoff, like the old code.
+static inline int rollState(const eyeSample &sample,
+			    const eyeBoundaries &boundaries)
+{
+  int rolledRight = (sample.roll >= boundaries.roll);
+  int rolledLeft  = (sample.roll <= -boundaries.roll) & !rolledRight;
+
+  return rolledRight + 2 * rolledLeft;
+}
+
+
+
+int eyeState(const eyeSample &sample, const eyeBoundaries &boundaries)
+{
+  return eyeCell(sample, boundaries) * EYE_ROLL_STATES +
+    rollState(sample, boundaries);
+}
+
+
+
+
+template<class inputType>
+static inline void encodeState(int cell, int roll, inputType *inputs)
+{
+  const float *pattern = eyePatterns[cell];
+
+  for (int i = 0; i < EYE_CELLS; i++)
+    {
+      inputs[i] = pattern[i];
+    }
+
+  inputs[EYE_CELLS]     = 2 * (roll == 1) - 1;
+  inputs[EYE_CELLS + 1] = 2 * (roll == 2) - 1;
+}
+
+
+
+template<class inputType>
+static inline void encodeOne(const eyeSample &sample,
+			     const eyeBoundaries &boundaries,
+			     inputType *inputs)
+{
+  encodeState(eyeCell(sample, boundaries), rollState(sample, boundaries),
+	      inputs);
+}
+
+
+
+void eyeStateInputs(int state, double inputs[EYE_INPUTS])
+{
+  encodeState(state / EYE_ROLL_STATES, state % EYE_ROLL_STATES, inputs);
+}
+
+
+
+
+void encodeEyes(const eyeSample &sample, const eyeBoundaries &boundaries,
+		float inputs[EYE_INPUTS])
+{
+  encodeOne(sample, boundaries, inputs);
+}
+
+
+
+void encodeEyes(const eyeSample &sample, const eyeBoundaries &boundaries,
+		double inputs[EYE_INPUTS])
+{
+  encodeOne(sample, boundaries, inputs);
+}
+
+
+
+void encodeEyesBatch(const eyeSample *samples, int count,
+		     const eyeBoundaries &boundaries, float *inputs)
+{
+  for (int i = 0; i < count; i++)
+    {
+      encodeOne(samples[i], boundaries, inputs + i * EYE_INPUTS);
+    }
+}
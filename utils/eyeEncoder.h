@@ -0,0 +1,100 @@
+// The 9 sensor "eye" the TargetSeeker neural
+// net sees the target with, plus the rolled
+// right/left flags. Used both when flying
+// (pilot.c++) and when recording or testing
+// (aiTrainer.c++), so the net always sees the
+// same encoding it was trained on.
+//
+// The target is to the left, ahead, or right,
+// and above, level, or below. Those two give
+// one of the 9 cells, which is looked up
+// instead of worked out with a chain of ifs.
+
+
+#ifndef EYEENCODER_H
+#define EYEENCODER_H
+
+
+#include "dataSet.h"
+
+
+
+#define EYE_CELLS 9
+
+// And with the roll flags, the eye inputs
+// only ever come in this many combinations,
+// one cell times rolled right, left or neither
+#define EYE_ROLL_STATES 3
+#define EYE_STATES      (EYE_CELLS * EYE_ROLL_STATES)
+
+
+
+// Where the target is, relative to the
+// aircraft. Bearing and elevation are in
+// degrees off the nose, relativeX is positive
+// to the right, relativeZ positive above.
+// Roll is in degrees, right wing down positive.
+struct eyeSample
+{
+  float  bearing;
+  float  elevation;
+  double relativeX;
+  double relativeZ;
+  double roll;
+};
+
+
+
+// Angles at which the target counts as
+// to the side / above or below, and the
+// roll at which the aircraft counts as rolled
+struct eyeBoundaries
+{
+  float  side;
+  float  vertical;
+  double roll;
+};
+
+
+
+// Write the EYE_INPUTS net inputs (in the
+// order of eyeInputNames) for one sample.
+// The double version can write straight into
+// a NeuralNetwork's input layer.
+extern void encodeEyes(const eyeSample &sample,
+		       const eyeBoundaries &boundaries,
+		       float inputs[EYE_INPUTS]);
+
+extern void encodeEyes(const eyeSample &sample,
+		       const eyeBoundaries &boundaries,
+		       double inputs[EYE_INPUTS]);
+
+
+// Many samples (agents, recorded frames) at
+// once, inputs is count * EYE_INPUTS floats
+extern void encodeEyesBatch(const eyeSample *samples, int count,
+			    const eyeBoundaries &boundaries,
+			    float *inputs);
+
+
+// Which of the 9 cells is active for a sample,
+// 0 being upper left, 8 lower right, reading
+// across. Handy for printing the eye.
+extern int eyeCell(const eyeSample &sample,
+		   const eyeBoundaries &boundaries);
+
+
+// Which of the EYE_STATES a sample's inputs
+// are, cell * 3 + roll (0 level, 1 rolled
+// right, 2 rolled left). A brain that sees
+// the eyes can be worked out for all of them
+// beforehand, see brainTable.h.
+extern int eyeState(const eyeSample &sample,
+		    const eyeBoundaries &boundaries);
+
+// The EYE_INPUTS net inputs for a state
+extern void eyeStateInputs(int state, double inputs[EYE_INPUTS]);
+
+
+
+#endif // EYEENCODER_H
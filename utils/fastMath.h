@@ -0,0 +1,261 @@
+// Fast replacements for the libm calls on the
+// control path: exp() for the neurons of the
+// nets, acos() for the target bearing and
+// elevation, and sin/cos/atan2 for geometry.
+//
+// All inline, no tables and no branches the
+// compiler can't turn into selects, so loops
+// over them (the *Array versions) vectorize.
+// That takes -O3 -fno-trapping-math
+// -fno-math-errno, without them gcc keeps the
+// compares and the sqrt as branches. Built
+// the way autoAgent and aiTrainer are (no
+// -O) only sin/cos beats libm, exp and the
+// sigmoid take more than twice as long. So
+// the neurons stay on libm's exp(). fastAcos
+// is used for its clamp, not its speed.
+//
+// Largest errors against libm, measured by
+// mathbench over the ranges the project uses
+// (see mathBench.c++, which fails if any of
+// these is exceeded):
+//
+//   fastExp      relative 1e-15,  |x| <= 700
+//   fastSigmoid  absolute 5e-16,  any x
+//   fastAcos     absolute 3e-8 radians (about
+//                2e-6 degrees), x in -1..1.
+//                Outside -1..1 x is clamped,
+//                where acos() would give NaN.
+//   fastAtan2    absolute 2e-8 radians
+//   fastSinCos   absolute 5e-16,  |x| <= 1000
+
+
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+
+#include <stdint.h>
+#include <string.h>
+
+
+
+#define FASTMATH_EXP_MAX_REL_ERROR     1e-15
+#define FASTMATH_SIGMOID_MAX_ERROR     5e-16
+#define FASTMATH_ACOS_MAX_ERROR        3e-8
+#define FASTMATH_ATAN2_MAX_ERROR       2e-8
+#define FASTMATH_SINCOS_MAX_ERROR      5e-16
+
+#define FASTMATH_PI      3.14159265358979323846
+#define FASTMATH_HALF_PI 1.57079632679489661923
+
+
+
+// Adding and taking away 1.5 * 2^52 rounds
+// to the nearest integer without a call
+#define FASTMATH_ROUNDER 6755399441055744.0
+
+static const double FASTMATH_ROUNDER_VALUE = FASTMATH_ROUNDER;
+
+
+
+
+static inline double fastClamp(double x, double low, double high)
+{
+  x = (x < low)  ? low  : x;
+  x = (x > high) ? high : x;
+  return x;
+}
+
+
+
+
+// e^x as 2^n * e^r, |r| <= ln(2)/2, with
+// e^r from its Taylor series. n comes out of
+// the rounding trick already sitting in the
+// low bits of shifted, so 2^n is built with
+// integer adds and shifts, which vectorize
+// where a double to integer conversion won't.
+static inline double fastExp(double x)
+{
+  const double log2e = 1.4426950408889634;
+  const double ln2Hi = 6.93147180369123816490e-01;
+  const double ln2Lo = 1.90821492927058770002e-10;
+
+  double  shifted, n, r, p, scale;
+  int64_t bits, rounderBits;
+
+  x = fastClamp(x, -700.0, 700.0);
+
+  shifted = x * log2e + FASTMATH_ROUNDER;
+  n       = shifted - FASTMATH_ROUNDER;
+  r       = (x - n * ln2Hi) - n * ln2Lo;
+
+  p = 1.0 + r * (1.0 + r * (1.0 / 2 + r * (1.0 / 6 + r * (1.0 / 24 +
+      r * (1.0 / 120 + r * (1.0 / 720 + r * (1.0 / 5040 +
+      r * (1.0 / 40320 + r * (1.0 / 362880 + r * (1.0 / 3628800 +
+      r * (1.0 / 39916800 + r * (1.0 / 479001600))))))))))));
+
+  // 2^n, straight into the exponent bits
+  memcpy(&bits, &shifted, sizeof(bits));
+  memcpy(&rounderBits, &FASTMATH_ROUNDER_VALUE, sizeof(rounderBits));
+  bits = (bits - rounderBits + 1023) << 52;
+  memcpy(&scale, &bits, sizeof(scale));
+
+  return p * scale;
+}
+
+
+
+
+// The neurons' activation, 1 / (1 + e^-x)
+static inline double fastSigmoid(double x)
+{
+  return 1.0 / (1.0 + fastExp(-x));
+}
+
+
+
+
+// Abramowitz and Stegun 4.4.46, for |x| <= 1
+static inline double fastAcos(double x)
+{
+  double a, r;
+
+  x = fastClamp(x, -1.0, 1.0);
+  a = (x < 0.0) ? -x : x;
+
+  r = 1.5707963050 + a * (-0.2145988016 + a * (0.0889789874 +
+      a * (-0.0501743046 + a * (0.0308918810 + a * (-0.0170881256 +
+      a * (0.0066700901 + a * (-0.0012624911)))))));
+  r *= __builtin_sqrt(1.0 - a);
+
+  return (x < 0.0) ? FASTMATH_PI - r : r;
+}
+
+
+
+
+// Abramowitz and Stegun 4.4.49 for the first
+// octant, then unfolded into the others
+static inline double fastAtan2(double y, double x)
+{
+  double ax = (x < 0.0) ? -x : x;
+  double ay = (y < 0.0) ? -y : y;
+  double mx = (ax > ay) ? ax : ay;
+  double mn = (ax > ay) ? ay : ax;
+  double z, z2, r;
+
+  z  = (mx > 0.0) ? mn / mx : 0.0;
+  z2 = z * z;
+
+  r = z * (1.0 + z2 * (-0.3333314528 + z2 * (0.1999355085 +
+      z2 * (-0.1420889944 + z2 * (0.1065626393 + z2 * (-0.0752896400 +
+      z2 * (0.0429096138 + z2 * (-0.0161657367 + z2 * 0.0028662257))))))));
+
+  r = (ay > ax)  ? FASTMATH_HALF_PI - r : r;
+  r = (x  < 0.0) ? FASTMATH_PI - r : r;
+  r = (y  < 0.0) ? -r : r;
+
+  return r;
+}
+
+
+
+
+// Both at once, reduced to |r| <= pi/4
+// around the nearest multiple of pi/2
+static inline void fastSinCos(double x, double &sine, double &cosine)
+{
+  const double twoOverPi = 0.63661977236758134308;
+  const double halfPiHi  = 1.57079632673412561417e+00;
+  const double halfPiLo  = 6.07710050650619224932e-11;
+
+  double  shifted, q, r, r2, s, c;
+  uint64_t quadrant, rounderBits, sBits, cBits, swap;
+
+  shifted = x * twoOverPi + FASTMATH_ROUNDER;
+  q       = shifted - FASTMATH_ROUNDER;
+  r       = (x - q * halfPiHi) - q * halfPiLo;
+
+  r2 = r * r;
+  s  = r * (1.0 - r2 * (1.0 / 6 - r2 * (1.0 / 120 - r2 * (1.0 / 5040 -
+       r2 * (1.0 / 362880 - r2 * (1.0 / 39916800 - r2 * (1.0 / 6227020800.0 -
+       r2 / 1307674368000.0)))))));
+  c  = 1.0 - r2 * (1.0 / 2 - r2 * (1.0 / 24 - r2 * (1.0 / 720 -
+       r2 * (1.0 / 40320 - r2 * (1.0 / 3628800 - r2 * (1.0 / 479001600 -
+       r2 * (1.0 / 87178291200.0 - r2 / 20922789888000.0)))))));
+
+  // Quadrant 1 and 3 swap sine and cosine,
+  // 2 and 3 flip the sine, 1 and 2 the cosine.
+  // Done on the bits, like fastExp's 2^n.
+  memcpy(&quadrant, &shifted, sizeof(quadrant));
+  memcpy(&rounderBits, &FASTMATH_ROUNDER_VALUE, sizeof(rounderBits));
+  memcpy(&sBits, &s, sizeof(sBits));
+  memcpy(&cBits, &c, sizeof(cBits));
+  quadrant -= rounderBits;
+
+  swap   = -(quadrant & 1);
+  sBits ^= cBits & swap;
+  cBits ^= sBits & swap;
+  sBits ^= cBits & swap;
+
+  sBits ^= (quadrant & 2) << 62;
+  cBits ^= ((quadrant + 1) & 2) << 62;
+
+  memcpy(&sine, &sBits, sizeof(sine));
+  memcpy(&cosine, &cBits, sizeof(cosine));
+}
+
+
+
+
+// Array versions, in and out may be the same
+static inline void fastExpArray(const double *in, double *out, int count)
+{
+  for (int i = 0; i < count; i++)
+    {
+      out[i] = fastExp(in[i]);
+    }
+}
+
+
+static inline void fastSigmoidArray(const double *in, double *out, int count)
+{
+  for (int i = 0; i < count; i++)
+    {
+      out[i] = fastSigmoid(in[i]);
+    }
+}
+
+
+static inline void fastAcosArray(const double *in, double *out, int count)
+{
+  for (int i = 0; i < count; i++)
+    {
+      out[i] = fastAcos(in[i]);
+    }
+}
+
+
+static inline void fastAtan2Array(const double *y, const double *x,
+				  double *out, int count)
+{
+  for (int i = 0; i < count; i++)
+    {
+      out[i] = fastAtan2(y[i], x[i]);
+    }
+}
+
+
+static inline void fastSinCosArray(const double *in, double *sine,
+				   double *cosine, int count)
+{
+  for (int i = 0; i < count; i++)
+    {
+      fastSinCos(in[i], sine[i], cosine[i]);
+    }
+}
+
+
+
+#endif // FASTMATH_H
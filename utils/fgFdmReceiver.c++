@@ -65,6 +65,14 @@ FgFdmReceiver::FgFdmReceiver(int port)
   data.heading   = 0.0;
   data.aoa       = 0.0;
   data.sideSlip  = 0.0;
+  data.airspeed  = 0.0;
+  data.rollRate  = 0.0;
+  data.pitchRate = 0.0;
+  data.yawRate   = 0.0;
+  data.vNorth    = 0.0;
+  data.vEast     = 0.0;
+  data.vDown     = 0.0;
+  data.fdmTime   = 0;
 
 
   if ((sockfd = socket(AF_INET, SOCK_DGRAM, 0)) == -1) 
@@ -134,6 +142,13 @@ void FgFdmReceiver::update()
   data.aoa       = fdm.alpha     * RAD2DEG;
   data.sideSlip  = fdm.beta      * RAD2DEG;
   data.airspeed  = fdm.vcas;
+  data.rollRate  = fdm.phidot    * RAD2DEG;
+  data.pitchRate = fdm.thetadot  * RAD2DEG;
+  data.yawRate   = fdm.psidot    * RAD2DEG;
+  data.vNorth    = fdm.v_north;
+  data.vEast     = fdm.v_east;
+  data.vDown     = fdm.v_down;
+  data.fdmTime   = fdm.cur_time;
 }
 
 
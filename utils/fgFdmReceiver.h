@@ -17,6 +17,9 @@
 #define FGFDMRECEIVER_H
 
 
+// For socklen_t
+#include <sys/socket.h>
+
 // From the flightgear src/Network/ directory
 // Defines the class object pass over the network
 // socket, FGNetFDM
@@ -58,6 +61,19 @@ struct localDataStruct
   float  aoa;      
   float  sideSlip;
   float  airspeed;
+
+  // How it's all changing, for working out
+  // where the aircraft is by the time the
+  // controls get there (stateEstimator.h)
+  float  rollRate;   // degrees/second
+  float  pitchRate;
+  float  yawRate;
+  float  vNorth;     // feet/second
+  float  vEast;
+  float  vDown;
+
+  // FlightGear's clock, unix seconds
+  unsigned int fdmTime;
 };
 
 
@@ -0,0 +1,271 @@
+// Positions to GVP off the flying path,
+// see gvpSender.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <stdio.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+
+// These defines are
+// needed by gvpApiClient
+// to correctly find
+// the TAO corba headers
+#define LINUX
+#define ACE_5_4_6
+
+#include "gvpApiClient.hpp"
+#include "gvpTimer.hpp"
+
+#include "gvpSender.h"
+
+
+
+
+GvpSender::GvpSender(const TelemetryBus &bus, string gvpHost, int gvpPort,
+		     double displayRate):
+  fdm(bus),
+  display("GVP display", displayRate)
+{
+  host        = gvpHost;
+  port        = gvpPort;
+  gvp         = NULL;
+  view        = 0;
+  sent        = 0;
+  dropped     = 0;
+  disconnects = 0;
+  lastSent    = 0;
+  stopPipe[0] = -1;
+  stopPipe[1] = -1;
+  running     = false;
+}
+
+
+
+GvpSender::~GvpSender()
+{
+  stop();
+}
+
+
+
+bool GvpSender::start()
+{
+  if (running)
+    {
+      return true;
+    }
+
+  if ((pipe(stopPipe) == -1) ||
+      (pthread_create(&senderThread, NULL, senderThreadFunc, this) != 0))
+    {
+      perror("GvpSender: starting the sender thread");
+      stop();
+      return false;
+    }
+  running = true;
+
+  return true;
+}
+
+
+
+void GvpSender::stop()
+{
+  if (running)
+    {
+      // Wakes up any pause()
+      if (write(stopPipe[1], "x", 1) != 1)
+	{
+	  perror("GvpSender::stop");
+	}
+      pthread_join(senderThread, NULL);
+      running = false;
+    }
+
+  for (int i = 0; i < 2; i++)
+    {
+      if (stopPipe[i] != -1)
+	{
+	  close(stopPipe[i]);
+	  stopPipe[i] = -1;
+	}
+    }
+}
+
+
+
+long GvpSender::getSent() const
+{
+  return sent;
+}
+
+
+long GvpSender::getDropped() const
+{
+  return dropped;
+}
+
+
+long GvpSender::getDisconnects() const
+{
+  return disconnects;
+}
+
+
+
+void GvpSender::report() const
+{
+  cout<<"GVP: "<<sent<<" poses sent, "<<dropped<<" not shown, "
+      <<disconnects<<" times disconnected"<<endl;
+  display.report();
+}
+
+
+
+
+/******************************************
+ Private Functions
+*******************************************/
+
+
+
+void *GvpSender::senderThreadFunc(void *sender)
+{
+  // Nicer than the flying threads, so on a
+  // busy machine it's the display that waits
+  if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10) == -1)
+    {
+      perror("GvpSender: setpriority");
+    }
+
+  ((GvpSender*)sender)->sendPoses();
+  return NULL;
+}
+
+
+
+void GvpSender::sendPoses()
+{
+  telemetrySample sample;
+  double          backOff = GVP_RECONNECT_FIRST;
+  double          now;
+
+  while (true)
+    {
+      if (gvp == NULL)
+	{
+	  if (connect())
+	    {
+	      backOff = GVP_RECONNECT_FIRST;
+	    }
+	  else
+	    {
+	      if (!pause(backOff))
+		{
+		  break;
+		}
+
+	      backOff *= 2.0;
+	      if (backOff > GVP_RECONNECT_MOST)
+		{
+		  backOff = GVP_RECONNECT_MOST;
+		}
+	      continue;
+	    }
+	}
+
+      now = RateGroup::now();
+
+      if (!display.due(now))
+	{
+	  if (!pause(display.nextRelease() - now))
+	    {
+	      break;
+	    }
+	  continue;
+	}
+
+      // Only the newest, nothing new since
+      // the last one, nothing to show
+      if (fdm.latest(sample) && (sample.sequence != lastSent))
+	{
+	  try
+	    {
+	      gvp->setPositionGeo(currentTime(), view,
+				  sample.fdm.latitude, sample.fdm.longitude,
+				  sample.fdm.altitude * FEET2MET,
+				  sample.fdm.heading,
+				  sample.fdm.pitch, sample.fdm.roll);
+	    }
+	  catch (...)
+	    {
+	      cout<<"GvpSender: lost GVP on "<<host<<", reconnecting"<<endl;
+	      disconnects++;
+	      disconnect();
+	      continue;
+	    }
+
+	  if (lastSent > 0)
+	    {
+	      dropped += sample.sequence - lastSent - 1;
+	    }
+	  lastSent = sample.sequence;
+	  sent++;
+	}
+
+      display.finished(RateGroup::now());
+    }
+
+  disconnect();
+}
+
+
+
+// Whatever TAO throws when GVP isn't
+// there (TRANSIENT, COMM_FAILURE...)
+// just means try again later
+bool GvpSender::connect()
+{
+  try
+    {
+      gvp  = new gvpApiClient(host.c_str(), port);
+      view = gvp->getViewEntity();
+    }
+  catch (...)
+    {
+      disconnect();
+      return false;
+    }
+
+  cout<<"GvpSender: connected to GVP on "<<host<<":"<<port<<endl;
+  return true;
+}
+
+
+
+void GvpSender::disconnect()
+{
+  delete gvp;
+  gvp = NULL;
+}
+
+
+
+bool GvpSender::pause(double seconds)
+{
+  struct pollfd waitFor;
+  int           timeout = (int)(seconds * 1000.0 + 0.5);
+
+  waitFor.fd     = stopPipe[0];
+  waitFor.events = POLLIN;
+
+  // Interrupted by a signal counts as
+  // having waited, only the pipe stops us
+  return poll(&waitFor, 1, (timeout > 0) ? timeout : 0) != 1;
+}
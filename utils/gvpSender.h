@@ -0,0 +1,98 @@
+// Sends the aircraft's position to the GVP
+// viewpoint, on its own thread, so a slow or
+// missing GVP host can never hold up the
+// FDM or the control loop.
+//
+// The thread takes the newest sample off the
+// telemetry bus at the display rate, anything
+// published in between is just not shown. If
+// a call to GVP fails the client is thrown
+// away and the thread keeps trying to connect
+// again, backing off, while everything else
+// carries on flying.
+
+
+#ifndef GVPSENDER_H
+#define GVPSENDER_H
+
+
+#include <pthread.h>
+#include <string>
+
+#include "telemetryBus.h"
+#include "rateGroup.h"
+
+
+
+// Poses a second sent to GVP
+#ifndef GVP_DISPLAY_RATE
+#define GVP_DISPLAY_RATE 15.0
+#endif
+
+// Seconds between tries at reconnecting,
+// doubling up to the most
+#define GVP_RECONNECT_FIRST  1.0
+#define GVP_RECONNECT_MOST  30.0
+
+
+
+// From gvpApiClient.hpp, only the
+// sender's own file needs TAO
+class gvpApiClient;
+
+
+
+class GvpSender
+{
+ public:
+  GvpSender(const TelemetryBus &bus, std::string gvpHost, int gvpPort,
+	    double displayRate = GVP_DISPLAY_RATE);
+  ~GvpSender();
+
+  bool start();
+  void stop();
+
+  // Poses sent, poses published that weren't
+  // (between sends, or while GVP was away),
+  // and times the connection was lost
+  long getSent()        const;
+  long getDropped()     const;
+  long getDisconnects() const;
+
+  // The counts, and how the sends kept
+  // up with the display rate
+  void report() const;
+
+
+ private:
+  TelemetrySubscriber fdm;
+  RateGroup           display;
+
+  std::string   host;
+  int           port;
+  gvpApiClient *gvp;
+  unsigned long view;
+
+  long sent;
+  long dropped;
+  long disconnects;
+  unsigned long long lastSent;
+
+  int       stopPipe[2];
+  pthread_t senderThread;
+  bool      running;
+
+  static void *senderThreadFunc(void *sender);
+  void  sendPoses();
+
+  bool  connect();
+  void  disconnect();
+
+  // Returns false if told to stop meanwhile
+  bool  pause(double seconds);
+};
+
+
+
+
+#endif // GVPSENDER_H
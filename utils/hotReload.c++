@@ -0,0 +1,228 @@
+// Reloading brains and courses while
+// flying, see hotReload.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+
+#include "hotReload.h"
+
+
+
+
+HotReloader::HotReloader()
+{
+  inotifyFd   = -1;
+  stopPipe[0] = -1;
+  stopPipe[1] = -1;
+  running     = false;
+}
+
+
+
+HotReloader::~HotReloader()
+{
+  stop();
+}
+
+
+
+void HotReloader::watch(string path, reloadFunction reload, void *context)
+{
+  watchedFile file;
+  size_t      slash = path.rfind('/');
+
+  if (slash == string::npos)
+    {
+      file.directory = ".";
+      file.name      = path;
+    }
+  else
+    {
+      file.directory = (slash == 0) ? "/" : path.substr(0, slash);
+      file.name      = path.substr(slash + 1);
+    }
+
+  file.path    = path;
+  file.watch   = -1;
+  file.reload  = reload;
+  file.context = context;
+
+  files.push_back(file);
+}
+
+
+
+bool HotReloader::start()
+{
+  if (running)
+    {
+      return true;
+    }
+
+  if ((inotifyFd = inotify_init1(IN_CLOEXEC)) == -1)
+    {
+      perror("HotReloader: inotify_init1");
+      return false;
+    }
+
+  // A finished write, or a file renamed
+  // over the one we're flying with
+  for (size_t i = 0; i < files.size(); i++)
+    {
+      files[i].watch = inotify_add_watch(inotifyFd,
+					 files[i].directory.c_str(),
+					 IN_CLOSE_WRITE | IN_MOVED_TO);
+
+      if (files[i].watch == -1)
+	{
+	  cout<<"HotReloader: can't watch "<<files[i].directory<<": "
+	      <<strerror(errno)<<endl;
+	  stop();
+	  return false;
+	}
+    }
+
+  if ((pipe(stopPipe) == -1) ||
+      (pthread_create(&reloadThread, NULL, reloadThreadFunc, this) != 0))
+    {
+      perror("HotReloader: starting the reload thread");
+      stop();
+      return false;
+    }
+  running = true;
+
+  for (size_t i = 0; i < files.size(); i++)
+    {
+      cout<<"HotReloader: watching "<<files[i].path<<endl;
+    }
+
+  return true;
+}
+
+
+
+void HotReloader::stop()
+{
+  if (running)
+    {
+      // Wakes the poll() up
+      if (write(stopPipe[1], "x", 1) != 1)
+	{
+	  perror("HotReloader::stop");
+	}
+      pthread_join(reloadThread, NULL);
+      running = false;
+    }
+
+  if (inotifyFd != -1)
+    {
+      close(inotifyFd);
+      inotifyFd = -1;
+    }
+
+  for (int i = 0; i < 2; i++)
+    {
+      if (stopPipe[i] != -1)
+	{
+	  close(stopPipe[i]);
+	  stopPipe[i] = -1;
+	}
+    }
+}
+
+
+
+
+/******************************************
+ Private Functions
+*******************************************/
+
+
+
+void *HotReloader::reloadThreadFunc(void* reloader)
+{
+  ((HotReloader*)reloader)->watchForChanges();
+  return NULL;
+}
+
+
+
+void HotReloader::watchForChanges()
+{
+  // Room for a good few events at once
+  char  events[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)]
+    __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *event;
+  struct pollfd               waitFor[2];
+  vector<bool>                changed(files.size());
+  ssize_t                     length;
+
+  waitFor[0].fd     = inotifyFd;
+  waitFor[0].events = POLLIN;
+  waitFor[1].fd     = stopPipe[0];
+  waitFor[1].events = POLLIN;
+
+  while (true)
+    {
+      if (poll(waitFor, 2, -1) == -1)
+	{
+	  if (errno == EINTR)
+	    {
+	      continue;
+	    }
+	  perror("HotReloader: poll");
+	  return;
+	}
+
+      if (waitFor[1].revents)
+	{
+	  return;
+	}
+
+      if ((length = read(inotifyFd, events, sizeof(events))) <= 0)
+	{
+	  continue;
+	}
+
+      // A save can be a burst of events,
+      // reload each file once for all of them
+      for (size_t i = 0; i < files.size(); i++)
+	{
+	  changed[i] = false;
+	}
+
+      for (char *next = events; next < events + length;
+	   next += sizeof(struct inotify_event) + event->len)
+	{
+	  event = (const struct inotify_event*)next;
+
+	  for (size_t i = 0; i < files.size(); i++)
+	    {
+	      if ((event->wd == files[i].watch) && (event->len > 0) &&
+		  (files[i].name == event->name))
+		{
+		  changed[i] = true;
+		}
+	    }
+	}
+
+      for (size_t i = 0; i < files.size(); i++)
+	{
+	  if (changed[i])
+	    {
+	      cout<<"HotReloader: "<<files[i].path<<" changed, reloading"<<endl;
+	      files[i].reload(files[i].path, files[i].context);
+	    }
+	}
+    }
+}
@@ -0,0 +1,144 @@
+// Swapping in a new brain or course while
+// flying, without stopping the control loop.
+//
+// A HotReloader thread watches files with
+// inotify. When one is rewritten or replaced
+// it calls that file's reload function, still
+// on its own thread, which loads and checks
+// the new version and publish()es it into a
+// ReloadSlot. The control thread calls
+// swapIn() once a tick. That's an atomic
+// exchange, so the tick never waits on a file.
+//
+// The object being replaced isn't freed right
+// away, the control thread could still have
+// been using it. It's retired into the slot
+// and freed by the next publish(), by which
+// time the tick that swapped it out is long
+// over (RCU style, the tick boundary is the
+// grace period).
+
+
+#ifndef HOTRELOAD_H
+#define HOTRELOAD_H
+
+
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+
+
+// One new version at a time going to the
+// control thread, and one old one coming back
+template<class objectType>
+class ReloadSlot
+{
+ public:
+  ReloadSlot()
+  {
+    pending = NULL;
+    retired = NULL;
+  }
+
+  ~ReloadSlot()
+  {
+    delete pending.exchange(NULL);
+    delete retired.exchange(NULL);
+  }
+
+
+  // Reload thread. Takes ownership. A version
+  // the control thread never picked up is
+  // simply replaced.
+  void publish(objectType *fresh)
+  {
+    delete retired.exchange(NULL);
+    delete pending.exchange(fresh);
+  }
+
+
+  // Control thread, never blocks. If there's
+  // a new version, current becomes it and the
+  // old one is handed back to be freed.
+  bool swapIn(objectType *&current)
+  {
+    objectType *fresh = pending.exchange(NULL);
+
+    if (fresh == NULL)
+      {
+	return false;
+      }
+
+    // Only not NULL if two versions came in
+    // before the reload thread got round to
+    // freeing the first old one, rare enough
+    // to free here
+    delete retired.exchange(current);
+
+    current = fresh;
+    return true;
+  }
+
+
+ private:
+  std::atomic<objectType*> pending;
+  std::atomic<objectType*> retired;
+};
+
+
+
+
+
+// Called on the reload thread with the
+// path of the file that changed
+typedef void (*reloadFunction)(const std::string &path, void *context);
+
+
+
+class HotReloader
+{
+ public:
+  HotReloader();
+  ~HotReloader();
+
+  // Add the files before start()
+  void watch(std::string path, reloadFunction reload, void *context);
+
+  // Returns false (and says why) if the files
+  // can't be watched, flying carries on with
+  // what was loaded at startup
+  bool start();
+  void stop();
+
+
+ private:
+  // The directory is watched, not the file,
+  // so files replaced by a rename (which is
+  // how a finished brain should be dropped
+  // in) are seen too
+  struct watchedFile
+  {
+    std::string    directory;
+    std::string    name;
+    std::string    path;
+    int            watch;
+    reloadFunction reload;
+    void          *context;
+  };
+
+  std::vector<watchedFile> files;
+
+  int       inotifyFd;
+  int       stopPipe[2];
+  pthread_t reloadThread;
+  bool      running;
+
+  static void *reloadThreadFunc(void* reloader);
+  void  watchForChanges();
+};
+
+
+
+#endif // HOTRELOAD_H
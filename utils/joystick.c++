@@ -5,11 +5,30 @@
 
 #include <iostream>
 using namespace std;
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
 
 #include "joystick.h"
 
 
 
+// Bit n of an evdev bitmask
+#define TESTBIT(bits, n) \
+  ((bits)[(n) / (8 * sizeof(long))] & (1UL << ((n) % (8 * sizeof(long)))))
+
+#define BITMASKLONGS(count) (((count) + 8 * sizeof(long) - 1) / \
+			     (8 * sizeof(long)))
+
+
+
 
 /******************************************
  Public Functions
@@ -20,30 +39,128 @@ using namespace std;
 // of joysticks on the computer.
 Joystick::Joystick(int jsNumber)
 {
+  unsigned long absBits[BITMASKLONGS(ABS_CNT)];
+  unsigned long keyBits[BITMASKLONGS(KEY_CNT)];
+  int           clock = CLOCK_MONOTONIC;
+  char          name[128];
+  string        path;
+  struct epoll_event watch;
+  struct timespec    now;
+
   joystickNumber = jsNumber;
 
-  js = new jsJoystick(joystickNumber);
-  
-  if (!js)
+  path = findDevice(joystickNumber);
+  if (path.empty())
+    {
+      cout<<"Joystick "<<joystickNumber<<" isn't plugged in!"<<endl;
+      exit(1);
+    }
+
+  device = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (device == -1)
+    {
+      perror(("Joystick: opening " + path).c_str());
+      exit(1);
+    }
+
+  // Stamp events on the same clock as
+  // everything else
+  if (ioctl(device, EVIOCSCLOCKID, &clock) == -1)
+    {
+      perror("Joystick: EVIOCSCLOCKID");
+    }
+
+  if (ioctl(device, EVIOCGNAME(sizeof(name)), name) < 0)
+    {
+      strcpy(name, "Unknown");
+    }
+  cout<<"Joystick: "<<name<<" ("<<path<<")"<<endl;
+
+  memset(absBits, 0, sizeof(absBits));
+  memset(keyBits, 0, sizeof(keyBits));
+  ioctl(device, EVIOCGBIT(EV_ABS, sizeof(absBits)), absBits);
+  ioctl(device, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits);
+
+
+  // Every absolute axis, in code order
+  numberOfAxes = 0;
+  for (int code = 0; code < ABS_CNT; code++)
+    {
+      axisOf[code] = -1;
+
+      if (TESTBIT(absBits, code) && (numberOfAxes < MAXAXIS) &&
+	  (ioctl(device, EVIOCGABS(code), &axisRanges[numberOfAxes]) == 0))
+	{
+	  axisCodes[numberOfAxes] = code;
+	  axisOf[code]            = numberOfAxes++;
+	}
+    }
+
+  // The joystick buttons first, then
+  // the rest of the BTN_MISC and up
+  numberOfButtons = 0;
+  for (int code = 0; code < KEY_CNT; code++)
+    {
+      buttonOf[code] = -1;
+    }
+
+  for (int i = 0; i < KEY_CNT - BTN_MISC; i++)
     {
-      cout<<"Error instantiating a jsJoystick in Joystick::Joystick()"
-	  <<endl;
+      int code = BTN_MISC + (i + BTN_JOYSTICK - BTN_MISC) % (KEY_CNT - BTN_MISC);
+
+      if (TESTBIT(keyBits, code) && (numberOfButtons < MAXBUTTONS))
+	{
+	  buttonCodes[numberOfButtons] = code;
+	  buttonOf[code]               = numberOfButtons++;
+	}
+    }
+
+  if (numberOfAxes == 0)
+    {
+      cout<<"Joystick "<<joystickNumber<<" hasn't got any axes!"<<endl;
       exit(1);
     }
 
-  jsInit();
-  
-  cout<<"Joystick: "<<js->getName()<<endl;
+  memset(&pending, 0, sizeof(pending));
+  memset(axis, 0, sizeof(axis));
+  pending.numberOfAxes = numberOfAxes;
+  dropped              = false;
+
+  sequence.store(0);
+  eventLog.store(NULL);
+  events.store(0);
+
+  // Where the stick is now, before
+  // it's moved at all
+  resync();
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  publish(now.tv_sec + now.tv_nsec * 1e-9);
 
-  if (js->notWorking())
+
+  // The reader thread sleeps on
+  // the device and the stop pipe
+  running = false;
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+  if ((epollFd == -1) || (pipe2(stopPipe, O_CLOEXEC) == -1))
     {
-      cout<<"Joystick "<<joystickNumber<<" isn't responding!"<<endl;
+      perror("Joystick: setting up the reader");
       exit(1);
     }
-  
-  jsVals.numberOfAxes = js->getNumAxes();
 
-  axis = new float[jsVals.numberOfAxes];
+  watch.events  = EPOLLIN;
+  watch.data.fd = device;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, device, &watch);
+
+  watch.data.fd = stopPipe[0];
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, stopPipe[0], &watch);
+
+  if (pthread_create(&readerThread, NULL, readerThreadFunc, this) != 0)
+    {
+      perror("Joystick: starting the reader thread");
+      exit(1);
+    }
+  running = true;
 }
 
 
@@ -51,50 +168,329 @@ Joystick::Joystick(int jsNumber)
 // Destructor
 Joystick::~Joystick()
 {
-  delete js;
-  delete axis;
+  FILE *log;
+
+  if (running)
+    {
+      // Wakes the epoll up
+      if (write(stopPipe[1], "x", 1) != 1)
+	{
+	  perror("Joystick::~Joystick");
+	}
+      pthread_join(readerThread, NULL);
+    }
+
+  close(stopPipe[0]);
+  close(stopPipe[1]);
+  close(epollFd);
+  close(device);
+
+  log = eventLog.exchange(NULL);
+  if (log)
+    {
+      fclose(log);
+    }
 }
 
 
 
-joystickValues Joystick::getJoystickValues()
+// A copy of the last batch, tried
+// again in the rare case the reader
+// was writing it at the same time
+joystickValues Joystick::getJoystickValues() const
 {
-  static int buttons;
-  static int i;
-  static int counter;
-  static int value;
+  joystickValues values;
+  unsigned long  before;
+
+  do
+    {
+      before = sequence.load(std::memory_order_acquire);
+      values = published;
+      std::atomic_thread_fence(std::memory_order_acquire);
+    }
+  while ((before & 1) || (sequence.load(std::memory_order_relaxed) != before));
 
-  js->read(&buttons, axis);
+  return values;
+}
 
-  jsVals.aileron      =  axis[0];
-  jsVals.elevator     = -axis[1];
-  jsVals.rudder       =  axis[2];
-  jsVals.throttle     = -axis[3];
-  jsVals.hatLeftRight =  axis[4];
-  jsVals.hatUpDown    =  axis[5];
 
-  
-  for (int i = 0; i < MAXBUTTONS; i++)
+
+bool Joystick::recordEvents(string filename)
+{
+  FILE *log;
+
+  if (eventLog.load())
+    {
+      return false;
+    }
+
+  log = fopen(filename.c_str(), "w");
+  if (log == NULL)
     {
-      jsVals.buttons[i] = 0;
+      perror(("Joystick: opening " + filename).c_str());
+      return false;
     }
-  
-  // If true, some button is pushed
-  if (buttons)
+
+  fprintf(log, "# time axis|button number value\n");
+
+  eventLog.store(log);
+  return true;
+}
+
+
+
+long Joystick::getEvents() const
+{
+  return events.load();
+}
+
+
+
+
+/******************************************
+ Private Functions
+*******************************************/
+
+
+
+void *Joystick::readerThreadFunc(void *joystick)
+{
+  ((Joystick*)joystick)->readEvents();
+  return NULL;
+}
+
+
+
+void Joystick::readEvents()
+{
+  struct input_event batch[JOYSTICK_READ_EVENTS];
+  struct epoll_event ready[2];
+  ssize_t            length;
+  int                count;
+  bool               stop = false;
+
+  while (!stop)
     {
-      counter = 0;
-      value   = buttons;
+      count = epoll_wait(epollFd, ready, 2, -1);
 
-      while (value != 1)
+      if (count == -1)
 	{
-	  value /= 2;
-	  counter++;
+	  if (errno == EINTR)
+	    {
+	      continue;
+	    }
+	  perror("Joystick: epoll_wait");
+	  return;
 	}
-      jsVals.buttons[counter] = 1;
+
+      for (int i = 0; i < count; i++)
+	{
+	  if (ready[i].data.fd == stopPipe[0])
+	    {
+	      stop = true;
+	    }
+	}
+
+      if (stop)
+	{
+	  break;
+	}
+
+      // Everything there is, the device is
+      // non blocking
+      while ((length = read(device, batch, sizeof(batch))) > 0)
+	{
+	  for (int i = 0; i < (int)(length / sizeof(batch[0])); i++)
+	    {
+	      handleEvent(batch[i]);
+	    }
+	}
+
+      if ((length == -1) && (errno == ENODEV))
+	{
+	  cout<<"Joystick "<<joystickNumber<<" was unplugged, "
+	      <<"holding the last values"<<endl;
+	  return;
+	}
+    }
+}
+
+
+
+void Joystick::handleEvent(const struct input_event &event)
+{
+  FILE  *log  = eventLog.load(std::memory_order_acquire);
+  double time = event.input_event_sec + event.input_event_usec * 1e-6;
+  int    index;
+
+  if (event.type == EV_SYN)
+    {
+      if (event.code == SYN_DROPPED)
+	{
+	  // The kernel's buffer overflowed,
+	  // everything up to the next report
+	  // is junk, ask where things are
+	  dropped = true;
+	}
+      else if (event.code == SYN_REPORT)
+	{
+	  if (dropped)
+	    {
+	      resync();
+	      dropped = false;
+	    }
+	  publish(time);
+	}
+      return;
+    }
+
+  if (dropped)
+    {
+      return;
     }
-      
-  return jsVals;
+
+  if ((event.type == EV_ABS) && (event.code < ABS_CNT) &&
+      ((index = axisOf[event.code]) >= 0))
+    {
+      axis[index] = scaleAxis(index, event.value);
+
+      if (log)
+	{
+	  fprintf(log, "%.6f axis %d %.4f\n", time, index, axis[index]);
+	}
+    }
+  else if ((event.type == EV_KEY) && (event.code < KEY_CNT) &&
+	   ((index = buttonOf[event.code]) >= 0))
+    {
+      pending.buttons[index] = (event.value != 0);
+
+      if (log)
+	{
+	  fprintf(log, "%.6f button %d %d\n", time, index, event.value != 0);
+	}
+    }
+  else
+    {
+      return;
+    }
+
+  events.fetch_add(1, std::memory_order_relaxed);
 }
 
 
 
+// Read where every axis and button
+// is straight from the device
+void Joystick::resync()
+{
+  unsigned long        keyBits[BITMASKLONGS(KEY_CNT)];
+  struct input_absinfo range;
+
+  for (int i = 0; i < numberOfAxes; i++)
+    {
+      if (ioctl(device, EVIOCGABS(axisCodes[i]), &range) == 0)
+	{
+	  axis[i] = scaleAxis(i, range.value);
+	}
+    }
+
+  memset(keyBits, 0, sizeof(keyBits));
+  ioctl(device, EVIOCGKEY(sizeof(keyBits)), keyBits);
+
+  for (int i = 0; i < numberOfButtons; i++)
+    {
+      pending.buttons[i] = TESTBIT(keyBits, buttonCodes[i]) ? 1 : 0;
+    }
+}
+
+
+
+void Joystick::publish(double time)
+{
+  unsigned long current = sequence.load(std::memory_order_relaxed);
+
+  pending.aileron      =  axis[0];
+  pending.elevator     = -axis[1];
+  pending.rudder       =  axis[2];
+  pending.throttle     = -axis[3];
+  pending.hatLeftRight =  axis[4];
+  pending.hatUpDown    =  axis[5];
+  pending.time         = time;
+  pending.changes++;
+
+  sequence.store(current + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  published = pending;
+
+  sequence.store(current + 2, std::memory_order_release);
+}
+
+
+
+// The event device that goes with
+// /dev/input/js<jsNumber>, empty if
+// there isn't one
+string Joystick::findDevice(int jsNumber)
+{
+  char           path[64];
+  DIR           *directory;
+  struct dirent *entry;
+  string         device;
+
+  snprintf(path, sizeof(path), "/sys/class/input/js%d/device", jsNumber);
+
+  directory = opendir(path);
+  if (directory == NULL)
+    {
+      return "";
+    }
+
+  while ((entry = readdir(directory)) != NULL)
+    {
+      if (!strncmp(entry->d_name, "event", 5))
+	{
+	  device = string("/dev/input/") + entry->d_name;
+	  break;
+	}
+    }
+
+  closedir(directory);
+
+  return device;
+}
+
+
+
+// -1 to 1 about the middle of the axis'
+// range, 0 inside its flat spot
+float Joystick::scaleAxis(int index, int raw) const
+{
+  const struct input_absinfo &range = axisRanges[index];
+  double center = (range.minimum + range.maximum) / 2.0;
+  double half   = (range.maximum - range.minimum) / 2.0;
+  double value;
+
+  if (half <= 0.0)
+    {
+      return 0.0;
+    }
+
+  if (fabs(raw - center) <= range.flat)
+    {
+      return 0.0;
+    }
+
+  value = (raw - center) / half;
+
+  if (value > 1.0)
+    {
+      value = 1.0;
+    }
+  else if (value < -1.0)
+    {
+      value = -1.0;
+    }
+
+  return value;
+}
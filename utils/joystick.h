@@ -1,20 +1,39 @@
 // This class simplifies using a joystick
 // Drew Kirkpatrick, drew.kirkpatrick@gmail.com
-// Make sure when you compile this you link in
-// the proper libraries (-lplibjs -lplibul)
+//
+// The stick is read from its Linux event
+// device (evdev) by a thread of its own,
+// asleep in epoll until the stick moves.
+// Each batch of events the kernel reports
+// together is published as a whole new
+// joystickValues, stamped with the time the
+// kernel saw it, so getJoystickValues() is
+// only a copy, and never waits on the device.
+//
+// The times are CLOCK_MONOTONIC, the same
+// clock the FDM samples are stamped with,
+// so what the human did lines up with what
+// the aircraft was doing.
 
 
 #ifndef JOYSTICK_H
 #define JOYSTICK_H
 
 
-#include <plib/js.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <linux/input.h>
 
 
 
 #define MAXAXIS    8
 #define MAXBUTTONS 32
 
+// Events read from the device at a time
+#define JOYSTICK_READ_EVENTS 64
+
 
 
 struct joystickValues
@@ -28,7 +47,14 @@ struct joystickValues
 
   int   numberOfAxes;
 
+  // 1 for every button held down
   int   buttons[MAXBUTTONS];
+
+  // When the kernel saw the last change,
+  // seconds on CLOCK_MONOTONIC, and how
+  // many changes there have been
+  double        time;
+  unsigned long changes;
 };
 
 
@@ -41,20 +67,67 @@ class Joystick
   // Constructor, take a number corresponding
   // to which joystick on the system to use,
   // starting at 0 (If multiple joysticks)
-  Joystick(int jsNumber); 
+  Joystick(int jsNumber);
   ~Joystick();
 
-  joystickValues getJoystickValues();
+  // The latest state, from any thread
+  joystickValues getJoystickValues() const;
 
- private:
-  jsJoystick *js;
-  float      *axis;
-  joystickValues jsVals;
-  
-
-  int joystickNumber;
+  // Also write every axis and button event to
+  // filename as it comes in, a line each of
+  //   time axis|button number value
+  // Only once, false if it can't be opened.
+  bool recordEvents(std::string filename);
 
+  long getEvents() const;
 
+ private:
+  int joystickNumber;
+  int device;
+
+  // evdev codes of the axes and buttons, in
+  // the order the old joystick driver (and
+  // plib) numbered them, so axis 0 is still
+  // the aileron. -1 for codes we don't use.
+  int                  numberOfAxes;
+  int                  axisCodes [MAXAXIS];
+  struct input_absinfo axisRanges[MAXAXIS];
+  int                  axisOf    [ABS_CNT];
+
+  int                  numberOfButtons;
+  int                  buttonCodes[MAXBUTTONS];
+  int                  buttonOf   [KEY_CNT];
+
+  // Built up by the reader thread a
+  // batch of events at a time
+  float          axis[MAXAXIS];
+  joystickValues pending;
+  bool           dropped;
+
+  // The last whole batch. The sequence is
+  // odd while it's being written (a seqlock).
+  std::atomic<unsigned long> sequence;
+  joystickValues             published;
+
+  std::atomic<FILE*> eventLog;
+  std::atomic<long>  events;
+
+  pthread_t readerThread;
+  int       stopPipe[2];
+  int       epollFd;
+  bool      running;
+
+  static void *readerThreadFunc(void *joystick);
+  void  readEvents();
+  void  handleEvent(const struct input_event &event);
+  void  resync();
+  void  publish(double time);
+
+  static std::string findDevice(int jsNumber);
+  float scaleAxis(int index, int raw) const;
+
+  Joystick(const Joystick&);
+  Joystick& operator=(const Joystick&);
 };
 
 
@@ -0,0 +1,162 @@
+// Periodic work at its own rate,
+// see rateGroup.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <math.h>
+#include <time.h>
+
+
+#include "rateGroup.h"
+
+
+
+
+RateGroup::RateGroup(const char *groupName, double hertz)
+{
+  name         = groupName;
+  release      = 0.0;
+  started      = 0.0;
+  haveRun      = false;
+  runs         = 0;
+  skipped      = 0;
+  overruns     = 0;
+  totalRunTime = 0.0;
+  worstRunTime = 0.0;
+
+  setRate(hertz);
+}
+
+
+
+void RateGroup::setRate(double hertz)
+{
+  period = (hertz > 0.0) ? 1.0 / hertz : 0.0;
+
+  // Start a new grid from the next run
+  haveRun = false;
+}
+
+
+double RateGroup::getRate() const
+{
+  return (period > 0.0) ? 1.0 / period : 0.0;
+}
+
+
+
+bool RateGroup::due(double time)
+{
+  double behind;
+
+  if (!haveRun)
+    {
+      release = time;
+      haveRun = true;
+    }
+  else if (time < release)
+    {
+      return false;
+    }
+
+  started = time;
+
+  if (period > 0.0)
+    {
+      // Catch the grid up if whole periods
+      // went by, rather than running them
+      // all back to back
+      behind = floor((time - release) / period);
+
+      if (behind > 0.0)
+	{
+	  skipped += (long)behind;
+	  release += behind * period;
+	}
+
+      release += period;
+    }
+
+  return true;
+}
+
+
+
+void RateGroup::finished(double time)
+{
+  double runTime = time - started;
+
+  runs++;
+  totalRunTime += runTime;
+
+  if (runTime > worstRunTime)
+    {
+      worstRunTime = runTime;
+    }
+
+  if ((period > 0.0) && (runTime > period))
+    {
+      overruns++;
+    }
+}
+
+
+
+double RateGroup::nextRelease() const
+{
+  return (haveRun && (period > 0.0)) ? release : 0.0;
+}
+
+
+
+long RateGroup::getRuns() const
+{
+  return runs;
+}
+
+
+long RateGroup::getSkipped() const
+{
+  return skipped;
+}
+
+
+long RateGroup::getOverruns() const
+{
+  return overruns;
+}
+
+
+double RateGroup::getWorstRunTime() const
+{
+  return worstRunTime;
+}
+
+
+
+void RateGroup::report() const
+{
+  cout<<name<<" at "<<getRate()<<" Hz: "<<runs<<" runs, "
+      <<skipped<<" periods skipped, "<<overruns<<" overruns";
+
+  if (runs > 0)
+    {
+      cout<<", "<<totalRunTime / runs * 1e6<<" us average, "
+	  <<worstRunTime * 1e6<<" us worst";
+    }
+
+  cout<<endl;
+}
+
+
+
+double RateGroup::now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,68 @@
+// A piece of periodic work, run at its own
+// rate from a loop that goes round faster.
+// The loop asks due() every time round, and
+// tells finished() when the work is done so
+// it can be checked against its period.
+//
+// Releases stay on a fixed grid of periods
+// from the first one, a late run doesn't push
+// the ones after it back. Whole periods that
+// went by without a run are counted as
+// skipped. A run that takes longer than its
+// period is counted as an overrun.
+
+
+#ifndef RATEGROUP_H
+#define RATEGROUP_H
+
+
+
+
+class RateGroup
+{
+ public:
+  // 0 hertz runs it every time round
+  RateGroup(const char *groupName, double hertz);
+
+  void   setRate(double hertz);
+  double getRate() const;
+
+  // Times are seconds on CLOCK_MONOTONIC,
+  // see now()
+  bool   due(double time);
+  void   finished(double time);
+
+  // When it's next due, so a loop with nothing
+  // to do can sleep until then. Anything not
+  // yet run, or run every time, is due now.
+  double nextRelease() const;
+
+  long   getRuns()     const;
+  long   getSkipped()  const;
+  long   getOverruns() const;
+  double getWorstRunTime() const;
+
+  // One line of the counts
+  void   report() const;
+
+  static double now();
+
+
+ private:
+  const char *name;
+  double      period;
+  double      release;
+  double      started;
+  bool        haveRun;
+
+  long        runs;
+  long        skipped;
+  long        overruns;
+  double      totalRunTime;
+  double      worstRunTime;
+};
+
+
+
+
+#endif // RATEGROUP_H
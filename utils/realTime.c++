@@ -0,0 +1,257 @@
+// Real time threads and memory,
+// see realTime.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <malloc.h>
+#include <sys/mman.h>
+
+
+#include "realTime.h"
+
+
+
+
+realTimeSettings::realTimeSettings()
+{
+  enabled         = false;
+  controlCpu      = -1;
+  controlPriority = REALTIME_CONTROL_PRIORITY;
+  receiveCpu      = -1;
+  receivePriority = REALTIME_RECEIVE_PRIORITY;
+  lockMemory      = true;
+}
+
+
+
+bool realTimeSettings::load(const string &filename)
+{
+  ifstream settingsFile(filename.c_str());
+  string   line, name;
+  int      value;
+  int      lineNumber = 0;
+
+  if (!settingsFile)
+    {
+      cout<<"Couldn't open real time settings "<<filename<<endl;
+      return false;
+    }
+
+  while (getline(settingsFile, line))
+    {
+      lineNumber++;
+
+      istringstream words(line);
+
+      if (!(words>>name) || (name[0] == '#'))
+	{
+	  continue;
+	}
+
+      if (!(words>>value))
+	{
+	  cout<<filename<<":"<<lineNumber<<": "<<name
+	      <<" needs a number"<<endl;
+	  return false;
+	}
+
+      if (name == "controlCpu")
+	controlCpu = value;
+      else if (name == "controlPriority")
+	controlPriority = value;
+      else if (name == "receiveCpu")
+	receiveCpu = value;
+      else if (name == "receivePriority")
+	receivePriority = value;
+      else if (name == "lockMemory")
+	lockMemory = (value != 0);
+      else
+	{
+	  cout<<filename<<":"<<lineNumber<<": don't know what "
+	      <<name<<" is"<<endl;
+	  return false;
+	}
+    }
+
+  enabled = true;
+  return true;
+}
+
+
+
+bool realTimeSettings::parseOption(const char *argument)
+{
+  if (!strcmp(argument, "-realtime"))
+    {
+      enabled = true;
+      return true;
+    }
+
+  if (!strncmp(argument, "-realtime=", 10))
+    {
+      if (!load(argument + 10))
+	{
+	  cout<<"Running without real time mode"<<endl;
+	}
+      return true;
+    }
+
+  return false;
+}
+
+
+
+
+bool makeThreadRealTime(const char *name, int cpu, int priority)
+{
+  struct sched_param schedule;
+  cpu_set_t          cpus;
+  int                error;
+  bool               ok = true;
+
+  if (cpu >= 0)
+    {
+      CPU_ZERO(&cpus);
+      CPU_SET(cpu, &cpus);
+
+      error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+      if (error)
+	{
+	  cout<<name<<" can't be pinned to cpu "<<cpu<<": "
+	      <<strerror(error)<<endl;
+	  ok = false;
+	}
+    }
+
+  if (priority > 0)
+    {
+      memset(&schedule, 0, sizeof(schedule));
+      schedule.sched_priority = priority;
+
+      error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedule);
+      if (error)
+	{
+	  cout<<name<<" can't run SCHED_FIFO at priority "<<priority<<": "
+	      <<strerror(error)<<endl;
+	  ok = false;
+	}
+    }
+
+  if (ok)
+    {
+      cout<<name<<" is running";
+      if (priority > 0)
+	cout<<" SCHED_FIFO at priority "<<priority;
+      if (cpu >= 0)
+	cout<<" on cpu "<<cpu;
+      cout<<endl;
+    }
+
+  return ok;
+}
+
+
+
+// Its own function, so the compiler
+// can't leave the array out
+static void __attribute__((noinline)) prefaultStack()
+{
+  volatile char stack[REALTIME_STACK_PREFAULT];
+
+  memset((char*)stack, 0, sizeof(stack));
+}
+
+
+
+bool lockAllMemory()
+{
+  // Freed memory stays with us, already
+  // locked, and big blocks come off the
+  // heap rather than fresh mmap()s
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
+    {
+      perror("Can't lock memory (mlockall)");
+      return false;
+    }
+
+  prefaultStack();
+
+  cout<<"Memory is locked"<<endl;
+  return true;
+}
+
+
+
+
+JitterMonitor::JitterMonitor(const char *loopName)
+{
+  name    = loopName;
+  wakeUps = 0;
+  late    = 0;
+  total   = 0.0;
+  worst   = 0.0;
+}
+
+
+
+void JitterMonitor::wokeUp(double wanted, double woke)
+{
+  double jitter = woke - wanted;
+
+  if (jitter < 0.0)
+    {
+      jitter = 0.0;
+    }
+
+  wakeUps++;
+  total += jitter;
+
+  if (jitter > worst)
+    {
+      worst = jitter;
+    }
+
+  if (jitter > REALTIME_LATE_WAKEUP)
+    {
+      late++;
+    }
+}
+
+
+
+double JitterMonitor::getWorst() const
+{
+  return worst;
+}
+
+
+long JitterMonitor::getLate() const
+{
+  return late;
+}
+
+
+
+void JitterMonitor::report() const
+{
+  cout<<name<<": "<<wakeUps<<" wake ups";
+
+  if (wakeUps > 0)
+    {
+      cout<<", jitter "<<total / wakeUps * 1e6<<" us average, "
+	  <<worst * 1e6<<" us worst, "<<late<<" over "
+	  <<REALTIME_LATE_WAKEUP * 1e6<<" us";
+    }
+
+  cout<<endl;
+}
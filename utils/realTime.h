@@ -0,0 +1,120 @@
+// Running the control loop as a real time
+// task, for steady ticks on a busy machine.
+// Threads can be pinned to a core and run
+// SCHED_FIFO, above everything else that
+// isn't, and the memory locked and touched
+// up front so the loop never waits on a
+// page fault.
+//
+// The settings come from the command line,
+// or a file of "name value" lines:
+//
+//   # autoAgent real time settings
+//   controlCpu       2
+//   controlPriority  80
+//   receiveCpu       3
+//   receivePriority  85
+//   lockMemory       1
+//
+// A cpu of -1 leaves the thread unpinned, a
+// priority of 0 leaves it time shared. Both
+// need root, or CAP_SYS_NICE. Anything that
+// can't be had is said so and done without.
+
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+
+#include <string>
+
+
+
+// Defaults when real time mode is on.
+// The receive thread goes above the
+// control loop, it feeds it.
+#ifndef REALTIME_CONTROL_PRIORITY
+#define REALTIME_CONTROL_PRIORITY 80
+#endif
+
+#ifndef REALTIME_RECEIVE_PRIORITY
+#define REALTIME_RECEIVE_PRIORITY 85
+#endif
+
+// Stack touched before the loop starts
+#ifndef REALTIME_STACK_PREFAULT
+#define REALTIME_STACK_PREFAULT (512 * 1024)  // bytes
+#endif
+
+// Wake ups later than this are counted
+#define REALTIME_LATE_WAKEUP 0.001  // seconds
+
+
+
+struct realTimeSettings
+{
+  bool enabled;
+
+  int  controlCpu;
+  int  controlPriority;
+  int  receiveCpu;
+  int  receivePriority;
+
+  bool lockMemory;
+
+  realTimeSettings();
+
+  // "name value" lines, false (after saying
+  // why) if the file can't be read or has
+  // something it doesn't know in it
+  bool load(const std::string &filename);
+
+  // -realtime for the defaults, or
+  // -realtime=<settings file>. False if
+  // the argument isn't one of those.
+  bool parseOption(const char *argument);
+};
+
+
+
+// Pin the calling thread to cpu and run it
+// SCHED_FIFO at priority. Threads it starts
+// afterwards get the same, so call it once
+// they're started.
+bool makeThreadRealTime(const char *name, int cpu, int priority);
+
+// Lock everything mapped now and from now on
+// into memory, keep the heap from handing
+// memory back, and touch the stack
+bool lockAllMemory();
+
+
+
+
+// How late a loop wakes up, against
+// when it asked to
+class JitterMonitor
+{
+ public:
+  JitterMonitor(const char *loopName);
+
+  // Times in seconds on CLOCK_MONOTONIC
+  void wokeUp(double wanted, double woke);
+
+  double getWorst() const;
+  long   getLate()  const;
+
+  void   report() const;
+
+ private:
+  const char *name;
+  long        wakeUps;
+  long        late;
+  double      total;
+  double      worst;
+};
+
+
+
+
+#endif // REALTIME_H
@@ -0,0 +1,509 @@
+// Precomputed navigation course,
+// see route.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "route.h"
+#include "fastMath.h"
+
+
+
+// WGS84
+#define ROUTE_EARTH_A   6378137.0
+#define ROUTE_EARTH_E2  6.69437999014e-3
+
+#ifndef DEG2RAD
+#define DEG2RAD 0.017453292519943295
+#endif
+
+
+
+
+static inline double dot(const double a[3], const double b[3])
+{
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+
+
+
+// The next number in a mapped file. There's
+// no terminating 0 at the end of a mapping,
+// so strtod gets a copy of the one number.
+// Returns false at the end of the file or
+// on something that isn't a number.
+static bool nextNumber(const char *&text, const char *end, double &value)
+{
+  char  number[64];
+  char *numberEnd;
+  int   length = 0;
+
+  while ((text < end) && ((*text == ' ') || (*text == '\t') ||
+			  (*text == '\n') || (*text == '\r')))
+    {
+      text++;
+    }
+
+  while ((text < end) && (length < (int)sizeof(number) - 1) &&
+	 (*text != ' ') && (*text != '\t') &&
+	 (*text != '\n') && (*text != '\r'))
+    {
+      number[length++] = *text++;
+    }
+
+  number[length] = '\0';
+  value = strtod(number, &numberEnd);
+
+  return (length > 0) && (*numberEnd == '\0');
+}
+
+
+
+
+Route::Route()
+{
+  length = 0.0;
+}
+
+
+
+bool Route::load(string filename)
+{
+  struct stat fileInfo;
+  const char *text, *end;
+  void       *mapping;
+  double      lat, lon, alt;
+  int         fd;
+
+  clear();
+
+  if ((fd = ::open(filename.c_str(), O_RDONLY)) == -1)
+    {
+      perror("Route::load");
+      return false;
+    }
+
+  if ((fstat(fd, &fileInfo) == -1) || (fileInfo.st_size == 0))
+    {
+      cout<<"Route::load: "<<filename<<" is empty"<<endl;
+      ::close(fd);
+      return false;
+    }
+
+  mapping = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+    {
+      perror("Route::load: mmap");
+      return false;
+    }
+
+  madvise(mapping, fileInfo.st_size, MADV_SEQUENTIAL);
+
+  text = (const char*)mapping;
+  end  = text + fileInfo.st_size;
+
+  // A partial last line is dropped,
+  // like the old stream reader did
+  while (nextNumber(text, end, lat) &&
+	 nextNumber(text, end, lon) &&
+	 nextNumber(text, end, alt))
+    {
+      addWaypoint(lat, lon, alt);
+    }
+
+  munmap(mapping, fileInfo.st_size);
+
+  if (waypoints.empty())
+    {
+      cout<<"Route::load: no waypoints in "<<filename<<endl;
+      return false;
+    }
+
+  build();
+  return true;
+}
+
+
+
+void Route::clear()
+{
+  waypoints.clear();
+  legs.clear();
+  grid.clear();
+  length = 0.0;
+}
+
+
+
+
+void Route::addWaypoint(double lat, double lon, double alt)
+{
+  routeWaypoint waypoint;
+
+  waypoint.lat = lat;
+  waypoint.lon = lon;
+  waypoint.alt = alt;
+  geoToEcef(lat, lon, alt, waypoint.ecef);
+
+  waypoints.push_back(waypoint);
+}
+
+
+
+
+// Work out the legs and fill
+// in the nearest leg grid
+void Route::build()
+{
+  routeLeg leg;
+  double   up[3], upLength, rightLength, point[3];
+  int64_t  cell[3];
+  int      samples;
+
+  legs.clear();
+  grid.clear();
+  length = 0.0;
+
+  for (int i = 0; i + 1 < (int)waypoints.size(); i++)
+    {
+      const double *start = waypoints[i].ecef;
+      const double *stop  = waypoints[i + 1].ecef;
+
+      for (int j = 0; j < 3; j++)
+	{
+	  leg.direction[j] = stop[j] - start[j];
+	}
+
+      leg.length        = sqrt(dot(leg.direction, leg.direction));
+      leg.startDistance = length;
+      length           += leg.length;
+
+      for (int j = 0; j < 3; j++)
+	{
+	  leg.direction[j] = (leg.length > 0.0) ?
+	    leg.direction[j] / leg.length : 0.0;
+	}
+
+      // Up is near enough the direction from
+      // the center of the earth for this
+      upLength = sqrt(dot(start, start));
+      for (int j = 0; j < 3; j++)
+	{
+	  up[j] = start[j] / upLength;
+	}
+
+      leg.right[0] = leg.direction[1] * up[2] - leg.direction[2] * up[1];
+      leg.right[1] = leg.direction[2] * up[0] - leg.direction[0] * up[2];
+      leg.right[2] = leg.direction[0] * up[1] - leg.direction[1] * up[0];
+
+      rightLength = sqrt(dot(leg.right, leg.right));
+      for (int j = 0; j < 3; j++)
+	{
+	  leg.right[j] = (rightLength > 0.0) ? leg.right[j] / rightLength : 0.0;
+	}
+
+      legs.push_back(leg);
+
+
+      // Points every half cell along the leg
+      // put it in every cell it goes through
+      samples = (int)ceil(leg.length / (ROUTE_GRID_CELL / 2));
+      samples = (samples < 1) ? 1 : samples;
+
+      for (int s = 0; s <= samples; s++)
+	{
+	  double along = leg.length * s / samples;
+	  gridEntry entry;
+
+	  for (int j = 0; j < 3; j++)
+	    {
+	      point[j] = start[j] + leg.direction[j] * along;
+	    }
+
+	  cellOf(point, cell);
+	  entry.cell = cellKey(cell[0], cell[1], cell[2]);
+	  entry.leg  = i;
+	  grid.push_back(entry);
+	}
+    }
+
+  sort(grid.begin(), grid.end());
+  grid.erase(unique(grid.begin(), grid.end(),
+		    [](const gridEntry &a, const gridEntry &b)
+		    { return (a.cell == b.cell) && (a.leg == b.leg); }),
+	     grid.end());
+}
+
+
+
+
+int Route::getNumberOfWaypoints() const
+{
+  return waypoints.size();
+}
+
+
+int Route::getNumberOfLegs() const
+{
+  return legs.size();
+}
+
+
+double Route::getLength() const
+{
+  return length;
+}
+
+
+const routeWaypoint& Route::getWaypoint(int index) const
+{
+  return waypoints[index];
+}
+
+
+const routeLeg& Route::getLeg(int index) const
+{
+  return legs[index];
+}
+
+
+
+
+void Route::geoToEcef(double lat, double lon, double alt, double ecef[3])
+{
+  double sinLat, cosLat, sinLon, cosLon, n;
+
+  fastSinCos(lat * DEG2RAD, sinLat, cosLat);
+  fastSinCos(lon * DEG2RAD, sinLon, cosLon);
+
+  // Prime vertical radius of curvature
+  n = ROUTE_EARTH_A / sqrt(1.0 - ROUTE_EARTH_E2 * sinLat * sinLat);
+
+  ecef[0] = (n + alt) * cosLat * cosLon;
+  ecef[1] = (n + alt) * cosLat * sinLon;
+  ecef[2] = (n * (1.0 - ROUTE_EARTH_E2) + alt) * sinLat;
+}
+
+
+
+
+double Route::distanceToWaypoint(const double position[3], int index) const
+{
+  const double *waypoint = waypoints[index].ecef;
+  double        toWaypoint[3];
+
+  for (int j = 0; j < 3; j++)
+    {
+      toWaypoint[j] = waypoint[j] - position[j];
+    }
+
+  return sqrt(dot(toWaypoint, toWaypoint));
+}
+
+
+
+void Route::trackError(const double position[3], int leg,
+		       double &crossTrack, double &alongTrack) const
+{
+  const double *start = waypoints[leg].ecef;
+  double        fromStart[3];
+
+  for (int j = 0; j < 3; j++)
+    {
+      fromStart[j] = position[j] - start[j];
+    }
+
+  alongTrack = dot(fromStart, legs[leg].direction);
+  crossTrack = dot(fromStart, legs[leg].right);
+}
+
+
+
+double Route::distanceRemaining(const double position[3], int leg) const
+{
+  double crossTrack, alongTrack;
+
+  trackError(position, leg, crossTrack, alongTrack);
+  alongTrack = fastClamp(alongTrack, 0.0, legs[leg].length);
+
+  return length - (legs[leg].startDistance + alongTrack);
+}
+
+
+
+
+// Closest point on the leg, not the
+// line through it
+double Route::distanceToLeg(const double position[3], int leg) const
+{
+  const double *start = waypoints[leg].ecef;
+  double        fromStart[3], along;
+
+  for (int j = 0; j < 3; j++)
+    {
+      fromStart[j] = position[j] - start[j];
+    }
+
+  along = fastClamp(dot(fromStart, legs[leg].direction),
+		    0.0, legs[leg].length);
+
+  for (int j = 0; j < 3; j++)
+    {
+      fromStart[j] -= legs[leg].direction[j] * along;
+    }
+
+  return sqrt(dot(fromStart, fromStart));
+}
+
+
+
+
+// Search rings of cells outwards from the
+// aircraft's. Every point of a leg is within
+// a quarter cell of one of its grid points, so
+// once the best leg is closer than anything
+// outside the rings searched so far can be,
+// it's the nearest.
+int Route::nearestLeg(const double position[3]) const
+{
+  int64_t center[3], cell[3];
+  double  bestDistance = 1e30, distance;
+  int     best = -1;
+
+  if (legs.empty())
+    {
+      return -1;
+    }
+
+  cellOf(position, center);
+
+  for (int ring = 0; ring <= ROUTE_GRID_RINGS; ring++)
+    {
+      for (int x = -ring; x <= ring; x++)
+	{
+	  for (int y = -ring; y <= ring; y++)
+	    {
+	      for (int z = -ring; z <= ring; z++)
+		{
+		  // Only the shell, the inside
+		  // was done on earlier rings
+		  if ((abs(x) != ring) && (abs(y) != ring) && (abs(z) != ring))
+		    {
+		      continue;
+		    }
+
+		  // Nothing in a cell further
+		  // away than the best so far
+		  // can beat it
+		  cell[0] = center[0] + x;
+		  cell[1] = center[1] + y;
+		  cell[2] = center[2] + z;
+
+		  if (distanceToCell(position, cell) - ROUTE_GRID_CELL / 4 >=
+		      bestDistance)
+		    {
+		      continue;
+		    }
+
+		  gridEntry first;
+		  first.cell = cellKey(cell[0], cell[1], cell[2]);
+		  first.leg  = -1;
+
+		  for (vector<gridEntry>::const_iterator entry =
+			 lower_bound(grid.begin(), grid.end(), first);
+		       (entry != grid.end()) && (entry->cell == first.cell);
+		       entry++)
+		    {
+		      distance = distanceToLeg(position, entry->leg);
+
+		      if ((distance < bestDistance) ||
+			  ((distance == bestDistance) && (entry->leg < best)))
+			{
+			  bestDistance = distance;
+			  best         = entry->leg;
+			}
+		    }
+		}
+	    }
+	}
+
+      if (bestDistance <= (ring - 0.25) * ROUTE_GRID_CELL)
+	{
+	  return best;
+	}
+    }
+
+  // Nothing close, check them all
+  for (int leg = 0; leg < (int)legs.size(); leg++)
+    {
+      distance = distanceToLeg(position, leg);
+
+      if (distance < bestDistance)
+	{
+	  bestDistance = distance;
+	  best         = leg;
+	}
+    }
+
+  return best;
+}
+
+
+
+
+// How close position is to any
+// point in the cell
+double Route::distanceToCell(const double position[3],
+			     const int64_t cell[3])
+{
+  double low, gap, squared = 0.0;
+
+  for (int j = 0; j < 3; j++)
+    {
+      low = cell[j] * ROUTE_GRID_CELL;
+      gap = (position[j] < low) ? low - position[j] :
+	position[j] - (low + ROUTE_GRID_CELL);
+      gap = (gap > 0.0) ? gap : 0.0;
+      squared += gap * gap;
+    }
+
+  return sqrt(squared);
+}
+
+
+
+void Route::cellOf(const double position[3], int64_t cell[3])
+{
+  for (int j = 0; j < 3; j++)
+    {
+      cell[j] = (int64_t)floor(position[j] / ROUTE_GRID_CELL);
+    }
+}
+
+
+
+// 21 bits a side is plenty, the earth
+// is about 6400 cells across
+uint64_t Route::cellKey(int64_t x, int64_t y, int64_t z)
+{
+  const int64_t offset = 1 << 20;
+  const int64_t mask   = (1 << 21) - 1;
+
+  return ((uint64_t)((x + offset) & mask) << 42) |
+    ((uint64_t)((y + offset) & mask) << 21) |
+    (uint64_t)((z + offset) & mask);
+}
@@ -0,0 +1,149 @@
+// A navigation course, worked out once when
+// it's loaded instead of every tick. Each
+// waypoint's earth centered (ECEF) position,
+// each leg's direction, length and distance
+// along the route are kept, so distance to a
+// waypoint and cross-track and along-track
+// error are a few multiplies and adds given
+// the aircraft's ECEF position.
+//
+// Long routes (survey patterns, 10k+ points)
+// also get a grid over the legs, so finding
+// the leg nearest the aircraft only looks at
+// the legs close by.
+//
+// The file is the same waypointsFile as
+// always, "lat lon alt" per waypoint, lat and
+// lon in degrees, alt in meters. It's mapped,
+// not read through a stream.
+
+
+#ifndef ROUTE_H
+#define ROUTE_H
+
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+
+// Size of the nearest leg grid cells, and
+// how many rings of cells around the aircraft
+// to search before giving up and checking
+// every leg
+#ifndef ROUTE_GRID_CELL
+#define ROUTE_GRID_CELL   2000.0  // meters
+#endif
+#ifndef ROUTE_GRID_RINGS
+#define ROUTE_GRID_RINGS  4
+#endif
+
+
+
+struct routeWaypoint
+{
+  double lat;
+  double lon;
+  double alt;
+  double ecef[3];
+};
+
+
+
+// The leg from waypoint i to waypoint i + 1.
+// right is level and square to the leg,
+// pointing to the right of the direction
+// of travel.
+struct routeLeg
+{
+  double direction[3];
+  double right[3];
+  double length;
+  double startDistance;   // along the route
+};
+
+
+
+class Route
+{
+ public:
+  Route();
+
+  // Read a waypoints file. Returns false (and
+  // says why) if there isn't a usable one,
+  // leaving the route empty.
+  bool load(std::string filename);
+  void clear();
+
+  // Or build one up a waypoint at a time,
+  // then call build() before using it
+  void addWaypoint(double lat, double lon, double alt);
+  void build();
+
+
+  // Indexes are from 0, leg i ends at
+  // waypoint i + 1
+  int    getNumberOfWaypoints() const;
+  int    getNumberOfLegs()      const;
+  double getLength()            const;
+
+  const routeWaypoint& getWaypoint(int index) const;
+  const routeLeg&      getLeg(int index)      const;
+
+
+  // WGS84, degrees and meters in
+  static void geoToEcef(double lat, double lon, double alt,
+			double ecef[3]);
+
+  // Straight line distance from position
+  // (ECEF) to a waypoint, in meters
+  double distanceToWaypoint(const double position[3], int index) const;
+
+  // How far along the leg position is (from
+  // its start, negative before it) and how
+  // far off to the side (positive is right)
+  void trackError(const double position[3], int leg,
+		  double &crossTrack, double &alongTrack) const;
+
+  // Distance left to fly to the end of the
+  // route, from position on leg
+  double distanceRemaining(const double position[3], int leg) const;
+
+  // The leg closest to position, -1 if
+  // there aren't any legs
+  int nearestLeg(const double position[3]) const;
+
+
+ private:
+  std::vector<routeWaypoint> waypoints;
+  std::vector<routeLeg>      legs;
+  double                     length;
+
+  // (cell, leg) pairs sorted by cell, a leg
+  // is in every cell it passes through
+  struct gridEntry
+  {
+    uint64_t cell;
+    int      leg;
+
+    bool operator<(const gridEntry &other) const
+    {
+      return (cell < other.cell) ||
+	((cell == other.cell) && (leg < other.leg));
+    }
+  };
+
+  std::vector<gridEntry> grid;
+
+  static void     cellOf(const double position[3], int64_t cell[3]);
+  static uint64_t cellKey(int64_t x, int64_t y, int64_t z);
+  static double   distanceToCell(const double position[3],
+				 const int64_t cell[3]);
+
+  double distanceToLeg(const double position[3], int leg) const;
+};
+
+
+
+#endif // ROUTE_H
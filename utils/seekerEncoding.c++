@@ -0,0 +1,170 @@
+// TargetSeeker input encodings,
+// see seekerEncoding.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <math.h>
+
+
+#include "seekerEncoding.h"
+
+
+
+const char* continuousInputNames[CONTINUOUS_AIRSPEED_INPUTS] =
+  {
+    "bearing",
+    "elevation",
+    "roll",
+    "pitch",
+    "rangeRate",
+    "airspeed"
+  };
+
+
+
+
+// acos() of a dot product a hair over 1
+// gives a NaN, call that 0 rather than
+// hand it to the net
+static inline double clampUnit(double value)
+{
+  if (value > 1.0)
+    return 1.0;
+  if (value < -1.0)
+    return -1.0;
+  if (value != value)
+    return 0.0;
+
+  return value;
+}
+
+
+
+
+SeekerEncoding encodingForInputs(int numInputs)
+{
+  switch(numInputs)
+    {
+    case EYE_INPUTS:
+      return EyeEncoding;
+
+    case CONTINUOUS_INPUTS:
+      return ContinuousEncoding;
+
+    case CONTINUOUS_AIRSPEED_INPUTS:
+      return ContinuousAirspeedEncoding;
+
+    default:
+      return UnknownEncoding;
+    }
+}
+
+
+
+int inputsForEncoding(SeekerEncoding encoding)
+{
+  switch(encoding)
+    {
+    case EyeEncoding:
+      return EYE_INPUTS;
+
+    case ContinuousEncoding:
+      return CONTINUOUS_INPUTS;
+
+    case ContinuousAirspeedEncoding:
+      return CONTINUOUS_AIRSPEED_INPUTS;
+
+    default:
+      return 0;
+    }
+}
+
+
+
+const char* encodingName(SeekerEncoding encoding)
+{
+  switch(encoding)
+    {
+    case EyeEncoding:
+      return "eye";
+
+    case ContinuousEncoding:
+      return "continuous";
+
+    case ContinuousAirspeedEncoding:
+      return "continuousAirspeed";
+
+    default:
+      return "unknown";
+    }
+}
+
+
+
+const char** encodingInputNames(SeekerEncoding encoding)
+{
+  if (encoding == EyeEncoding)
+    {
+      return eyeInputNames;
+    }
+
+  // The airspeed one just has one more
+  return continuousInputNames;
+}
+
+
+
+
+template<class inputType>
+static inline void encodeOne(const continuousSample &sample,
+			     bool withAirspeed, inputType *inputs)
+{
+  double bearing   = (sample.relativeX <= 0.0) ? -sample.bearing
+					       :  sample.bearing;
+  double elevation = (sample.relativeZ <= 0.0) ? -sample.elevation
+					       :  sample.elevation;
+
+  inputs[0] = clampUnit(bearing      / CONTINUOUS_ANGLE_SCALE);
+  inputs[1] = clampUnit(elevation    / CONTINUOUS_ANGLE_SCALE);
+  inputs[2] = clampUnit(sample.roll  / CONTINUOUS_ANGLE_SCALE);
+  inputs[3] = clampUnit(sample.pitch / CONTINUOUS_PITCH_SCALE);
+  inputs[4] = clampUnit(sample.rangeRate / CONTINUOUS_RANGE_RATE_SCALE);
+
+  if (withAirspeed)
+    {
+      inputs[5] = clampUnit(2.0 * sample.airspeed /
+			    CONTINUOUS_AIRSPEED_SCALE - 1.0);
+    }
+}
+
+
+
+
+void encodeContinuous(const continuousSample &sample, bool withAirspeed,
+		      float *inputs)
+{
+  encodeOne(sample, withAirspeed, inputs);
+}
+
+
+
+void encodeContinuous(const continuousSample &sample, bool withAirspeed,
+		      double *inputs)
+{
+  encodeOne(sample, withAirspeed, inputs);
+}
+
+
+
+void encodeContinuousBatch(const continuousSample *samples, int count,
+			   bool withAirspeed, float *inputs)
+{
+  int stride = withAirspeed ? CONTINUOUS_AIRSPEED_INPUTS : CONTINUOUS_INPUTS;
+
+  for (int i = 0; i < count; i++)
+    {
+      encodeOne(samples[i], withAirspeed, inputs + i * stride);
+    }
+}
@@ -0,0 +1,99 @@
+// The ways the TargetSeeker's neural net can
+// be shown where the target is. The original
+// 9 eye encoding (eyeEncoder.h) only says which
+// of 9 boxes the target is in. The continuous
+// encoding gives the net the actual numbers,
+// signed bearing and elevation to the target,
+// roll, pitch, how fast the range is closing,
+// and optionally airspeed, all scaled to -1..1.
+//
+// Which one a brain uses is told by its
+// number of inputs, so brains and data sets
+// don't need any extra bookkeeping.
+
+
+#ifndef SEEKERENCODING_H
+#define SEEKERENCODING_H
+
+
+#include "eyeEncoder.h"
+
+
+
+enum SeekerEncoding
+  {
+    EyeEncoding,
+    ContinuousEncoding,
+    ContinuousAirspeedEncoding,
+    UnknownEncoding
+  };
+
+
+#define CONTINUOUS_INPUTS          5
+#define CONTINUOUS_AIRSPEED_INPUTS 6
+
+
+// What maps to +-1. Anything bigger is
+// clamped, a net doesn't need to tell 400
+// knots of closure from 300.
+#define CONTINUOUS_ANGLE_SCALE      180.0  // degrees, bearing, elevation, roll
+#define CONTINUOUS_PITCH_SCALE       90.0  // degrees
+#define CONTINUOUS_RANGE_RATE_SCALE 300.0  // meters/second
+#define CONTINUOUS_AIRSPEED_SCALE   600.0  // knots, 0 is -1
+
+
+// Input names, in input order, airspeed last
+extern const char* continuousInputNames[CONTINUOUS_AIRSPEED_INPUTS];
+
+
+
+// Bearing and elevation are the unsigned
+// angles off the nose the TargetSeeker works
+// out, relativeX/Z give them their sign (left
+// and below are negative). rangeRate is
+// positive while the target gets further away.
+struct continuousSample
+{
+  float  bearing;
+  float  elevation;
+  double relativeX;
+  double relativeZ;
+  double roll;
+  double pitch;
+  double rangeRate;
+  double airspeed;
+};
+
+
+
+// Which encoding a net with this many
+// inputs uses, and the other way around
+extern SeekerEncoding encodingForInputs(int numInputs);
+extern int            inputsForEncoding(SeekerEncoding encoding);
+extern const char*    encodingName(SeekerEncoding encoding);
+
+// Input names for a data set of this encoding
+extern const char**   encodingInputNames(SeekerEncoding encoding);
+
+
+// Write the CONTINUOUS_INPUTS (or, with
+// airspeed, CONTINUOUS_AIRSPEED_INPUTS) net
+// inputs for one sample. The double version
+// can write straight into a NeuralNetwork's
+// input layer.
+extern void encodeContinuous(const continuousSample &sample,
+			     bool withAirspeed, float *inputs);
+
+extern void encodeContinuous(const continuousSample &sample,
+			     bool withAirspeed, double *inputs);
+
+
+// Many samples at once, inputs is count *
+// (CONTINUOUS_INPUTS or CONTINUOUS_AIRSPEED_INPUTS)
+extern void encodeContinuousBatch(const continuousSample *samples,
+				  int count, bool withAirspeed,
+				  float *inputs);
+
+
+
+#endif // SEEKERENCODING_H
@@ -0,0 +1,349 @@
+// Latency compensation for the FDM,
+// see stateEstimator.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <math.h>
+
+
+#include "stateEstimator.h"
+
+
+
+// Close enough to turn velocities
+// into degrees of lat/lon
+#define EARTH_RADIUS 6378137.0  // meters
+
+
+
+
+// -180..180
+static double wrapAngle(double angle)
+{
+  angle = fmod(angle, 360.0);
+
+  if (angle > 180.0)
+    {
+      angle -= 360.0;
+    }
+  else if (angle < -180.0)
+    {
+      angle += 360.0;
+    }
+
+  return angle;
+}
+
+
+// 0..360
+static double wrapHeading(double heading)
+{
+  heading = fmod(heading, 360.0);
+
+  if (heading < 0.0)
+    {
+      heading += 360.0;
+    }
+
+  return heading;
+}
+
+
+
+
+// The constant rate model, the rate is
+// assumed to wander by up to acceleration
+// a second
+static void predictChannel(kalmanChannel &channel, double dt,
+			   double acceleration)
+{
+  double q = acceleration * acceleration;
+
+  channel.value += channel.rate * dt;
+
+  channel.p00 += dt * (2.0 * channel.p01 + dt * channel.p11) +
+    q * dt * dt * dt / 3.0;
+  channel.p01 += dt * channel.p11 + q * dt * dt / 2.0;
+  channel.p11 += q * dt;
+}
+
+
+
+// Both the value and its rate are
+// measured, so it's the full 2x2
+// gain, K = P (P + R)^-1
+static void correctChannel(kalmanChannel &channel, double valueError,
+			   double rateError, const kalmanNoise &noise)
+{
+  double s00 = channel.p00 + noise.value * noise.value;
+  double s01 = channel.p01;
+  double s11 = channel.p11 + noise.rate * noise.rate;
+  double det = s00 * s11 - s01 * s01;
+
+  double i00 =  s11 / det;
+  double i01 = -s01 / det;
+  double i11 =  s00 / det;
+
+  double k00 = channel.p00 * i00 + channel.p01 * i01;
+  double k01 = channel.p00 * i01 + channel.p01 * i11;
+  double k10 = channel.p01 * i00 + channel.p11 * i01;
+  double k11 = channel.p01 * i01 + channel.p11 * i11;
+
+  double p00 = (1.0 - k00) * channel.p00 - k01 * channel.p01;
+  double p01 = (1.0 - k00) * channel.p01 - k01 * channel.p11;
+  double p11 = (1.0 - k11) * channel.p11 - k10 * channel.p01;
+
+  channel.value += k00 * valueError + k01 * rateError;
+  channel.rate  += k10 * valueError + k11 * rateError;
+
+  channel.p00 = p00;
+  channel.p01 = p01;
+  channel.p11 = p11;
+}
+
+
+
+
+StateEstimator::StateEstimator()
+{
+  lastTime       = 0.0;
+  lastSequence   = 0;
+  haveSample     = false;
+  transportDelay = ESTIMATOR_TRANSPORT_DELAY;
+  leadTime       = ESTIMATOR_LEAD_TIME;
+  filtering      = false;
+  filterTime     = 0.0;
+}
+
+
+
+void StateEstimator::setTransportDelay(double seconds)
+{
+  transportDelay = seconds;
+}
+
+
+void StateEstimator::setLeadTime(double seconds)
+{
+  leadTime = seconds;
+}
+
+
+double StateEstimator::getLeadTime() const
+{
+  return leadTime;
+}
+
+
+
+void StateEstimator::setFiltering(bool on)
+{
+  if (on && !filtering && haveSample)
+    {
+      startFilters(last);
+      filterTime = lastTime;
+    }
+
+  filtering = on;
+}
+
+
+
+void StateEstimator::addSample(const telemetrySample &sample)
+{
+  double values[NumberOfChannels], rates[NumberOfChannels];
+  double sent = sample.time - transportDelay;
+  double dt, error;
+
+  if (haveSample && (sample.sequence <= lastSequence))
+    {
+      return;
+    }
+
+  if (filtering)
+    {
+      dt = sent - filterTime;
+
+      // Nothing to go on after a long gap,
+      // start again from this one
+      if (!haveSample || (dt > ESTIMATOR_MAX_EXTRAPOLATION))
+	{
+	  startFilters(sample.fdm);
+	}
+      else
+	{
+	  if (dt < 0.0)
+	    {
+	      dt = 0.0;
+	    }
+
+	  measure(sample.fdm, values, rates);
+
+	  for (int i = 0; i < NumberOfChannels; i++)
+	    {
+	      predictChannel(channels[i], dt, noise[i].acceleration);
+
+	      error = values[i] - channels[i].value;
+	      if (i >= RollChannel)
+		{
+		  error = wrapAngle(error);
+		}
+
+	      correctChannel(channels[i], error, rates[i] - channels[i].rate,
+			     noise[i]);
+
+	      if (i >= RollChannel)
+		{
+		  channels[i].value = wrapAngle(channels[i].value);
+		}
+	    }
+	}
+
+      filterTime = sent;
+    }
+
+  last         = sample.fdm;
+  lastTime     = sent;
+  lastSequence = sample.sequence;
+  haveSample   = true;
+}
+
+
+
+bool StateEstimator::predict(double time, localDataStruct &state) const
+{
+  double values[NumberOfChannels], rates[NumberOfChannels];
+  double dt;
+
+  if (!haveSample)
+    {
+      return false;
+    }
+
+  if (filtering)
+    {
+      for (int i = 0; i < NumberOfChannels; i++)
+	{
+	  values[i] = channels[i].value;
+	  rates[i]  = channels[i].rate;
+	}
+      dt = time + leadTime - filterTime;
+    }
+  else
+    {
+      measure(last, values, rates);
+      dt = time + leadTime - lastTime;
+    }
+
+  if (dt < 0.0)
+    {
+      dt = 0.0;
+    }
+  else if (dt > ESTIMATOR_MAX_EXTRAPOLATION)
+    {
+      dt = ESTIMATOR_MAX_EXTRAPOLATION;
+    }
+
+  for (int i = 0; i < NumberOfChannels; i++)
+    {
+      values[i] += rates[i] * dt;
+    }
+
+  // Everything else (airspeed, aoa...) is
+  // just the last sample's
+  state = last;
+
+  state.latitude  = values[LatChannel];
+  state.longitude = values[LonChannel];
+  state.altitude  = values[AltChannel];
+  state.agl       = last.agl + (values[AltChannel] - last.altitude);
+  state.roll      = wrapAngle(values[RollChannel]);
+  state.pitch     = values[PitchChannel];
+  state.heading   = wrapHeading(values[HeadingChannel]);
+
+  return true;
+}
+
+
+
+double StateEstimator::getAge(double time) const
+{
+  return time - lastTime;
+}
+
+
+
+
+/******************************************
+ Private Functions
+*******************************************/
+
+
+
+// The velocities turned into the
+// units of each channel
+void StateEstimator::measure(const localDataStruct &fdm, double values[],
+			     double rates[]) const
+{
+  double metersPerSecond = FEET2MET * RAD2DEG / EARTH_RADIUS;
+
+  values[LatChannel]     = fdm.latitude;
+  values[LonChannel]     = fdm.longitude;
+  values[AltChannel]     = fdm.altitude;
+  values[RollChannel]    = fdm.roll;
+  values[PitchChannel]   = fdm.pitch;
+  values[HeadingChannel] = fdm.heading;
+
+  rates[LatChannel]      = fdm.vNorth * metersPerSecond;
+  rates[LonChannel]      = fdm.vEast  * metersPerSecond /
+    cos(fdm.latitude * DEG2RAD);
+  rates[AltChannel]      = -fdm.vDown;
+  rates[RollChannel]     = fdm.rollRate;
+  rates[PitchChannel]    = fdm.pitchRate;
+  rates[HeadingChannel]  = fdm.yawRate;
+}
+
+
+
+void StateEstimator::startFilters(const localDataStruct &fdm)
+{
+  double values[NumberOfChannels], rates[NumberOfChannels];
+
+  measure(fdm, values, rates);
+  setNoise(fdm);
+
+  for (int i = 0; i < NumberOfChannels; i++)
+    {
+      channels[i].value = values[i];
+      channels[i].rate  = rates[i];
+      channels[i].p00   = noise[i].value * noise[i].value;
+      channels[i].p01   = 0.0;
+      channels[i].p11   = noise[i].rate * noise[i].rate;
+    }
+}
+
+
+
+// Meters for lat/lon turned into degrees
+// where the aircraft is, close enough for
+// as long as a flight
+void StateEstimator::setNoise(const localDataStruct &fdm)
+{
+  double latDegrees = RAD2DEG / EARTH_RADIUS;
+  double lonDegrees = latDegrees / cos(fdm.latitude * DEG2RAD);
+
+  //                   acceleration        value              rate
+  kalmanNoise lat  = { 5.0 * latDegrees,   0.5 * latDegrees,  0.3 * latDegrees };
+  kalmanNoise lon  = { 5.0 * lonDegrees,   0.5 * lonDegrees,  0.3 * lonDegrees };
+  kalmanNoise alt  = { 5.0 * MET2FEET,     0.5 * MET2FEET,    0.3 * MET2FEET };
+  kalmanNoise turn = { 30.0,               0.2,               1.0 };
+
+  noise[LatChannel]     = lat;
+  noise[LonChannel]     = lon;
+  noise[AltChannel]     = alt;
+  noise[RollChannel]    = turn;
+  noise[PitchChannel]   = turn;
+  noise[HeadingChannel] = turn;
+}
@@ -0,0 +1,139 @@
+// Where the aircraft is now, not where it
+// was when FlightGear sent the last packet.
+//
+// Every FDM sample is already a network hop
+// old when it arrives, and the controls worked
+// out from it take a while more to reach
+// FlightGear. The estimator takes each sample
+// with the time it was received, and moves
+// the pose forward with the rates FlightGear
+// sends along (roll, pitch and yaw rates, and
+// the north, east and down velocities) to the
+// time the controls will be acted on.
+//
+// With filtering on, each of those is a small
+// Kalman filter (value and rate, constant rate
+// model) instead of the last sample, which
+// evens out the jitter in when packets arrive,
+// and carries on through a dropped one. Either
+// way it won't guess more than
+// ESTIMATOR_MAX_EXTRAPOLATION past the last
+// sample, if the packets stop so does it.
+
+
+#ifndef STATEESTIMATOR_H
+#define STATEESTIMATOR_H
+
+
+#include "fgFdmReceiver.h"
+#include "telemetryBus.h"
+
+
+
+// Seconds from a packet leaving FlightGear
+// to it being received, and from predict()
+// to the controls being acted on. Both are a
+// guess, running on one machine the first is
+// next to nothing, the second about half a
+// frame of FlightGear's 30 Hz.
+#ifndef ESTIMATOR_TRANSPORT_DELAY
+#define ESTIMATOR_TRANSPORT_DELAY 0.002
+#endif
+
+#ifndef ESTIMATOR_LEAD_TIME
+#define ESTIMATOR_LEAD_TIME       0.017
+#endif
+
+// Seconds past the last sample
+#define ESTIMATOR_MAX_EXTRAPOLATION 0.5
+
+
+
+
+// One quantity and how fast it's changing,
+// with their covariance
+struct kalmanChannel
+{
+  double value;
+  double rate;
+  double p00, p01, p11;
+};
+
+
+// How far off the model and the measurements
+// can be, as standard deviations. Changes of
+// the rate a second, and the measured value
+// and rate.
+struct kalmanNoise
+{
+  double acceleration;
+  double value;
+  double rate;
+};
+
+
+
+
+class StateEstimator
+{
+ public:
+  StateEstimator();
+
+  void   setTransportDelay(double seconds);
+  void   setLeadTime(double seconds);
+  double getLeadTime() const;
+
+  // Off by default, plain dead reckoning
+  // from the last sample
+  void   setFiltering(bool on);
+
+  // A sample off the telemetry bus,
+  // ones already seen are ignored
+  void   addSample(const telemetrySample &sample);
+
+  // The state at time + the lead time, time
+  // is CLOCK_MONOTONIC seconds like the
+  // samples'. False before the first sample.
+  bool   predict(double time, localDataStruct &state) const;
+
+  // Seconds since the last sample was sent
+  double getAge(double time) const;
+
+
+ private:
+  // The channels, lat/lon/alt in degrees
+  // and feet like localDataStruct
+  enum
+    {
+      LatChannel,
+      LonChannel,
+      AltChannel,
+      RollChannel,
+      PitchChannel,
+      HeadingChannel,
+      NumberOfChannels
+    };
+
+  localDataStruct last;
+  double          lastTime;   // when it was sent
+  unsigned long long lastSequence;
+  bool            haveSample;
+
+  double transportDelay;
+  double leadTime;
+  bool   filtering;
+
+  kalmanChannel channels[NumberOfChannels];
+  kalmanNoise   noise[NumberOfChannels];
+  double        filterTime;
+
+  void measure(const localDataStruct &fdm, double values[],
+	       double rates[]) const;
+  void startFilters(const localDataStruct &fdm);
+  void setNoise(const localDataStruct &fdm);
+};
+
+
+
+
+#endif // STATEESTIMATOR_H
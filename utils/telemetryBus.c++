@@ -0,0 +1,367 @@
+// Shared memory FDM telemetry,
+// see telemetryBus.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+
+#include "telemetryBus.h"
+
+
+
+
+// The ring's shared between processes,
+// so not the FUTEX_PRIVATE_ ones
+static void futexWait(std::atomic<unsigned int> *word, unsigned int value,
+		      double timeout)
+{
+  struct timespec ts;
+
+  ts.tv_sec  = (time_t)timeout;
+  ts.tv_nsec = (long)((timeout - ts.tv_sec) * 1e9);
+
+  syscall(SYS_futex, (unsigned int*)word, FUTEX_WAIT, value, &ts, NULL, 0);
+}
+
+
+static void futexWakeAll(std::atomic<unsigned int> *word)
+{
+  syscall(SYS_futex, (unsigned int*)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+
+
+static double secondsNow()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+
+
+/******************************************
+ TelemetryBus
+*******************************************/
+
+
+
+TelemetryBus::TelemetryBus()
+{
+  sequence = 0;
+
+  if ((memFd = memfd_create("fdmTelemetry",
+			    MFD_CLOEXEC | MFD_ALLOW_SEALING)) == -1)
+    {
+      perror("TelemetryBus::constructor: memfd_create");
+      exit(1);
+    }
+
+  // Sealed at its size, so a reader in another
+  // process can trust what it maps
+  if ((ftruncate(memFd, sizeof(telemetryRing)) == -1) ||
+      (fcntl(memFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) == -1))
+    {
+      perror("TelemetryBus::constructor: sizing the ring");
+      exit(1);
+    }
+
+  ring = (telemetryRing*)mmap(NULL, sizeof(telemetryRing),
+			      PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+
+  if (ring == MAP_FAILED)
+    {
+      perror("TelemetryBus::constructor: mmap");
+      exit(1);
+    }
+
+  // A new memfd is all zeroes, every stamp
+  // already says nothing's there
+  ring->slots      = TELEMETRY_SLOTS;
+  ring->sampleSize = sizeof(telemetrySample);
+  ring->head.store(0);
+  ring->published.store(0);
+  ring->waiters.store(0);
+  ring->magic      = TELEMETRY_MAGIC;
+}
+
+
+
+TelemetryBus::~TelemetryBus()
+{
+  munmap(ring, sizeof(telemetryRing));
+  close(memFd);
+}
+
+
+
+void TelemetryBus::publish(double time, const localDataStruct &fdm)
+{
+  telemetrySlot *slot;
+
+  sequence++;
+  slot = &ring->slot[sequence % TELEMETRY_SLOTS];
+
+  // Readers see 0 until it's all there
+  slot->stamp.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot->sample.sequence = sequence;
+  slot->sample.time     = time;
+  slot->sample.fdm      = fdm;
+
+  slot->stamp.store(sequence, std::memory_order_release);
+  ring->head.store(sequence);
+
+  // Only a system call if someone's waiting
+  ring->published.fetch_add(1);
+
+  if (ring->waiters.load() > 0)
+    {
+      futexWakeAll(&ring->published);
+    }
+}
+
+
+
+unsigned long long TelemetryBus::getPublished() const
+{
+  return sequence;
+}
+
+
+
+telemetryRing *TelemetryBus::getRing() const
+{
+  return ring;
+}
+
+
+
+string TelemetryBus::getPath() const
+{
+  char path[64];
+
+  snprintf(path, sizeof(path), "/proc/%d/fd/%d", (int)getpid(), memFd);
+
+  return path;
+}
+
+
+
+
+/******************************************
+ TelemetrySubscriber
+*******************************************/
+
+
+
+TelemetrySubscriber::TelemetrySubscriber(const TelemetryBus &bus)
+{
+  ring   = bus.getRing();
+  mapped = false;
+  cursor = ring->head.load() + 1;
+  lost   = 0;
+}
+
+
+
+TelemetrySubscriber::TelemetrySubscriber(const char *path)
+{
+  struct stat fileInfo;
+  int         fd;
+
+  mapped = true;
+  lost   = 0;
+
+  if ((fd = open(path, O_RDWR | O_CLOEXEC)) == -1)
+    {
+      cout<<"TelemetrySubscriber: can't open "<<path<<": "
+	  <<strerror(errno)<<endl;
+      exit(1);
+    }
+
+  if ((fstat(fd, &fileInfo) == -1) ||
+      (fileInfo.st_size != (off_t)sizeof(telemetryRing)))
+    {
+      cout<<"TelemetrySubscriber: "<<path<<" isn't a telemetry ring"<<endl;
+      exit(1);
+    }
+
+  ring = (telemetryRing*)mmap(NULL, sizeof(telemetryRing),
+			      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (ring == MAP_FAILED)
+    {
+      perror("TelemetrySubscriber: mmap");
+      exit(1);
+    }
+
+  // Built with a different ring
+  if ((ring->magic != TELEMETRY_MAGIC) ||
+      (ring->slots != TELEMETRY_SLOTS) ||
+      (ring->sampleSize != sizeof(telemetrySample)))
+    {
+      cout<<"TelemetrySubscriber: "<<path<<" is a different "
+	  <<"kind of telemetry ring"<<endl;
+      exit(1);
+    }
+
+  cursor = ring->head.load() + 1;
+}
+
+
+
+TelemetrySubscriber::~TelemetrySubscriber()
+{
+  if (mapped)
+    {
+      munmap(ring, sizeof(telemetryRing));
+    }
+}
+
+
+
+bool TelemetrySubscriber::next(telemetrySample &sample)
+{
+  unsigned long long head = ring->head.load();
+
+  while (cursor <= head)
+    {
+      // Lapped, skip straight to the oldest
+      // one that can still be there
+      if (head - cursor >= TELEMETRY_SLOTS)
+	{
+	  lost  += head - cursor - TELEMETRY_SLOTS + 1;
+	  cursor = head - TELEMETRY_SLOTS + 1;
+	}
+
+      if (readSlot(cursor, sample))
+	{
+	  cursor++;
+	  return true;
+	}
+
+      // Overwritten while we were at it
+      lost++;
+      cursor++;
+    }
+
+  return false;
+}
+
+
+
+bool TelemetrySubscriber::waitForNext(telemetrySample &sample, double timeout)
+{
+  double       giveUp = secondsNow() + timeout;
+  double       left;
+  unsigned int published;
+  bool         gotOne;
+
+  while (true)
+    {
+      // Read before looking, if anything's
+      // published after this the futex
+      // won't sleep
+      published = ring->published.load();
+
+      if (next(sample))
+	{
+	  return true;
+	}
+
+      if ((left = giveUp - secondsNow()) <= 0.0)
+	{
+	  return false;
+	}
+
+      ring->waiters.fetch_add(1);
+
+      if (!(gotOne = next(sample)))
+	{
+	  futexWait(&ring->published, published, left);
+	}
+
+      ring->waiters.fetch_sub(1);
+
+      if (gotOne)
+	{
+	  return true;
+	}
+    }
+}
+
+
+
+bool TelemetrySubscriber::latest(telemetrySample &sample)
+{
+  unsigned long long head;
+
+  while ((head = ring->head.load()) > 0)
+    {
+      if (readSlot(head, sample))
+	{
+	  if (cursor <= head)
+	    {
+	      cursor = head + 1;
+	    }
+	  return true;
+	}
+    }
+
+  return false;
+}
+
+
+
+unsigned long long TelemetrySubscriber::getLost() const
+{
+  return lost;
+}
+
+
+
+
+/******************************************
+ Private Functions
+*******************************************/
+
+
+
+bool TelemetrySubscriber::readSlot(unsigned long long wanted,
+				   telemetrySample &sample) const
+{
+  const telemetrySlot *slot = &ring->slot[wanted % TELEMETRY_SLOTS];
+
+  if (slot->stamp.load(std::memory_order_acquire) != wanted)
+    {
+      return false;
+    }
+
+  sample = slot->sample;
+
+  // Still the same one after the copy,
+  // nothing was written over it
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  return slot->stamp.load(std::memory_order_relaxed) == wanted;
+}
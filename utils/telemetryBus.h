@@ -0,0 +1,152 @@
+// One FDM receiver, any number of readers.
+//
+// The receiving thread publish()es every
+// decoded FDM packet into a ring of samples
+// in shared memory (a memfd). Each reader is
+// a TelemetrySubscriber with its own place
+// in the ring, so the GVP forwarder, the
+// control loop, a recorder or a monitor all
+// see the same packets without a socket each,
+// and nobody but the receiver binds the port.
+//
+// Nobody takes a lock. Every slot has a stamp,
+// the sample's sequence number once it's fully
+// written, 0 while it's being written. A reader
+// copies the sample out and checks the stamp
+// didn't change under it (a seqlock). The
+// writer never waits for readers, a reader
+// that falls a whole ring behind loses the
+// oldest samples, and is told how many.
+//
+// Other processes can read it too, through
+// getPath() (/proc/<pid>/fd/<fd>).
+
+
+#ifndef TELEMETRYBUS_H
+#define TELEMETRYBUS_H
+
+
+#include <atomic>
+#include <string>
+
+#include "fgFdmReceiver.h"
+
+
+
+// About 4 seconds at FlightGear's 30 Hz
+#ifndef TELEMETRY_SLOTS
+#define TELEMETRY_SLOTS 128
+#endif
+
+// Tells a reader it's mapped a ring
+// and the ring's the shape it expects
+#define TELEMETRY_MAGIC 0x464d4454  // "TDMF"
+
+
+
+struct telemetrySample
+{
+  unsigned long long sequence;  // 1, 2, 3... as published
+  double             time;      // CLOCK_MONOTONIC seconds when received
+  localDataStruct    fdm;
+};
+
+
+
+// What's in the shared memory
+struct telemetrySlot
+{
+  std::atomic<unsigned long long> stamp;
+  telemetrySample                 sample;
+};
+
+struct telemetryRing
+{
+  unsigned int magic;
+  unsigned int slots;
+  unsigned int sampleSize;
+
+  // Written every publish, kept off
+  // the slots' cache lines
+  alignas(64) std::atomic<unsigned long long> head;
+  std::atomic<unsigned int>       published;  // futex word
+  std::atomic<unsigned int>       waiters;
+
+  alignas(64) telemetrySlot slot[TELEMETRY_SLOTS];
+};
+
+
+
+
+
+// The writing end, owns the memory
+class TelemetryBus
+{
+ public:
+  TelemetryBus();
+  ~TelemetryBus();
+
+  // Only ever from the one thread
+  void publish(double time, const localDataStruct &fdm);
+
+  // How many have been published
+  unsigned long long getPublished() const;
+
+  telemetryRing *getRing() const;
+  std::string    getPath() const;
+
+
+ private:
+  int                memFd;
+  telemetryRing     *ring;
+  unsigned long long sequence;
+};
+
+
+
+
+
+// One reader. Starts at whatever is
+// published after it subscribes.
+class TelemetrySubscriber
+{
+ public:
+  // In the same process
+  TelemetrySubscriber(const TelemetryBus &bus);
+
+  // In another one, from the bus's getPath()
+  TelemetrySubscriber(const char *path);
+
+  ~TelemetrySubscriber();
+
+  // The next sample in order, false if
+  // there isn't a new one yet
+  bool next(telemetrySample &sample);
+
+  // The same, but waits up to timeout
+  // seconds for one to turn up
+  bool waitForNext(telemetrySample &sample, double timeout);
+
+  // Just the newest, skipping any in
+  // between (they don't count as lost),
+  // false if nothing's been published
+  bool latest(telemetrySample &sample);
+
+  // Samples overwritten before
+  // this reader got to them
+  unsigned long long getLost() const;
+
+
+ private:
+  telemetryRing     *ring;
+  bool               mapped;
+  unsigned long long cursor;
+  unsigned long long lost;
+
+  bool readSlot(unsigned long long wanted, telemetrySample &sample) const;
+};
+
+
+
+
+#endif // TELEMETRYBUS_H
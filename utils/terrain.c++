@@ -0,0 +1,782 @@
+// DTED terrain tiles, mapped and cached,
+// see terrain.h
+
+
+
+#include <iostream>
+using namespace std;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#include "terrain.h"
+
+
+
+// DTED's headers, UHL, DSI and ACC records,
+// then a record per longitude line of
+//   0xAA, block count (3), lon count (2),
+//   lat count (2), the posts (2 each, south
+//   to north), checksum (4)
+#define DTED_HEADER_LENGTH  3428
+#define DTED_RECORD_START   8
+#define DTED_RECORD_EXTRA   12
+#define DTED_SENTINEL       0xAA
+#define DTED_VOID           -32767
+
+#define TERRAIN_METERS_PER_DEGREE 111320.0
+
+#ifndef DEG2RAD
+#define DEG2RAD 0.017453292519943295
+#endif
+
+
+
+
+// Digits in a fixed width DTED field,
+// -1 if they aren't
+static int dtedNumber(const unsigned char *field, int length)
+{
+  int number = 0;
+
+  for (int i = 0; i < length; i++)
+    {
+      if ((field[i] < '0') || (field[i] > '9'))
+	{
+	  return -1;
+	}
+      number = number * 10 + (field[i] - '0');
+    }
+
+  return number;
+}
+
+
+
+// DDDMMSSH
+static double dtedAngle(const unsigned char *field)
+{
+  double angle = dtedNumber(field, 3) + dtedNumber(field + 3, 2) / 60.0 +
+    dtedNumber(field + 5, 2) / 3600.0;
+
+  return ((field[7] == 'W') || (field[7] == 'S')) ? -angle : angle;
+}
+
+
+
+
+Terrain::Terrain(string tileDirectory, int cacheTiles)
+{
+  directory = tileDirectory;
+  maxTiles  = (cacheTiles > 0) ? cacheTiles : 1;
+
+  tiles = new terrainTile[maxTiles];
+  for (int i = 0; i < maxTiles; i++)
+    {
+      tiles[i].readers.store(0);
+      tiles[i].lastUsed.store(0);
+      tiles[i].cell     = -1;
+      tiles[i].retiring = false;
+      tiles[i].map      = NULL;
+      tiles[i].mapSize  = 0;
+    }
+
+  cellTiles  = new atomic<terrainTile*>[TERRAIN_CELLS];
+  cellStates = new atomic<unsigned char>[TERRAIN_CELLS];
+  for (int i = 0; i < TERRAIN_CELLS; i++)
+    {
+      cellTiles[i].store(NULL);
+      cellStates[i].store(CellUnknown);
+    }
+
+  wanted.store(0);
+  useClock.store(0);
+  loads.store(0);
+  evictions.store(0);
+  misses.store(0);
+
+  pthread_mutex_init(&loadLock, NULL);
+
+  // Queries wake the loader through this,
+  // it's there as long as they can be
+  if (pipe2(wakePipe, O_NONBLOCK | O_CLOEXEC) == -1)
+    {
+      perror("Terrain: pipe2");
+      wakePipe[0] = -1;
+      wakePipe[1] = -1;
+    }
+
+  running = false;
+  stopping.store(false);
+}
+
+
+
+Terrain::~Terrain()
+{
+  stop();
+
+  for (int i = 0; i < maxTiles; i++)
+    {
+      if (tiles[i].map)
+	{
+	  unmapTile(&tiles[i]);
+	}
+    }
+
+  for (int i = 0; i < 2; i++)
+    {
+      if (wakePipe[i] != -1)
+	{
+	  close(wakePipe[i]);
+	}
+    }
+
+  pthread_mutex_destroy(&loadLock);
+
+  delete [] cellStates;
+  delete [] cellTiles;
+  delete [] tiles;
+}
+
+
+
+bool Terrain::start()
+{
+  if (running)
+    {
+      return true;
+    }
+
+  if (wakePipe[0] == -1)
+    {
+      return false;
+    }
+
+  stopping.store(false);
+
+  if (pthread_create(&loaderThread, NULL, loaderThreadFunc, this) != 0)
+    {
+      perror("Terrain: starting the loader thread");
+      return false;
+    }
+  running = true;
+
+  cout<<"Terrain: loading tiles from "<<directory<<" as they're needed"<<endl;
+
+  return true;
+}
+
+
+
+void Terrain::stop()
+{
+  if (running)
+    {
+      stopping.store(true);
+
+      // Wakes the poll() up
+      if (write(wakePipe[1], "x", 1) != 1)
+	{
+	  perror("Terrain::stop");
+	}
+      pthread_join(loaderThread, NULL);
+      running = false;
+    }
+}
+
+
+
+int Terrain::preload(double south, double west, double north, double east)
+{
+  int loaded = 0;
+  int cell;
+
+  pthread_mutex_lock(&loadLock);
+
+  for (double lat = floor(south); lat <= floor(north); lat++)
+    {
+      for (double lon = floor(west); lon <= floor(east); lon++)
+	{
+	  cell = cellOf(lat, lon);
+
+	  if ((cell >= 0) && loadCell(cell))
+	    {
+	      loaded++;
+	    }
+	}
+    }
+
+  pthread_mutex_unlock(&loadLock);
+
+  return loaded;
+}
+
+
+
+bool Terrain::height(double lat, double lon, double &meters)
+{
+  terrainTile *tile = acquire(cellOf(lat, lon));
+  bool         known;
+
+  if (tile == NULL)
+    {
+      return false;
+    }
+
+  known = interpolate(tile, lat, lon, meters);
+  release(tile);
+
+  return known;
+}
+
+
+
+// A straight line on a flat earth, close
+// enough for the few kilometers ahead.
+// Holds on to a tile until the line
+// crosses into the next one.
+bool Terrain::highestAhead(double lat, double lon, double heading,
+			   double distance, double &meters)
+{
+  terrainTile *tile     = NULL;
+  int          tileCell = -1;
+  int          steps    = (int)ceil(distance / TERRAIN_LOOKAHEAD_STEP);
+  double       north    = cos(heading * DEG2RAD) / TERRAIN_METERS_PER_DEGREE;
+  double       east     = sin(heading * DEG2RAD) /
+    (TERRAIN_METERS_PER_DEGREE * cos(lat * DEG2RAD));
+  double       highest  = -1e30;
+  double       along, pointLat, pointLon, ground;
+  int          cell;
+  bool         known    = true;
+
+  for (int i = 0; (i <= steps) && known; i++)
+    {
+      along    = (i < steps) ? i * TERRAIN_LOOKAHEAD_STEP : distance;
+      pointLat = lat + north * along;
+      pointLon = lon + east * along;
+      cell     = cellOf(pointLat, pointLon);
+
+      if ((cell != tileCell) || (tile == NULL))
+	{
+	  if (tile)
+	    {
+	      release(tile);
+	    }
+
+	  tile     = acquire(cell);
+	  tileCell = cell;
+
+	  if (tile == NULL)
+	    {
+	      known = false;
+	      break;
+	    }
+	}
+
+      if (pointLon >= 180.0)
+	{
+	  pointLon -= 360.0;
+	}
+      else if (pointLon < -180.0)
+	{
+	  pointLon += 360.0;
+	}
+
+      known = interpolate(tile, pointLat, pointLon, ground);
+
+      if (known && (ground > highest))
+	{
+	  highest = ground;
+	}
+    }
+
+  if (tile)
+    {
+      release(tile);
+    }
+
+  if (known)
+    {
+      meters = highest;
+    }
+
+  return known;
+}
+
+
+
+long Terrain::getLoads() const
+{
+  return loads.load();
+}
+
+
+long Terrain::getEvictions() const
+{
+  return evictions.load();
+}
+
+
+long Terrain::getMisses() const
+{
+  return misses.load();
+}
+
+
+
+
+/******************************************
+ Private Functions
+*******************************************/
+
+
+
+void *Terrain::loaderThreadFunc(void *loader)
+{
+  Terrain      *terrain = (Terrain*)loader;
+  struct pollfd waitFor;
+  char          buffer[64];
+
+  waitFor.fd     = terrain->wakePipe[0];
+  waitFor.events = POLLIN;
+
+  while (!terrain->stopping.load())
+    {
+      if ((poll(&waitFor, 1, TERRAIN_LOAD_PERIOD) == -1) && (errno != EINTR))
+	{
+	  perror("Terrain: poll");
+	  return NULL;
+	}
+
+      while (read(terrain->wakePipe[0], buffer, sizeof(buffer)) > 0)
+	{
+	}
+
+      if (terrain->stopping.load())
+	{
+	  break;
+	}
+
+      // The LRU's clock
+      terrain->useClock.fetch_add(1, memory_order_relaxed);
+
+      terrain->loadWanted();
+    }
+
+  return NULL;
+}
+
+
+
+void Terrain::loadWanted()
+{
+  pthread_mutex_lock(&loadLock);
+
+  for (int cell = 0; (cell < TERRAIN_CELLS) && (wanted.load() > 0); cell++)
+    {
+      if (cellStates[cell].load() == CellWanted)
+	{
+	  loadCell(cell);
+	}
+    }
+
+  pthread_mutex_unlock(&loadLock);
+}
+
+
+
+// A query's hold on the cell's tile, so it
+// isn't unmapped until release(). The tile
+// is looked up again after taking the hold,
+// the loader clears the cell before it
+// checks for holds, so one or the other
+// sees the change.
+Terrain::terrainTile *Terrain::acquire(int cell)
+{
+  terrainTile  *tile;
+  unsigned int  now;
+
+  if (cell < 0)
+    {
+      return NULL;
+    }
+
+  tile = cellTiles[cell].load();
+
+  if (tile == NULL)
+    {
+      misses.fetch_add(1, memory_order_relaxed);
+      request(cell);
+      return NULL;
+    }
+
+  tile->readers.fetch_add(1);
+
+  if (cellTiles[cell].load() != tile)
+    {
+      tile->readers.fetch_sub(1);
+      return NULL;
+    }
+
+  now = useClock.load(memory_order_relaxed);
+  if (tile->lastUsed.load(memory_order_relaxed) != now)
+    {
+      tile->lastUsed.store(now, memory_order_relaxed);
+    }
+
+  return tile;
+}
+
+
+
+void Terrain::release(terrainTile *tile)
+{
+  tile->readers.fetch_sub(1, memory_order_release);
+}
+
+
+
+// Only the first ask wakes the loader
+void Terrain::request(int cell)
+{
+  unsigned char expected = CellUnknown;
+
+  if (cellStates[cell].load(memory_order_relaxed) != CellUnknown)
+    {
+      return;
+    }
+
+  if (cellStates[cell].compare_exchange_strong(expected, CellWanted))
+    {
+      wanted.fetch_add(1);
+
+      if ((wakePipe[1] != -1) && (write(wakePipe[1], "w", 1) != 1) &&
+	  (errno != EAGAIN))
+	{
+	  perror("Terrain: waking the loader");
+	}
+    }
+}
+
+
+
+// With loadLock held. False if there's no
+// tile for the cell, or no room for it yet.
+bool Terrain::loadCell(int cell)
+{
+  terrainTile *tile;
+  string       path;
+
+  if (cellTiles[cell].load() != NULL)
+    {
+      return true;
+    }
+
+  if (cellStates[cell].load() == CellMissing)
+    {
+      return false;
+    }
+
+  // Nothing's evicted for a tile
+  // that isn't there
+  path = findTile(cell);
+
+  if (path.empty())
+    {
+      tile = NULL;
+    }
+  else
+    {
+      tile = freeTile();
+      if (tile == NULL)
+	{
+	  return false;
+	}
+    }
+
+  if ((tile == NULL) || !mapTile(tile, path))
+    {
+      if (cellStates[cell].exchange(CellMissing) == CellWanted)
+	{
+	  wanted.fetch_sub(1);
+	}
+      return false;
+    }
+
+  tile->lastUsed.store(useClock.load());
+  tile->cell = cell;
+  loads.fetch_add(1);
+
+  if (cellStates[cell].exchange(CellLoaded) == CellWanted)
+    {
+      wanted.fetch_sub(1);
+    }
+
+  cellTiles[cell].store(tile);
+
+  return true;
+}
+
+
+
+// A tile that's not in use, unmapping the
+// least recently used one if they all are.
+// NULL while it's still held by a query.
+Terrain::terrainTile *Terrain::freeTile()
+{
+  terrainTile  *oldest = NULL;
+  unsigned int  now    = useClock.load();
+
+  for (int i = 0; i < maxTiles; i++)
+    {
+      if (tiles[i].retiring && (tiles[i].readers.load() == 0))
+	{
+	  unmapTile(&tiles[i]);
+	}
+    }
+
+  for (int i = 0; i < maxTiles; i++)
+    {
+      if ((tiles[i].cell == -1) && !tiles[i].retiring)
+	{
+	  return &tiles[i];
+	}
+
+      if (!tiles[i].retiring &&
+	  ((oldest == NULL) ||
+	   (now - tiles[i].lastUsed.load() > now - oldest->lastUsed.load())))
+	{
+	  oldest = &tiles[i];
+	}
+    }
+
+  if (oldest == NULL)
+    {
+      return NULL;
+    }
+
+  cellTiles[oldest->cell].store(NULL);
+  cellStates[oldest->cell].store(CellUnknown);
+  oldest->retiring = true;
+  evictions.fetch_add(1);
+
+  if (oldest->readers.load() != 0)
+    {
+      return NULL;
+    }
+
+  unmapTile(oldest);
+  return oldest;
+}
+
+
+
+// The finest level there is of the cell,
+// empty if there's none
+string Terrain::findTile(int cell) const
+{
+  static const char *extensions[] = { ".dt2", ".dt1", ".dt0" };
+
+  string path;
+
+  for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++)
+    {
+      path = tilePath(cell, extensions[i]);
+
+      if (access(path.c_str(), R_OK) == 0)
+	{
+	  return path;
+	}
+    }
+
+  return "";
+}
+
+
+
+bool Terrain::mapTile(terrainTile *tile, const string &path)
+{
+  const unsigned char *header;
+  struct stat          status;
+  int                  fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1)
+    {
+      perror(("Terrain: opening " + path).c_str());
+      return false;
+    }
+
+  if ((fstat(fd, &status) == -1) || (status.st_size < DTED_HEADER_LENGTH))
+    {
+      cout<<"Terrain: "<<path<<" is too short for a DTED file"<<endl;
+      close(fd);
+      return false;
+    }
+
+  // Faulted in now, on this thread,
+  // not by the first query to touch it
+  tile->mapSize = status.st_size;
+  tile->map     = mmap(NULL, tile->mapSize, PROT_READ,
+		       MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+
+  if (tile->map == MAP_FAILED)
+    {
+      perror(("Terrain: mapping " + path).c_str());
+      tile->map = NULL;
+      return false;
+    }
+
+  header = (const unsigned char*)tile->map;
+
+  tile->originLon    = dtedAngle(header + 4);
+  tile->originLat    = dtedAngle(header + 12);
+  tile->lonSpacing   = dtedNumber(header + 20, 4) / 36000.0;
+  tile->latSpacing   = dtedNumber(header + 24, 4) / 36000.0;
+  tile->lonLines     = dtedNumber(header + 47, 4);
+  tile->latPoints    = dtedNumber(header + 51, 4);
+  tile->recordLength = DTED_RECORD_EXTRA + 2 * (size_t)tile->latPoints;
+  tile->posts        = header + DTED_HEADER_LENGTH + DTED_RECORD_START;
+
+  if (memcmp(header, "UHL", 3) || (tile->lonSpacing <= 0.0) ||
+      (tile->latSpacing <= 0.0) || (tile->lonLines < 2) ||
+      (tile->latPoints < 2) ||
+      (tile->mapSize < DTED_HEADER_LENGTH +
+       tile->lonLines * tile->recordLength) ||
+      (header[DTED_HEADER_LENGTH] != DTED_SENTINEL))
+    {
+      cout<<"Terrain: "<<path<<" isn't a DTED file we can read"<<endl;
+      munmap(tile->map, tile->mapSize);
+      tile->map = NULL;
+      return false;
+    }
+
+  return true;
+}
+
+
+
+void Terrain::unmapTile(terrainTile *tile)
+{
+  munmap(tile->map, tile->mapSize);
+
+  tile->map      = NULL;
+  tile->mapSize  = 0;
+  tile->cell     = -1;
+  tile->retiring = false;
+}
+
+
+
+// directory/w122/n36.dt1
+string Terrain::tilePath(int cell, const char *extension) const
+{
+  char name[32];
+  int  lat = cell / 360 - 90;
+  int  lon = cell % 360 - 180;
+
+  snprintf(name, sizeof(name), "/%c%03d/%c%02d%s",
+	   (lon < 0) ? 'w' : 'e', abs(lon),
+	   (lat < 0) ? 's' : 'n', abs(lat), extension);
+
+  return directory + name;
+}
+
+
+
+int Terrain::cellOf(double lat, double lon)
+{
+  int latCell, lonCell;
+
+  if ((lat < -90.0) || (lat > 90.0))
+    {
+      return -1;
+    }
+
+  lon = fmod(lon + 180.0, 360.0);
+  if (lon < 0.0)
+    {
+      lon += 360.0;
+    }
+
+  latCell = (int)floor(lat) + 90;
+  lonCell = (int)floor(lon);
+
+  if (latCell > 179)
+    {
+      latCell = 179;
+    }
+
+  return latCell * 360 + lonCell;
+}
+
+
+
+// Bilinear between the four posts
+// around lat, lon
+bool Terrain::interpolate(const terrainTile *tile, double lat, double lon,
+			  double &meters)
+{
+  double x = (lon - tile->originLon) / tile->lonSpacing;
+  double y = (lat - tile->originLat) / tile->latSpacing;
+  double fx, fy;
+  int    column, row;
+  int    h00, h10, h01, h11;
+
+  if ((x < 0.0) || (y < 0.0) ||
+      (x > tile->lonLines - 1) || (y > tile->latPoints - 1))
+    {
+      return false;
+    }
+
+  column = (int)x;
+  row    = (int)y;
+
+  if (column > tile->lonLines - 2)
+    {
+      column = tile->lonLines - 2;
+    }
+  if (row > tile->latPoints - 2)
+    {
+      row = tile->latPoints - 2;
+    }
+
+  fx = x - column;
+  fy = y - row;
+
+  h00 = post(tile, column,     row);
+  h10 = post(tile, column + 1, row);
+  h01 = post(tile, column,     row + 1);
+  h11 = post(tile, column + 1, row + 1);
+
+  if ((h00 == DTED_VOID) || (h10 == DTED_VOID) ||
+      (h01 == DTED_VOID) || (h11 == DTED_VOID))
+    {
+      return false;
+    }
+
+  meters = (h00 * (1.0 - fx) + h10 * fx) * (1.0 - fy) +
+    (h01 * (1.0 - fx) + h11 * fx) * fy;
+
+  return true;
+}
+
+
+
+// Big endian, sign and magnitude
+int Terrain::post(const terrainTile *tile, int column, int row)
+{
+  const unsigned char *p = tile->posts + column * tile->recordLength + 2 * row;
+  int                  value = ((p[0] & 0x7f) << 8) | p[1];
+
+  return (p[0] & 0x80) ? -value : value;
+}
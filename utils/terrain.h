@@ -0,0 +1,176 @@
+// The height of the ground, from DTED
+// elevation tiles on disk, for flying a
+// safe height over it instead of trusting
+// a fixed climb.
+//
+// Tiles are the usual one degree DTED
+// files, laid out directory/w122/n36.dt1
+// (level 2, 1 or 0, the finest there is).
+// Each is mapped whole and read in place,
+// the posts are never copied or decoded
+// ahead of time.
+//
+// Up to TERRAIN_CACHE_TILES are kept mapped
+// at once. Asking about somewhere that isn't
+// loaded comes back false, and the loader
+// thread maps that tile shortly after, making
+// room by letting go of the least recently
+// used one. The file work all happens there
+// (or in preload()), the tiles are faulted
+// in when they're mapped, so a query is a
+// few reads of memory.
+//
+// Queries take no locks and can come from
+// any number of threads at once. A tile in
+// use by a query is never unmapped under it,
+// the loader waits for it to be let go.
+
+
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+
+#include <atomic>
+#include <string>
+#include <pthread.h>
+
+
+
+// Tiles mapped at once. A level 1 tile is
+// about 2.8 MB, a level 2 one about 25 MB.
+#ifndef TERRAIN_CACHE_TILES
+#define TERRAIN_CACHE_TILES 16
+#endif
+
+// How often the loader looks for tiles
+// that have been asked for, if it isn't
+// woken up first
+#define TERRAIN_LOAD_PERIOD 100  // milliseconds
+
+// Spacing of the heights checked
+// along a look ahead
+#define TERRAIN_LOOKAHEAD_STEP 90.0  // meters
+
+// One degree cells of the whole earth
+#define TERRAIN_CELLS (180 * 360)
+
+
+
+class Terrain
+{
+ public:
+  // Tiles come from under directory
+  Terrain(std::string tileDirectory, int cacheTiles = TERRAIN_CACHE_TILES);
+  ~Terrain();
+
+  // The loader thread
+  bool start();
+  void stop();
+
+  // Map the tiles covering the box now, on this
+  // thread, around the route before flying
+  // say. Returns how many are loaded.
+  int  preload(double south, double west, double north, double east);
+
+
+  // Meters above sea level at lat, lon
+  // (degrees), between the four posts around
+  // it. False if the tile isn't loaded yet,
+  // there isn't one, or the posts are void.
+  bool height(double lat, double lon, double &meters);
+
+  // The highest ground along heading (degrees
+  // true) from lat, lon, for distance meters.
+  // False if any of it isn't known.
+  bool highestAhead(double lat, double lon, double heading,
+		    double distance, double &meters);
+
+
+  long getLoads()     const;
+  long getEvictions() const;
+  long getMisses()    const;
+
+
+ private:
+  struct terrainTile
+  {
+    // Queries using it, and the
+    // loader's clock when last used
+    std::atomic<int>          readers;
+    std::atomic<unsigned int> lastUsed;
+
+    int    cell;       // -1 if not loaded
+    bool   retiring;   // waiting on readers to unmap
+
+    void  *map;
+    size_t mapSize;
+
+    const unsigned char *posts;
+    size_t recordLength;
+    int    lonLines;
+    int    latPoints;
+    double originLat;
+    double originLon;
+    double latSpacing;  // degrees
+    double lonSpacing;
+  };
+
+  enum
+    {
+      CellUnknown,
+      CellWanted,
+      CellLoaded,
+      CellMissing
+    };
+
+  std::string  directory;
+  int          maxTiles;
+  terrainTile *tiles;
+
+  // Per one degree cell, its tile
+  // if it's loaded, and whether
+  // it's been asked for
+  std::atomic<terrainTile*>  *cellTiles;
+  std::atomic<unsigned char> *cellStates;
+  std::atomic<int>            wanted;
+
+  std::atomic<unsigned int> useClock;
+  std::atomic<long>         loads;
+  std::atomic<long>         evictions;
+  std::atomic<long>         misses;
+
+  // The loader only, preload() too
+  pthread_mutex_t loadLock;
+
+  int               wakePipe[2];
+  pthread_t         loaderThread;
+  bool              running;
+  std::atomic<bool> stopping;
+
+  static void *loaderThreadFunc(void *terrain);
+  void  loadWanted();
+
+  terrainTile *acquire(int cell);
+  void         release(terrainTile *tile);
+  void         request(int cell);
+
+  bool  loadCell(int cell);
+  bool  mapTile(terrainTile *tile, const std::string &path);
+  void  unmapTile(terrainTile *tile);
+  terrainTile *freeTile();
+
+  std::string findTile(int cell) const;
+  std::string tilePath(int cell, const char *extension) const;
+
+  static int  cellOf(double lat, double lon);
+  static bool interpolate(const terrainTile *tile, double lat, double lon,
+			  double &meters);
+  static int  post(const terrainTile *tile, int column, int row);
+
+  Terrain(const Terrain&);
+  Terrain& operator=(const Terrain&);
+};
+
+
+
+#endif // TERRAIN_H
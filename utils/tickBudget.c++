@@ -0,0 +1,211 @@
+// Deadlines and stage budgets for a tick,
+// see tickBudget.h
+
+
+
+#include <iostream>
+using namespace std;
+
+
+#include "tickBudget.h"
+
+
+
+
+TickBudget::TickBudget(const char *budgetName, double deadlineSeconds)
+{
+  name           = budgetName;
+  numberOfStages = 0;
+
+  deadline       = 0.0;
+  inTick         = false;
+  tickMissed     = false;
+
+  ticks          = 0;
+  missedTicks    = 0;
+  missStreak     = 0;
+  madeStreak     = 0;
+
+  setDeadline(deadlineSeconds);
+}
+
+
+
+int TickBudget::addStage(const char *stageName, double budget)
+{
+  stage *added;
+
+  if (numberOfStages == TICKBUDGET_MAX_STAGES)
+    {
+      cout<<"TickBudget "<<name<<": no room for stage "<<stageName<<endl;
+      return -1;
+    }
+
+  added = &stages[numberOfStages];
+
+  added->name       = stageName;
+  added->budget     = budget;
+  added->worst      = 0.0;
+  added->runs       = 0;
+  added->overBudget = 0;
+  added->misses     = 0;
+  added->leftOut    = 0;
+
+  return numberOfStages++;
+}
+
+
+
+void TickBudget::setDeadline(double seconds)
+{
+  deadlineAfter = seconds;
+}
+
+
+
+void TickBudget::startTick(double time)
+{
+  if (inTick)
+    {
+      ticks++;
+
+      if (tickMissed)
+	{
+	  missedTicks++;
+	  missStreak++;
+	  madeStreak = 0;
+	}
+      else
+	{
+	  madeStreak++;
+	  missStreak = 0;
+	}
+    }
+
+  deadline   = time + deadlineAfter;
+  inTick     = true;
+  tickMissed = false;
+}
+
+
+
+double TickBudget::getDeadline() const
+{
+  return deadline;
+}
+
+
+
+bool TickBudget::fits(int stage, double time) const
+{
+  double needed = 0.0;
+
+  if ((stage < 0) || (stage >= numberOfStages))
+    {
+      return true;
+    }
+
+  for (int i = stage; i < numberOfStages; i++)
+    {
+      needed += stages[i].budget;
+    }
+
+  return time + needed <= deadline;
+}
+
+
+
+void TickBudget::ran(int stage, double started, double finished)
+{
+  double runTime = finished - started;
+
+  if ((stage < 0) || (stage >= numberOfStages))
+    {
+      return;
+    }
+
+  stages[stage].runs++;
+
+  if (runTime > stages[stage].worst)
+    {
+      stages[stage].worst = runTime;
+    }
+
+  if (runTime > stages[stage].budget)
+    {
+      stages[stage].overBudget++;
+    }
+
+  if (inTick && (finished > deadline))
+    {
+      stages[stage].misses++;
+      tickMissed = true;
+    }
+}
+
+
+
+void TickBudget::leftOut(int stage)
+{
+  if ((stage >= 0) && (stage < numberOfStages))
+    {
+      stages[stage].leftOut++;
+    }
+}
+
+
+
+int TickBudget::getMissStreak() const
+{
+  return missStreak;
+}
+
+
+int TickBudget::getMadeStreak() const
+{
+  return madeStreak;
+}
+
+
+long TickBudget::getTicks() const
+{
+  return ticks;
+}
+
+
+long TickBudget::getMissedTicks() const
+{
+  return missedTicks;
+}
+
+
+long TickBudget::getMisses(int stage) const
+{
+  return ((stage >= 0) && (stage < numberOfStages)) ?
+    stages[stage].misses : 0;
+}
+
+
+long TickBudget::getLeftOut(int stage) const
+{
+  return ((stage >= 0) && (stage < numberOfStages)) ?
+    stages[stage].leftOut : 0;
+}
+
+
+
+void TickBudget::report() const
+{
+  cout<<name<<": "<<ticks<<" ticks, "<<missedTicks<<" missed the "
+      <<deadlineAfter * 1e6<<" us deadline"<<endl;
+
+  for (int i = 0; i < numberOfStages; i++)
+    {
+      cout<<"  "<<stages[i].name<<" ("<<stages[i].budget * 1e6
+	  <<" us budget): "<<stages[i].runs<<" runs, "
+	  <<stages[i].overBudget<<" over budget, "
+	  <<stages[i].misses<<" finished past the deadline, "
+	  <<stages[i].leftOut<<" left out, "
+	  <<stages[i].worst * 1e6<<" us worst"<<endl;
+    }
+}
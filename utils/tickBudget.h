@@ -0,0 +1,99 @@
+// A deadline for each tick of a loop, shared
+// out between the stages of the tick. The
+// loop asks fits() before a stage it could
+// do without, and leaves it out (or does
+// something cheaper) if it doesn't, so the
+// stages that have to happen still happen
+// on time. ran() does the accounting.
+//
+// Per stage it counts runs, runs over the
+// stage's own budget, runs that finished
+// past the tick's deadline (misses), and
+// times it was left out. Ticks in a row
+// that missed, or didn't, say when to give
+// up on something for a while, and when
+// it's safe to go back to it.
+
+
+#ifndef TICKBUDGET_H
+#define TICKBUDGET_H
+
+
+
+#define TICKBUDGET_MAX_STAGES 8
+
+
+
+
+class TickBudget
+{
+ public:
+  // deadlineSeconds is from the start
+  // of each tick
+  TickBudget(const char *budgetName, double deadlineSeconds);
+
+  // In the order they run, returns the
+  // stage's number. Budget in seconds.
+  int    addStage(const char *stageName, double budget);
+
+  void   setDeadline(double seconds);
+
+  // Times are seconds on CLOCK_MONOTONIC.
+  // Starting a tick finishes the last one.
+  void   startTick(double time);
+  double getDeadline() const;
+
+  // Whether the stage, and every one
+  // after it, still fit before the deadline
+  bool   fits(int stage, double time) const;
+
+  void   ran(int stage, double started, double finished);
+  void   leftOut(int stage);
+
+  // Ticks in a row, up to the last one
+  // finished, that missed the deadline,
+  // or made it
+  int    getMissStreak() const;
+  int    getMadeStreak() const;
+
+  long   getTicks()       const;
+  long   getMissedTicks() const;
+  long   getMisses (int stage) const;
+  long   getLeftOut(int stage) const;
+
+  // A line for each stage
+  void   report() const;
+
+
+ private:
+  struct stage
+  {
+    const char *name;
+    double      budget;
+    double      worst;
+    long        runs;
+    long        overBudget;
+    long        misses;
+    long        leftOut;
+  };
+
+  const char *name;
+  double      deadlineAfter;
+
+  stage  stages[TICKBUDGET_MAX_STAGES];
+  int    numberOfStages;
+
+  double deadline;
+  bool   inTick;
+  bool   tickMissed;
+
+  long   ticks;
+  long   missedTicks;
+  int    missStreak;
+  int    madeStreak;
+};
+
+
+
+
+#endif // TICKBUDGET_H